@@ -0,0 +1,139 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "AssetCache.h"
+
+/******************************************************************************
+*                                                                             *
+*                       AssetCache::addMesh / addTexture                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param path                                                                *
+*           Path to the asset file.                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The handle of the asset. Equal paths always receive the same handle.       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Interns the path without loading anything.                                 *
+*                                                                             *
+*******************************************************************************/
+GLuint AssetCache::addMesh(const std::string &path)
+{
+	/* Return the existing handle if the path is known. */
+	std::map<std::string, GLuint>::iterator it = meshHandles.find(path);
+	if (it != meshHandles.end())
+		return it->second;
+
+	/* Otherwise register a new, not yet loaded, mesh. */
+	GLuint handle = meshFiles.size();
+	meshFiles.push_back(path);
+	meshes.push_back(NULL);
+	meshTried.push_back(false);
+	meshHandles[path] = handle;
+	return handle;
+}
+GLuint AssetCache::addTexture(const std::string &path)
+{
+	/* Return the existing handle if the path is known. */
+	std::map<std::string, GLuint>::iterator it = textureHandles.find(path);
+	if (it != textureHandles.end())
+		return it->second;
+
+	/* Otherwise register a new, not yet loaded, texture. */
+	GLuint handle = textureFiles.size();
+	textureFiles.push_back(path);
+	textures.push_back((GLuint) -1);
+	textureTried.push_back(false);
+	textureHandles[path] = handle;
+	return handle;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        AssetCache::getMesh / getTexture                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param handle                                                              *
+*           Handle returned by addMesh / addTexture.                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The loaded mesh (NULL on failure) / texture ID (-1 on failure).            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Loads the asset the first time it is requested and returns the shared      *
+*  instance afterwards. Must be called with a current GL context. An empty    *
+*  path (a body without the asset) and a file which failed to load give       *
+*  NULL / -1 without trying again.                                            *
+*                                                                             *
+*******************************************************************************/
+Mesh* AssetCache::getMesh(GLuint handle)
+{
+	if (!meshTried[handle])
+	{
+		meshTried[handle] = true;
+		if (!meshFiles[handle].empty())
+			meshes[handle] = Geometry::loadObj(meshFiles[handle].c_str());
+	}
+	return meshes[handle];
+}
+GLuint AssetCache::getTexture(GLuint handle)
+{
+	if (!textureTried[handle])
+	{
+		textureTried[handle] = true;
+		if (!textureFiles[handle].empty())
+			textures[handle] =
+				Geometry::loadTexture(textureFiles[handle].c_str());
+	}
+	return textures[handle];
+}
+
+/******************************************************************************
+*                                                                             *
+*                              AssetCache::cleanUp                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Frees every loaded mesh and texture. The registered paths are kept, so     *
+*  the assets are simply reloaded if requested again.                         *
+*                                                                             *
+*******************************************************************************/
+void AssetCache::cleanUp()
+{
+	for (GLuint i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] != NULL)
+		{
+			meshes[i]->cleanUp();
+			delete meshes[i];
+			meshes[i] = NULL;
+		}
+		meshTried[i] = false;
+	}
+	for (GLuint i = 0; i < textures.size(); i++)
+	{
+		if (textures[i] != (GLuint) -1)
+		{
+			glDeleteTextures(1, &textures[i]);
+			textures[i] = (GLuint) -1;
+		}
+		textureTried[i] = false;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Geometry.h"
+
+/******************************************************************************
+*                                                                             *
+*                             AssetCache  (class)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  meshFiles                                                                  *
+*          Path of every distinct mesh file, indexed by mesh handle.          *
+*  textureFiles                                                               *
+*          Path of every distinct texture file, indexed by texture handle.    *
+*  meshHandles                                                                *
+*          Map from mesh path to mesh handle.                                 *
+*  textureHandles                                                             *
+*          Map from texture path to texture handle.                           *
+*  meshes                                                                     *
+*          Loaded meshes (NULL until first requested, or if loading failed).  *
+*  textures                                                                   *
+*          Loaded texture IDs (-1 until first requested, or if loading        *
+*          failed).                                                           *
+*  meshTried, textureTried                                                    *
+*          Whether each asset has been requested, so a missing file is only   *
+*          tried (and reported) once rather than every frame.                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class which interns asset paths into small integer handles and loads each  *
+*  distinct asset at most once. Parsing only registers paths, so scene files  *
+*  with millions of bodies referencing a handful of assets cost one map       *
+*  lookup per reference, and the GPU work is deferred until rendering asks    *
+*  for the asset (which requires a current GL context).                       *
+*                                                                             *
+*******************************************************************************/
+class AssetCache
+{
+public:
+	/* Constructor. */
+	                   AssetCache() {}
+
+	/* Register a path and return its handle. */
+	GLuint             addMesh(const std::string &path);
+	GLuint             addTexture(const std::string &path);
+
+	/* Load (on first use) and return the asset for a handle. */
+	Mesh*              getMesh(GLuint handle);
+	GLuint             getTexture(GLuint handle);
+
+	/* Getters. */
+	GLuint             getNumMeshes()           const
+	                                    {  return meshFiles.size();           }
+	GLuint             getNumTextures()         const
+	                                    {  return textureFiles.size();        }
+	const std::string& getMeshFile(GLuint h)    const
+	                                    {  return meshFiles[h];               }
+	const std::string& getTextureFile(GLuint h) const
+	                                    {  return textureFiles[h];            }
+
+	/* Free every loaded asset. */
+	void               cleanUp();
+
+private:
+	/* Interned paths. */
+	std::vector<std::string>      meshFiles;
+	std::vector<std::string>      textureFiles;
+	std::map<std::string, GLuint> meshHandles;
+	std::map<std::string, GLuint> textureHandles;
+	/* Loaded assets. */
+	std::vector<Mesh*>            meshes;
+	std::vector<GLuint>           textures;
+	std::vector<bool>             meshTried;
+	std::vector<bool>             textureTried;
+};
@@ -0,0 +1,406 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "BVH.h"
+#include <cfloat>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                               halfArea (file static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lower, upper                                                        *
+*           Corners of a box.                                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Half the surface area of the box (0 for an empty box).                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The surface area heuristic only compares areas, so the factor 2 is left    *
+*  out.                                                                       *
+*                                                                             *
+*******************************************************************************/
+static GLfloat halfArea(const glm::vec3 &lower, const glm::vec3 &upper)
+{
+	glm::vec3 d = upper - lower;
+	if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f)
+		return 0.0f;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+/******************************************************************************
+*                                                                             *
+*                                  BVH::build                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lower, upper                                                        *
+*           Corners of the box around each primitive.                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Replaces the tree with one over the given boxes. The primitives are        *
+*  referred to by their index in the arrays, through getOrder().              *
+*                                                                             *
+*******************************************************************************/
+void BVH::build(const std::vector<glm::vec3> &lower,
+                const std::vector<glm::vec3> &upper)
+{
+	clear();
+	const GLuint count = lower.size();
+	if (count == 0)
+		return;
+
+	std::vector<Primitive> primitives(count);
+	for (GLuint i = 0; i < count; i++)
+	{
+		primitives[i].lower = lower[i];
+		primitives[i].upper = upper[i];
+		primitives[i].centroid = (lower[i] + upper[i]) * 0.5f;
+		primitives[i].index = i;
+	}
+
+	nodes.reserve(2 * count);
+	buildNode(primitives, 0, count, 0);
+
+	order.resize(count);
+	for (GLuint i = 0; i < count; i++)
+		order[i] = primitives[i].index;
+}
+
+/******************************************************************************
+*                                                                             *
+*                                BVH::buildNode                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param primitives                                                          *
+*           Boxes of the primitives, reordered into leaf order as it goes.    *
+*  @param first, count                                                        *
+*           The run of primitives the node covers.                            *
+*  @param depth                                                               *
+*           Depth of the node (the root is 0).                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Index of the node.                                                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Appends the node, then (unless it stays a leaf) partitions its run so      *
+*  the primitives of the chosen buckets come first and builds both children   *
+*  after it. The boxes themselves are moved rather than indices to them, so   *
+*  every pass over a run reads memory in order. Primitives whose centroids    *
+*  coincide cannot be binned apart; too many of them are split down the       *
+*  middle of the run instead.                                                 *
+*                                                                             *
+*******************************************************************************/
+GLuint BVH::buildNode(std::vector<Primitive> &primitives, GLuint first,
+                      GLuint count, GLuint depth)
+{
+	Primitive* const run = &primitives[first];
+
+	/* Bound the primitives and their centroids. */
+	glm::vec3 boxLower(FLT_MAX), boxUpper(-FLT_MAX);
+	glm::vec3 centreLower(FLT_MAX), centreUpper(-FLT_MAX);
+	for (GLuint i = 0; i < count; i++)
+	{
+		boxLower = glm::min(boxLower, run[i].lower);
+		boxUpper = glm::max(boxUpper, run[i].upper);
+		centreLower = glm::min(centreLower, run[i].centroid);
+		centreUpper = glm::max(centreUpper, run[i].centroid);
+	}
+
+	const GLuint index = nodes.size();
+	BVHNode leaf = { boxLower, first, boxUpper, count };
+	nodes.push_back(leaf);
+	if (count <= BVH_MIN_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+		return index;
+
+	/* Find the cheapest boundary between buckets on any axis. */
+	GLfloat bestCost = FLT_MAX;
+	GLint   bestAxis = -1;
+	GLuint  bestSplit = 0;
+	for (GLint axis = 0; axis < 3; axis++)
+	{
+		GLfloat extent = centreUpper[axis] - centreLower[axis];
+		if (extent <= 0.0f)
+			continue;
+		GLfloat scale = BVH_SAH_BINS / extent;
+
+		GLuint    binCount[BVH_SAH_BINS] = { 0 };
+		glm::vec3 binLower[BVH_SAH_BINS];
+		glm::vec3 binUpper[BVH_SAH_BINS];
+		for (GLuint b = 0; b < BVH_SAH_BINS; b++)
+		{
+			binLower[b] = glm::vec3(FLT_MAX);
+			binUpper[b] = glm::vec3(-FLT_MAX);
+		}
+		for (GLuint i = 0; i < count; i++)
+		{
+			GLuint b = std::min((GLuint) ((run[i].centroid[axis] -
+				centreLower[axis]) * scale), (GLuint) (BVH_SAH_BINS - 1));
+			binCount[b]++;
+			binLower[b] = glm::min(binLower[b], run[i].lower);
+			binUpper[b] = glm::max(binUpper[b], run[i].upper);
+		}
+
+		/* Sweep from the right, then from the left pricing each boundary. */
+		GLfloat   rightArea[BVH_SAH_BINS];
+		GLuint    rightCount[BVH_SAH_BINS];
+		glm::vec3 sweepLower(FLT_MAX), sweepUpper(-FLT_MAX);
+		GLuint    sweepCount = 0;
+		for (GLuint b = BVH_SAH_BINS - 1; b > 0; b--)
+		{
+			sweepLower = glm::min(sweepLower, binLower[b]);
+			sweepUpper = glm::max(sweepUpper, binUpper[b]);
+			sweepCount += binCount[b];
+			rightArea[b] = halfArea(sweepLower, sweepUpper);
+			rightCount[b] = sweepCount;
+		}
+		sweepLower = glm::vec3(FLT_MAX);
+		sweepUpper = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (GLuint b = 0; b + 1 < BVH_SAH_BINS; b++)
+		{
+			sweepLower = glm::min(sweepLower, binLower[b]);
+			sweepUpper = glm::max(sweepUpper, binUpper[b]);
+			sweepCount += binCount[b];
+			if (sweepCount == 0 || rightCount[b + 1] == 0)
+				continue;
+			GLfloat cost = halfArea(sweepLower, sweepUpper) * sweepCount +
+				rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	/* Split, unless testing every primitive here is cheaper. */
+	GLuint half;
+	if (bestAxis < 0)
+	{
+		if (count <= BVH_MAX_LEAF_SIZE)
+			return index;
+		half = count / 2;
+	}
+	else
+	{
+		GLfloat area = halfArea(boxLower, boxUpper);
+		GLfloat cost = BVH_TRAVERSAL_COST +
+			((area > 0.0f) ? bestCost / area : 0.0f);
+		if (cost >= count && count <= BVH_MAX_LEAF_SIZE)
+			return index;
+
+		const GLfloat scale = BVH_SAH_BINS /
+			(centreUpper[bestAxis] - centreLower[bestAxis]);
+		const GLfloat base = centreLower[bestAxis];
+		half = std::partition(run, run + count, [&](const Primitive &p)
+		{
+			return std::min((GLuint) ((p.centroid[bestAxis] - base) * scale),
+				(GLuint) (BVH_SAH_BINS - 1)) <= bestSplit;
+		}) - run;
+	}
+
+	/* The first child follows this node; record where the second starts. */
+	buildNode(primitives, first, half, depth + 1);
+	GLuint second = buildNode(primitives, first + half, count - half,
+		depth + 1);
+	nodes[index].first = second;
+	nodes[index].count = 0;
+	return index;
+}
+
+/******************************************************************************
+*                                                                             *
+*                                  BVH::clear                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Empties the tree, keeping the memory for the next build.                   *
+*                                                                             *
+*******************************************************************************/
+void BVH::clear()
+{
+	nodes.clear();
+	order.clear();
+}
+
+/******************************************************************************
+*                                                                             *
+*                               BVH::enter (static)                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param node                                                                *
+*           Node whose box is tested.                                         *
+*  @param origin                                                              *
+*           Start of the ray.                                                 *
+*  @param inverseDirection                                                    *
+*           1 / direction, per component.                                     *
+*  @param maxT                                                                *
+*           End of the ray.                                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Distance (in units of the direction) at which the ray enters the box, 0    *
+*  if it starts inside, or -1 if it misses the box before maxT.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Slab test: the ray is inside the box where it is between all three pairs   *
+*  of planes.                                                                 *
+*                                                                             *
+*******************************************************************************/
+GLfloat BVH::enter(const BVHNode &node, const glm::vec3 &origin,
+                   const glm::vec3 &inverseDirection, GLfloat maxT)
+{
+	glm::vec3 t0 = (node.lower - origin) * inverseDirection;
+	glm::vec3 t1 = (node.upper - origin) * inverseDirection;
+	glm::vec3 tLower = glm::min(t0, t1);
+	glm::vec3 tUpper = glm::max(t0, t1);
+	GLfloat tEnter = std::max(std::max(tLower.x, tLower.y),
+		std::max(tLower.z, 0.0f));
+	GLfloat tExit = std::min(std::min(tUpper.x, tUpper.y),
+		std::min(tUpper.z, maxT));
+	return (tEnter <= tExit) ? tEnter : -1.0f;
+}
+
+/******************************************************************************
+*                                                                             *
+*                       TriangleBVH::TriangleBVH (Constructor)                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param positions                                                           *
+*           x of the first vertex position.                                   *
+*  @param stride                                                              *
+*           Floats from one position to the next.                             *
+*  @param indices, numIndices                                                 *
+*           Three indices per triangle (a trailing partial one is ignored).   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bounds each triangle, builds the tree and copies the corners out in its    *
+*  leaf order.                                                                *
+*                                                                             *
+*******************************************************************************/
+TriangleBVH::TriangleBVH(const GLfloat* positions, GLuint stride,
+                         const GLushort* indices, GLuint numIndices)
+{
+	const GLuint numTriangles = numIndices / 3;
+	std::vector<glm::vec3> lower(numTriangles);
+	std::vector<glm::vec3> upper(numTriangles);
+	for (GLuint t = 0; t < numTriangles; t++)
+	{
+		for (GLuint c = 0; c < 3; c++)
+		{
+			const GLfloat* p = positions + (size_t) indices[3 * t + c] * stride;
+			glm::vec3 corner(p[0], p[1], p[2]);
+			lower[t] = (c == 0) ? corner : glm::min(lower[t], corner);
+			upper[t] = (c == 0) ? corner : glm::max(upper[t], corner);
+		}
+	}
+	tree.build(lower, upper);
+
+	const std::vector<GLuint> &order = tree.getOrder();
+	corners.resize(3 * numTriangles);
+	for (GLuint i = 0; i < numTriangles; i++)
+	{
+		for (GLuint c = 0; c < 3; c++)
+		{
+			const GLfloat* p = positions +
+				(size_t) indices[3 * order[i] + c] * stride;
+			corners[3 * i + c] = glm::vec3(p[0], p[1], p[2]);
+		}
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TriangleBVH::intersect                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param origin, direction                                                   *
+*           The ray in model space.                                           *
+*  @param maxT                                                                *
+*           End of the ray; set to the distance of the hit, if any.           *
+*  @param triangle                                                            *
+*           Set to the index of the triangle hit (its first index / 3).       *
+*  @param barycentric                                                         *
+*           Set to the weights of its second and third corners (the first     *
+*           has 1 - u - v).                                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  true if a triangle was hit before *maxT.                                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Moller-Trumbore on each triangle the traversal reaches. Distances are in   *
+*  units of the direction, so they carry over to any space the ray was        *
+*  transformed from.                                                          *
+*                                                                             *
+*******************************************************************************/
+bool TriangleBVH::intersect(const glm::vec3 &origin,
+                            const glm::vec3 &direction, GLfloat* maxT,
+                            GLuint* triangle, glm::vec2* barycentric) const
+{
+	const std::vector<GLuint> &order = tree.getOrder();
+	bool hit = false;
+	tree.traverse(origin, direction, maxT, [&](GLuint i)
+	{
+		const glm::vec3* c = &corners[3 * i];
+		glm::vec3 edge1 = c[1] - c[0];
+		glm::vec3 edge2 = c[2] - c[0];
+		glm::vec3 p = glm::cross(direction, edge2);
+		GLfloat determinant = glm::dot(edge1, p);
+		if (determinant == 0.0f)
+			return;
+
+		GLfloat   inverse = 1.0f / determinant;
+		glm::vec3 s = origin - c[0];
+		GLfloat   u = glm::dot(s, p) * inverse;
+		if (u < 0.0f || u > 1.0f)
+			return;
+		glm::vec3 q = glm::cross(s, edge1);
+		GLfloat   v = glm::dot(direction, q) * inverse;
+		if (v < 0.0f || u + v > 1.0f)
+			return;
+		GLfloat   t = glm::dot(edge2, q) * inverse;
+		if (t < 0.0f || t >= *maxT)
+			return;
+
+		*maxT = t;
+		*triangle = order[i];
+		*barycentric = glm::vec2(u, v);
+		hit = true;
+	});
+	return hit;
+}
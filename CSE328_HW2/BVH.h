@@ -0,0 +1,249 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+#include <algorithm>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Buckets the centroids are sorted into when looking for a split. */
+#define  BVH_SAH_BINS               12
+/* Cost of visiting a node, relative to testing one primitive. */
+#define  BVH_TRAVERSAL_COST         1.0f
+/* Primitives kept in a leaf even when splitting looks cheaper. */
+#define  BVH_MIN_LEAF_SIZE          2
+/* Primitives above which a leaf is split even when it looks dearer. */
+#define  BVH_MAX_LEAF_SIZE          16
+/* Deepest node (bounds the traversal stack). */
+#define  BVH_MAX_DEPTH              48
+
+/******************************************************************************
+*                                                                             *
+*                              BVHNode  (struct)                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  lower, upper                                                               *
+*          Corners of the box around everything below the node.               *
+*  first                                                                      *
+*          Leaf: position of its first primitive in the order. Inner node:    *
+*          index of the second child (the first follows the node).            *
+*  count                                                                      *
+*          Number of primitives of a leaf, 0 for an inner node.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  One 32 byte node of a BVH, laid out depth first.                           *
+*                                                                             *
+*******************************************************************************/
+struct BVHNode
+{
+	glm::vec3      lower;
+	GLuint         first;
+	glm::vec3      upper;
+	GLuint         count;
+};
+
+/******************************************************************************
+*                                                                             *
+*                                BVH  (class)                                 *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  nodes                                                                      *
+*          The tree, root first.                                              *
+*  order                                                                      *
+*          Primitives in leaf order; a leaf covers a contiguous run of it.    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bounding volume hierarchy over boxes, built top down with the surface      *
+*  area heuristic. Each node sorts the centroids of its primitives into       *
+*  BVH_SAH_BINS buckets per axis and takes the bucket boundary minimizing     *
+*  traversal cost + (area left * count left + area right * count right) /     *
+*  area of the node, or stays a leaf when that is no cheaper than testing     *
+*  all of its primitives. Binning keeps the build O(n log n).                 *
+*                                                                             *
+*  Traversal visits the nearer child first and skips boxes beyond the         *
+*  closest hit so far, so the caller's visitor only sees primitives whose     *
+*  box the ray enters before its current end.                                 *
+*                                                                             *
+*******************************************************************************/
+class BVH
+{
+public:
+	/* Build over boxes lower[i]..upper[i]. */
+	void             build(const std::vector<glm::vec3> &lower,
+	                       const std::vector<glm::vec3> &upper);
+	/* Call visit(position in the order) for the leaves the ray reaches. */
+	template <typename Visit>
+	void             traverse(const glm::vec3 &origin,
+	                          const glm::vec3 &direction,
+	                          const GLfloat*   maxT,
+	                          const Visit     &visit)           const;
+	/* Forget the tree. */
+	void             clear();
+
+	/* Getters. */
+	bool             empty()                    const  {  return nodes.empty(); }
+	const BVHNode&   getRoot()                  const  {  return nodes[0];      }
+	GLuint           getNumNodes()              const  {  return nodes.size();  }
+	const std::vector<GLuint>& getOrder()       const  {  return order;         }
+
+	/* Entry distance of a ray into a box, or a negative value on a miss. */
+	static GLfloat   enter(const BVHNode &node, const glm::vec3 &origin,
+	                       const glm::vec3 &inverseDirection, GLfloat maxT);
+
+private:
+	/* A box being sorted into the tree. */
+	struct Primitive
+	{
+		glm::vec3        lower;
+		glm::vec3        upper;
+		glm::vec3        centroid;
+		GLuint           index;
+	};
+
+	std::vector<BVHNode> nodes;
+	std::vector<GLuint>  order;
+
+	/* Build the node over primitives[first .. first + count - 1]. */
+	GLuint           buildNode(std::vector<Primitive> &primitives,
+	                           GLuint first, GLuint count, GLuint depth);
+};
+
+/******************************************************************************
+*                                                                             *
+*                              TriangleBVH  (class)                           *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  tree                                                                       *
+*          BVH over the triangles.                                            *
+*  corners                                                                    *
+*          Three positions per triangle, in the leaf order of the tree.       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Triangles of an indexed mesh in a BVH, for ray queries in model space.     *
+*  The positions are copied out of the vertices in leaf order, so a leaf's    *
+*  triangles are read from one contiguous run of memory and the tree stays    *
+*  valid whatever happens to the mesh's arrays. Triangles are hit from both   *
+*  sides (Moller-Trumbore).                                                   *
+*                                                                             *
+*******************************************************************************/
+class TriangleBVH
+{
+public:
+	/* Build over the triangles of positions (stride floats apart). */
+	                 TriangleBVH(const GLfloat*  positions, GLuint stride,
+	                             const GLushort* indices,   GLuint numIndices);
+
+	/* Closest hit nearer than *maxT; updates *maxT and the triangle. */
+	bool             intersect(const glm::vec3 &origin,
+	                           const glm::vec3 &direction,
+	                           GLfloat* maxT, GLuint* triangle,
+	                           glm::vec2* barycentric)          const;
+
+	/* Getters. */
+	bool             empty()                    const  {  return tree.empty();  }
+	const BVHNode&   getBounds()                const  {  return tree.getRoot(); }
+	GLuint           getNumTriangles()          const
+	                                   {  return tree.getOrder().size();        }
+
+private:
+	BVH                     tree;
+	std::vector<glm::vec3>  corners;
+};
+
+/******************************************************************************
+*                                                                             *
+*                             BVH::traverse                                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param origin, direction                                                   *
+*           The ray, origin + t direction for t >= 0.                         *
+*  @param maxT                                                                *
+*           End of the ray, which visit may shorten as it finds hits.         *
+*  @param visit                                                               *
+*           Called with the position in getOrder() of each primitive in a     *
+*           leaf the ray enters before *maxT.                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Depth first with an explicit stack. Both children are tested at their      *
+*  parent; the nearer one is entered and the farther one pushed with its      *
+*  entry distance, and dropped when popped if a hit has come closer since.    *
+*                                                                             *
+*******************************************************************************/
+template <typename Visit>
+void BVH::traverse(const glm::vec3 &origin, const glm::vec3 &direction,
+                   const GLfloat* maxT, const Visit &visit) const
+{
+	if (nodes.empty())
+		return;
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	if (enter(nodes[0], origin, inverseDirection, *maxT) < 0.0f)
+		return;
+
+	GLuint  stack[BVH_MAX_DEPTH + 1];
+	GLfloat stackT[BVH_MAX_DEPTH + 1];
+	GLuint  top = 0;
+	GLuint  node = 0;
+	for (;;)
+	{
+		const BVHNode &n = nodes[node];
+		if (n.count > 0)
+		{
+			for (GLuint i = n.first; i < n.first + n.count; i++)
+				visit(i);
+		}
+		else
+		{
+			GLuint  nearChild = node + 1;
+			GLuint  farChild = n.first;
+			GLfloat tNear = enter(nodes[nearChild], origin, inverseDirection,
+				*maxT);
+			GLfloat tFar = enter(nodes[farChild], origin, inverseDirection,
+				*maxT);
+			if (tFar >= 0.0f && (tNear < 0.0f || tFar < tNear))
+			{
+				std::swap(nearChild, farChild);
+				std::swap(tNear, tFar);
+			}
+			if (tNear >= 0.0f)
+			{
+				if (tFar >= 0.0f)
+				{
+					stack[top] = farChild;
+					stackT[top++] = tFar;
+				}
+				node = nearChild;
+				continue;
+			}
+		}
+
+		/* Take the next pushed node which is still nearer than the hit. */
+		while (top > 0 && stackT[top - 1] > *maxT)
+			top--;
+		if (top == 0)
+			break;
+		node = stack[--top];
+	}
+}
@@ -0,0 +1,693 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "BarnesHut.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Bits sorted per radix sort pass and the number of passes for 63 bits. */
+#define RADIX_BITS      8
+#define RADIX_BUCKETS   (1 << RADIX_BITS)
+#define RADIX_PASSES    8
+/* Smallest number of bodies worth giving to a thread. */
+#define BODY_GRAIN      1024
+
+/******************************************************************************
+*                                                                             *
+*                           chunkStart (file static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param n                                                                   *
+*           Number of elements.                                               *
+*  @param chunks                                                              *
+*           Number of chunks the elements are divided into.                   *
+*  @param c                                                                   *
+*           Index of the chunk.                                               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Index of the first element of chunk c (chunk c ends at chunkStart(c + 1)). *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Divides n elements into nearly equal contiguous chunks. Used by the        *
+*  passes which must see the same division twice (histogram and scatter).     *
+*                                                                             *
+*******************************************************************************/
+static GLuint chunkStart(GLuint n, GLuint chunks, GLuint c)
+{
+	return (GLuint) ((unsigned long long) n * c / chunks);
+}
+
+/******************************************************************************
+*                                                                             *
+*                          expandBits (file static)                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param v                                                                   *
+*           A 21-bit integer coordinate.                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The bits of v spread out so that two zero bits follow every bit.           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Helper for interleaving three coordinates into a Morton code.              *
+*                                                                             *
+*******************************************************************************/
+static unsigned long long expandBits(GLuint v)
+{
+	unsigned long long x = v & 0x1fffff;
+	x = (x | x << 32) & 0x001f00000000ffffULL;
+	x = (x | x << 16) & 0x001f0000ff0000ffULL;
+	x = (x | x <<  8) & 0x100f00f00f00f00fULL;
+	x = (x | x <<  4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x <<  2) & 0x1249249249249249ULL;
+	return x;
+}
+
+/******************************************************************************
+*                                                                             *
+*                  BarnesHutSolver::BarnesHutSolver (Constructor)             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param openingAngle                                                        *
+*           Opening angle (theta) of the cell acceptance test.                *
+*  @param softening                                                           *
+*           Softening length added to every separation.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a solver with empty scratch arrays.                                *
+*                                                                             *
+*******************************************************************************/
+BarnesHutSolver::BarnesHutSolver(double openingAngle, double softening) :
+	openingAngle(openingAngle), softening(softening), boxSize(1.0)
+{
+	boxMin[0] = boxMin[1] = boxMin[2] = 0.0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                    BarnesHutSolver::computeAccelerations                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are to be computed.                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Rebuilds the octree for the current positions and walks it once per body.  *
+*  A cell is accepted as a point mass when it does not contain the body and   *
+*  width^2 < theta^2 * distance^2; leaves that must be opened are summed      *
+*  directly.                                                                  *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::computeAccelerations(BodyArrays &bodies, double gravity)
+{
+	/* Rebuild the tree for the current positions. */
+	computeBounds(bodies);
+	sortBodies(bodies);
+	buildTree();
+
+	/* Constants of the walk. */
+	const GLuint n = bodies.count;
+	const GLuint total = nodes.size();
+	const double theta2 = openingAngle * openingAngle;
+	const double eps2 = softening * softening;
+
+	/* Walk the tree for every body, in Morton order. */
+	Parallel::forRange(0, n, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			const double xi = sx[i], yi = sy[i], zi = sz[i];
+			double ax = 0.0, ay = 0.0, az = 0.0;
+
+			GLuint k = 0;
+			while (k < total)
+			{
+				const OctreeNode &node = nodes[k];
+
+				/* Leaves are summed body by body. */
+				if (node.next == k + 1)
+				{
+					for (GLuint j = node.first; j < node.first + node.count; j++)
+					{
+						if (j == i)
+							continue;
+						double dx = sx[j] - xi, dy = sy[j] - yi, dz = sz[j] - zi;
+						double r2 = dx * dx + dy * dy + dz * dz + eps2;
+						double inv = 1.0 / sqrt(r2);
+						double f = sm[j] * inv * inv * inv;
+						ax += f * dx; ay += f * dy; az += f * dz;
+					}
+					k = node.next;
+					continue;
+				}
+
+				/* Far cells which do not contain the body act as a point. */
+				double dx = node.x - xi, dy = node.y - yi, dz = node.z - zi;
+				double d2 = dx * dx + dy * dy + dz * dz;
+				bool contains = (i - node.first) < node.count;
+				if (!contains && node.width2 < theta2 * d2)
+				{
+					double inv = 1.0 / sqrt(d2 + eps2);
+					double f = node.mass * inv * inv * inv;
+					ax += f * dx; ay += f * dy; az += f * dz;
+					k = node.next;
+				}
+				/* Otherwise open the cell. */
+				else
+				{
+					k++;
+				}
+			}
+
+			/* Scatter back to the original body order. */
+			GLuint b = order[i];
+			bodies.ax[b] = gravity * ax;
+			bodies.ay[b] = gravity * ay;
+			bodies.az[b] = gravity * az;
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                        BarnesHutSolver::computeBounds                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be enclosed.                                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Finds the cube enclosing every body with a parallel min/max reduction.     *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::computeBounds(const BodyArrays &bodies)
+{
+	const GLuint n = bodies.count;
+	const GLuint chunks = Parallel::getNumThreads();
+
+	/* Per chunk minimum (0-2) and maximum (3-5). */
+	std::vector<double> partial(chunks * 6);
+	Parallel::forRange(0, chunks, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint c = lo; c < hi; c++)
+		{
+			double* p = &partial[c * 6];
+			p[0] = p[1] = p[2] = DBL_MAX;
+			p[3] = p[4] = p[5] = -DBL_MAX;
+			for (GLuint i = chunkStart(n, chunks, c);
+				i < chunkStart(n, chunks, c + 1); i++)
+			{
+				p[0] = std::min(p[0], bodies.px[i]);
+				p[1] = std::min(p[1], bodies.py[i]);
+				p[2] = std::min(p[2], bodies.pz[i]);
+				p[3] = std::max(p[3], bodies.px[i]);
+				p[4] = std::max(p[4], bodies.py[i]);
+				p[5] = std::max(p[5], bodies.pz[i]);
+			}
+		}
+	});
+
+	/* Combine the chunks. */
+	double lower[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+	double upper[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for (GLuint c = 0; c < chunks; c++)
+	{
+		for (GLuint d = 0; d < 3; d++)
+		{
+			lower[d] = std::min(lower[d], partial[c * 6 + d]);
+			upper[d] = std::max(upper[d], partial[c * 6 + 3 + d]);
+		}
+	}
+
+	/* Make a cube slightly larger than the extent so no code overflows. */
+	boxSize = 0.0;
+	for (GLuint d = 0; d < 3; d++)
+	{
+		boxMin[d] = (n > 0) ? lower[d] : 0.0;
+		boxSize = std::max(boxSize, (n > 0) ? upper[d] - lower[d] : 0.0);
+	}
+	boxSize = (boxSize > 0.0) ? boxSize * (1.0 + 1e-9) : 1.0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         BarnesHutSolver::sortBodies                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be sorted.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Computes a 63-bit Morton code per body and sorts the (code, index) pairs   *
+*  with a parallel LSD radix sort: every pass counts digits per chunk, turns  *
+*  the counts into per-chunk output offsets and scatters each chunk in order, *
+*  which keeps the sort stable. Passes over digits shared by every body are   *
+*  skipped. The positions and masses are then gathered in sorted order.       *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::sortBodies(const BodyArrays &bodies)
+{
+	const GLuint n = bodies.count;
+	codes.resize(n); codeScratch.resize(n);
+	order.resize(n); orderScratch.resize(n);
+
+	/* Morton code of every body. */
+	const double cells = (double) (1 << MORTON_BITS);
+	const double toCell = cells / boxSize;
+	Parallel::forRange(0, n, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			GLuint x = (GLuint) std::min(cells - 1,
+				(bodies.px[i] - boxMin[0]) * toCell);
+			GLuint y = (GLuint) std::min(cells - 1,
+				(bodies.py[i] - boxMin[1]) * toCell);
+			GLuint z = (GLuint) std::min(cells - 1,
+				(bodies.pz[i] - boxMin[2]) * toCell);
+			codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) |
+				expandBits(z);
+			order[i] = i;
+		}
+	});
+
+	/* Radix sort, one digit per pass. */
+	const GLuint chunks = Parallel::getNumThreads();
+	std::vector<GLuint> counts(chunks * RADIX_BUCKETS);
+	for (GLuint pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		const GLuint shift = pass * RADIX_BITS;
+
+		/* Count the digits of each chunk. */
+		std::fill(counts.begin(), counts.end(), 0);
+		Parallel::forRange(0, chunks, 1, [&](GLuint lo, GLuint hi)
+		{
+			for (GLuint c = lo; c < hi; c++)
+			{
+				GLuint* count = &counts[c * RADIX_BUCKETS];
+				for (GLuint i = chunkStart(n, chunks, c);
+					i < chunkStart(n, chunks, c + 1); i++)
+					count[(codes[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			}
+		});
+
+		/* Turn the counts into output offsets (digit major, chunk minor). */
+		GLuint offset = 0;
+		bool trivial = false;
+		for (GLuint d = 0; d < RADIX_BUCKETS; d++)
+		{
+			for (GLuint c = 0; c < chunks; c++)
+			{
+				GLuint count = counts[c * RADIX_BUCKETS + d];
+				if (count == n)
+					trivial = true;
+				counts[c * RADIX_BUCKETS + d] = offset;
+				offset += count;
+			}
+		}
+
+		/* Every body has the same digit: the pass would not move anything. */
+		if (trivial)
+			continue;
+
+		/* Scatter each chunk into its slots. */
+		Parallel::forRange(0, chunks, 1, [&](GLuint lo, GLuint hi)
+		{
+			for (GLuint c = lo; c < hi; c++)
+			{
+				GLuint* offsets = &counts[c * RADIX_BUCKETS];
+				for (GLuint i = chunkStart(n, chunks, c);
+					i < chunkStart(n, chunks, c + 1); i++)
+				{
+					GLuint pos = offsets[(codes[i] >> shift) &
+						(RADIX_BUCKETS - 1)]++;
+					codeScratch[pos] = codes[i];
+					orderScratch[pos] = order[i];
+				}
+			}
+		});
+		codes.swap(codeScratch);
+		order.swap(orderScratch);
+	}
+
+	/* Gather the positions and masses in Morton order. */
+	sx.resize(n); sy.resize(n); sz.resize(n); sm.resize(n);
+	Parallel::forRange(0, n, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			GLuint b = order[i];
+			sx[i] = bodies.px[b];
+			sy[i] = bodies.py[b];
+			sz[i] = bodies.pz[b];
+			sm[i] = bodies.mass[b];
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                          BarnesHutSolver::buildTree                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Builds the flat octree over the sorted bodies. The cells at depth          *
+*  OCTREE_SPLIT_LEVEL (up to 64) are built as independent subtrees in         *
+*  parallel, then the few levels above them are assembled serially, copying  *
+*  each subtree into place and relocating its skip indices.                   *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::buildTree()
+{
+	nodes.clear();
+	const GLuint n = codes.size();
+	if (n == 0)
+		return;
+
+	/* Find the subtree ranges (lo, hi, level triples). */
+	std::vector<GLuint> ranges;
+	collectSubtrees(0, n, 0, ranges);
+	const GLuint numSubtrees = ranges.size() / 3;
+
+	/* Build the subtrees in parallel. */
+	std::vector<std::vector<OctreeNode> > subtrees(numSubtrees);
+	Parallel::forRange(0, numSubtrees, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint s = lo; s < hi; s++)
+		{
+			subtrees[s].reserve(2 * (ranges[3 * s + 1] - ranges[3 * s]) /
+				OCTREE_LEAF_SIZE + 1);
+			buildSubtree(ranges[3 * s], ranges[3 * s + 1], ranges[3 * s + 2],
+				subtrees[s]);
+		}
+	});
+
+	/* Assemble the top of the tree around them. */
+	GLuint nextSubtree = 0;
+	nodes.reserve(2 * n / OCTREE_LEAF_SIZE + 64);
+	assemble(0, n, 0, subtrees, nextSubtree);
+}
+
+/******************************************************************************
+*                                                                             *
+*                          BarnesHutSolver::childEnd                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lo, hi                                                              *
+*           Range of sorted bodies inside a cell.                             *
+*  @param level                                                               *
+*           Depth of the cell.                                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  One past the last body sharing the child octant of body lo.                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Because the bodies are Morton sorted, the bodies of each child octant form *
+*  a contiguous run, found here by binary search on the code prefix.          *
+*                                                                             *
+*******************************************************************************/
+GLuint BarnesHutSolver::childEnd(GLuint lo, GLuint hi, GLuint level) const
+{
+	const GLuint shift = 3 * (MORTON_BITS - 1 - level);
+	const unsigned long long prefix = codes[lo] >> shift;
+	return (GLuint) (std::upper_bound(codes.begin() + lo, codes.begin() + hi,
+		prefix, [shift](unsigned long long p, unsigned long long c)
+		{
+			return p < (c >> shift);
+		}) - codes.begin());
+}
+
+/******************************************************************************
+*                                                                             *
+*                       BarnesHutSolver::collectSubtrees                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lo, hi                                                              *
+*           Range of sorted bodies inside the cell.                           *
+*  @param level                                                               *
+*           Depth of the cell.                                                *
+*  @param ranges                                                              *
+*           Output list of (lo, hi, level) triples.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Lists, in depth-first order, the cells that become independent subtrees:  *
+*  the cells at the split level and any shallower leaves.                     *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::collectSubtrees(GLuint lo, GLuint hi, GLuint level,
+                                      std::vector<GLuint> &ranges) const
+{
+	if (level == OCTREE_SPLIT_LEVEL || hi - lo <= OCTREE_LEAF_SIZE)
+	{
+		ranges.push_back(lo);
+		ranges.push_back(hi);
+		ranges.push_back(level);
+		return;
+	}
+	for (GLuint start = lo; start < hi;)
+	{
+		GLuint end = childEnd(start, hi, level);
+		collectSubtrees(start, end, level + 1, ranges);
+		start = end;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        BarnesHutSolver::buildSubtree                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lo, hi                                                              *
+*           Range of sorted bodies inside the cell.                           *
+*  @param level                                                               *
+*           Depth of the cell.                                                *
+*  @param out                                                                 *
+*           Node array the subtree is appended to.                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Index of the cell's node in out.                                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Recursively appends the cell and its children in depth-first order. Cells *
+*  with few bodies, or at the resolution of the Morton code, become leaves.  *
+*                                                                             *
+*******************************************************************************/
+GLuint BarnesHutSolver::buildSubtree(GLuint lo, GLuint hi, GLuint level,
+                                     std::vector<OctreeNode> &out) const
+{
+	GLuint index = out.size();
+	out.push_back(OctreeNode());
+
+	/* Leaf cell. */
+	if (hi - lo <= OCTREE_LEAF_SIZE || level == MORTON_BITS)
+	{
+		finishNode(out, index, lo, hi, level, true);
+		return index;
+	}
+
+	/* Interior cell: one child per non-empty octant. */
+	for (GLuint start = lo; start < hi;)
+	{
+		GLuint end = childEnd(start, hi, level);
+		buildSubtree(start, end, level + 1, out);
+		start = end;
+	}
+	finishNode(out, index, lo, hi, level, false);
+	return index;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          BarnesHutSolver::assemble                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param lo, hi                                                              *
+*           Range of sorted bodies inside the cell.                           *
+*  @param level                                                               *
+*           Depth of the cell.                                                *
+*  @param subtrees                                                            *
+*           Subtrees built in parallel, in depth-first order.                 *
+*  @param nextSubtree                                                         *
+*           Index of the next subtree to be copied.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Index of the cell's node in the tree.                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Mirrors collectSubtrees: above the split level the cell's node is created *
+*  here; at the split level the prebuilt subtree is appended and its skip    *
+*  indices shifted by its new position.                                       *
+*                                                                             *
+*******************************************************************************/
+GLuint BarnesHutSolver::assemble(GLuint lo, GLuint hi, GLuint level,
+                                 std::vector<std::vector<OctreeNode> > &subtrees,
+                                 GLuint &nextSubtree)
+{
+	GLuint index = nodes.size();
+
+	/* Copy a prebuilt subtree into place. */
+	if (level == OCTREE_SPLIT_LEVEL || hi - lo <= OCTREE_LEAF_SIZE)
+	{
+		std::vector<OctreeNode> &subtree = subtrees[nextSubtree++];
+		for (OctreeNode &node : subtree)
+		{
+			node.next += index;
+			nodes.push_back(node);
+		}
+		return index;
+	}
+
+	/* Build the cell above the split level. */
+	nodes.push_back(OctreeNode());
+	for (GLuint start = lo; start < hi;)
+	{
+		GLuint end = childEnd(start, hi, level);
+		assemble(start, end, level + 1, subtrees, nextSubtree);
+		start = end;
+	}
+	finishNode(nodes, index, lo, hi, level, false);
+	return index;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         BarnesHutSolver::finishNode                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param out                                                                 *
+*           Node array containing the cell and (after it) its children.       *
+*  @param index                                                               *
+*           Index of the cell's node.                                         *
+*  @param lo, hi                                                              *
+*           Range of sorted bodies inside the cell.                           *
+*  @param level                                                               *
+*           Depth of the cell.                                                *
+*  @param leaf                                                                *
+*           Whether the cell is a leaf.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Completes a node once its children have been appended: sets its skip      *
+*  index, body range and width, and computes its mass and center of mass      *
+*  from its bodies (leaf) or from its children (interior).                    *
+*                                                                             *
+*******************************************************************************/
+void BarnesHutSolver::finishNode(std::vector<OctreeNode> &out, GLuint index,
+                                 GLuint lo, GLuint hi, GLuint level,
+                                 bool leaf) const
+{
+	double mass = 0.0, x = 0.0, y = 0.0, z = 0.0;
+	double cx = 0.0, cy = 0.0, cz = 0.0;
+
+	if (leaf)
+	{
+		for (GLuint j = lo; j < hi; j++)
+		{
+			mass += sm[j];
+			x += sm[j] * sx[j]; y += sm[j] * sy[j]; z += sm[j] * sz[j];
+			cx += sx[j]; cy += sy[j]; cz += sz[j];
+		}
+	}
+	else
+	{
+		for (GLuint c = index + 1; c < out.size(); c = out[c].next)
+		{
+			const OctreeNode &child = out[c];
+			mass += child.mass;
+			x += child.mass * child.x;
+			y += child.mass * child.y;
+			z += child.mass * child.z;
+			cx += child.count * child.x;
+			cy += child.count * child.y;
+			cz += child.count * child.z;
+		}
+	}
+
+	OctreeNode &node = out[index];
+	node.mass = mass;
+	node.first = lo;
+	node.count = hi - lo;
+	node.next = out.size();
+	double width = boxSize / (double) (1u << level);
+	node.width2 = width * width;
+
+	/* Massless cells use the mean position so they stay well defined. */
+	if (mass > 0.0)
+	{
+		node.x = x / mass; node.y = y / mass; node.z = z / mass;
+	}
+	else
+	{
+		node.x = cx / node.count; node.y = cy / node.count;
+		node.z = cz / node.count;
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <vector>
+#include "GravitySolver.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Default opening angle (cell width / distance) below which a cell is used  */
+/* as a single point mass.                                                   */
+#define  DEFAULT_OPENING_ANGLE      0.5
+/* Maximum number of bodies stored in a leaf cell. */
+#define  OCTREE_LEAF_SIZE           8
+/* Bits of each coordinate in a Morton code (3 x 21 = 63 bits). */
+#define  MORTON_BITS                21
+/* Depth at which the tree is split into independently built subtrees. */
+#define  OCTREE_SPLIT_LEVEL         2
+
+/******************************************************************************
+*                                                                             *
+*                           OctreeNode  (struct)                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  x, y, z                                                                    *
+*          Center of mass of the bodies in the cell.                          *
+*  mass                                                                       *
+*          Total mass of the bodies in the cell.                              *
+*  width2                                                                     *
+*          Squared width of the cell.                                         *
+*  next                                                                       *
+*          Index of the first node after this cell's subtree.                 *
+*  first                                                                      *
+*          Index of the first (Morton sorted) body in the cell.               *
+*  count                                                                      *
+*          Number of bodies in the cell.                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Node of the linearized octree. Nodes are stored in depth-first order, so  *
+*  the first child of node i is node i + 1 and skipping a subtree means      *
+*  jumping to next. A node is a leaf exactly when next == i + 1.              *
+*                                                                             *
+*******************************************************************************/
+struct OctreeNode
+{
+	double         x, y, z;
+	double         mass;
+	double         width2;
+	GLuint         next;
+	GLuint         first;
+	GLuint         count;
+};
+
+/******************************************************************************
+*                                                                             *
+*                         BarnesHutSolver  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  openingAngle                                                               *
+*          Cells narrower than openingAngle times their distance are treated  *
+*          as point masses. Smaller values are slower and more accurate.      *
+*  softening                                                                  *
+*          Softening length added to every separation.                        *
+*  nodes                                                                      *
+*          Flat array of octree nodes in depth-first order.                   *
+*  codes, order                                                               *
+*          Morton code and original index of each body, sorted by code.       *
+*  sx, sy, sz, sm                                                             *
+*          Positions and masses of the bodies in Morton order.                *
+*  boxMin, boxSize                                                            *
+*          Corner and width of the cube enclosing every body.                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  O(n log n) gravity solver. Every step the bodies are sorted along a Morton *
+*  curve (parallel radix sort), copied into sorted arrays and an octree is    *
+*  built over them as a flat node array; the top levels are split into       *
+*  subtrees which are built in parallel. Accelerations are then computed in  *
+*  parallel by a stackless walk of the node array for each body, visiting     *
+*  the bodies in Morton order so neighbouring threads touch the same cells.  *
+*                                                                             *
+*******************************************************************************/
+class BarnesHutSolver : public GravitySolver
+{
+public:
+	/* Constructor. */
+	               BarnesHutSolver(double openingAngle = DEFAULT_OPENING_ANGLE,
+	                               double softening    = DEFAULT_SOFTENING);
+
+	/* Compute the acceleration of every body. */
+	void           computeAccelerations(BodyArrays &bodies,
+	                                    double      gravity) override;
+
+	/* Getters. */
+	double         getOpeningAngle()         const {  return openingAngle; }
+	double         getSoftening()            const {  return softening;    }
+	GLuint         getNumNodes()             const {  return nodes.size(); }
+
+	/* Setters. */
+	void           setOpeningAngle(double a)       {  openingAngle = a;    }
+	void           setSoftening(double s)          {  softening = s;       }
+
+private:
+	/* Parameters. */
+	double         openingAngle;
+	double         softening;
+	/* Octree. */
+	std::vector<OctreeNode>          nodes;
+	/* Morton sorted bodies. */
+	std::vector<unsigned long long>  codes, codeScratch;
+	std::vector<GLuint>              order, orderScratch;
+	std::vector<double>              sx, sy, sz, sm;
+	/* Bounding cube. */
+	double         boxMin[3];
+	double         boxSize;
+
+	/* Build steps. */
+	void           computeBounds(const BodyArrays &bodies);
+	void           sortBodies(const BodyArrays &bodies);
+	void           buildTree();
+	GLuint         buildSubtree(GLuint lo, GLuint hi, GLuint level,
+	                            std::vector<OctreeNode> &out) const;
+	GLuint         assemble(GLuint lo, GLuint hi, GLuint level,
+	                        std::vector<std::vector<OctreeNode> > &subtrees,
+	                        GLuint &nextSubtree);
+	void           collectSubtrees(GLuint lo, GLuint hi, GLuint level,
+	                               std::vector<GLuint> &ranges) const;
+	GLuint         childEnd(GLuint lo, GLuint hi, GLuint level) const;
+	void           finishNode(std::vector<OctreeNode> &out, GLuint index,
+	                          GLuint lo, GLuint hi, GLuint level,
+	                          bool leaf) const;
+};
@@ -58,27 +58,97 @@ glm::mat4 Camera::getWorldToViewMatrix() const
 	return glm::lookAt(position, position + viewDirection, upDirection);
 }
 
+/******************************************************************************
+*                                                                             *
+*                           Camera::updateLookAt()                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param newMousePosition                                                    *
+*           Position of the mouse in the window, in pixels.                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Turns the camera by the mouse movement since the last position at once.    *
+*                                                                             *
+*******************************************************************************/
 void Camera::updateLookAt(const glm::vec2 &newMousePosition)
+{
+	moveMouse(newMousePosition);
+	applyLookAt();
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Camera::moveMouse()                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param newMousePosition                                                    *
+*           Position of the mouse in the window, in pixels.                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Adds the movement since the last position to the pending turn, which       *
+*  applyLookAt carries out, so a frame's worth of motion events costs one     *
+*  rotation. Jumps of more than maxMovement pixels (the mouse leaving and     *
+*  re-entering the window) are skipped, as before.                            *
+*                                                                             *
+*******************************************************************************/
+void Camera::moveMouse(const glm::vec2 &newMousePosition)
 {
 	/* Calculate the change in mouse position. */
 	glm::vec2 mouseDelta = newMousePosition - oldMousePosition;
 
+	/* If the mouse moved greater than MAX_MOVEMENT pixels, don't move */
+	if (glm::length(mouseDelta) <= maxMovement)
+		lookDelta += mouseDelta;
+
+	/* Update the mouse position. */
+	oldMousePosition = newMousePosition;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Camera::applyLookAt()                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Turns the view direction by the pending mouse movement (sideways, then     *
+*  vertically) and clears it. Does nothing if the mouse has not moved.        *
+*                                                                             *
+*******************************************************************************/
+void Camera::applyLookAt()
+{
+	if (lookDelta.x == 0.0f && lookDelta.y == 0.0f)
+		return;
+
 	/* Get the horizontal rotation axis and normalize. */
 	glm::vec3 sideDirection = glm::cross(viewDirection, upDirection);	
 	sideDirection /= glm::length(sideDirection);
 
-	/* If the mouse moved greater than MAX_MOVEMENT pixels, don't move */
-	if (glm::length(mouseDelta) <= maxMovement) 
-	{
-			/* Generate the transformation = sideways * vertical rotation. */
-			glm::mat4 rot =
-				glm::rotate(mouseDelta.x * rotateSpeed,	-upDirection) *
-				glm::rotate(mouseDelta.y * rotateSpeed,	-sideDirection);
+	/* Generate the transformation = sideways * vertical rotation. */
+	glm::mat4 rot =
+		glm::rotate(lookDelta.x * rotateSpeed,	-upDirection) *
+		glm::rotate(lookDelta.y * rotateSpeed,	-sideDirection);
 
-			/* Set the new view direction. */
-			viewDirection = glm::mat3(rot) * viewDirection;
-	}
-
-	/* Update the mouse position. */
-	oldMousePosition = newMousePosition;
+	/* Set the new view direction. */
+	viewDirection = glm::mat3(rot) * viewDirection;
+	lookDelta = glm::vec2();
 }
@@ -33,6 +33,8 @@
 *           The x, y, z direction indicating the top of the camera.           *
 *  oldMousePosition                                                           *
 *           The x, y position the mouse was last recorded.                    *
+*  lookDelta                                                                  *
+*           Mouse movement collected by moveMouse, not yet turned by.         *
 *                                                                             *
 *******************************************************************************
 * DESCRIPTION                                                                 *
@@ -50,6 +52,10 @@ public:
 	glm::mat4      getWorldToViewMatrix()   const;
 	/* Respond to moouse input. */
 	void           updateLookAt(const glm::vec2 &newMousePosition);
+	/* Collect mouse input without turning yet. */
+	void           moveMouse(const glm::vec2 &newMousePosition);
+	/* Turn by the mouse input collected since the last call. */
+	void           applyLookAt();
 
 	/* Getters. */
 	glm::vec3*     getPosition()            {  return &position;       }
@@ -74,4 +80,6 @@ private:
 	glm::vec3      upDirection;
 	/* Last recorded mouse position */
 	glm::vec2      oldMousePosition;
+	/* Mouse movement not yet applied to the view direction. */
+	glm::vec2      lookDelta;
 };
@@ -0,0 +1,411 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Collision.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Bodies per task when computing bounds. */
+#define BODY_GRAIN 4096
+
+/******************************************************************************
+*                                                                             *
+*                               findRoot                                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param parent                                                              *
+*           Union-find forest over the bodies.                                *
+*  @param i                                                                   *
+*           A body.                                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The representative of the group of body i.                                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Halves the path on the way up.                                             *
+*                                                                             *
+*******************************************************************************/
+static GLuint findRoot(std::vector<GLuint> &parent, GLuint i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/******************************************************************************
+*                                                                             *
+*                  CollisionDetector::CollisionDetector (Constructor)         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a detector with no previous order.                                 *
+*                                                                             *
+*******************************************************************************/
+CollisionDetector::CollisionDetector() :
+	axis(0), seconds(0.0), calls(0), merged(0)
+{
+}
+
+/******************************************************************************
+*                                                                             *
+*                          CollisionDetector::touch (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies, at the end of the step.                               *
+*  @param i, j                                                                *
+*           The two bodies.                                                   *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the spheres overlapped at some time during the step.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Moves the separation back along the relative velocity to the start of   *
+*  the step and finds the closest point of that segment to the origin.       *
+*                                                                             *
+*******************************************************************************/
+bool CollisionDetector::touch(const BodyArrays &bodies, GLuint i, GLuint j,
+                              double dt)
+{
+	/* Separation at the end and its change over the step. */
+	double d[3] = { bodies.px[j] - bodies.px[i], bodies.py[j] - bodies.py[i],
+		bodies.pz[j] - bodies.pz[i] };
+	double m[3] = { (bodies.vx[j] - bodies.vx[i]) * dt,
+		(bodies.vy[j] - bodies.vy[i]) * dt,
+		(bodies.vz[j] - bodies.vz[i]) * dt };
+	double reach = bodies.radius[i] + bodies.radius[j];
+
+	/* Closest approach on start + s * m, s in [0, 1]. */
+	double start[3] = { d[0] - m[0], d[1] - m[1], d[2] - m[2] };
+	double mm = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+	double s = (mm > 0.0) ? -(start[0] * m[0] + start[1] * m[1] +
+		start[2] * m[2]) / mm : 1.0;
+	s = std::min(1.0, std::max(0.0, s));
+
+	double c[3] = { start[0] + s * m[0], start[1] + s * m[1],
+		start[2] + s * m[2] };
+	return c[0] * c[0] + c[1] * c[1] + c[2] * c[2] <= reach * reach;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          CollisionDetector::sortBoxes                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Insertion-sorts the boxes, which are in last step's order and so nearly  *
+*  sorted. If they have moved past each other so much that insertion sort   *
+*  would be slow, they are sorted from scratch instead.                       *
+*                                                                             *
+*******************************************************************************/
+void CollisionDetector::sortBoxes()
+{
+	const GLuint n = boxes.size();
+	const GLuint a = axis;
+	const unsigned long long limit = (unsigned long long) MAX_SWAPS_PER_BODY * n;
+	unsigned long long swaps = 0;
+	for (GLuint k = 1; k < n && swaps <= limit; k++)
+	{
+		if (boxes[k - 1].lower[a] <= boxes[k].lower[a])
+			continue;
+		Box box = boxes[k];
+		GLuint m = k;
+		while (m > 0 && boxes[m - 1].lower[a] > box.lower[a])
+		{
+			boxes[m] = boxes[m - 1];
+			m--;
+		}
+		boxes[m] = box;
+		swaps += k - m;
+	}
+
+	if (swaps > limit)
+	{
+		std::sort(boxes.begin(), boxes.end(), [a](const Box &b1, const Box &b2)
+		{
+			return b1.lower[a] < b2.lower[a];
+		});
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           CollisionDetector::detect                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies, at the end of the step.                               *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The number of touching pairs (see getPairs).                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bounds each body, sorts, and sweeps fixed blocks of the sorted boxes in   *
+*  parallel. Each block keeps its own pair list, and the lists are joined    *
+*  in block order, so the result does not depend on the threads.             *
+*                                                                             *
+*******************************************************************************/
+GLuint CollisionDetector::detect(const BodyArrays &bodies, double dt)
+{
+	std::chrono::steady_clock::time_point begin =
+		std::chrono::steady_clock::now();
+	const GLuint n = bodies.count;
+	pairs.clear();
+	if (n < 2)
+		return 0;
+
+	/* Bound the sphere of each body along its path during the step, keeping */
+	/* the boxes in last step's order if the bodies are the same.           */
+	const bool fresh = (boxes.size() != n);
+	if (fresh)
+	{
+		boxes.resize(n);
+		for (GLuint i = 0; i < n; i++)
+			boxes[i].body = i;
+	}
+	Parallel::forRange(0, n, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint k = lo; k < hi; k++)
+		{
+			Box &box = boxes[k];
+			const GLuint i = box.body;
+			const double p[3] = { bodies.px[i], bodies.py[i], bodies.pz[i] };
+			const double v[3] = { bodies.vx[i], bodies.vy[i], bodies.vz[i] };
+			const double r = bodies.radius[i];
+			for (GLuint d = 0; d < 3; d++)
+			{
+				double before = p[d] - v[d] * dt;
+				box.lower[d] = std::min(p[d], before) - r;
+				box.upper[d] = std::max(p[d], before) + r;
+			}
+		}
+	});
+
+	/* On a fresh start, sweep along the axis the bodies spread most over. */
+	if (fresh)
+	{
+		double extent[3];
+		for (GLuint d = 0; d < 3; d++)
+		{
+			double lo = boxes[0].lower[d], hi = boxes[0].upper[d];
+			for (GLuint k = 1; k < n; k++)
+			{
+				lo = std::min(lo, boxes[k].lower[d]);
+				hi = std::max(hi, boxes[k].upper[d]);
+			}
+			extent[d] = hi - lo;
+		}
+		axis = (extent[0] >= extent[1]) ? 0 : 1;
+		axis = (extent[2] > extent[axis]) ? 2 : axis;
+	}
+	sortBoxes();
+
+	/* Sweep. */
+	const GLuint a = axis, b = (axis + 1) % 3, c = (axis + 2) % 3;
+	const GLuint blocks = (n + SWEEP_GRAIN - 1) / SWEEP_GRAIN;
+	blockPairs.resize(blocks);
+	Parallel::forRange(0, blocks, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint block = lo; block < hi; block++)
+		{
+			std::vector<Pair> &found = blockPairs[block];
+			found.clear();
+			GLuint last = std::min(n, (block + 1) * SWEEP_GRAIN);
+			for (GLuint k = block * SWEEP_GRAIN; k < last; k++)
+			{
+				const Box &box = boxes[k];
+				for (GLuint m = k + 1; m < n &&
+					boxes[m].lower[a] <= box.upper[a]; m++)
+				{
+					const Box &other = boxes[m];
+					if (other.lower[b] > box.upper[b] ||
+						other.upper[b] < box.lower[b] ||
+						other.lower[c] > box.upper[c] ||
+						other.upper[c] < box.lower[c])
+						continue;
+					if (touch(bodies, box.body, other.body, dt))
+					{
+						Pair pair = { std::min(box.body, other.body),
+							std::max(box.body, other.body) };
+						found.push_back(pair);
+					}
+				}
+			}
+		}
+	});
+	for (const std::vector<Pair> &found : blockPairs)
+		pairs.insert(pairs.end(), found.begin(), found.end());
+
+	seconds += std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - begin).count();
+	calls++;
+	return pairs.size();
+}
+
+/******************************************************************************
+*                                                                             *
+*                           CollisionDetector::merge                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies the last detect ran on.                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The number of bodies removed.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Groups the touching pairs (a chain of contacts is one group) and replaces *
+*  each group by its heaviest body, which takes the total mass, the centre   *
+*  of mass position and velocity (so mass and momentum are conserved) and   *
+*  the radius of the total volume. The heaviest body keeps its name, spin    *
+*  and assets. Body indices change afterwards.                                *
+*                                                                             *
+*******************************************************************************/
+GLuint CollisionDetector::merge(BodyArrays &bodies)
+{
+	if (pairs.empty())
+		return 0;
+	const GLuint n = bodies.count;
+
+	/* Group. */
+	std::vector<GLuint> parent(n);
+	for (GLuint i = 0; i < n; i++)
+		parent[i] = i;
+	for (const Pair &pair : pairs)
+	{
+		GLuint r1 = findRoot(parent, pair.first);
+		GLuint r2 = findRoot(parent, pair.second);
+		if (r1 != r2)
+			parent[std::max(r1, r2)] = std::min(r1, r2);
+	}
+
+	/* Sum the members of each group into its root's slot. */
+	std::vector<GLuint> root(n), size(n, 0), heaviest(n, (GLuint) -1);
+	std::vector<double> mass(n, 0.0), volume(n, 0.0), p(3 * n, 0.0),
+		v(3 * n, 0.0);
+	for (GLuint i = 0; i < n; i++)
+	{
+		GLuint r = root[i] = findRoot(parent, i);
+		const double m = bodies.mass[i];
+		size[r]++;
+		mass[r] += m;
+		volume[r] += bodies.radius[i] * bodies.radius[i] * bodies.radius[i];
+		p[3 * r + 0] += m * bodies.px[i];
+		p[3 * r + 1] += m * bodies.py[i];
+		p[3 * r + 2] += m * bodies.pz[i];
+		v[3 * r + 0] += m * bodies.vx[i];
+		v[3 * r + 1] += m * bodies.vy[i];
+		v[3 * r + 2] += m * bodies.vz[i];
+		if (heaviest[r] == (GLuint) -1 || m > bodies.mass[heaviest[r]])
+			heaviest[r] = i;
+	}
+
+	/* Replace each group of two or more by its heaviest body. */
+	std::vector<bool> removed(n, false);
+	GLuint count = 0;
+	for (GLuint i = 0; i < n; i++)
+	{
+		GLuint r = root[i];
+		if (size[r] < 2)
+			continue;
+		if (heaviest[r] != i)
+		{
+			removed[i] = true;
+			count++;
+			continue;
+		}
+
+		const double m = mass[r];
+		bodies.mass[i] = m;
+		bodies.radius[i] = cbrt(volume[r]);
+		bodies.px[i] = p[3 * r + 0] / m;
+		bodies.py[i] = p[3 * r + 1] / m;
+		bodies.pz[i] = p[3 * r + 2] / m;
+		bodies.vx[i] = v[3 * r + 0] / m;
+		bodies.vy[i] = v[3 * r + 1] / m;
+		bodies.vz[i] = v[3 * r + 2] / m;
+	}
+
+	/* Drop the absorbed bodies; the boxes no longer match them. */
+	bodies.remove(removed);
+	boxes.clear();
+	pairs.clear();
+	merged += count;
+	return count;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         CollisionDetector::reportStats                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints the mean time per detection and the bodies merged since the last *
+*  report.                                                                    *
+*                                                                             *
+*******************************************************************************/
+void CollisionDetector::reportStats()
+{
+	if (calls > 0)
+	{
+		fprintf(stdout, "Stats: Collisions %.3f ms per step, %u bodies "
+			"merged\n", 1000.0 * seconds / calls, merged);
+	}
+	seconds = 0.0;
+	calls = 0;
+	merged = 0;
+}
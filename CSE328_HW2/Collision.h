@@ -0,0 +1,96 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <vector>
+#include "OrbitalSystem.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Sorted bodies per task of the sweep. */
+#define  SWEEP_GRAIN                1024
+/* Insertion sort swaps per body above which the order is sorted afresh. */
+#define  MAX_SWAPS_PER_BODY         8
+
+/******************************************************************************
+*                                                                             *
+*                        CollisionDetector  (class)                           *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  axis                                                                       *
+*          Axis the bodies are sorted along (0, 1, 2 for x, y, z).            *
+*  boxes                                                                      *
+*          Swept bounds of the bodies, sorted by their lower end on axis and *
+*          kept in last step's order between steps.                           *
+*  blockPairs, pairs                                                          *
+*          Touching pairs found per sweep block, and all of them in order.    *
+*  seconds, calls, merged                                                     *
+*          Time spent in detect, its number of calls, and bodies removed by   *
+*          merge, since the last report.                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sort-and-sweep collision detection. Each body is bounded by a box around *
+*  its radius and the path it moved along during the step. The boxes are    *
+*  refreshed in place and sorted along one axis (insertion sort of last     *
+*  step's order, which is nearly sorted, so this is close to linear) and    *
+*  swept in parallel:                                                         *
+*  each body is tested against the following bodies until their intervals    *
+*  stop overlapping. Pairs whose boxes overlap go to an exact narrow phase   *
+*  finding the closest approach of the two spheres during the step, so fast *
+*  bodies cannot pass through each other between steps.                      *
+*                                                                             *
+*******************************************************************************/
+class CollisionDetector
+{
+public:
+	/* A pair of touching bodies, first < second. */
+	struct Pair { GLuint first, second; };
+
+	/* Constructor. */
+	                 CollisionDetector();
+
+	/* Find the bodies which touched during the last step; returns pairs. */
+	GLuint           detect(const BodyArrays &bodies, double dt);
+	/* Merge each group of touching bodies; returns bodies removed. */
+	GLuint           merge(BodyArrays &bodies);
+	/* Forget the order (after bodies are added or removed elsewhere). */
+	void             reset()                    {  boxes.clear();       }
+	/* Print and reset the timing and merge counters. */
+	void             reportStats();
+
+	/* Getters. */
+	const std::vector<Pair>& getPairs() const   {  return pairs;        }
+
+private:
+	/* Swept bounds of a body. */
+	struct Box
+	{
+		double           lower[3];
+		double           upper[3];
+		GLuint           body;
+	};
+
+	GLuint                          axis;
+	std::vector<Box>                boxes;
+	std::vector<std::vector<Pair> > blockPairs;
+	std::vector<Pair>               pairs;
+	double                          seconds;
+	GLuint                          calls;
+	GLuint                          merged;
+
+	/* Sort the boxes by their lower ends on axis. */
+	void             sortBoxes();
+	/* Exact test of two spheres moving linearly during the step. */
+	static bool      touch(const BodyArrays &bodies, GLuint i, GLuint j,
+	                       double dt);
+};
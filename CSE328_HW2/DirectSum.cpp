@@ -0,0 +1,483 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "DirectSum.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* MSVC accepts any intrinsic in any function; GCC/Clang need the target    */
+/* enabled per function. AVX-512 intrinsics need Visual Studio 2017.         */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define  TARGET_AVX2
+#define  TARGET_AVX512
+#if _MSC_VER >= 1911
+#define  DIRECT_SUM_AVX512
+#endif
+#else
+#include <immintrin.h>
+#define  TARGET_AVX2                __attribute__((target("avx2,fma")))
+#define  TARGET_AVX512              __attribute__((target("avx512f")))
+#define  DIRECT_SUM_AVX512
+#endif
+
+/******************************************************************************
+*                                                                             *
+*                          Kernel Type  (file static)                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Every kernel adds the acceleration (without G) exerted on one target at    *
+*  (xi, yi, zi) by sources [begin, end) to acc. end - begin is a multiple of  *
+*  DIRECT_PADDING; padding sources have zero mass.                            *
+*                                                                             *
+*******************************************************************************/
+typedef void (*PairKernel)(const double* x, const double* y, const double* z,
+                           const float* m, GLuint begin, GLuint end,
+                           double xi, double yi, double zi, float eps2,
+                           double acc[3]);
+
+/******************************************************************************
+*                                                                             *
+*                          kernelScalar (file static)                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Portable kernel with the same precision as the vector kernels.             *
+*                                                                             *
+*******************************************************************************/
+static void kernelScalar(const double* x, const double* y, const double* z,
+                         const float* m, GLuint begin, GLuint end,
+                         double xi, double yi, double zi, float eps2,
+                         double acc[3])
+{
+	float ax = 0.0f, ay = 0.0f, az = 0.0f;
+	for (GLuint j = begin; j < end; j++)
+	{
+		float dx = (float) (x[j] - xi);
+		float dy = (float) (y[j] - yi);
+		float dz = (float) (z[j] - zi);
+		float d2 = dx * dx + dy * dy + dz * dz;
+		if (d2 <= 0.0f)
+			continue;
+		float inv = 1.0f / sqrtf(d2 + eps2);
+		float f = (m[j] * inv) * (inv * inv);
+		ax += f * dx; ay += f * dy; az += f * dz;
+	}
+	acc[0] += ax; acc[1] += ay; acc[2] += az;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           kernelAVX2 (file static)                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  8 sources per iteration. Separations are converted from two 4-wide double *
+*  differences; the inverse distance is the 12-bit estimate refined by one   *
+*  Newton step (about 22 bits).                                               *
+*                                                                             *
+*******************************************************************************/
+TARGET_AVX2
+static void kernelAVX2(const double* x, const double* y, const double* z,
+                       const float* m, GLuint begin, GLuint end,
+                       double xi, double yi, double zi, float eps2,
+                       double acc[3])
+{
+	const __m256d xi4 = _mm256_set1_pd(xi);
+	const __m256d yi4 = _mm256_set1_pd(yi);
+	const __m256d zi4 = _mm256_set1_pd(zi);
+	const __m256  e8 = _mm256_set1_ps(eps2);
+	const __m256  half = _mm256_set1_ps(0.5f);
+	const __m256  threeHalves = _mm256_set1_ps(1.5f);
+	const __m256  zero = _mm256_setzero_ps();
+	__m256 ax = zero, ay = zero, az = zero;
+
+	for (GLuint j = begin; j < end; j += 8)
+	{
+		/* Double precision separations, narrowed to float. */
+		__m256 dx = _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(x + j), xi4))),
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(x + j + 4), xi4)), 1);
+		__m256 dy = _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(y + j), yi4))),
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(y + j + 4), yi4)), 1);
+		__m256 dz = _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(z + j), zi4))),
+			_mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(z + j + 4), zi4)), 1);
+
+		/* Softened inverse distance, zero for coincident bodies. */
+		__m256 d2 = _mm256_fmadd_ps(dx, dx,
+			_mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+		__m256 r2 = _mm256_add_ps(d2, e8);
+		__m256 inv = _mm256_rsqrt_ps(r2);
+		inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2),
+			_mm256_mul_ps(inv, inv), threeHalves));
+		inv = _mm256_and_ps(inv, _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+
+		/* m / r^3, ordered to stay inside the float range. */
+		__m256 f = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(m + j), inv),
+			_mm256_mul_ps(inv, inv));
+		ax = _mm256_fmadd_ps(f, dx, ax);
+		ay = _mm256_fmadd_ps(f, dy, ay);
+		az = _mm256_fmadd_ps(f, dz, az);
+	}
+
+	/* Horizontal sums into the double accumulators. */
+	float lanes[8];
+	_mm256_storeu_ps(lanes, ax);
+	acc[0] += ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+		((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+	_mm256_storeu_ps(lanes, ay);
+	acc[1] += ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+		((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+	_mm256_storeu_ps(lanes, az);
+	acc[2] += ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+		((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+#ifdef DIRECT_SUM_AVX512
+/******************************************************************************
+*                                                                             *
+*                          kernelAVX512 (file static)                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  16 sources per iteration, using the 14-bit estimate plus one Newton step. *
+*                                                                             *
+*******************************************************************************/
+TARGET_AVX512
+static __m512 narrow16(__m512d lo, __m512d hi)
+{
+	return _mm512_castpd_ps(_mm512_insertf64x4(
+		_mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(lo))),
+		_mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1));
+}
+
+TARGET_AVX512
+static void kernelAVX512(const double* x, const double* y, const double* z,
+                         const float* m, GLuint begin, GLuint end,
+                         double xi, double yi, double zi, float eps2,
+                         double acc[3])
+{
+	const __m512d xi8 = _mm512_set1_pd(xi);
+	const __m512d yi8 = _mm512_set1_pd(yi);
+	const __m512d zi8 = _mm512_set1_pd(zi);
+	const __m512  e16 = _mm512_set1_ps(eps2);
+	const __m512  half = _mm512_set1_ps(0.5f);
+	const __m512  threeHalves = _mm512_set1_ps(1.5f);
+	const __m512  zero = _mm512_setzero_ps();
+	__m512 ax = zero, ay = zero, az = zero;
+
+	for (GLuint j = begin; j < end; j += 16)
+	{
+		/* Double precision separations, narrowed to float. */
+		__m512 dx = narrow16(_mm512_sub_pd(_mm512_loadu_pd(x + j), xi8),
+			_mm512_sub_pd(_mm512_loadu_pd(x + j + 8), xi8));
+		__m512 dy = narrow16(_mm512_sub_pd(_mm512_loadu_pd(y + j), yi8),
+			_mm512_sub_pd(_mm512_loadu_pd(y + j + 8), yi8));
+		__m512 dz = narrow16(_mm512_sub_pd(_mm512_loadu_pd(z + j), zi8),
+			_mm512_sub_pd(_mm512_loadu_pd(z + j + 8), zi8));
+
+		/* Softened inverse distance, zero for coincident bodies. */
+		__m512 d2 = _mm512_fmadd_ps(dx, dx,
+			_mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+		__m512 r2 = _mm512_add_ps(d2, e16);
+		__m512 inv = _mm512_rsqrt14_ps(r2);
+		inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2),
+			_mm512_mul_ps(inv, inv), threeHalves));
+		__mmask16 apart = _mm512_cmp_ps_mask(d2, zero, _CMP_GT_OQ);
+
+		/* m / r^3, ordered to stay inside the float range. */
+		__m512 f = _mm512_maskz_mul_ps(apart,
+			_mm512_mul_ps(_mm512_loadu_ps(m + j), inv), _mm512_mul_ps(inv, inv));
+		ax = _mm512_fmadd_ps(f, dx, ax);
+		ay = _mm512_fmadd_ps(f, dy, ay);
+		az = _mm512_fmadd_ps(f, dz, az);
+	}
+
+	/* Horizontal sums into the double accumulators. */
+	acc[0] += _mm512_reduce_add_ps(ax);
+	acc[1] += _mm512_reduce_add_ps(ay);
+	acc[2] += _mm512_reduce_add_ps(az);
+}
+#endif
+
+/******************************************************************************
+*                                                                             *
+*                        DirectSumSolver::detectKernel                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The fastest kernel the processor and operating system support.            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Checks CPUID for AVX2+FMA and AVX-512F, and XCR0 for the operating system *
+*  saving the YMM/ZMM registers.                                              *
+*                                                                             *
+*******************************************************************************/
+DirectSumKernel DirectSumSolver::detectKernel()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return KERNEL_SCALAR;
+
+	/* The OS must save the vector registers (OSXSAVE, XCR0). */
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave)
+		return KERNEL_SCALAR;
+	unsigned long long xcr0 = _xgetbv(0);
+
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512 = (info[1] & (1 << 16)) != 0;
+
+#ifdef DIRECT_SUM_AVX512
+	if (avx512 && (xcr0 & 0xe6) == 0xe6)
+		return KERNEL_AVX512;
+#endif
+	if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+		return KERNEL_AVX2;
+	return KERNEL_SCALAR;
+#else
+	if (__builtin_cpu_supports("avx512f"))
+		return KERNEL_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return KERNEL_AVX2;
+	return KERNEL_SCALAR;
+#endif
+}
+
+/******************************************************************************
+*                                                                             *
+*                       DirectSumSolver::getKernelName                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param kernel                                                              *
+*           The kernel.                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  A short name of the kernel.                                                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Used in the statistics output.                                             *
+*                                                                             *
+*******************************************************************************/
+const char* DirectSumSolver::getKernelName(DirectSumKernel kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_AVX512:  return "avx512";
+	case KERNEL_AVX2:    return "avx2";
+	default:             return "scalar";
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                  DirectSumSolver::DirectSumSolver (Constructor)             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param softening                                                           *
+*           Softening length added to every separation.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a solver using the best kernel of this processor.                  *
+*                                                                             *
+*******************************************************************************/
+DirectSumSolver::DirectSumSolver(double softening) :
+	softening(softening), kernel(detectKernel())
+{
+	/* Empty. */
+}
+
+/******************************************************************************
+*                                                                             *
+*                          DirectSumSolver::setKernel                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param k                                                                   *
+*           The requested kernel.                                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Selects a kernel, falling back to the best supported one if the processor *
+*  cannot run the requested instruction set.                                  *
+*                                                                             *
+*******************************************************************************/
+void DirectSumSolver::setKernel(DirectSumKernel k)
+{
+	kernel = std::min(k, detectKernel());
+}
+
+/******************************************************************************
+*                                                                             *
+*                    DirectSumSolver::computeAccelerations                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are to be computed.                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Computes the acceleration of every body.                                   *
+*                                                                             *
+*******************************************************************************/
+void DirectSumSolver::computeAccelerations(BodyArrays &bodies, double gravity)
+{
+	evaluate(bodies, gravity, NULL, bodies.count);
+}
+
+/******************************************************************************
+*                                                                             *
+*                 DirectSumSolver::computeActiveAccelerations                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are to be computed.                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param active                                                              *
+*           Indices of the bodies whose acceleration is needed.               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Computes the acceleration of the listed bodies only, at a cost of          *
+*  O(active * n). The other bodies keep their previous acceleration.          *
+*                                                                             *
+*******************************************************************************/
+void DirectSumSolver::computeActiveAccelerations(BodyArrays &bodies,
+	double gravity, const std::vector<GLuint> &active)
+{
+	if (!active.empty())
+		evaluate(bodies, gravity, &active[0], active.size());
+}
+
+/******************************************************************************
+*                                                                             *
+*                           DirectSumSolver::evaluate                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are to be computed.                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param targets                                                             *
+*           Indices of the target bodies, or NULL for bodies 0 .. count - 1.  *
+*  @param count                                                               *
+*           Number of target bodies.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Copies the sources into padded arrays, then splits the targets into       *
+*  blocks run in parallel. Within a block the source tiles are the outer     *
+*  loop so each tile is loaded into cache once per block. Every target only  *
+*  writes its own accumulators, so the result does not depend on the number  *
+*  of threads.                                                                *
+*                                                                             *
+*******************************************************************************/
+void DirectSumSolver::evaluate(BodyArrays &bodies, double gravity,
+                               const GLuint* targets, GLuint count)
+{
+	const GLuint n = bodies.count;
+	if (n == 0 || count == 0)
+		return;
+
+	/* Padded sources; padding has zero mass and so no effect. */
+	const GLuint padded = (n + DIRECT_PADDING - 1) / DIRECT_PADDING *
+		DIRECT_PADDING;
+	jx.assign(padded, 0.0); jy.assign(padded, 0.0); jz.assign(padded, 0.0);
+	jm.assign(padded, 0.0f);
+	std::copy(bodies.px.begin(), bodies.px.begin() + n, jx.begin());
+	std::copy(bodies.py.begin(), bodies.py.begin() + n, jy.begin());
+	std::copy(bodies.pz.begin(), bodies.pz.begin() + n, jz.begin());
+	for (GLuint j = 0; j < n; j++)
+		jm[j] = (float) bodies.mass[j];
+	accX.assign(count, 0.0); accY.assign(count, 0.0); accZ.assign(count, 0.0);
+
+	/* Pick the kernel. */
+	PairKernel pair = kernelScalar;
+	if (kernel == KERNEL_AVX2)
+		pair = kernelAVX2;
+#ifdef DIRECT_SUM_AVX512
+	else if (kernel == KERNEL_AVX512)
+		pair = kernelAVX512;
+#endif
+
+	const float eps2 = (float) (softening * softening);
+	Parallel::forRange(0, count, DIRECT_BLOCK_SIZE, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint block = lo; block < hi; block += DIRECT_BLOCK_SIZE)
+		{
+			GLuint blockEnd = std::min(hi, block + DIRECT_BLOCK_SIZE);
+			for (GLuint tile = 0; tile < padded; tile += DIRECT_TILE_SIZE)
+			{
+				GLuint tileEnd = std::min(padded, tile + DIRECT_TILE_SIZE);
+				for (GLuint t = block; t < blockEnd; t++)
+				{
+					GLuint i = (targets != NULL) ? targets[t] : t;
+					double acc[3] = { accX[t], accY[t], accZ[t] };
+					pair(&jx[0], &jy[0], &jz[0], &jm[0], tile, tileEnd,
+						jx[i], jy[i], jz[i], eps2, acc);
+					accX[t] = acc[0]; accY[t] = acc[1]; accZ[t] = acc[2];
+				}
+			}
+			for (GLuint t = block; t < blockEnd; t++)
+			{
+				GLuint i = (targets != NULL) ? targets[t] : t;
+				bodies.ax[i] = gravity * accX[t];
+				bodies.ay[i] = gravity * accY[t];
+				bodies.az[i] = gravity * accZ[t];
+			}
+		}
+	});
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <vector>
+#include "GravitySolver.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Number of source bodies per tile (positions + masses fit in L1). */
+#define  DIRECT_TILE_SIZE           512
+/* Number of target bodies handed to a thread at a time. */
+#define  DIRECT_BLOCK_SIZE          64
+/* Source arrays are padded to a multiple of the widest vector. */
+#define  DIRECT_PADDING             16
+
+/******************************************************************************
+*                                                                             *
+*                          DirectSumKernel  (enum)                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Instruction sets the pairwise kernel is compiled for, from slowest to      *
+*  fastest. The best one supported by the processor is picked at runtime.     *
+*                                                                             *
+*******************************************************************************/
+enum DirectSumKernel
+{
+	KERNEL_SCALAR = 0,
+	KERNEL_AVX2   = 1,
+	KERNEL_AVX512 = 2
+};
+
+/******************************************************************************
+*                                                                             *
+*                         DirectSumSolver  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  softening                                                                  *
+*          Softening length added to every separation.                        *
+*  kernel                                                                     *
+*          Instruction set used for the pairwise interactions.                *
+*  jx, jy, jz, jm                                                             *
+*          Padded copies of the source positions (double) and masses (float). *
+*  accX, accY, accZ                                                           *
+*          Double precision accumulators of the target bodies.                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Exact O(n^2) gravity solver for small and medium systems. The sources are  *
+*  processed in tiles of DIRECT_TILE_SIZE bodies which stay in L1 while every *
+*  target of a block visits them. Separations are taken in double precision  *
+*  and converted to float, so close pairs far from the origin keep their     *
+*  accuracy, while the inverse distance and force run in float vectors of 8  *
+*  (AVX2) or 16 (AVX-512) lanes. Each tile's float partial sum is added to a *
+*  double accumulator. Coincident bodies (including a body and itself) exert  *
+*  no force.                                                                  *
+*                                                                             *
+*******************************************************************************/
+class DirectSumSolver : public GravitySolver
+{
+public:
+	/* Constructor. */
+	                 DirectSumSolver(double softening = DEFAULT_SOFTENING);
+
+	/* Compute the acceleration of every body. */
+	void             computeAccelerations(BodyArrays &bodies,
+	                                      double      gravity) override;
+	/* Compute the acceleration of the listed bodies only. */
+	void             computeActiveAccelerations(BodyArrays &bodies,
+	                                   double      gravity,
+	                                   const std::vector<GLuint> &active) override;
+
+	/* Best kernel supported by this processor. */
+	static DirectSumKernel detectKernel();
+	/* Name of a kernel, for reporting. */
+	static const char*     getKernelName(DirectSumKernel kernel);
+
+	/* Getters. */
+	double           getSoftening()           const {  return softening;  }
+	DirectSumKernel  getKernel()              const {  return kernel;     }
+
+	/* Setters (the kernel is limited to what the processor supports). */
+	void             setSoftening(double s)         {  softening = s;     }
+	void             setKernel(DirectSumKernel k);
+
+private:
+	/* Parameters. */
+	double           softening;
+	DirectSumKernel  kernel;
+	/* Padded sources. */
+	std::vector<double>  jx, jy, jz;
+	std::vector<float>   jm;
+	/* Target accumulators. */
+	std::vector<double>  accX, accY, accZ;
+
+	/* Compute the acceleration of the given targets (NULL: all bodies). */
+	void             evaluate(BodyArrays &bodies, double gravity,
+	                          const GLuint* targets, GLuint count);
+};
@@ -11,6 +11,8 @@
 #include <iostream>
 #include "Display.h"
 #include "Geometry.h"
+#include "Parallel.h"
+#include "TaskScheduler.h"
 
 /******************************************************************************
 *                                                                             *
@@ -37,7 +39,8 @@
 *  to the hardware-specific implementation (OpenGL acts as an Adapter Class)  *
 *                                                                             *
 *******************************************************************************/
-Display::Display(std::string title, GLushort width, GLushort height) 
+Display::Display(std::string title, GLushort width, GLushort height) :
+	shader(NULL), trails(NULL), latency(NULL), system(NULL), assets(NULL)
 {
 
 	/* Create the SDL window. */
@@ -162,6 +165,164 @@ void Display::updateViewport()
 		DEFAULT_FAR_PLANE);
 }
 
+/******************************************************************************
+*                                                                             *
+*                             Display::getPickRay                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param x, y                                                                *
+*           Window coordinates of the pixel (from the top left, as in SDL     *
+*           mouse events).                                                    *
+*  @param origin                                                              *
+*           Set to the point of the pixel on the near plane.                  *
+*  @param direction                                                           *
+*           Set to the unit direction from the camera through the pixel.      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Unprojects the pixel at the near and far planes through the camera and     *
+*  the projection of the last repaint.                                        *
+*                                                                             *
+*******************************************************************************/
+void Display::getPickRay(GLint x, GLint y, glm::vec3* origin,
+                         glm::vec3* direction)
+{
+	GLint width, height;
+	SDL_GetWindowSize(window, &width, &height);
+	const glm::vec4 viewport(0.0f, 0.0f, (GLfloat) width, (GLfloat) height);
+	const glm::mat4 worldToView = camera.getWorldToViewMatrix();
+
+	/* GL counts rows from the bottom; sample the centre of the pixel. */
+	glm::vec3 pixel(x + 0.5f, height - (y + 0.5f), 0.0f);
+	glm::vec3 nearPoint = glm::unProject(pixel, worldToView,
+		viewToProjectionMatrix, viewport);
+	pixel.z = 1.0f;
+	glm::vec3 farPoint = glm::unProject(pixel, worldToView,
+		viewToProjectionMatrix, viewport);
+
+	*origin = nearPoint;
+	*direction = glm::normalize(farPoint - nearPoint);
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Display::drawMesh                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param m                                                                   *
+*           The mesh to draw.                                                 *
+*  @param texture                                                             *
+*           Texture ID to bind (-1 to keep the one bound).                    *
+*  @param modelToWorld                                                        *
+*           Model -> World transformation of this draw.                       *
+*  @param modelToProjection                                                   *
+*           Model -> Projection transformation of this draw.                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Issues the OpenGL calls for one mesh. The transformations are passed in    *
+*  rather than read from the mesh, so one shared mesh can be drawn at many    *
+*  places (the bodies of a system using the same asset).                      *
+*                                                                             *
+*******************************************************************************/
+void Display::drawMesh(Mesh* m, GLuint texture, const glm::mat4 &modelToWorld,
+                       const glm::mat4 &modelToProjection)
+{
+	/* Use the Model -> Proj. transformation. */
+	modelToProjectionMatrix = modelToProjection;
+
+	/* Bind the appropriate Vertex Array. */
+	glBindVertexArray(m->getVertexArrayID());
+
+	/* Bind the appropriate Index Array. */
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->getBufferIDs()[1]);
+
+	/* If a texture has been generated, bind the Texture ID. */
+	if (texture != (GLuint) -1)
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+	/* Set the active Texture. */
+	glActiveTexture(GL_TEXTURE0);
+	shader->setUniform(textureUniform, 0);
+
+	/* Send the transformation data down to the buffer. */
+	shader->setUniform(modelToWorldUniform, modelToWorld);
+	shader->setUniform(modelToProjectionUniform, modelToProjectionMatrix);
+
+	/* Apply settings for wireframe/solid face. */
+	if (m->isSolid())
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	else
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+	/* Draw the elements to the window. */
+	glDrawElements(m->getDrawMode(),      // Draw mode.
+                   m->getNumIndices(),    // Number of indices
+				   GL_UNSIGNED_SHORT,     // Data type of index
+                   0);                    // Index offset
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Display::drawBodies                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param worldToProjection                                                   *
+*           World -> Projection transformation of the frame.                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Draws every body with a mesh, placed from the body arrays of this frame:   *
+*  at its position and radius in world units (meters over the scale of the    *
+*  system, as the trails are), tilted about z and turned about y by its       *
+*  rotation. Bodies share the mesh and texture of their asset handles,        *
+*  which the cache loads the first time a body needs them. Bodies without     *
+*  a mesh file, or whose mesh failed to load, are not drawn.                  *
+*                                                                             *
+*******************************************************************************/
+void Display::drawBodies(const glm::mat4 &worldToProjection)
+{
+	const BodyArrays &bodies = system->getBodies();
+	const double inverseScale = 1.0 / system->getScale();
+	for (GLuint i = 0; i < bodies.count; i++)
+	{
+		if (bodies.mesh[i] >= assets->getNumMeshes())
+			continue;
+		Mesh* m = assets->getMesh(bodies.mesh[i]);
+		if (m == NULL)
+			continue;
+		GLuint texture = (bodies.texture[i] < assets->getNumTextures()) ?
+			assets->getTexture(bodies.texture[i]) : (GLuint) -1;
+
+		GLfloat radius = (GLfloat) (bodies.radius[i] * inverseScale);
+		glm::mat4 modelToWorld =
+			glm::translate(glm::vec3((GLfloat) (bodies.px[i] * inverseScale),
+			                         (GLfloat) (bodies.py[i] * inverseScale),
+			                         (GLfloat) (bodies.pz[i] * inverseScale))) *
+			glm::rotate(glm::radians(bodies.tilt[i]),
+			            glm::vec3(0.0f, 0.0f, 1.0f)) *
+			glm::rotate(glm::radians(bodies.rotation[i]),
+			            glm::vec3(0.0f, 1.0f, 0.0f)) *
+			glm::scale(glm::vec3(radius));
+		drawMesh(m, texture, modelToWorld, worldToProjection * modelToWorld);
+	}
+}
+
 /******************************************************************************
 *                                                                             *
 *                             Display::repaint                                *
@@ -178,7 +339,11 @@ void Display::updateViewport()
 *******************************************************************************
 * DESCRIPTION                                                                 *
 *  Function which clears the window by changing all of the pixels to the      *
-*  specified color and opacity.                                               *
+*  specified color and opacity. The transformations of the meshes are         *
+*  computed in parallel into scratch memory first; the OpenGL calls are then  *
+*  issued from this thread, which owns the context. The bodies of the         *
+*  orbital system, if any, follow, and the orbit trails are blended over      *
+*  everything.                                                                *
 *                                                                             *
 *******************************************************************************/
 void Display::repaint(const std::vector<Mesh*> &meshes)
@@ -191,50 +356,50 @@ void Display::repaint(const std::vector<Mesh*> &meshes)
 
 	glEnable(GL_DEPTH_TEST);
 
+	/* Prepare the frame: compose the changed transformations, then the */
+	/* projections of every mesh.                                        */
+	TransformSystem::get().update();
+	ScratchArena &scratch = TaskScheduler::get().getScratch();
+	ScratchArena::Mark mark = scratch.getMark();
+	const GLuint numMeshes = meshes.size();
+	glm::mat4* modelToWorld = scratch.allocate<glm::mat4>(2 * numMeshes);
+	glm::mat4* modelToProjection = modelToWorld + numMeshes;
+	const glm::mat4 worldToProjection =
+		viewToProjectionMatrix *               // View  -> Proj.
+		camera.getWorldToViewMatrix();         // World -> View
+	Parallel::forRange(0, numMeshes, FRAME_PREP_GRAIN,
+		[&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			modelToWorld[i] = meshes[i]->getTransform();      // Model -> World
+			modelToProjection[i] = worldToProjection * modelToWorld[i];
+		}
+	});
+
 	/* Draw 3-D space. */
-	for (Mesh* m : meshes)
+	for (GLuint i = 0; i < numMeshes; i++)
+		drawMesh(meshes[i], meshes[i]->getTextureID(), modelToWorld[i],
+			modelToProjection[i]);
+	scratch.release(mark);
+
+	/* Draw the bodies of the orbital system. */
+	if (system != NULL && assets != NULL)
+		drawBodies(worldToProjection);
+
+	/* Draw the orbit trails over the meshes, then restore the program. */
+	if (trails != NULL)
 	{
-		/* Generate the Model -> Proj. transformation. */
-		modelToProjectionMatrix = 
-			viewToProjectionMatrix *           // View  -> Proj.
-            camera.getWorldToViewMatrix() *	   // World -> View 
-            m->getTransform();                 // Model -> World
-
-		/* Bind the appropriate Vertex Array. */
-		glBindVertexArray(m->getVertexArrayID());
-
-		/* Bind the appropriate Index Array. */
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->getBufferIDs()[1]);
-
-		/* If a texture has been generated, bind the Texture ID. */
-		if (m->getTextureID() != -1)
-			glBindTexture(GL_TEXTURE_2D, m->getTextureID());
-
-		/* Set the active Texture. */
-		glActiveTexture(GL_TEXTURE0);
-		glUniform1i(textureUniformLocation, 0);
-
-		/* Send the transformation data down to the buffer. */
-		glUniformMatrix4fv(modelToWorldUniformLocation, 1, GL_FALSE, 
-			 &(m->getTransform()[0][0]));
-		glUniformMatrix4fv(modelToProjectionUniformLocation, 1, GL_FALSE,
-			&modelToProjectionMatrix[0][0]);
-
-		/* Apply settings for wireframe/solid face. */
-		if (m->isSolid())
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-		/* Draw the elements to the window. */
-		glDrawElements(m->getDrawMode(),      // Draw mode.
-                       m->getNumIndices(),    // Number of indices
-					   GL_UNSIGNED_SHORT,     // Data type of index
-                       0);                    // Index offset
+		trails->draw(worldToProjection, DEFAULT_TRAIL_COLOR);
+		shader->use();
 	}
 
-	/* Swap the double buffer. */
+	/* Swap the double buffer, timing it for the latency measurement. */
+	if (latency != NULL)
+		latency->beforeSwap();
 	SDL_GL_SwapWindow(window);
+	if (latency != NULL)
+		latency->afterSwap();
 }
 
 /******************************************************************************
@@ -253,39 +418,29 @@ void Display::repaint(const std::vector<Mesh*> &meshes)
 *******************************************************************************
 * DESCRIPTION                                                                 *
 *  Tells OpenGL to use the indicated shader for rendering, and gets the       *
-*  location IDs of the uniform variables inside the shader program.           *
+*  indices of the uniform variables in the shader's reflected uniform table.  *
 *                                                                             *
 *******************************************************************************/
-void Display::setShader(Shader shader)
+void Display::setShader(Shader* shader)
 {
 	/* Tell OpenGL to use this shader. */
-	shader.use();
-
-	/* Get the location of the fullTransformMatrix uniform variable. */
-	modelToProjectionUniformLocation = glGetUniformLocation(
-		shader.getProgram(), "modelToProjectionMatrix");
-
-	modelToWorldUniformLocation = glGetUniformLocation(
-		shader.getProgram(), "modelToWorldMatrix");
-
-	/* Get the location of the texture sampler uniform variable. */
-	textureUniformLocation = glGetUniformLocation(
-		shader.getProgram(), "texture");
-
-	lightSourceUniformLocation = glGetUniformLocation(
-		shader.getProgram(), "lightSource");
-
-	/* Get the location of the light source uniform variable. */
-	ambientLightUniformLocation = glGetUniformLocation(
-		shader.getProgram(), "ambientLight");
-
+	this->shader = shader;
+	shader->use();
+
+	/* Look up the uniforms once in the shader's reflected table. */
+	modelToProjectionUniform = shader->getUniformIndex(
+		"modelToProjectionMatrix");
+	modelToWorldUniform = shader->getUniformIndex("modelToWorldMatrix");
+	textureUniform = shader->getUniformIndex("texture");
+	lightSourceUniform = shader->getUniformIndex("lightSource");
+	ambientLightUniform = shader->getUniformIndex("ambientLight");
+
+	/* Set the lighting parameters. */
 	float brightness = 0.00f;
-	glm::vec4 ambientLight(brightness, brightness, brightness, 1.0f);
-	glUniform4fv(ambientLightUniformLocation, 1, &ambientLight[0]);
-
-	glm::vec3 lightSource(0.0f, 2500.0f, 100000.0f);
-	glUniform3fv(lightSourceUniformLocation, 1, &lightSource[0]);
-
+	shader->setUniform(ambientLightUniform, 
+		glm::vec4(brightness, brightness, brightness, 1.0f));
+	shader->setUniform(lightSourceUniform, 
+		glm::vec3(0.0f, 2500.0f, 100000.0f));
 }
 
 /******************************************************************************
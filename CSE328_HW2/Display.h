@@ -10,8 +10,12 @@
 #include <glm\glm.hpp>
 #include <string>
 #include <vector>
+#include "AssetCache.h"
 #include "Camera.h"
 #include "Geometry.h"
+#include "LatencyMonitor.h"
+#include "OrbitTrails.h"
+#include "OrbitalSystem.h"
 #include "Shader.h"
 
 /******************************************************************************
@@ -29,6 +33,10 @@
 /* Default vertex and fragment shader source files. */
 #define  DEFAULT_VERTEX_SHADER    "res/shaders/shader.vs"
 #define  DEFAULT_FRAGMENT_SHADER  "res/shaders/shader.fs"
+/* Meshes per task when preparing a frame. */
+#define  FRAME_PREP_GRAIN         64
+/* Color of the newest end of the orbit trails. */
+#define  DEFAULT_TRAIL_COLOR      glm::vec4(0.4f, 0.7f, 1.0f, 0.8f)
 
 /******************************************************************************
  *																			  *
@@ -73,11 +81,20 @@ enum class Dimension
  *  viewToProjectionMatrix                                                    *
  *          4-D matrix representing the transformation from the view to the   *
  *          projection (camera view).                                         *
- *  modelToProjectionUniformLocation                                          *
- *          ID  of the location for the modelToProjectionMatrix in the shader *
- *          program.                                                          *
- *  textureUniformLocation                                                    *
- *          ID  of the location for the texture sampler in the shader program *
+ *  shader                                                                    *
+ *          Shader program currently used for rendering.                      *
+ *  modelToProjectionUniform                                                  *
+ *          Index of the modelToProjectionMatrix in the shader's uniform      *
+ *          table.                                                            *
+ *  textureUniform                                                            *
+ *          Index of the texture sampler in the shader's uniform table.       *
+ *  trails                                                                    *
+ *          Orbit trails drawn over the meshes (NULL for none).               *
+ *  latency                                                                   *
+ *          Told when each frame is swapped (NULL for none).                  *
+ *  system, assets                                                            *
+ *          Orbital system whose bodies are drawn with the meshes and         *
+ *          textures of the cache (NULL for none).                            *
  *                                                                            *
  ******************************************************************************
  * DESCRIPTION                                                                *
@@ -105,12 +122,22 @@ public:
 
 	/* Repaint the graphics. */
 	void     repaint(const std::vector<Mesh*> &meshes);
+
+	/* World space ray through a window pixel, as last drawn. */
+	void     getPickRay(GLint x, GLint y, glm::vec3* origin,
+	                    glm::vec3* direction);
 	
 	/* Getters. */
 	Camera*  getCamera()               {  return &camera;            }
+	bool     isMinimized()      const  {  return (SDL_GetWindowFlags(window) &
+	                                              SDL_WINDOW_MINIMIZED) != 0; }
 
 	/* Setters. */     
-	void    setShader(Shader shader);
+	void    setShader(Shader* shader);
+	void    setTrails(OrbitTrails* trails)  {  this->trails = trails;    }
+	void    setLatencyMonitor(LatencyMonitor* l)  {  latency = l;        }
+	void    setSystem(const OrbitalSystem* system, AssetCache* assets)
+	                     {  this->system = system;  this->assets = assets;  }
 	void    setClearColor(GLclampf r, 
                           GLclampf b,
                           GLclampf g, 
@@ -134,15 +161,31 @@ private:
 	glm::mat4      modelToProjectionMatrix;
 	/* View to Projection matrix. */
 	glm::mat4      viewToProjectionMatrix;
-	/* Uniform location for the full transformation. */
-	GLuint         modelToProjectionUniformLocation;
-	/* Uniform location for the texture. */
-	GLuint         textureUniformLocation;
-	/* Uniform location for the light source. */
-	GLuint         lightSourceUniformLocation;
-	/* Uniform location for the ambient light. */
-	GLuint         ambientLightUniformLocation;
-	/* Uniform location for the model to world transformation.*/
-	GLuint         modelToWorldUniformLocation;
+	/* Shader used for rendering. */
+	Shader*        shader;
+	/* Uniform index for the full transformation. */
+	GLint          modelToProjectionUniform;
+	/* Uniform index for the texture. */
+	GLint          textureUniform;
+	/* Uniform index for the light source. */
+	GLint          lightSourceUniform;
+	/* Uniform index for the ambient light. */
+	GLint          ambientLightUniform;
+	/* Uniform index for the model to world transformation.*/
+	GLint          modelToWorldUniform;
+	/* Orbit trails. */
+	OrbitTrails*   trails;
+	/* Input-to-photon latency measurement. */
+	LatencyMonitor* latency;
+	/* Bodies to draw and the assets they use. */
+	const OrbitalSystem* system;
+	AssetCache*    assets;
+
+	/* Draw one mesh with the given texture and transformations. */
+	void           drawMesh(Mesh* m, GLuint texture,
+	                        const glm::mat4 &modelToWorld,
+	                        const glm::mat4 &modelToProjection);
+	/* Draw the bodies of the system with their shared meshes. */
+	void           drawBodies(const glm::mat4 &worldToProjection);
 
 };
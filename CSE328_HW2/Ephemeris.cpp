@@ -0,0 +1,430 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Ephemeris.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Bodies per task when fitting and evaluating. */
+#define EPHEMERIS_GRAIN 1024
+
+/******************************************************************************
+*                                                                             *
+*                       Ephemeris::Ephemeris (Constructor)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates an ephemeris with no file.                                         *
+*                                                                             *
+*******************************************************************************/
+Ephemeris::Ephemeris() :
+	coefficients(NULL)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+/******************************************************************************
+*                                                                             *
+*                         Ephemeris::chebyshev (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param x                                                                   *
+*           Point in [-1, 1].                                                 *
+*  @param degree                                                              *
+*           Highest degree wanted.                                            *
+*  @param t                                                                   *
+*           Set to T_0(x) .. T_degree(x).                                     *
+*  @param dt                                                                  *
+*           Set to T_0'(x) .. T_degree'(x) (may be NULL).                     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Uses T_j+1 = 2x T_j - T_j-1, and T_j' = j U_j-1 with the polynomials of   *
+*  the second kind following the same recurrence.                             *
+*                                                                             *
+*******************************************************************************/
+void Ephemeris::chebyshev(double x, GLuint degree, double* t, double* dt)
+{
+	double u[MAX_EPHEMERIS_DEGREE + 1];
+	t[0] = 1.0;
+	u[0] = 1.0;
+	if (degree > 0)
+	{
+		t[1] = x;
+		u[1] = 2.0 * x;
+	}
+	for (GLuint j = 2; j <= degree; j++)
+	{
+		t[j] = 2.0 * x * t[j - 1] - t[j - 2];
+		u[j] = 2.0 * x * u[j - 1] - u[j - 2];
+	}
+	if (dt != NULL)
+	{
+		dt[0] = 0.0;
+		for (GLuint j = 1; j <= degree; j++)
+			dt[j] = j * u[j - 1];
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Ephemeris::build (static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the ephemeris to be written.                              *
+*  @param system                                                              *
+*           The system, in its state at the start of the ephemeris.          *
+*  @param simulation                                                          *
+*           Simulation of the system, started.                                *
+*  @param duration                                                            *
+*           Simulated seconds to cover (rounded up to whole intervals).       *
+*  @param steps                                                               *
+*           Simulation steps per interval.                                    *
+*  @param degree                                                              *
+*           Degree of the polynomials (at most steps).                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the ephemeris was written.                                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Samples every body at each of the steps + 1 step boundaries of an         *
+*  interval and fits each axis by least squares. The samples sit at the same *
+*  points of every interval, so the fit is a fixed projection               *
+*  P = (A^T A)^-1 A^T of the samples, with A the Chebyshev polynomials at     *
+*  the sample points; it is factored once and applied to all bodies at once. *
+*  The largest distance between a fit and its samples is reported.          *
+*                                                                             *
+*******************************************************************************/
+bool Ephemeris::build(const char* filename, OrbitalSystem &system,
+                      Simulation &simulation, double duration, GLuint steps,
+                      GLuint degree)
+{
+	BodyArrays &bodies = system.getBodies();
+	const GLuint n = bodies.count;
+	const double timeStep = simulation.getTimeStep();
+	if (n == 0 || duration <= 0.0 || degree > MAX_EPHEMERIS_DEGREE ||
+		steps < degree || timeStep <= 0.0)
+	{
+		std::cerr << "Error building ephemeris: need bodies, a duration and "
+		          << "a degree of at most " << MAX_EPHEMERIS_DEGREE
+		          << " and at most the steps per interval" << std::endl;
+		return false;
+	}
+	const GLuint terms = degree + 1;
+	const GLuint samples = steps + 1;
+
+	/* A, then its normal matrix G = A^T A, factored G = L L^T. */
+	std::vector<double> a(samples * terms), l(terms * terms, 0.0);
+	for (GLuint s = 0; s < samples; s++)
+		chebyshev(2.0 * s / steps - 1.0, degree, &a[s * terms], NULL);
+	for (GLuint i = 0; i < terms; i++)
+	{
+		for (GLuint j = 0; j <= i; j++)
+		{
+			double sum = 0.0;
+			for (GLuint s = 0; s < samples; s++)
+				sum += a[s * terms + i] * a[s * terms + j];
+			for (GLuint k = 0; k < j; k++)
+				sum -= l[i * terms + k] * l[j * terms + k];
+			l[i * terms + j] = (i == j) ? sqrt(sum) : sum / l[j * terms + j];
+		}
+	}
+
+	/* P, one column per sample: solve L L^T p = (row s of A). */
+	std::vector<double> p(terms * samples);
+	for (GLuint s = 0; s < samples; s++)
+	{
+		double y[MAX_EPHEMERIS_DEGREE + 1];
+		for (GLuint i = 0; i < terms; i++)
+		{
+			double sum = a[s * terms + i];
+			for (GLuint k = 0; k < i; k++)
+				sum -= l[i * terms + k] * y[k];
+			y[i] = sum / l[i * terms + i];
+		}
+		for (GLuint i = terms; i-- > 0;)
+		{
+			double sum = y[i];
+			for (GLuint k = i + 1; k < terms; k++)
+				sum -= l[k * terms + i] * p[k * samples + s];
+			p[i * samples + s] = sum / l[i * terms + i];
+		}
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		std::cerr << "Error building ephemeris: cannot create " << filename
+		          << std::endl;
+		return false;
+	}
+	EphemerisHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = EPHEMERIS_MAGIC;
+	header.version = EPHEMERIS_VERSION;
+	header.bodies = n;
+	header.degree = degree;
+	header.intervals = (GLuint) ceil(duration / (steps * timeStep));
+	header.startTime = simulation.getTime();
+	header.intervalLength = steps * timeStep;
+	fwrite(&header, sizeof(header), 1, file);
+
+	/* Samples by [sample][axis][body]; coefficients by [axis][term][body]. */
+	std::vector<double> sampled(samples * 3 * n);
+	std::vector<double> block(3 * terms * n);
+	const std::vector<double>* positions[3] =
+		{ &bodies.px, &bodies.py, &bodies.pz };
+	double maxError = 0.0;
+	for (GLuint k = 0; k < header.intervals; k++)
+	{
+		/* The last sample of an interval is the first of the next. */
+		if (k > 0)
+			std::copy(sampled.end() - 3 * n, sampled.end(), sampled.begin());
+		else
+		{
+			for (GLuint d = 0; d < 3; d++)
+				std::copy(positions[d]->begin(), positions[d]->end(),
+					sampled.begin() + d * n);
+		}
+		for (GLuint s = 1; s < samples; s++)
+		{
+			simulation.advance(timeStep);
+			if (bodies.count != n)
+			{
+				std::cerr << "Error building ephemeris: bodies merged, "
+				          << "ephemeris cut short" << std::endl;
+				fclose(file);
+				return false;
+			}
+			for (GLuint d = 0; d < 3; d++)
+				std::copy(positions[d]->begin(), positions[d]->end(),
+					sampled.begin() + (s * 3 + d) * n);
+		}
+
+		/* Fit, and measure the fit against the samples. */
+		double error = Parallel::reduce(0, n, EPHEMERIS_GRAIN, 0.0,
+			[&](GLuint lo, GLuint hi)
+		{
+			for (GLuint d = 0; d < 3; d++)
+			{
+				for (GLuint j = 0; j < terms; j++)
+				{
+					double* row = &block[(d * terms + j) * n];
+					std::fill(row + lo, row + hi, 0.0);
+					for (GLuint s = 0; s < samples; s++)
+					{
+						const double w = p[j * samples + s];
+						const double* x = &sampled[(s * 3 + d) * n];
+						for (GLuint b = lo; b < hi; b++)
+							row[b] += w * x[b];
+					}
+				}
+			}
+			double worst = 0.0;
+			for (GLuint b = lo; b < hi; b++)
+			{
+				for (GLuint s = 0; s < samples; s++)
+				{
+					double e2 = 0.0;
+					for (GLuint d = 0; d < 3; d++)
+					{
+						double fit = 0.0;
+						for (GLuint j = 0; j < terms; j++)
+							fit += a[s * terms + j] *
+								block[(d * terms + j) * n + b];
+						double e = fit - sampled[(s * 3 + d) * n + b];
+						e2 += e * e;
+					}
+					worst = std::max(worst, e2);
+				}
+			}
+			return sqrt(worst);
+		}, [](double x, double y) { return std::max(x, y); });
+		maxError = std::max(maxError, error);
+		fwrite(block.data(), sizeof(double), block.size(), file);
+	}
+
+	bool written = !ferror(file);
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		std::cerr << "Error building ephemeris: cannot write " << filename
+		          << std::endl;
+		return false;
+	}
+	fprintf(stdout, "Stats: Ephemeris of %u bodies, %u intervals of %.2f days, "
+		"degree %u, %.1f KB, fit error at most %.3f m\n", n, header.intervals,
+		header.intervalLength / 86400.0, degree, (sizeof(header) +
+		(double) header.intervals * block.size() * sizeof(double)) / 1024.0,
+		maxError);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Ephemeris::open                                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the ephemeris.                                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file is a complete ephemeris.                                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Maps the file and checks its header against its size. The coefficients   *
+*  are read from the mapping, so only the intervals used are paged in.       *
+*                                                                             *
+*******************************************************************************/
+bool Ephemeris::open(const char* filename)
+{
+	coefficients = NULL;
+	memset(&header, 0, sizeof(header));
+	if (!map.open(filename))
+		return false;
+
+	const size_t size = map.getSize();
+	if (size >= sizeof(header))
+		memcpy(&header, map.getData(), sizeof(header));
+	const size_t expected = sizeof(header) + (size_t) header.intervals * 3 *
+		(header.degree + 1) * header.bodies * sizeof(double);
+	if (size < sizeof(header) || header.magic != EPHEMERIS_MAGIC ||
+		header.version != EPHEMERIS_VERSION ||
+		header.degree > MAX_EPHEMERIS_DEGREE || header.intervals == 0 ||
+		header.intervalLength <= 0.0 || size != expected)
+	{
+		std::cerr << "Error opening ephemeris " << filename << ": not a "
+		          << "complete version " << EPHEMERIS_VERSION << " ephemeris"
+		          << std::endl;
+		memset(&header, 0, sizeof(header));
+		map.close();
+		return false;
+	}
+	coefficients = (const double*) (map.getData() + sizeof(header));
+
+	fprintf(stdout, "Stats: Ephemeris of %u bodies from %s, %.2f days\n",
+		header.bodies, filename, (getEndTime() - getStartTime()) / 86400.0);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Ephemeris::getEndTime                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The time at which the last interval ends.                                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Start time plus the length of every interval.                             *
+*                                                                             *
+*******************************************************************************/
+double Ephemeris::getEndTime() const
+{
+	return header.startTime + header.intervals * header.intervalLength;
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Ephemeris::seek                                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param time                                                                *
+*           Simulated time in seconds (clamped to the ephemeris).             *
+*  @param bodies                                                              *
+*           The bodies, as many as the ephemeris holds.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False if no ephemeris is open or the body counts differ.                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Picks the interval, maps the time to x in [-1, 1], evaluates T_j(x) and   *
+*  T_j'(x) once, then accumulates c_j T_j (positions) and c_j T_j' dx/dt     *
+*  (velocities) term by term over the bodies of each task.                   *
+*                                                                             *
+*******************************************************************************/
+bool Ephemeris::seek(double time, BodyArrays &bodies) const
+{
+	if (coefficients == NULL || bodies.count != header.bodies)
+		return false;
+
+	const GLuint n = header.bodies;
+	const GLuint terms = header.degree + 1;
+	time = std::min(getEndTime(), std::max(header.startTime, time));
+	double u = (time - header.startTime) / header.intervalLength;
+	GLuint k = std::min((GLuint) u, header.intervals - 1);
+	double x = std::min(1.0, 2.0 * (u - k) - 1.0);
+
+	double t[MAX_EPHEMERIS_DEGREE + 1], dt[MAX_EPHEMERIS_DEGREE + 1];
+	chebyshev(x, header.degree, t, dt);
+	const double dxdt = 2.0 / header.intervalLength;
+	const double* base = coefficients + (size_t) k * 3 * terms * n;
+
+	double* positions[3] = { &bodies.px[0], &bodies.py[0], &bodies.pz[0] };
+	double* velocities[3] = { &bodies.vx[0], &bodies.vy[0], &bodies.vz[0] };
+	Parallel::forRange(0, n, EPHEMERIS_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint d = 0; d < 3; d++)
+		{
+			double* p = positions[d];
+			double* v = velocities[d];
+			std::fill(p + lo, p + hi, 0.0);
+			std::fill(v + lo, v + hi, 0.0);
+			for (GLuint j = 0; j < terms; j++)
+			{
+				const double* c = base + (d * terms + j) * n;
+				const double tj = t[j], vj = dt[j] * dxdt;
+				for (GLuint b = lo; b < hi; b++)
+				{
+					p[b] += c[b] * tj;
+					v[b] += c[b] * vj;
+				}
+			}
+		}
+		for (GLuint b = lo; b < hi; b++)
+			bodies.rotation[b] = (GLfloat) fmod(bodies.rotationalSpeed[b] *
+				time, 360.0);
+	});
+	return true;
+}
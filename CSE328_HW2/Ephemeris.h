@@ -0,0 +1,125 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include "MappedFile.h"
+#include "OrbitalSystem.h"
+#include "Simulation.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flags building, or playing back, an ephemeris. */
+#define  EPHEMERIS_BUILD_FLAG       "--precompute"
+#define  EPHEMERIS_FLAG             "--ephemeris"
+/* Format identification. */
+#define  EPHEMERIS_MAGIC            0x4D485045   /* "EPHM" */
+#define  EPHEMERIS_VERSION          1
+/* Degree of the fitted polynomials. */
+#define  DEFAULT_EPHEMERIS_DEGREE   12
+/* Simulation steps per interval (and samples per fit, less one). */
+#define  DEFAULT_EPHEMERIS_STEPS    64
+/* Largest supported degree. */
+#define  MAX_EPHEMERIS_DEGREE       31
+
+/******************************************************************************
+*                                                                             *
+*                        EphemerisHeader  (struct)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  magic, version                                                             *
+*          EPHEMERIS_MAGIC and EPHEMERIS_VERSION.                             *
+*  bodies                                                                     *
+*          Number of bodies.                                                  *
+*  degree                                                                     *
+*          Degree of the polynomials (degree + 1 coefficients each).          *
+*  intervals                                                                  *
+*          Number of intervals.                                               *
+*  startTime, intervalLength                                                  *
+*          Time at which the first interval starts, and seconds per interval.*
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Start of an ephemeris file, followed by the coefficients as doubles. The  *
+*  coefficients of an interval are stored axis by axis, coefficient by       *
+*  coefficient, and body by body within a coefficient, so the coefficients   *
+*  every body needs for one term of one axis are contiguous. The header is  *
+*  a multiple of 8 bytes, so the coefficients can be used in place from a    *
+*  mapping of the file. All values are little-endian.                        *
+*                                                                             *
+*******************************************************************************/
+struct EphemerisHeader
+{
+	GLuint           magic;
+	GLuint           version;
+	GLuint           bodies;
+	GLuint           degree;
+	GLuint           intervals;
+	GLuint           reserved;
+	double           startTime;
+	double           intervalLength;
+};
+
+/******************************************************************************
+*                                                                             *
+*                           Ephemeris  (class)                                *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  map                                                                        *
+*          The mapped file.                                                   *
+*  header                                                                     *
+*          Header of the file.                                                *
+*  coefficients                                                               *
+*          First coefficient, inside the mapping.                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Piecewise Chebyshev fits of every body's trajectory, as in the JPL        *
+*  ephemerides. build runs a simulation and fits each fixed interval of its *
+*  positions; seek then gives the positions and velocities at any time      *
+*  covered, without integrating, by summing degree + 1 terms per axis. The   *
+*  Chebyshev values are computed once per seek and the sums run across the   *
+*  contiguous coefficients of all bodies, so they vectorize.                  *
+*                                                                             *
+*******************************************************************************/
+class Ephemeris
+{
+public:
+	/* Constructor. */
+	                 Ephemeris();
+
+	/* Simulate for duration seconds and write the fits; false on error. */
+	static bool      build(const char* filename, OrbitalSystem &system,
+	                       Simulation &simulation, double duration,
+	                       GLuint steps = DEFAULT_EPHEMERIS_STEPS,
+	                       GLuint degree = DEFAULT_EPHEMERIS_DEGREE);
+
+	/* Map the file; false on error. */
+	bool             open(const char* filename);
+	/* Write the positions, velocities (and spins) at time into bodies. */
+	bool             seek(double time, BodyArrays &bodies) const;
+
+	/* Getters. */
+	GLuint           getNumBodies()     const {  return header.bodies;    }
+	GLuint           getDegree()        const {  return header.degree;    }
+	double           getStartTime()     const {  return header.startTime; }
+	double           getEndTime()       const;
+
+private:
+	MappedFile       map;
+	EphemerisHeader  header;
+	const double*    coefficients;
+
+	/* Chebyshev polynomials T_j(x) and their derivatives, j <= degree. */
+	static void      chebyshev(double x, GLuint degree, double* t,
+	                           double* dt);
+};
@@ -25,6 +25,104 @@ EventManager::EventManager(Camera* camera, GLfloat* speed)
 {
 	this->camera = camera;
 	this->speed = speed;
+	this->timeline = NULL;
+	this->latency = NULL;
+	this->clicked = false;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         EventManager::processEvents()                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param waitMillis                                                          *
+*           Longest time to sleep if no event is queued (0 to not wait).      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  false once the application was asked to quit (window closed or Escape),    *
+*  true otherwise.                                                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Drains the event queue, blocking in SDL_WaitEventTimeout until the first   *
+*  event or the timeout so an idle loop does not spin. Mouse motion is only   *
+*  collected here (see update), so any number of motion events costs one      *
+*  camera turn per frame.                                                     *
+*                                                                             *
+*******************************************************************************/
+bool EventManager::processEvents(GLuint waitMillis)
+{
+	SDL_Event event;
+	bool      running = true;
+	int       pending = (waitMillis > 0) ?
+		SDL_WaitEventTimeout(&event, waitMillis) : SDL_PollEvent(&event);
+	while (pending)
+	{
+		/* Closing the window or pressing Escape ends the main loop, so the */
+		/* checkpoint, logs and latency histograms are still written.       */
+		if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN &&
+			event.key.keysym.scancode == SDL_SCANCODE_ESCAPE))
+			running = false;
+		else
+			handleSDLEvent(&event);
+		pending = SDL_PollEvent(&event);
+	}
+	return running;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            EventManager::update()                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param seconds                                                             *
+*           Time since the previous update.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Turns the camera by the mouse motion collected since the last frame and    *
+*  moves it along every held movement key at CAMERA_MOVE_SPEED, so movement   *
+*  is smooth and independent of the keyboard's autorepeat rate.               *
+*                                                                             *
+*******************************************************************************/
+void EventManager::update(GLfloat seconds)
+{
+	/* Turn once for all of the frame's mouse motion. */
+	camera->applyLookAt();
+	if (latency != NULL)
+		latency->inputApplied();
+
+	/* Directions to move in. */
+	const Uint8* keys = SDL_GetKeyboardState(NULL);
+	glm::vec3 view = glm::normalize(*(camera->getViewDirection()));
+	glm::vec3 up = glm::normalize(*(camera->getUpDirection()));
+	glm::vec3 side = glm::normalize(glm::cross(view, up));
+	glm::vec3 move;
+
+	/* Strafe Right / Left. */
+	if (keys[SDL_SCANCODE_D] || keys[SDL_SCANCODE_RIGHT])
+		move += side;
+	if (keys[SDL_SCANCODE_A] || keys[SDL_SCANCODE_LEFT])
+		move -= side;
+	/* Step Forward / Backward. */
+	if (keys[SDL_SCANCODE_W] || keys[SDL_SCANCODE_UP])
+		move += view;
+	if (keys[SDL_SCANCODE_S] || keys[SDL_SCANCODE_DOWN])
+		move -= view;
+	/* Step Up / Down. */
+	if (keys[SDL_SCANCODE_X])
+		move += up;
+	if (keys[SDL_SCANCODE_Z])
+		move -= up;
+
+	*(camera->getPosition()) += move * (CAMERA_MOVE_SPEED * seconds);
 }
 
 /******************************************************************************
@@ -49,14 +147,25 @@ EventManager::EventManager(Camera* camera, GLfloat* speed)
 *******************************************************************************/
 void EventManager::handleSDLEvent(SDL_Event* event) 
 {
+	/* Time the input from its event to the screen. */
+	if (latency != NULL && (event->type == SDL_MOUSEMOTION ||
+		event->type == SDL_KEYDOWN))
+		latency->inputHandled(event->common.timestamp);
+
 	if (event->type == SDL_MOUSEMOTION)
 	{
-		camera->updateLookAt({ event->motion.x, event->motion.y });
+		camera->moveMouse({ event->motion.x, event->motion.y });
 	}
 	else if (event->type == SDL_KEYDOWN)
 	{
 		handleKeyPress(event->key.keysym.scancode);
 	}
+	else if (event->type == SDL_MOUSEBUTTONDOWN &&
+		event->button.button == SDL_BUTTON_LEFT)
+	{
+		clicked = true;
+		clickPosition = glm::ivec2(event->button.x, event->button.y);
+	}
 }
 
 /******************************************************************************
@@ -74,14 +183,12 @@ void EventManager::handleSDLEvent(SDL_Event* event)
 *                                                                             *
 *******************************************************************************
 * DESCRIPTION                                                                 *
-*  Handles a key press event, typically indicating camera motion.             *
+*  Handles a key press event: speed and replay keys (camera movement keys     *
+*  are read as held keys by update instead).                                  *
 *                                                                             *
 *******************************************************************************/
 void EventManager::handleKeyPress(SDL_Scancode key) 
 {	
-	glm::vec3 move;
-	float scale = 1.0f;
-
 	switch (key) 
 	{
 	/* Speed Up. */
@@ -96,52 +203,41 @@ void EventManager::handleKeyPress(SDL_Scancode key)
 			*speed -= 0.5f;
 		break;
 
-	/* Strafe Right. */
-	case SDL_SCANCODE_D:
-	case SDL_SCANCODE_RIGHT:
-		move = glm::cross(*(camera->getViewDirection()), *(camera->getUpDirection()));
-		move = move / glm::length(move);
-		*( camera->getPosition() ) += move * scale;
-		break;
-
-	/* Strafe Left. */
-	case SDL_SCANCODE_A:
-	case SDL_SCANCODE_LEFT:
-		move = glm::cross(*( camera->getUpDirection() ), *( camera->getViewDirection() ));
-		move = move / glm::length(move);
-		*( camera->getPosition() ) += move * scale;
-		break;
-
-	/* Step Forward. */
-	case SDL_SCANCODE_W:
-	case SDL_SCANCODE_UP:
-		move = *( camera->getViewDirection() );
-		move /= glm::length(move);
-		*( camera->getPosition() ) += move * scale;
-		break;
-
-	/* Step Backward. */
-	case SDL_SCANCODE_S:
-	case SDL_SCANCODE_DOWN:
-		move = *(camera->getViewDirection());
-		move = -1.0f * ( move / glm::length(move) );
-		*( camera->getPosition() ) += move * scale;
-		break;
-
-	/* Step Down. */
-	case SDL_SCANCODE_Z:
-		move = *(camera->getUpDirection());
-		move /= glm::length(move);
-		*( camera->getPosition() ) -= move * scale;
+	/* Scrub the replay back and forward. */
+	case SDL_SCANCODE_LEFTBRACKET:
+		if (timeline != NULL)
+			*timeline -= SCRUB_STEP_SECONDS;
 		break;
-
-	/* Step Up. */
-	case SDL_SCANCODE_X:
-		move = *( camera->getUpDirection() );
-		move /= glm::length(move);
-		*( camera->getPosition() ) += move * scale;
+	case SDL_SCANCODE_RIGHTBRACKET:
+		if (timeline != NULL)
+			*timeline += SCRUB_STEP_SECONDS;
 		break;
-	case  SDL_SCANCODE_ESCAPE:
-		exit(0);
 	}
-}
\ No newline at end of file
+}
+/******************************************************************************
+*                                                                             *
+*                           EventManager::takeClick()                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param position                                                            *
+*           Set to the window coordinates of the click, if there was one.     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  true if the left mouse button was pressed since the last call.             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Hands a click over for picking once; several clicks within one frame       *
+*  count as the last of them.                                                 *
+*                                                                             *
+*******************************************************************************/
+bool EventManager::takeClick(glm::ivec2* position)
+{
+	if (!clicked)
+		return false;
+	clicked = false;
+	*position = clickPosition;
+	return true;
+}
@@ -2,6 +2,12 @@
 #include  "Camera.h"
 #include  "SDL\SDL.h"
 #include  <GL\glew.h>
+#include  "LatencyMonitor.h"
+
+/* Simulated seconds skipped by one press of the scrubbing keys. */
+#define  SCRUB_STEP_SECONDS  86400.0
+/* Distance the camera moves per second while a movement key is held. */
+#define  CAMERA_MOVE_SPEED   30.0f
 
 /******************************************************************************
  *																			  *
@@ -25,16 +31,25 @@ public:
 	/* Constructor. */
 	EventManager(Camera* camera, GLfloat* speed);
 
+	/* Handle every queued event, waiting up to waitMillis for the first. */
+	bool           processEvents(GLuint waitMillis);
+	/* Apply the input of one frame to the camera. */
+	void           update(GLfloat seconds);
 	/* Handle an SDL Event. */
 	void           handleSDLEvent(SDL_Event* event);
 	/* Handle a key press event. */
 	void           handleKeyPress(SDL_Scancode key);
+	/* Return the last click since the previous call, if any. */
+	bool           takeClick(glm::ivec2* position);
 
 	/* Getters. */
 	Camera*        getCamera()                   {  return camera;        }
 
 	/* Setters. */
 	void           setCamera(Camera* c)          {  camera = c;           }
+	void           setTimeline(double* t)        {  timeline = t;         }
+	void           setLatencyMonitor(LatencyMonitor* l)
+	                                             {  latency = l;          }
 
 	/* Destructor. */
 	~EventManager()                              {                        }
@@ -44,5 +59,12 @@ private:
 	/* Camera for the application. */
 	Camera*        camera;
 	GLfloat*        speed;
+	/* Replay time moved by the scrubbing keys (NULL when not replaying). */
+	double*        timeline;
+	/* Latency measurement of the handled input (NULL for none). */
+	LatencyMonitor* latency;
+	/* Whether the left button was pressed since takeClick, and where. */
+	bool            clicked;
+	glm::ivec2      clickPosition;
 };
 
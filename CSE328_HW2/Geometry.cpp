@@ -14,7 +14,12 @@
 #include <glm\glm.hpp>
 #include <glm\gtx\transform.hpp>
 #include <SDL\SDL_image.h>
-#include "tiny_obj_loader.h"
+#include "ObjLoader.h"
+#include "Parallel.h"
+#include "VertexTransform.h"
+#include "NormalGenerator.h"
+#include <algorithm>
+#include <mutex>
 
 /******************************************************************************
 *                                                                             *
@@ -24,6 +29,7 @@
 #define ARRAY_SIZE(a) sizeof(a) / sizeof(*a)
 
 Shader* Geometry::shader = NULL;
+bool Geometry::deferUploads = false;
 const char* Geometry::ICO_OBJ = "res/meshes/icosohedron.obj";
 const char* Geometry::TORUS_OBJ = "res/meshes/torus.obj";
 const glm::vec3 Geometry::COLORS[] = { { +1.0f, +0.0f, +0.0f },   // Red.
@@ -33,6 +39,203 @@ const glm::vec3 Geometry::COLORS[] = { { +1.0f, +0.0f, +0.0f },   // Red.
                                        { +1.0f, +0.0f, +1.0f },   // Magenta.
                                        { +0.0f, +1.0f, +1.0f } }; // Cyan.
 
+/******************************************************************************
+*                                                                             *
+*                              Built-in Polyhedra                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Vertex data of the base shapes as plain float tables, one row per Vertex   *
+*  (position, color, normal, texture coordinate), so they are constant data   *
+*  of the executable rather than built or loaded at startup. The icosahedron  *
+*  is the golden rectangle one scaled to the unit sphere (normals equal the   *
+*  positions, colors as loadObj gives them); all faces wind counter-          *
+*  clockwise seen from outside.                                               *
+*                                                                             *
+******************************************************************************/
+static const GLfloat CUBE_VERTICES[][FLOATS_PER_VERTEX] =
+{
+	/* Top. */
+	{ -1.0f, +1.0f, +1.0f,   +1.0f, +0.0f, +0.0f,   +0.0f, +1.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, +1.0f, +1.0f,   +0.0f, +1.0f, +0.0f,   +0.0f, +1.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, +1.0f, -1.0f,   +0.0f, +0.0f, +1.0f,   +0.0f, +1.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, +1.0f, -1.0f,   +1.0f, +1.0f, +1.0f,   +0.0f, +1.0f, +0.0f,   +0.0f, +0.0f },
+	/* Front. */
+	{ -1.0f, +1.0f, -1.0f,   +1.0f, +0.0f, +1.0f,   +0.0f, +0.0f, -1.0f,   +0.0f, +0.0f },
+	{ +1.0f, +1.0f, -1.0f,   +0.0f, +0.5f, +0.2f,   +0.0f, +0.0f, -1.0f,   +0.0f, +0.0f },
+	{ +1.0f, -1.0f, -1.0f,   +0.8f, +0.6f, +0.4f,   +0.0f, +0.0f, -1.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, -1.0f,   +0.3f, +1.0f, +0.5f,   +0.0f, +0.0f, -1.0f,   +0.0f, +0.0f },
+	/* Right. */
+	{ +1.0f, +1.0f, -1.0f,   +0.2f, +0.5f, +0.2f,   +1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, +1.0f, +1.0f,   +0.9f, +0.3f, +0.7f,   +1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, -1.0f, +1.0f,   +0.3f, +0.7f, +0.5f,   +1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, -1.0f, -1.0f,   +0.5f, +0.7f, +0.5f,   +1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	/* Left. */
+	{ -1.0f, +1.0f, +1.0f,   +0.7f, +0.8f, +0.2f,   -1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, +1.0f, -1.0f,   +0.5f, +0.7f, +0.3f,   -1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, -1.0f,   +0.4f, +0.7f, +0.7f,   -1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, +1.0f,   +0.2f, +0.5f, +1.0f,   -1.0f, +0.0f, +0.0f,   +0.0f, +0.0f },
+	/* Back. */
+	{ +1.0f, +1.0f, +1.0f,   +0.6f, +1.0f, +0.7f,   +0.0f, +0.0f, +1.0f,   +0.0f, +0.0f },
+	{ -1.0f, +1.0f, +1.0f,   +0.6f, +0.4f, +0.8f,   +0.0f, +0.0f, +1.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, +1.0f,   +0.2f, +0.8f, +0.7f,   +0.0f, +0.0f, +1.0f,   +0.0f, +0.0f },
+	{ +1.0f, -1.0f, +1.0f,   +0.2f, +0.7f, +1.0f,   +0.0f, +0.0f, +1.0f,   +0.0f, +0.0f },
+	/* Bottom. */
+	{ +1.0f, -1.0f, -1.0f,   +0.8f, +0.3f, +0.7f,   +0.0f, -1.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, -1.0f,   +0.8f, +0.9f, +0.5f,   +0.0f, -1.0f, +0.0f,   +0.0f, +0.0f },
+	{ -1.0f, -1.0f, +1.0f,   +0.5f, +0.8f, +0.5f,   +0.0f, -1.0f, +0.0f,   +0.0f, +0.0f },
+	{ +1.0f, -1.0f, +1.0f,   +0.9f, +1.0f, +0.2f,   +0.0f, -1.0f, +0.0f,   +0.0f, +0.0f },
+};
+static const GLushort CUBE_INDICES[] =
+{
+	0, 1, 2, 0, 2, 3,       // Top
+	4, 5, 6, 4, 6, 7,       // Front
+	8, 9, 10, 8, 10, 11,    // Right
+	12, 13, 14, 12, 14, 15, // Left
+	16, 17, 18, 16, 18, 19, // Back
+	20, 22, 21, 20, 23, 22, // Bottom
+};
+
+static const GLfloat TETRAHEDRON_VERTICES[][FLOATS_PER_VERTEX] =
+{
+	{ +0.5773503f, +0.5773503f, +0.5773503f,   +1.0f, +0.0f, +0.0f,   +0.5773503f, -0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, -0.5773503f, +0.5773503f,   +1.0f, +0.0f, +0.0f,   +0.5773503f, -0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ +0.5773503f, -0.5773503f, -0.5773503f,   +1.0f, +0.0f, +0.0f,   +0.5773503f, -0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ +0.5773503f, +0.5773503f, +0.5773503f,   +0.0f, +1.0f, +0.0f,   -0.5773503f, +0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, +0.5773503f, -0.5773503f,   +0.0f, +1.0f, +0.0f,   -0.5773503f, +0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, -0.5773503f, +0.5773503f,   +0.0f, +1.0f, +0.0f,   -0.5773503f, +0.5773503f, +0.5773503f,   +0.0f, +0.0f },
+	{ +0.5773503f, +0.5773503f, +0.5773503f,   +0.0f, +0.0f, +1.0f,   +0.5773503f, +0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+	{ +0.5773503f, -0.5773503f, -0.5773503f,   +0.0f, +0.0f, +1.0f,   +0.5773503f, +0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, +0.5773503f, -0.5773503f,   +0.0f, +0.0f, +1.0f,   +0.5773503f, +0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+	{ +0.5773503f, -0.5773503f, -0.5773503f,   +1.0f, +1.0f, +0.0f,   -0.5773503f, -0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, -0.5773503f, +0.5773503f,   +1.0f, +1.0f, +0.0f,   -0.5773503f, -0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+	{ -0.5773503f, +0.5773503f, -0.5773503f,   +1.0f, +1.0f, +0.0f,   -0.5773503f, -0.5773503f, -0.5773503f,   +0.0f, +0.0f },
+};
+static const GLushort TETRAHEDRON_INDICES[] =
+{
+	0, 1, 2,
+	3, 4, 5,
+	6, 7, 8,
+	9, 10, 11,
+};
+
+static const GLfloat ICOSAHEDRON_VERTICES[][FLOATS_PER_VERTEX] =
+{
+	{ -0.5257311f, +0.8506508f, +0.0000000f,   +1.0f, +0.0f, +0.0f,   -0.5257311f, +0.8506508f, +0.0000000f,   +0.0f, +0.0f },
+	{ +0.5257311f, +0.8506508f, +0.0000000f,   +1.0f, +0.0f, +0.0f,   +0.5257311f, +0.8506508f, +0.0000000f,   +0.0f, +0.0f },
+	{ -0.5257311f, -0.8506508f, +0.0000000f,   +1.0f, +0.0f, +0.0f,   -0.5257311f, -0.8506508f, +0.0000000f,   +0.0f, +0.0f },
+	{ +0.5257311f, -0.8506508f, +0.0000000f,   +0.0f, +1.0f, +0.0f,   +0.5257311f, -0.8506508f, +0.0000000f,   +0.0f, +0.0f },
+	{ +0.0000000f, -0.5257311f, +0.8506508f,   +0.0f, +1.0f, +0.0f,   +0.0000000f, -0.5257311f, +0.8506508f,   +0.0f, +0.0f },
+	{ +0.0000000f, +0.5257311f, +0.8506508f,   +0.0f, +1.0f, +0.0f,   +0.0000000f, +0.5257311f, +0.8506508f,   +0.0f, +0.0f },
+	{ +0.0000000f, -0.5257311f, -0.8506508f,   +0.0f, +0.0f, +1.0f,   +0.0000000f, -0.5257311f, -0.8506508f,   +0.0f, +0.0f },
+	{ +0.0000000f, +0.5257311f, -0.8506508f,   +0.0f, +0.0f, +1.0f,   +0.0000000f, +0.5257311f, -0.8506508f,   +0.0f, +0.0f },
+	{ +0.8506508f, +0.0000000f, -0.5257311f,   +0.0f, +0.0f, +1.0f,   +0.8506508f, +0.0000000f, -0.5257311f,   +0.0f, +0.0f },
+	{ +0.8506508f, +0.0000000f, +0.5257311f,   +1.0f, +1.0f, +0.0f,   +0.8506508f, +0.0000000f, +0.5257311f,   +0.0f, +0.0f },
+	{ -0.8506508f, +0.0000000f, -0.5257311f,   +1.0f, +1.0f, +0.0f,   -0.8506508f, +0.0000000f, -0.5257311f,   +0.0f, +0.0f },
+	{ -0.8506508f, +0.0000000f, +0.5257311f,   +1.0f, +1.0f, +0.0f,   -0.8506508f, +0.0000000f, +0.5257311f,   +0.0f, +0.0f },
+};
+static const GLushort ICOSAHEDRON_INDICES[] =
+{
+	0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+	1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+	3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+	4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1,
+};
+
+/* The tables are read as Vertex arrays. */
+static_assert(sizeof(Vertex) == FLOATS_PER_VERTEX * sizeof(GLfloat),
+	"Vertex must be tightly packed floats.");
+static_assert(ARRAY_SIZE(ICOSAHEDRON_VERTICES) == SphereSize<0>::VERTICES &&
+	ARRAY_SIZE(ICOSAHEDRON_INDICES) == SphereSize<0>::INDICES,
+	"Icosahedron does not match SphereSize<0>.");
+
+/* Picking BVHs by a hash of the geometry they were built over, so meshes */
+/* with the same triangles (instances of one shape) share one. Each entry */
+/* keeps the positions and indices to confirm a match on a hash hit.      */
+struct BVHCacheEntry
+{
+	std::vector<glm::vec3>              positions;
+	std::vector<GLushort>               indices;
+	std::weak_ptr<const TriangleBVH>    bvh;
+};
+static std::mutex bvhCacheLock;
+static std::multimap<Uint64, BVHCacheEntry> bvhCache;
+
+/******************************************************************************
+*                                                                             *
+*                           geometryHash (file static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertices, numVertices                                               *
+*           The vertices (only the positions count).                          *
+*  @param indices, numIndices                                                 *
+*           The indices.                                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  64-bit FNV-1a hash of the counts, positions and indices.                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Identifies the triangles of a mesh for the BVH cache. Colors, normals      *
+*  and texture coordinates do not change what a ray hits.                     *
+*                                                                             *
+*******************************************************************************/
+static Uint64 geometryHash(const Vertex* vertices, GLuint numVertices,
+                           const GLushort* indices, GLuint numIndices)
+{
+	Uint64 hash = 14695981039346656037ULL;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*) data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	};
+	mix(&numVertices, sizeof(numVertices));
+	mix(&numIndices, sizeof(numIndices));
+	for (GLuint i = 0; i < numVertices; i++)
+		mix(&vertices[i].position, sizeof(glm::vec3));
+	mix(indices, numIndices * sizeof(GLushort));
+	return hash;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           sameGeometry (file static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param entry                                                               *
+*           A BVH cache entry.                                                *
+*  @param vertices, numVertices                                               *
+*           The vertices (only the positions count).                          *
+*  @param indices, numIndices                                                 *
+*           The indices.                                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the entry was built over exactly these triangles.                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Guards the cache against hash collisions, which would otherwise hand a     *
+*  mesh the BVH of different triangles.                                       *
+*                                                                             *
+*******************************************************************************/
+static bool sameGeometry(const BVHCacheEntry &entry, const Vertex* vertices,
+                         GLuint numVertices, const GLushort* indices,
+                         GLuint numIndices)
+{
+	if (entry.positions.size() != numVertices ||
+		entry.indices.size() != numIndices)
+		return false;
+	for (GLuint i = 0; i < numVertices; i++)
+		if (entry.positions[i] != vertices[i].position)
+			return false;
+	return std::equal(entry.indices.begin(), entry.indices.end(), indices);
+}
+
 /******************************************************************************
 *                                                                             *
 *                       Mesh::Mesh  (constructor - overloaded)                *
@@ -59,15 +262,14 @@ const glm::vec3 Geometry::COLORS[] = { { +1.0f, +0.0f, +0.0f },   // Red.
 *                                                                             *
 * DESCRIPTION (2)                                                             *
 *  Copy constructor which copis all of the data from one Mesh to a new one.   *
+*  The picking BVH is shared rather than copied.                              *
 *                                                                             *
 *******************************************************************************/
 Mesh::Mesh() :
     /* Constructor Initialization. */
     vertices(0), numVertices(0),
     indices(0), numIndices(0),
-	textureID(-1), changed(false),
-	transform_MTW(glm::mat4()), translate_M(glm::mat4()),
-	scale_M(glm::mat4()), rotate_M(glm::mat4()), revolve_M(glm::mat4()), 
+	textureID(-1), transform(TransformSystem::get().create()),
     numBuffers(DEFAULT_NUM_BUFFERS), bufferIDs(0), vertexArrayID(0),
 	drawMode(DEFAULT_DRAW_MODE), solid(DEFAULT_SOLID)
 {
@@ -80,7 +282,9 @@ Mesh::Mesh(const Mesh& rhs) :
 	textureID(rhs.getTextureID()),
 	numBuffers(rhs.getNumBuffers()),
 	vertexArrayID(rhs.getVertexArrayID()),
-	drawMode(rhs.getDrawMode())
+	transform(TransformSystem::get().create()),
+	drawMode(rhs.getDrawMode()),
+	bvh(rhs.bvh)
 {
 	/* Allocate space for the vertices, indices, and buffers on the heap. */
 	vertices = new Vertex[rhs.getNumVertices()];
@@ -113,8 +317,7 @@ Mesh::Mesh(const Mesh& rhs) :
 *******************************************************************************/
 void Mesh::translateModel(glm::vec3 translate)
 {
-	translate_M = glm::translate(translate);
-	changed = true;
+	TransformSystem::get().setTranslation(transform, translate);
 }
 
 /******************************************************************************
@@ -141,8 +344,7 @@ void Mesh::translateModel(glm::vec3 translate)
 *******************************************************************************/
 void Mesh::rotateModel(GLfloat theta, glm::vec3 axis)
 {
-	rotate_M = glm::rotate(theta, axis);
-	changed = true;
+	TransformSystem::get().setRotation(transform, theta, axis);
 }
 
 /******************************************************************************
@@ -165,8 +367,7 @@ void Mesh::rotateModel(GLfloat theta, glm::vec3 axis)
 *******************************************************************************/
 void Mesh::scaleModel(glm::vec3 scale)
 {
-	scale_M = glm::scale(scale);
-	changed = true;
+	TransformSystem::get().setScale(transform, scale);
 }
 
 
@@ -193,8 +394,7 @@ void Mesh::scaleModel(glm::vec3 scale)
 *******************************************************************************/
 void Mesh::revolveModel(GLfloat theta, glm::vec3 axis)
 {
-	revolve_M = glm::rotate(theta, axis);
-	changed = true;
+	TransformSystem::get().setRevolution(transform, theta, axis);
 }
 
 /******************************************************************************
@@ -211,17 +411,13 @@ void Mesh::revolveModel(GLfloat theta, glm::vec3 axis)
 *                                                                             *
 *******************************************************************************
 * DESCRIPTION                                                                 *
-*  Calculates and returns the combined transformation matrix for this mesh.   *
+*  Returns the combined transformation matrix for this mesh, composed by      *
+*  the last TransformSystem::update. Safe to call from any thread.            *
 *                                                                             *
 *******************************************************************************/
-glm::mat4 Mesh::getTransform()
+glm::mat4 Mesh::getTransform() const
 {
-	if (changed)
-	{
-		transform_MTW = revolve_M * translate_M * rotate_M * scale_M;
-		changed = false;
-	}
-	return transform_MTW;
+	return TransformSystem::get().getWorld(transform);
 }
 
 /******************************************************************************
@@ -243,8 +439,76 @@ glm::mat4 Mesh::getTransform()
 *******************************************************************************/
 void Mesh::clearTransform()
 {
-	revolve_M = translate_M = rotate_M = scale_M = transform_MTW = glm::mat4();
-	changed = false;
+	TransformSystem::get().clear(transform);
+}
+
+/******************************************************************************
+*                                                                             *
+*                               Mesh::getBVH                                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The BVH over the triangles in model space, or NULL for a mesh which is     *
+*  not drawn as triangles or has none.                                        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Looked up on the first query after the geometry was set or changed: a      *
+*  mesh with the same positions and indices as a live one (another instance   *
+*  of the shape, or a copy) shares its BVH, otherwise a new one is built.     *
+*  Hash hits are compared in full, and building a new BVH first drops the     *
+*  entries whose BVHs have been freed, so the cache holds only live ones.     *
+*  Not safe to call for the same mesh from two threads at once.               *
+*                                                                             *
+*******************************************************************************/
+const TriangleBVH* Mesh::getBVH() const
+{
+	if (drawMode != GL_TRIANGLES || numIndices < 3 || numVertices == 0)
+		return NULL;
+
+	if (!bvh)
+	{
+		Uint64 key = geometryHash(vertices, numVertices, indices, numIndices);
+		std::lock_guard<std::mutex> guard(bvhCacheLock);
+
+		/* Share a live BVH over the same triangles. */
+		auto range = bvhCache.equal_range(key);
+		for (auto it = range.first; it != range.second && !bvh; ++it)
+		{
+			std::shared_ptr<const TriangleBVH> live = it->second.bvh.lock();
+			if (live && sameGeometry(it->second, vertices, numVertices,
+				indices, numIndices))
+				bvh = live;
+		}
+
+		if (!bvh)
+		{
+			/* Drop the entries of BVHs no mesh uses any more. */
+			for (auto it = bvhCache.begin(); it != bvhCache.end();)
+			{
+				if (it->second.bvh.expired())
+					it = bvhCache.erase(it);
+				else
+					++it;
+			}
+
+			bvh = std::make_shared<TriangleBVH>(&vertices[0].position.x,
+				(GLuint) (sizeof(Vertex) / sizeof(GLfloat)), indices,
+				numIndices);
+			BVHCacheEntry entry;
+			entry.positions.resize(numVertices);
+			for (GLuint i = 0; i < numVertices; i++)
+				entry.positions[i] = vertices[i].position;
+			entry.indices.assign(indices, indices + numIndices);
+			entry.bvh = bvh;
+			bvhCache.insert(std::make_pair(key, entry));
+		}
+	}
+	return bvh.get();
 }
 
 
@@ -269,159 +533,15 @@ void Mesh::clearTransform()
 *******************************************************************************/
 Mesh* Geometry::makeCube(GLfloat side)
 {
-	/* Define return mesh. */
-	Mesh* cube = new Mesh();
-
-	cube->setTextureID(-1);
-	cube->setDrawMode(GL_TRIANGLES);
-
-	/* Deine vertices. */
-	Vertex localVertices[] =
-	{
-		/* Vertex 0. */
-		glm::vec3(-1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+1.0f, +0.0f, +0.0f), // Color.
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 1. */
-		glm::vec3(+1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+0.0f, +1.0f, +0.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 2. */
-		glm::vec3(+1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+0.0f, +0.0f, +1.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 3. */
-		glm::vec3(-1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+1.0f, +1.0f, +1.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 4. */
-		glm::vec3(-1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+1.0f, +0.0f, +1.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 5. */
-		glm::vec3(+1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+0.0f, +0.5f, +0.2f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 6. */
-		glm::vec3(+1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.8f, +0.6f, +0.4f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 7. */
-		glm::vec3(-1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.3f, +1.0f, +0.5f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 8. */
-		glm::vec3(+1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+0.2f, +0.5f, +0.2f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 9. */
-		glm::vec3(+1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+0.9f, +0.3f, +0.7f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 10. */
-		glm::vec3(+1.0f, -1.0f, +1.0f), // Position.
-		glm::vec3(+0.3f, +0.7f, +0.5f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 11. */
-		glm::vec3(+1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.5f, +0.7f, +0.5f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 12. */
-		glm::vec3(-1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+0.7f, +0.8f, +0.2f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 13. */
-		glm::vec3(-1.0f, +1.0f, -1.0f), // Position.
-		glm::vec3(+0.5f, +0.7f, +0.3f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 14. */
-		glm::vec3(-1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.4f, +0.7f, +0.7f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 15. */
-		glm::vec3(-1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.2f, +0.5f, +1.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 16. */
-		glm::vec3(+1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+0.6f, +1.0f, +0.7f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 17. */
-		glm::vec3(-1.0f, +1.0f, +1.0f), // Position.
-		glm::vec3(+0.6f, +0.4f, +0.8f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 18. */
-		glm::vec3(-1.0f, -1.0f, +1.0f), // Position.
-		glm::vec3(+0.2f, +0.8f, +0.7f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 19. */
-		glm::vec3(+1.0f, -1.0f, +1.0f), // Position.
-		glm::vec3(+0.2f, +0.7f, +1.0f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 21. */
-		glm::vec3(+1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.8f, +0.3f, +0.7f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 22. */
-		glm::vec3(-1.0f, -1.0f, -1.0f), // Position.
-		glm::vec3(+0.8f, +0.9f, +0.5f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 23. */
-		glm::vec3(-1.0f, -1.0f, +1.0f), // Position.
-		glm::vec3(+0.5f, +0.8f, +0.5f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-		/* Vertex 24. */
-		glm::vec3(+1.0f, -1.0f, +1.0f), // Position.
-		glm::vec3(+0.9f, +1.0f, +0.2f), // Color
-		glm::vec3(+0.0f, +0.0f, +0.0f), // Vertex Normal
-		glm::vec2(+0.0f, +0.0f),        // Texture Coordinate.
-	};
-
-	/* Define indices. */
-	GLushort localIndices[] = {
-		0, 1, 2, 0, 2, 3, // Top
-		4, 5, 6, 4, 6, 7, // Front
-		8, 9, 10, 8, 10, 11, // Right
-		12, 14, 13, 12, 14, 15, // Left
-		16, 17, 18, 16, 18, 19, // Back
-		20, 22, 21, 20, 23, 22, // Bottom
-	};
+	/* Define return mesh from the built-in cube. */
+	Mesh* cube = makeMesh((const Vertex*) CUBE_VERTICES,
+		ARRAY_SIZE(CUBE_VERTICES), CUBE_INDICES, ARRAY_SIZE(CUBE_INDICES));
 
 	// Apply the scale transformation.
-	glm::mat3 scale = glm::mat3{ glm::scale(glm::vec3{ side, side, side }) };
-	for (int i = 0; i < ARRAY_SIZE(localVertices); i++)
-		localVertices[i].position = scale * localVertices[i].position;
-
-	/* Set the vertices and the indices for the mesh.. */
-	cube->setVertices(ARRAY_SIZE(localVertices), localVertices);
-	cube->setIndices(ARRAY_SIZE(localIndices), localIndices);
+	cube->transformVertices(glm::scale(glm::vec3{ side, side, side }));
 
-	/* Generate buffer and vertex arrays. */
-	cube->genBufferArrayID();
-	cube->genVertexArrayID();
+	/* Generate buffer and vertex arrays (unless deferred). */
+	finishMesh(cube);
 
 	/* Return mesh. */
 	return cube;
@@ -449,72 +569,114 @@ Mesh* Geometry::makeCube(GLfloat side)
 *******************************************************************************/
 Mesh* Geometry::makeTetrahedron(GLfloat radius)
 {
-	/* Define return mesh. */
-	Mesh* tetra = new Mesh();
-
-	tetra->setTextureID(-1);
-	tetra->setDrawMode(GL_TRIANGLES);
+	/* Define return mesh from the built-in tetrahedron. */
+	Mesh* tetra = makeMesh((const Vertex*) TETRAHEDRON_VERTICES,
+		ARRAY_SIZE(TETRAHEDRON_VERTICES), TETRAHEDRON_INDICES,
+		ARRAY_SIZE(TETRAHEDRON_INDICES));
 
-	glm::vec2 texture{0.0f, 0.0f};
-	glm::vec3 a = glm::normalize(glm::vec3{ +1.0f, +1.0f, +1.0f });
-	glm::vec3 b = glm::normalize(glm::vec3{ +1.0f, -1.0f, -1.0f });
-	glm::vec3 c = glm::normalize(glm::vec3{ -1.0f, +1.0f, -1.0f });
-	glm::vec3 d = glm::normalize(glm::vec3{ -1.0f, -1.0f, +1.0f });
+	/* Generate buffer and vertex arrays (unless deferred). */
+	finishMesh(tetra);
 
-	/* Deine vertices. */
-	Vertex localVertices[] =
-	{
-		// Vertex 0. 
-		a, COLORS[0], -c, texture,  
-		// Vertex 1.
-		d, COLORS[0], -c, texture,
-		// Vertex 2. 
-		b, COLORS[0], -c, texture, 
-		// Vertex 3.
-		a, COLORS[1], -b, texture, 
-		// Vertex 4. 
-		c, COLORS[1], -b, texture, 
-		// Vertex 5.
-		d, COLORS[1], -b, texture,    
-		// Vertex 6.
-		a, COLORS[2], -d, texture, 
-		// Vertex 7. 
-		b, COLORS[2], -d, texture,  
-		// Vertex 8. 
-		c, COLORS[2], -d ,texture,
-		// Vertex 9.
-		b, COLORS[3], -a, texture,
-		// Vertex 10.
-		d, COLORS[3], -a, texture,
-		// Vertex 11.
-		c, COLORS[3], -a, texture,
-	};
-
-	/* Define indices. */
-	GLushort localIndices[] = {
-		0, 1, 2, 
-		3, 4, 5,
-		6, 7, 8, 
-		9, 10, 11,
-	};
+	/* Return mesh. */
+	return tetra;
+}
 
-	// Apply the scale transformation.
-	//glm::mat3 scale = glm::mat3{ 
-	//	glm::scale(glm::vec3{ radius, radius, radius}) 
-	//};
-	//for (int i = 0; i < ARRAY_SIZE(localVertices); i++)
-	//	localVertices[i].position = scale * localVertices[i].position;
+/******************************************************************************
+*                                                                             *
+*                               subdivideSphere                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  verts                                                                      *
+*           Vertices of the sphere, all at the given radius.                  *
+*  indices                                                                    *
+*           Triangles of the sphere, replaced by four triangles each.         *
+*  radius                                                                     *
+*           Radius of the sphere.                                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  One level of tesselation, equivalent to calling middlePointIndex on every  *
+*  edge but done in parallel: the edges are collected and sorted, one new     *
+*  vertex is made per distinct edge (placed on the sphere and averaging the   *
+*  other attributes), and each triangle then finds its three midpoints by     *
+*  binary search. The result does not depend on the number of threads.        *
+*                                                                             *
+*******************************************************************************/
+static void subdivideSphere(std::vector<Vertex>* verts,
+	std::vector<GLushort>* indices, GLfloat radius)
+{
+	const GLuint numTriangles = indices->size() / 3;
+	const GLuint base = verts->size();
+	const GLushort* tri = indices->data();
 
-	/* Set the vertices and the indices for the mesh.. */
-	tetra->setVertices(ARRAY_SIZE(localVertices), localVertices);
-	tetra->setIndices(ARRAY_SIZE(localIndices), localIndices);
+	// Key each edge by its two vertices, the smaller first.
+	std::vector<GLuint> edges(3 * numTriangles);
+	Parallel::forRange(0, numTriangles, 1024, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint j = lo; j < hi; j++)
+		{
+			for (GLuint k = 0; k < 3; k++)
+			{
+				GLuint i1 = tri[3 * j + k], i2 = tri[3 * j + (k + 1) % 3];
+				edges[3 * j + k] = (std::min(i1, i2) << 16) | std::max(i1, i2);
+			}
+		}
+	});
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	// Create the middle vertex of each edge.
+	verts->resize(base + edges.size());
+	Vertex* v = verts->data();
+	Parallel::forRange(0, edges.size(), 1024, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint e = lo; e < hi; e++)
+		{
+			const Vertex &v1 = v[edges[e] >> 16];
+			const Vertex &v2 = v[edges[e] & 0xFFFF];
+			Vertex &middle = v[base + e];
+			middle.position = glm::normalize(v1.position + v2.position) *
+				radius;
+			middle.color = 0.5f * (v1.color + v2.color);
+			middle.normal = glm::normalize(v1.normal + v2.normal);
+			middle.textureCoordinate = (v1.textureCoordinate +
+				v2.textureCoordinate) * 0.5f;
+		}
+	});
 
-	/* Generate buffer and vertex arrays. */
-	tetra->genBufferArrayID();
-	tetra->genVertexArrayID();
+	// Split each triangle into 4 new triangles.
+	std::vector<GLushort> newIndices(12 * numTriangles);
+	Parallel::forRange(0, numTriangles, 1024, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint j = lo; j < hi; j++)
+		{
+			// Get the middle index of each side of the triangle.
+			GLushort m[3];
+			for (GLuint k = 0; k < 3; k++)
+			{
+				GLuint i1 = tri[3 * j + k], i2 = tri[3 * j + (k + 1) % 3];
+				GLuint key = (std::min(i1, i2) << 16) | std::max(i1, i2);
+				m[k] = (GLushort) (base + (std::lower_bound(edges.begin(),
+					edges.end(), key) - edges.begin()));
+			}
+			GLushort a = m[0], b = m[1], c = m[2];
+			GLushort* out = &newIndices[12 * j];
+
+			// Triangles 1 to 3 at the corners, 4 in the middle.
+			out[0] = tri[3 * j + 0];  out[1]  = a;  out[2]  = c;
+			out[3] = tri[3 * j + 1];  out[4]  = b;  out[5]  = a;
+			out[6] = tri[3 * j + 2];  out[7]  = c;  out[8]  = b;
+			out[9] = a;               out[10] = b;  out[11] = c;
+		}
+	});
 
-	/* Return mesh. */
-	return tetra;
+	// Update local indices.
+	indices->swap(newIndices);
 }
 
 /******************************************************************************
@@ -541,97 +703,94 @@ Mesh* Geometry::makeTetrahedron(GLfloat radius)
 *******************************************************************************/
 Mesh* Geometry::makeSphere(GLfloat radius, GLuint tesselation)
 {
-	// Create return mesh and cache for tessellating the sphere.
-	Mesh* sphere = Geometry::loadObj(ICO_OBJ);
-	std::map<GLuint, GLushort> middlePointIndexCache;
-
-	// Get the vertices from icosohedron.
+	// Tesselate the built-in icosohedron.
 	std::vector<Vertex> localVerts;
-	for (GLuint i = 0; i < sphere->getNumVertices(); i++)
-	{
-		localVerts.push_back(sphere->getVertex(i));
-		localVerts.at(i).position = glm::normalize(localVerts.at(i).position) *
-			radius;
-	}
-
-	// Get the indices from the icosohedron.
 	std::vector<GLushort> localIndices;
-	for (GLuint i = 0; i < sphere->getNumIndices(); i++)
-		localIndices.push_back(sphere->getIndex(i));
+	buildSphere(tesselation, radius, &localVerts, &localIndices);
 
-	// Index variables for tesselation.
-	GLushort a, b, c;
-
-	// Tesselate.
-	for (GLuint i = 0; i < tesselation; i++)
-	{
-		// Buffer for adding indices.
-		std::vector<GLushort> newIndices;
-
-		// Split each triangle into 4 new triangles.
-		for (GLuint j = 0; j < localIndices.size(); j += 3)
-		{
-			// Vertices of originial triangle.
-			GLushort v_0 = localIndices.at(j + 0);
-			GLushort v_1 = localIndices.at(j + 1);
-			GLushort v_2 = localIndices.at(j + 2);
-
-			// Get the middle index of each side of the triangle.
-			a = middlePointIndex(v_0, v_1, &localVerts,
-				&middlePointIndexCache);
-			b = middlePointIndex(v_1, v_2, &localVerts,
-				&middlePointIndexCache);
-			c = middlePointIndex(v_2, v_0, &localVerts,
-				&middlePointIndexCache);
-
-			// Make sure vertex sits on sphere radius.
-			localVerts[a].position *= radius;
-			localVerts[b].position *= radius;
-			localVerts[c].position *= radius;
-			
-			// Triangle 1.
-			newIndices.push_back(v_0); 
-			newIndices.push_back(a); 
-			newIndices.push_back(c);
-
-			// Triangle 2.
-			newIndices.push_back(v_1);
-			newIndices.push_back(b);
-			newIndices.push_back(a);
-
-			// Triangle 3.
-			newIndices.push_back(v_2);
-			newIndices.push_back(c);
-			newIndices.push_back(b);
-
-			// Triangle 4.
-			newIndices.push_back(a);
-			newIndices.push_back(b);
-			newIndices.push_back(c);
-
-		}
-
-		// Update local indices.
-		localIndices = newIndices;
-	}
+	// Create return mesh.
+	Mesh* sphere = makeMesh(localVerts.data(), localVerts.size(),
+		localIndices.data(), localIndices.size());
 
-	// Copy over the local vertex data.
-	sphere->setVertices(&localVerts);
+	// Generate buffer and vertex arrays (unless deferred).
+	finishMesh(sphere);
 
-	// Copy over the local index data.
-	sphere->setIndices(&localIndices);
+	// Return the mesh.
+	return sphere;
+}
 
-	// Delete the buffers on the graphics hardware.
-	glDeleteBuffers(sphere->getNumBuffers(), sphere->getBufferIDs());
-	const GLuint vaid = sphere->getVertexArrayID();
-	glDeleteBuffers(1, &vaid);
+/******************************************************************************
+*                                                                             *
+*                        Geometry::buildSphere (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  level                                                                      *
+*           Level of approximation from the base sphere (icosohedron).        *
+*  radius                                                                     *
+*           Radius of the sphere.                                             *
+*  vertices                                                                   *
+*           Receives the vertices of the sphere.                              *
+*  indices                                                                    *
+*           Receives the triangles of the sphere.                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Subdivides the built-in icosahedron level times. The counts are those of   *
+*  SphereSize<level>; levels above MAX_SPHERE_LEVEL overflow the 16-bit       *
+*  indices.                                                                   *
+*                                                                             *
+*******************************************************************************/
+void Geometry::buildSphere(GLuint level, GLfloat radius,
+	std::vector<Vertex>* vertices, std::vector<GLushort>* indices)
+{
+	const Vertex* base = (const Vertex*) ICOSAHEDRON_VERTICES;
+	vertices->assign(base, base + ARRAY_SIZE(ICOSAHEDRON_VERTICES));
+	indices->assign(ICOSAHEDRON_INDICES,
+		ICOSAHEDRON_INDICES + ARRAY_SIZE(ICOSAHEDRON_INDICES));
+	for (GLuint i = 0; i < vertices->size(); i++)
+		(*vertices)[i].position *= radius;
 
-	// Generate new buffers.
-	sphere->genBufferArrayID();
-	sphere->genVertexArrayID();
+	// Tesselate.
+	for (GLuint i = 0; i < level; i++)
+		subdivideSphere(vertices, indices, radius);
+}
 
-	// Return the mesh.
-	return sphere;
+/******************************************************************************
+*                                                                             *
+*                         Geometry::makeMesh (static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  vertices, numVertices                                                      *
+*           The vertices to copy into the mesh.                               *
+*  indices, numIndices                                                        *
+*           The triangles to copy into the mesh.                              *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  A new untextured triangle mesh, without buffers yet.                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Common start of the generators, so a shape can be copied straight from     *
+*  constant tables. The caller generates the buffers once the vertices are    *
+*  final, and must free the mesh once it is no longer needed.                 *
+*                                                                             *
+*******************************************************************************/
+Mesh* Geometry::makeMesh(const Vertex* vertices, GLuint numVertices,
+	const GLushort* indices, GLuint numIndices)
+{
+	Mesh* mesh = new Mesh();
+	mesh->setTextureID(-1);
+	mesh->setDrawMode(GL_TRIANGLES);
+	mesh->setVertices(numVertices, vertices);
+	mesh->setIndices(numIndices, indices);
+	return mesh;
 }
 
 /******************************************************************************
@@ -666,23 +825,9 @@ Mesh* Geometry::makeEllipse(GLfloat r_x, GLfloat r_y, GLfloat r_z,
 	// Generate a unit sphere.
 	Mesh* ellipse = makeSphere(1, tesselation);
 
-	// Create the scale transformation.
-	glm::mat3 scale = glm::mat3(glm::scale(glm::vec3{ r_x, r_y, r_z }));
-
-	// Apply transformation to all vertices in the ellipse.
-	Vertex* vertices = ellipse->getVertices();
-	GLuint count = ellipse->getNumVertices();
-	for (int i = 0; i < count; i++)
-		vertices[i].position = scale * vertices[i].position;
-
-	// Delete the buffers on the graphics hardware.
-	glDeleteBuffers(ellipse->getNumBuffers(), ellipse->getBufferIDs());
-	const GLuint vaid = ellipse->getVertexArrayID();
-	glDeleteBuffers(1, &vaid);
-
-	// Generate new buffers.
-	ellipse->genBufferArrayID();
-	ellipse->genVertexArrayID();
+	// Apply the scale to all vertices (and normals) in the ellipse, and
+	// update its buffers in place.
+	ellipse->transformVertices(glm::scale(glm::vec3{ r_x, r_y, r_z }));
 
 	// Return transformed sphere.
 	return ellipse;
@@ -744,7 +889,7 @@ Mesh* Geometry::makeCylinder(GLfloat radius, GLfloat length)
 	// Calculate the arc of each segment.
 	GLfloat theta = (2 * M_PI) / NUM_SEGMENTS;
 	
-	// Temp variables for vertex members.
+	// Temp variables for vertex members (normals are generated below).
 	glm::vec3 normal;
 	glm::vec3 color;
 	glm::vec2 textureCoordinates{ +0.0f, +0.0f };
@@ -774,45 +919,45 @@ Mesh* Geometry::makeCylinder(GLfloat radius, GLfloat length)
 		v_2.y = sinf(i * theta) * radius;
 		v_2.z = base;
 
-		// Calculate second vertex of circle.
-		v_3.x = cosf((i + 1) * theta) * radius;
-		v_3.y = sinf((i + 1) * theta) * radius;
+		// Calculate second vertex of circle (the last wraps to the first).
+		v_3.x = cosf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
+		v_3.y = sinf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
 		v_3.z = base;
 
 		// Add bottom circle.
 		localVerts.push_back({
-			v_0, color, {+0.0f, -1.0f, +0.0f}, textureCoordinates
+			v_0, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			v_2, color, { +0.0f, -1.0f, +0.0f }, textureCoordinates
+			v_2, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			v_3, color, { +0.0f, -1.0f, +0.0f }, textureCoordinates
+			v_3, color, normal, textureCoordinates
 		});
 
-		// Add indices
+		// Add indices (facing down).
 		localIndices.push_back(index + 0);
-		localIndices.push_back(index + 1);
 		localIndices.push_back(index + 2);
+		localIndices.push_back(index + 1);
 
 		v_2.z = base + length;
 		v_3.z = base + length;
 
 		// Add top circle.
 		localVerts.push_back({
-			v_2, color, { +0.0f, +1.0f, +0.0f }, textureCoordinates
+			v_2, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			v_1, color, { +0.0f, +1.0f, +0.0f }, textureCoordinates
+			v_1, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			v_3, color, { +0.0f, +1.0f, +0.0f }, textureCoordinates
+			v_3, color, normal, textureCoordinates
 		});
 
-		// Add indices.
+		// Add indices (facing up).
 		localIndices.push_back(index + 3);
-		localIndices.push_back(index + 4);
 		localIndices.push_back(index + 5);
+		localIndices.push_back(index + 4);
 
 		// Increment Index
 		index += 6;
@@ -830,9 +975,9 @@ Mesh* Geometry::makeCylinder(GLfloat radius, GLfloat length)
 			v_0.y = sinf(i * theta) * radius;
 			v_0.z = base + z;
 
-			// Vertex 1 coordinates.
-			v_1.x = cosf((i + 1) * theta) * radius;
-			v_1.y = sinf((i + 1) * theta) * radius;
+			// Vertex 1 coordinates (the last wraps to the first).
+			v_1.x = cosf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
+			v_1.y = sinf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
 			v_1.z = base + z;
 
 			// Vertex 2 coordinates.
@@ -849,9 +994,6 @@ Mesh* Geometry::makeCylinder(GLfloat radius, GLfloat length)
 			GLuint c = (i + (GLuint)z) % color_size;
 			color = COLORS[c];
 
-			// Calculate normal.
-			normal = -glm::normalize(glm::cross((v_2 - v_0), (v_1 - v_0)));
-
 			// Add the 4 vertices.
 			localVerts.push_back({ 
 				v_0, color, normal, textureCoordinates
@@ -882,15 +1024,18 @@ Mesh* Geometry::makeCylinder(GLfloat radius, GLfloat length)
 		}
 	}
 
+	// Smooth the side, keeping the rims sharp.
+	NormalGenerator::generateNormals(&localVerts, &localIndices,
+		NORMALS_ANGLE_WEIGHTED);
+
 	// Copy over the local vertex data.
 	cylinder->setVertices(&localVerts);
 
 	// Copy over the local index data.
 	cylinder->setIndices(&localIndices);
 
-	// Generate new buffers.
-	cylinder->genBufferArrayID();
-	cylinder->genVertexArrayID();
+	// Generate buffer and vertex arrays (unless deferred).
+	finishMesh(cylinder);
 
 	// Return cylinder.
 	return cylinder;
@@ -928,7 +1073,7 @@ Mesh* Geometry::makeCone(GLfloat radius, GLfloat length)
 	// Calculate the arc of each segment.
 	GLfloat theta = (2 * M_PI) / NUM_SEGMENTS;
 
-	// Temp variables for vertex members.
+	// Temp variables for vertex members (normals are generated below).
 	glm::vec3 position;
 	glm::vec3 normal;
 	glm::vec3 color;
@@ -952,18 +1097,15 @@ Mesh* Geometry::makeCone(GLfloat radius, GLfloat length)
 		v_0.y = sinf(i * theta) * radius;
 		v_0.z = 0;
 
-		// Vertex 1 coordinates.
-		v_1.x = cosf((i + 1) * theta) * radius;
-		v_1.y = sinf((i + 1) * theta) * radius;
+		// Vertex 1 coordinates (the last wraps to the first).
+		v_1.x = cosf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
+		v_1.y = sinf(((i + 1) % NUM_SEGMENTS) * theta) * radius;
 		v_1.z = 0;
 
 		// Update color.
 		GLuint c = i % color_size;
 		color = COLORS[c];
 
-		// Calculate normal.
-		normal = -glm::normalize(glm::cross((top - v_0), (top - v_0)));
-
 		// Add the 3 vertices.
 		localVerts.push_back({
 			v_0, color, normal, textureCoordinates
@@ -986,35 +1128,38 @@ Mesh* Geometry::makeCone(GLfloat radius, GLfloat length)
 
 		// Add 3 new vertices.
 		localVerts.push_back({
-			v_0, color, { +0.0f, -1.0f, +0.0f }, textureCoordinates
+			v_0, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			v_1, color, { +0.0f, -1.0f, +0.0f }, textureCoordinates
+			v_1, color, normal, textureCoordinates
 		});
 		localVerts.push_back({
-			{+0.0f, +0.0f, +0.0f}, color, { +0.0f, -1.0f, +0.0f }, 
+			{+0.0f, +0.0f, +0.0f}, color, normal, 
 			textureCoordinates
 		});
 
-		// Add triangle.
+		// Add triangle (facing down).
 		localIndices.push_back(index + 3);
-		localIndices.push_back(index + 4);
 		localIndices.push_back(index + 5);
+		localIndices.push_back(index + 4);
 
 		// Increment index counter.
 		index += 6;
 
 	}
 
+	// Smooth the side, keeping the rim sharp.
+	NormalGenerator::generateNormals(&localVerts, &localIndices,
+		NORMALS_ANGLE_WEIGHTED);
+
 	// Copy over the local vertex data.
 	cone->setVertices(&localVerts);
 
 	// Copy over the local index data.
 	cone->setIndices(&localIndices);
 
-	// Generate new buffers.
-	cone->genBufferArrayID();
-	cone->genVertexArrayID();
+	// Generate buffer and vertex arrays (unless deferred).
+	finishMesh(cone);
 
 	// Return cone.
 	return cone;
@@ -1164,17 +1309,22 @@ GLsizeiptr Mesh::indexBufferSize() const
 *  Sets the number of vertices, as well as their values, for this Mesh.       *
 *                                                                             *
 *******************************************************************************/
-void Mesh::setVertices(GLuint n, Vertex* a)
+void Mesh::setVertices(GLuint n, const Vertex* a)
 {
+	// Drop the picking BVH of the old vertices.
+	bvh.reset();
 	// Set number of vertices.
 	numVertices = n;
 	// Allocate space on the heap.
+	delete[] vertices;
 	vertices = new Vertex[n];
 	// Copy the data over to the allocated space.
 	memcpy(vertices, a, sizeof(Vertex) * n);
 }
 void Mesh::setVertices(std::vector<Vertex>* v)
 {
+	// Drop the picking BVH of the old vertices.
+	bvh.reset();
 	// Set number of vertices.
 	numVertices = v->size();
 	// Allocate space on the heap.
@@ -1209,17 +1359,22 @@ void Mesh::setVertices(std::vector<Vertex>* v)
 *  Sets the number of indices, as well as their values, for this Mesh.        *
 *                                                                             *
 *******************************************************************************/
-void Mesh::setIndices(GLuint n, GLushort* a)
+void Mesh::setIndices(GLuint n, const GLushort* a)
 {
+	// Drop the picking BVH of the old triangles.
+	bvh.reset();
 	// Set number of indices.
 	numIndices = n;
 	// Allocate space on the heap.
+	delete[] indices;
 	indices = new GLushort[n];
 	// Copy the data over to the allocated space.
 	memcpy(indices, a, sizeof(GLushort) * n);
 }
 void Mesh::setIndices(std::vector<GLushort>* i)
 {
+	// Drop the picking BVH of the old triangles.
+	bvh.reset();
 	// Set number of vertices.
 	numIndices = i->size();
 	// Allocate space on the heap.
@@ -1258,27 +1413,18 @@ Mesh* Geometry::loadObj(const char* objFile, const char* textureFile)
 	// Create a new Mesh object on the heap.
 	Mesh* obj = new Mesh();
 
-	// Declare the Vectors for shape and material data.
-	std::vector<tinyobj::shape_t>    shapes;
-	std::vector<tinyobj::material_t> materials;
+	// Load the first shape of the indicated OBJ file.
+	ObjMesh s;
 	glm::vec3 triangleColor{1.0f, 1.0f, 1.0f};
-
-	// Load the indicated OBJ file and get the error message. 
-	std::string errMsg = tinyobj::LoadObj(shapes, materials, objFile);
-
-	// If there was an error message, prompt the user and exit function. */
-	if (!errMsg.empty())
+	if (!ObjLoader::load(objFile, &s))
 	{
-		std::cerr << "Error loading obj: " << errMsg << std::endl;
+		delete obj;
 		return nullptr;
 	}
 
-	// Get the shape from the file.
-	tinyobj::shape_t  s = shapes.at(0);
-
 	// Copy over the Vertex data.
 	std::vector<Vertex> localVertices;
-	for (GLuint i = 0; i < (s.mesh.positions.size() / 3); i++)
+	for (GLuint i = 0; i < (s.positions.size() / 3); i++)
 	{
 		// Generate random color.
 		if ((i % 3) == 0)
@@ -1293,43 +1439,51 @@ Mesh* Geometry::loadObj(const char* objFile, const char* textureFile)
 		localVertices.push_back({
 
 			// Vertex Position.
-			{ s.mesh.positions.at((3 * i) + 0),
-			s.mesh.positions.at((3 * i) + 1),
-			s.mesh.positions.at((3 * i) + 2) },
+			{ s.positions[(3 * i) + 0],
+			s.positions[(3 * i) + 1],
+			s.positions[(3 * i) + 2] },
 
 			// Vertex Color.
 			triangleColor,
 
 			// Vertex Normal.
-			{ s.mesh.normals.at((3 * i) + 0),
-			s.mesh.normals.at((3 * i) + 1),
-			s.mesh.normals.at((3 * i) + 2) },
+			{ s.normals[(3 * i) + 0],
+			s.normals[(3 * i) + 1],
+			s.normals[(3 * i) + 2] },
 
 			// U, V Coordinate.
-			{ s.mesh.texcoords.at((2 * i) + 0),
-			1 - s.mesh.texcoords.at((2 * i) + 1) }
+			{ s.texcoords[(2 * i) + 0],
+			1 - s.texcoords[(2 * i) + 1] }
 
 		});
 	}
 
 	// Copy the Index data.
 	std::vector<GLushort> localIndices;
-	for(GLuint i = 0; i < s.mesh.indices.size(); i++) 
+	for(GLuint i = 0; i < s.indices.size(); i++) 
 		localIndices.push_back(
-			(GLushort) s.mesh.indices.at(i)
+			(GLushort) s.indices[i]
 		);
 
+	// Generate smooth normals if the file has none.
+	if (!s.hasNormals)
+		NormalGenerator::generateNormals(&localVertices, &localIndices,
+			NORMALS_ANGLE_WEIGHTED);
+
 	// Set the vertices and indices of this mesh.
 	obj->setVertices(&localVertices);
 	obj->setIndices(&localIndices);
 	
-	// Generate buffer and vertex arrays.
-	obj->genBufferArrayID();
-	obj->genVertexArrayID();
+	// Generate buffer and vertex arrays (unless deferred).
+	finishMesh(obj);
 
-	// If the texture file was provided, generate the texture.
-	if (textureFile != NULL)
+	// If the texture file was provided, generate the texture (which needs
+	// the GL context, so not while uploads are deferred to it).
+	if (textureFile != NULL && !deferUploads)
 		obj->genTextureID(textureFile);
+	else if (textureFile != NULL)
+		std::cerr << "Error loading " << textureFile
+		          << ": textures need the GL thread" << std::endl;
 
 	// Return the mesh.
 	return obj;
@@ -1357,10 +1511,42 @@ Mesh* Geometry::loadObj(const char* objFile, const char* textureFile)
 *                                                                             *
 *******************************************************************************/
 void Mesh::genTextureID(const char* filename)
+{
+	/* Load the texture and keep the ID if it loaded. */
+	GLuint id = Geometry::loadTexture(filename);
+	if (id != (GLuint) -1)
+		textureID = id;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Geometry::loadTexture (static)                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  filename                                                                   *
+*        The path to the texture that is to be loaded. Can be of any valid    *
+*        image format.                                                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The ID of the new texture buffer, or -1 if the image could not be loaded.  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Generates a texture buffer and sends the data from the indicated file down *
+*  to the graphics hardware. Textures shared between several meshes should be *
+*  loaded once with this function and assigned with Mesh::setTextureID.       *
+*                                                                             *
+*******************************************************************************/
+GLuint Geometry::loadTexture(const char* filename)
 {
 	/* Enable Texture 2D. */
 	glEnable(GL_TEXTURE_2D);
 
+	/* ID of the new texture (-1 until one is generated). */
+	GLuint textureID = -1;
+
 	/* If the filename is null, do nothing. */
 	if(filename != NULL) 
 	{
@@ -1395,8 +1581,14 @@ void Mesh::genTextureID(const char* filename)
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+			/* The pixels now live on the graphics card. */
+			SDL_FreeSurface(textureSurface);
 		}
 	}
+
+	/* Return the texture ID. */
+	return textureID;
 }
 
 /******************************************************************************
@@ -1424,6 +1616,29 @@ void Mesh::genBufferArrayID()
 	bufferIDs = new GLuint[numBuffers];
 	glGenBuffers(numBuffers, bufferIDs);
 
+	// Fill the buffers.
+	fillBuffers();
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Mesh::fillBuffers                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sends the vertex and index data to the buffers named in bufferIDs.         *
+*                                                                             *
+*******************************************************************************/
+void Mesh::fillBuffers()
+{
 	// Create vertex buffer.
 	glBindBuffer(GL_ARRAY_BUFFER, bufferIDs[0]);
 	glBufferData(GL_ARRAY_BUFFER, vertexBufferSize(), vertices,
@@ -1435,6 +1650,82 @@ void Mesh::genBufferArrayID()
 		GL_STATIC_DRAW);
 }
 
+/******************************************************************************
+*                                                                             *
+*                              Mesh::updateBuffers                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Overwrites the contents of the vertex and index buffers after the data     *
+*  changed in place (same counts), keeping the buffer and vertex array IDs.   *
+*  Does nothing before genBufferArrayID. The picking BVH is dropped either    *
+*  way, to be rebuilt from the new data by the next getBVH.                   *
+*                                                                             *
+*******************************************************************************/
+void Mesh::updateBuffers()
+{
+	/* The vertices changed, so the picking BVH is stale. */
+	bvh.reset();
+
+	if (bufferIDs == NULL)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, bufferIDs[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBufferSize(), vertices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferIDs[1]);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBufferSize(), indices);
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Mesh::transformVertices                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param transform                                                           *
+*           Affine transformation to apply to the model.                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Transforms the positions, and the normals by the inverse transpose         *
+*  (renormalized). A mirroring transformation would turn the triangles        *
+*  inside out, so their winding is reversed. The buffers, if generated, are   *
+*  updated in place.                                                          *
+*                                                                             *
+*******************************************************************************/
+void Mesh::transformVertices(const glm::mat4 &transform)
+{
+	const GLuint stride = sizeof(Vertex) / sizeof(GLfloat);
+	if (numVertices > 0)
+	{
+		VertexTransform::transformPoints(&vertices[0].position.x, stride,
+			numVertices, transform);
+		VertexTransform::transformDirections(&vertices[0].normal.x, stride,
+			numVertices, VertexTransform::normalMatrix(transform), true);
+	}
+
+	if (drawMode == GL_TRIANGLES &&
+		glm::determinant(glm::mat3(transform)) < 0.0f)
+	{
+		for (GLuint i = 0; i + 2 < numIndices; i += 3)
+			std::swap(indices[i + 1], indices[i + 2]);
+	}
+
+	updateBuffers();
+}
+
 /******************************************************************************
 *                                                                             *
 *                            Mesh::genVertexArrayID                           *
@@ -1461,6 +1752,29 @@ void Mesh::genVertexArrayID()
 	// Generate Vertex Array Object.
 	glGenVertexArrays(1, &vertexArrayID);
 
+	// Record the vertex attributes in it.
+	bindAttributes();
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Mesh::bindAttributes                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Binds vertexArrayID and points its attributes into the vertex buffer.      *
+*                                                                             *
+*******************************************************************************/
+void Mesh::bindAttributes()
+{
 	// Bind this vertex array ID.
 	glBindVertexArray(vertexArrayID);
 
@@ -1490,6 +1804,94 @@ void Mesh::genVertexArrayID()
 		(void*)ATTRIBUTE_3_OFFSET);
 }
 
+/******************************************************************************
+*                                                                             *
+*                            Mesh::uploadAll (static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param meshes                                                              *
+*           Meshes whose buffers were deferred (others, and NULL, are         *
+*           skipped).                                                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Does genBufferArrayID and genVertexArrayID for every mesh in one batch:    *
+*  all buffer and vertex array names come from a single call each, then the   *
+*  data is sent mesh after mesh without switching between generating,         *
+*  filling and attribute setup. Must be called with a current GL context.     *
+*                                                                             *
+*******************************************************************************/
+void Mesh::uploadAll(const std::vector<Mesh*> &meshes)
+{
+	// Collect the meshes still without buffers.
+	std::vector<Mesh*> pending;
+	GLuint numNames = 0;
+	for (GLuint i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] != NULL && meshes[i]->bufferIDs == NULL)
+		{
+			pending.push_back(meshes[i]);
+			numNames += meshes[i]->numBuffers;
+		}
+	}
+	if (pending.empty())
+		return;
+
+	// Generate every name at once.
+	std::vector<GLuint> names(numNames);
+	std::vector<GLuint> arrays(pending.size());
+	glGenBuffers(numNames, names.data());
+	glGenVertexArrays(pending.size(), arrays.data());
+
+	// Fill the buffers and record the attributes of each mesh.
+	GLuint next = 0;
+	for (GLuint i = 0; i < pending.size(); i++)
+	{
+		Mesh* m = pending[i];
+		m->bufferIDs = new GLuint[m->numBuffers];
+		std::copy(names.begin() + next, names.begin() + next + m->numBuffers,
+			m->bufferIDs);
+		next += m->numBuffers;
+		m->fillBuffers();
+		m->vertexArrayID = arrays[i];
+		m->bindAttributes();
+	}
+	glBindVertexArray(0);
+}
+
+/******************************************************************************
+*                                                                             *
+*                         Geometry::finishMesh (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param mesh                                                                *
+*           A generated mesh whose vertices are final.                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Generates the buffers and vertex array of the mesh, or leaves them to      *
+*  Mesh::uploadAll while deferUploads is set, so the generators can run on    *
+*  worker threads without a GL context.                                       *
+*                                                                             *
+*******************************************************************************/
+void Geometry::finishMesh(Mesh* mesh)
+{
+	if (deferUploads)
+		return;
+	mesh->genBufferArrayID();
+	mesh->genVertexArrayID();
+}
+
 /******************************************************************************
 *                                                                             *
 *                             Mesh::cleanUp (Destructor)                      *
@@ -1510,9 +1912,12 @@ void Mesh::genVertexArrayID()
 *******************************************************************************/
 void Mesh::cleanUp()
 {
-	// Delete the buffers on the graphics hardware. 
-	glDeleteBuffers(numBuffers, bufferIDs);
-	glDeleteBuffers(1, &vertexArrayID);
+	// Delete the buffers on the graphics hardware (none if deferred).
+	if (bufferIDs != NULL)
+	{
+		glDeleteBuffers(numBuffers, bufferIDs);
+		glDeleteBuffers(1, &vertexArrayID);
+	}
 
 	// Free the space allocated on the heap for vertex/index data.
 	delete[] vertices;
@@ -1520,10 +1925,16 @@ void Mesh::cleanUp()
 	delete[] bufferIDs;
 
 	// Remove any dangling pointers.
+	bvh.reset();
 	vertices = NULL;
 	indices = NULL;
 	bufferIDs = NULL;
 
 	// Set the number of vertices/indices to 0.
 	numVertices = numIndices = 0;
+
+	// Return the transformation for reuse (once).
+	if (transform != (GLuint) -1)
+		TransformSystem::get().release(transform);
+	transform = (GLuint) -1;
 }
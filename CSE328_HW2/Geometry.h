@@ -8,9 +8,15 @@
 #include <GL\glew.h>
 #include <SDL\SDL.h>
 #include <glm\glm.hpp>
+#include <glm\gtx\transform.hpp>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include "BVH.h"
 #include "Shader.h"
+#include "TransformSystem.h"
 
 /******************************************************************************
 *                                                                             *
@@ -25,6 +31,8 @@
 #define ATTRIBUTE_1_OFFSET      (sizeof(GLfloat) * 3)
 #define ATTRIBUTE_2_OFFSET      (sizeof(GLfloat) * 6)
 #define ATTRIBUTE_3_OFFSET      (sizeof(GLfloat) * 9)
+#define FLOATS_PER_VERTEX       11
+#define MAX_SPHERE_LEVEL        6
 
 /******************************************************************************
 *                                                                             *
@@ -104,9 +112,14 @@ struct Triangle
 *  vertexArrayID                                                              *
 *          ID of the buffer in which the vertex array object for this Mesh    *
 *          is located.                                                        *
+*  transform                                                                  *
+*          Handle of the model to world transformation in TransformSystem.    *
 *  drawMode                                                                   *
 *          GLenum for the draw mode of this Mesh. Can be GL_TRIANGLES,        *
 *          GL_LINES, GL_QUADS, etc.                                           *
+*  bvh                                                                        *
+*          Triangle BVH for ray picking, built on first use and shared by     *
+*          every mesh with the same positions and indices.                    *
 *                                                                             *
 *******************************************************************************
 * DESCRIPTION                                                                 *
@@ -132,6 +145,12 @@ public:
 	void           genTextureID(const char* filename);
 	/* Generate the vertex array object and ID for the mesh. */
 	void           genVertexArrayID();
+	/* Generate the buffers and vertex arrays of many meshes at once. */
+	static void    uploadAll(const std::vector<Mesh*> &meshes);
+	/* Copy the vertices (and indices) into the existing buffers. */
+	void           updateBuffers();
+	/* Bake a transformation into the vertices (and the buffers). */
+	void           transformVertices(const glm::mat4 &transform);
 	/* Translate the mesh in model space. */
 	void           translateModel(glm::vec3 translate);
 	/* Rotate the mesh in model space. */
@@ -140,10 +159,12 @@ public:
 	void           scaleModel(glm::vec3 scale);
 	/* Revolve the mesh in world space. */
 	void           revolveModel(GLfloat theta, glm::vec3 axis);
-	/* Calculate the transformation and return the new matrix. */
-	glm::mat4      getTransform();
+	/* Return the transformation as of the last TransformSystem update. */
+	glm::mat4      getTransform()        const;
 	/* Reset the transformation. */
 	void           clearTransform();
+	/* Return the triangle BVH in model space (NULL if not triangles). */
+	const TriangleBVH* getBVH()          const;
 
 	/* Getters*/
 	Vertex*        getVertices()         const   {  return vertices;       }
@@ -157,12 +178,13 @@ public:
 	GLuint*        getBufferIDs()        const   {  return bufferIDs;      }
 	GLuint         getBufferID(GLuint i) const   {  return bufferIDs[i];   } 
 	GLuint         getVertexArrayID()    const   {  return vertexArrayID;  }
+	GLuint         getTransformHandle()  const   {  return transform;      }
 	GLenum         getDrawMode()         const   {  return drawMode;       }
 	bool           isSolid()             const   {  return solid;          }											    						 
 	/* Setters */							    						 
-	void           setVertices(GLuint n, Vertex* a);
+	void           setVertices(GLuint n, const Vertex* a);
 	void           setVertices(std::vector<Vertex>* v);
-	void           setIndices(GLuint n, GLushort* a);
+	void           setIndices(GLuint n, const GLushort* a);
 	void           setIndices(std::vector<GLushort>* v);
 	void           setTextureID(GLuint t)        {  textureID        = t;  }
 	void           setNumBuffers(GLuint n)       {  numBuffers       = n;  }
@@ -188,16 +210,92 @@ protected:
 	GLuint*        bufferIDs;
 	GLuint         vertexArrayID;
 	/* Transformation Data */
-	bool           changed;
-	glm::mat4      transform_MTW;
-	glm::mat4      translate_M;
-	glm::mat4      rotate_M;
-	glm::mat4      scale_M;
-	glm::mat4      revolve_M;
+	GLuint         transform;
 	/* Draw Data */
 	GLenum         drawMode;
 	bool           solid;
+	/* Picking Data */
+	mutable std::shared_ptr<const TriangleBVH> bvh;
+
+	/* Send the vertices and indices to the named buffers. */
+	void           fillBuffers();
+	/* Set up the attributes of the named vertex array. */
+	void           bindAttributes();
+};
+
+/******************************************************************************
+*                                                                             *
+*                         SphereSize<Level>  (struct)                         *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  FACES, EDGES, VERTICES, INDICES                                            *
+*          Counts for the icosahedron subdivided Level times.                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Compile time sizes of a tesselated sphere. Each level splits every face    *
+*  into four and adds a vertex on every edge, so the counts follow from the   *
+*  level below, down to the icosahedron at level 0.                           *
+*                                                                             *
+*******************************************************************************/
+template <GLuint Level>
+struct SphereSize
+{
+	enum
+	{
+		FACES    = 4 * SphereSize<Level - 1>::FACES,
+		EDGES    = 2 * SphereSize<Level - 1>::EDGES +
+		           3 * SphereSize<Level - 1>::FACES,
+		VERTICES = SphereSize<Level - 1>::VERTICES +
+		           SphereSize<Level - 1>::EDGES,
+		INDICES  = 3 * FACES
+	};
+};
+template <>
+struct SphereSize<0>
+{
+	enum
+	{
+		FACES    = 20,
+		EDGES    = 30,
+		VERTICES = 12,
+		INDICES  = 60
+	};
+};
+
+/******************************************************************************
+*                                                                             *
+*                         SphereTable<Level>  (struct)                        *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  vertices, indices                                                          *
+*          The unit sphere of the level, filled by its first makeSphere.      *
+*  once                                                                       *
+*          Guards the fill.                                                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Storage behind Geometry::makeSphere<Level>. The members are static data    *
+*  of a class template rather than locals of makeSphere, so they are set up   *
+*  before main instead of on the first call (Visual Studio 2013 does not      *
+*  initialize function statics thread-safely).                                *
+*                                                                             *
+*******************************************************************************/
+template <GLuint Level>
+struct SphereTable
+{
+	static Vertex         vertices[SphereSize<Level>::VERTICES];
+	static GLushort       indices[SphereSize<Level>::INDICES];
+	static std::once_flag once;
 };
+template <GLuint Level>
+Vertex SphereTable<Level>::vertices[SphereSize<Level>::VERTICES];
+template <GLuint Level>
+GLushort SphereTable<Level>::indices[SphereSize<Level>::INDICES];
+template <GLuint Level>
+std::once_flag SphereTable<Level>::once;
 
 /******************************************************************************
 *                                                                             *
@@ -224,17 +322,84 @@ public:
 	static Mesh*    makeTetrahedron(GLfloat radius);
 	static Mesh*    makeCube(GLfloat side);
 	static Mesh*    makeSphere(GLfloat radius, GLuint tesselation);
+	template <GLuint Level>
+	static Mesh*    makeSphere(GLfloat radius = 1.0f);
 	static Mesh*    makeEllipse(GLfloat r_x, GLfloat r_y, GLfloat r_z,
                                 GLuint tesselation);
 	static Mesh*    makeCylinder(GLfloat radius, GLfloat length);
 	static Mesh*    makeCone(GLfloat radius, GLfloat length);
 	static Mesh*    makeTorus();
+	static Mesh*    makeMesh(const Vertex* vertices, GLuint numVertices,
+	                         const GLushort* indices, GLuint numIndices);
+	static void     buildSphere(GLuint level, GLfloat radius,
+	                            std::vector<Vertex>* vertices,
+	                            std::vector<GLushort>* indices);
 	static GLushort middlePointIndex(GLushort i1, GLushort i2,
 		std::vector<Vertex> *verts, std::map<GLuint, GLushort>* cache);
 
 	/* Shader program. */
 	static Shader*   shader;
+	/* Leave the buffers of new meshes to Mesh::uploadAll (off GL thread). */
+	static bool      deferUploads;
+	/* Generate the buffers of a new mesh unless they are deferred. */
+	static void      finishMesh(Mesh* mesh);
 	/* Load from .obj file. */
 	static Mesh*     loadObj(const char* objFile, 
                              const char* textFile = NULL);
+	/* Load a texture file into a new texture buffer. */
+	static GLuint    loadTexture(const char* filename);
 };
+
+/******************************************************************************
+*                                                                             *
+*                     Geometry::makeSphere<Level> (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  Level                                                                      *
+*           Level of approximation from the base sphere (icosohedron), at     *
+*           most MAX_SPHERE_LEVEL.                                            *
+*  radius                                                                     *
+*           Radius of the sphere to generate.                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  A mesh object describing a simple 3-D sphere.                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Same sphere as makeSphere(radius, Level), but the unit sphere of each      *
+*  level is tesselated once into static arrays sized at compile time and      *
+*  every later sphere of that level is copied straight from them. Meshes are  *
+*  built on the worker threads, so the tesselation runs under std::call_once  *
+*  and concurrent first calls wait for it.                                    *
+*                                                                             *
+*******************************************************************************/
+template <GLuint Level>
+Mesh* Geometry::makeSphere(GLfloat radius)
+{
+	static_assert(Level <= MAX_SPHERE_LEVEL,
+		"Sphere has too many vertices for 16-bit indices.");
+	typedef SphereTable<Level> Table;
+
+	/* Tesselate the unit sphere on first use. */
+	std::call_once(Table::once, []
+	{
+		std::vector<Vertex> localVerts;
+		std::vector<GLushort> localIndices;
+		buildSphere(Level, 1.0f, &localVerts, &localIndices);
+		std::copy(localVerts.begin(), localVerts.end(), Table::vertices);
+		std::copy(localIndices.begin(), localIndices.end(), Table::indices);
+	});
+
+	/* Copy it into a new mesh, at the given radius. */
+	Mesh* sphere = makeMesh(Table::vertices, SphereSize<Level>::VERTICES,
+		Table::indices, SphereSize<Level>::INDICES);
+	if (radius != 1.0f)
+		sphere->transformVertices(glm::scale(glm::vec3(radius)));
+
+	/* Generate buffer and vertex arrays (unless deferred). */
+	finishMesh(sphere);
+
+	return sphere;
+}
@@ -0,0 +1,149 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "GravityBenchmark.h"
+#include "DirectSum.h"
+#include "BarnesHut.h"
+#include "ParticleMesh.h"
+#include "Parallel.h"
+#include <SDL\SDL.h>
+#include <cstdio>
+#include <random>
+
+/******************************************************************************
+*                                                                             *
+*                        GravityBenchmark::makeBodies                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The arrays to be filled.                                          *
+*  @param n                                                                   *
+*           Number of bodies.                                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Places n bodies of planetary mass in a thick disc of the size of the inner *
+*  solar system. The generator is seeded so every run times the same system. *
+*                                                                             *
+*******************************************************************************/
+void GravityBenchmark::makeBodies(BodyArrays &bodies, GLuint n)
+{
+	std::mt19937 generator(328);
+	std::normal_distribution<double> disc(0.0, 1.5e11);
+	std::uniform_real_distribution<double> mass(1.0e22, 1.0e25);
+
+	bodies.resize(n);
+	for (GLuint i = 0; i < n; i++)
+	{
+		bodies.px[i] = disc(generator);
+		bodies.py[i] = 0.05 * disc(generator);
+		bodies.pz[i] = disc(generator);
+		bodies.mass[i] = mass(generator);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        GravityBenchmark::timeSolver                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param solver                                                              *
+*           The solver to be timed.                                           *
+*  @param bodies                                                              *
+*           The system it is run on.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Average seconds per evaluation.                                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs one untimed evaluation to warm caches and scratch arrays, then        *
+*  repeats until at least BENCHMARK_MIN_SECONDS have passed.                  *
+*                                                                             *
+*******************************************************************************/
+double GravityBenchmark::timeSolver(GravitySolver &solver, BodyArrays &bodies)
+{
+	solver.computeAccelerations(bodies, DEFAULT_GRAVITY);
+
+	const double frequency = (double) SDL_GetPerformanceFrequency();
+	Uint64 start = SDL_GetPerformanceCounter();
+	GLuint calls = 0;
+	double elapsed = 0.0;
+	do
+	{
+		solver.computeAccelerations(bodies, DEFAULT_GRAVITY);
+		calls++;
+		elapsed = (SDL_GetPerformanceCounter() - start) / frequency;
+	} while (elapsed < BENCHMARK_MIN_SECONDS);
+
+	return elapsed / calls;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            GravityBenchmark::run                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints one line per solver and size with the time per evaluation and the  *
+*  (equivalent) pairwise interactions per second.                             *
+*                                                                             *
+*******************************************************************************/
+void GravityBenchmark::run()
+{
+	fprintf(stdout, "Stats: Gravity benchmark on %u threads\n",
+		Parallel::getNumThreads());
+
+	BodyArrays bodies;
+	for (GLuint n = BENCHMARK_MIN_BODIES; n <= BENCHMARK_MAX_BODIES; n *= 2)
+	{
+		makeBodies(bodies, n);
+		const double pairs = (double) n * n;
+
+		/* Every direct sum kernel this processor can run. */
+		DirectSumSolver direct;
+		for (GLuint k = KERNEL_SCALAR; k <= DirectSumSolver::detectKernel(); k++)
+		{
+			direct.setKernel((DirectSumKernel) k);
+			double seconds = timeSolver(direct, bodies);
+			fprintf(stdout, "Stats: direct-%-6s n=%-6u %10.3f ms %12.4g "
+				"interactions/s\n", DirectSumSolver::getKernelName(
+				(DirectSumKernel) k), n, seconds * 1000.0, pairs / seconds);
+		}
+
+		/* The tree solver at its default opening angle. */
+		BarnesHutSolver tree;
+		double seconds = timeSolver(tree, bodies);
+		fprintf(stdout, "Stats: barnes-hut    n=%-6u %10.3f ms %12.4g "
+			"interactions/s (equivalent)\n", n, seconds * 1000.0,
+			pairs / seconds);
+
+		/* The particle mesh, without and with the short range correction. */
+		ParticleMeshSolver mesh;
+		for (GLuint p3m = 0; p3m < 2; p3m++)
+		{
+			mesh.setShortRange(p3m != 0);
+			seconds = timeSolver(mesh, bodies);
+			fprintf(stdout, "Stats: %-13s n=%-6u %10.3f ms %12.4g "
+				"interactions/s (equivalent)\n", p3m ? "p3m" : "particle-mesh",
+				n, seconds * 1000.0, pairs / seconds);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include "GravitySolver.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flag which runs the benchmark instead of the viewer. */
+#define  GRAVITY_BENCHMARK_FLAG     "--benchmark-gravity"
+/* Smallest and largest system sizes measured (doubling in between). */
+#define  BENCHMARK_MIN_BODIES       256
+#define  BENCHMARK_MAX_BODIES       32768
+/* Minimum measured time per configuration, in seconds. */
+#define  BENCHMARK_MIN_SECONDS      0.25
+
+/******************************************************************************
+*                                                                             *
+*                         GravityBenchmark  (class)                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to time the gravity solvers on random *
+*  systems of increasing size. The direct sum is reported in pairwise         *
+*  interactions per second for every kernel the processor supports; the tree *
+*  and particle mesh solvers are reported in the same unit (n^2 per step) so *
+*  the rows can be compared directly to find the crossovers.                  *
+*                                                                             *
+*******************************************************************************/
+class GravityBenchmark
+{
+public:
+	/* Run every configuration and print the results. */
+	static void     run();
+
+private:
+	/* Fill a system with n random bodies. */
+	static void     makeBodies(BodyArrays &bodies, GLuint n);
+	/* Seconds per call of computeAccelerations. */
+	static double   timeSolver(GravitySolver &solver, BodyArrays &bodies);
+};
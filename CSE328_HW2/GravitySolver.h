@@ -0,0 +1,52 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "OrbitalSystem.h"
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Default softening length (meters) added to every separation. */
+#define  DEFAULT_SOFTENING          1.0e3
+
+/******************************************************************************
+*                                                                             *
+*                          GravitySolver  (class)                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Interface of the gravity solvers. A solver reads the positions and masses  *
+*  of the bodies and writes the acceleration of every body into the ax, ay   *
+*  and az arrays. Solvers keep their scratch memory between calls so that     *
+*  stepping the same system does not allocate.                                *
+*  Block timestep integrators only need the bodies whose step ends; solvers   *
+*  which can evaluate a subset cheaply override computeActiveAccelerations,  *
+*  the others compute every body.                                             *
+*                                                                             *
+*******************************************************************************/
+class GravitySolver
+{
+public:
+	/* Compute the acceleration of every body. */
+	virtual void   computeAccelerations(BodyArrays &bodies,
+	                                    double      gravity) = 0;
+
+	/* Compute the acceleration of (at least) the listed bodies. */
+	virtual void   computeActiveAccelerations(BodyArrays &bodies,
+	                                          double      gravity,
+	                                          const std::vector<GLuint> & /*active*/)
+	{
+		computeAccelerations(bodies, gravity);
+	}
+
+	/* Destructor. */
+	virtual        ~GravitySolver() {}
+};
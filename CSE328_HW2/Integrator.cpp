@@ -0,0 +1,631 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Integrator.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Smallest number of bodies worth giving to a thread. */
+#define BODY_GRAIN      4096
+
+/* Dormand-Prince 5(4) tableau: stage coefficients, 5th order weights (the */
+/* last row of A) and the difference to the embedded 4th order weights.   */
+static const double RK_A[7][6] =
+{
+	{ 0.0 },
+	{ 1.0 / 5.0 },
+	{ 3.0 / 40.0, 9.0 / 40.0 },
+	{ 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+	{ 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+	{ 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0,
+	  -5103.0 / 18656.0 },
+	{ 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0,
+	  11.0 / 84.0 }
+};
+static const double RK_E[7] =
+{
+	35.0 / 384.0 - 5179.0 / 57600.0,
+	0.0,
+	500.0 / 1113.0 - 7571.0 / 16695.0,
+	125.0 / 192.0 - 393.0 / 640.0,
+	-2187.0 / 6784.0 + 92097.0 / 339200.0,
+	11.0 / 84.0 - 187.0 / 2100.0,
+	-1.0 / 40.0
+};
+
+/******************************************************************************
+*                                                                             *
+*                           Integrator::drift (static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be moved.                                           *
+*  @param dt                                                                  *
+*           Length of the drift in seconds.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Moves every body along its velocity: x += v dt.                            *
+*                                                                             *
+*******************************************************************************/
+void Integrator::drift(BodyArrays &bodies, double dt)
+{
+	Parallel::forRange(0, bodies.count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			bodies.px[i] += bodies.vx[i] * dt;
+			bodies.py[i] += bodies.vy[i] * dt;
+			bodies.pz[i] += bodies.vz[i] * dt;
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                           Integrator::kick (static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be accelerated.                                     *
+*  @param dt                                                                  *
+*           Length of the kick in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Changes every velocity by its acceleration: v += a dt.                     *
+*                                                                             *
+*******************************************************************************/
+void Integrator::kick(BodyArrays &bodies, double dt)
+{
+	Parallel::forRange(0, bodies.count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			bodies.vx[i] += bodies.ax[i] * dt;
+			bodies.vy[i] += bodies.ay[i] * dt;
+			bodies.vz[i] += bodies.az[i] * dt;
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                          LeapfrogIntegrator::step                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Half kick, full drift, new accelerations, half kick.                       *
+*                                                                             *
+*******************************************************************************/
+void LeapfrogIntegrator::step(BodyArrays &bodies, GravitySolver &solver,
+                              double gravity, double dt)
+{
+	if (!primed)
+	{
+		solver.computeAccelerations(bodies, gravity);
+		evaluations++;
+		primed = true;
+	}
+
+	kick(bodies, 0.5 * dt);
+	drift(bodies, dt);
+	solver.computeAccelerations(bodies, gravity);
+	evaluations++;
+	kick(bodies, 0.5 * dt);
+}
+
+/******************************************************************************
+*                                                                             *
+*                           YoshidaIntegrator::step                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Three drift-kick-drift leapfrog substeps of w1, w0 and w1 times dt, where *
+*  w1 = 1 / (2 - 2^(1/3)) and w0 = 1 - 2 w1. The middle substep runs          *
+*  backwards in time and cancels the third order error of the outer two.     *
+*                                                                             *
+*******************************************************************************/
+void YoshidaIntegrator::step(BodyArrays &bodies, GravitySolver &solver,
+                             double gravity, double dt)
+{
+	static const double w1 = 1.0 / (2.0 - pow(2.0, 1.0 / 3.0));
+	static const double w0 = 1.0 - 2.0 * w1;
+	static const double c[4] = { 0.5 * w1, 0.5 * (w0 + w1),
+	                             0.5 * (w0 + w1), 0.5 * w1 };
+	static const double d[3] = { w1, w0, w1 };
+
+	for (GLuint s = 0; s < 3; s++)
+	{
+		drift(bodies, c[s] * dt);
+		solver.computeAccelerations(bodies, gravity);
+		evaluations++;
+		kick(bodies, d[s] * dt);
+	}
+	drift(bodies, c[3] * dt);
+}
+
+/******************************************************************************
+*                                                                             *
+*                    RK45Integrator::RK45Integrator (Constructor)             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param tolerance                                                           *
+*           Relative error allowed per substep.                               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates an integrator whose first substep is the whole step.               *
+*                                                                             *
+*******************************************************************************/
+RK45Integrator::RK45Integrator(double tolerance) :
+	tolerance(tolerance), substep(0.0), rejected(0)
+{
+	/* Empty. */
+}
+
+/******************************************************************************
+*                                                                             *
+*                         RK45Integrator::derivative                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies (their positions are overwritten with the state).      *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param s                                                                   *
+*           State: x, y, z, vx, vy, vz blocks of n values each.               *
+*  @param ds                                                                  *
+*           Derivative of the state: velocities then accelerations.           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Evaluates the equations of motion at the given state.                      *
+*                                                                             *
+*******************************************************************************/
+void RK45Integrator::derivative(BodyArrays &bodies, GravitySolver &solver,
+                                double gravity, const std::vector<double> &s,
+                                std::vector<double> &ds)
+{
+	const GLuint n = bodies.count;
+	std::copy(s.begin(), s.begin() + n, bodies.px.begin());
+	std::copy(s.begin() + n, s.begin() + 2 * n, bodies.py.begin());
+	std::copy(s.begin() + 2 * n, s.begin() + 3 * n, bodies.pz.begin());
+	solver.computeAccelerations(bodies, gravity);
+	evaluations++;
+
+	std::copy(s.begin() + 3 * n, s.end(), ds.begin());
+	std::copy(bodies.ax.begin(), bodies.ax.end(), ds.begin() + 3 * n);
+	std::copy(bodies.ay.begin(), bodies.ay.end(), ds.begin() + 4 * n);
+	std::copy(bodies.az.begin(), bodies.az.end(), ds.begin() + 5 * n);
+}
+
+/******************************************************************************
+*                                                                             *
+*                            RK45Integrator::step                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Covers dt with adaptive substeps. The error of a substep is the largest,  *
+*  over bodies, of the position and velocity error relative to the body's    *
+*  own distance and speed; substeps with an error above the tolerance are    *
+*  repeated with a smaller length. The next length is the usual               *
+*  0.9 * (tolerance / error)^(1/5) controller limited to [0.2, 5] times the   *
+*  last one.                                                                  *
+*                                                                             *
+*******************************************************************************/
+void RK45Integrator::step(BodyArrays &bodies, GravitySolver &solver,
+                          double gravity, double dt)
+{
+	const GLuint n = bodies.count;
+	const GLuint size = 6 * n;
+	y.resize(size); scratch.resize(size);
+	for (GLuint s = 0; s < 7; s++)
+		k[s].resize(size);
+
+	/* Pack the state. */
+	std::copy(bodies.px.begin(), bodies.px.end(), y.begin());
+	std::copy(bodies.py.begin(), bodies.py.end(), y.begin() + n);
+	std::copy(bodies.pz.begin(), bodies.pz.end(), y.begin() + 2 * n);
+	std::copy(bodies.vx.begin(), bodies.vx.end(), y.begin() + 3 * n);
+	std::copy(bodies.vy.begin(), bodies.vy.end(), y.begin() + 4 * n);
+	std::copy(bodies.vz.begin(), bodies.vz.end(), y.begin() + 5 * n);
+	derivative(bodies, solver, gravity, y, k[0]);
+
+	double h = (substep > 0.0) ? substep : dt;
+	double t = 0.0;
+	while (t < dt)
+	{
+		/* Do not step past the end. */
+		double hs = std::min(h, dt - t);
+
+		/* Stages 2 to 7; stage 7 is evaluated at the 5th order solution. */
+		for (GLuint s = 1; s < 7; s++)
+		{
+			for (GLuint i = 0; i < size; i++)
+			{
+				double sum = 0.0;
+				for (GLuint j = 0; j < s; j++)
+					sum += RK_A[s][j] * k[j][i];
+				scratch[i] = y[i] + hs * sum;
+			}
+			derivative(bodies, solver, gravity, scratch, k[s]);
+		}
+
+		/* Error relative to each body's distance and speed. */
+		double error = 0.0;
+		for (GLuint b = 0; b < n; b++)
+		{
+			for (GLuint part = 0; part < 2; part++)
+			{
+				double e2 = 0.0, y2 = 0.0;
+				for (GLuint d = 0; d < 3; d++)
+				{
+					GLuint i = (3 * part + d) * n + b;
+					double e = 0.0;
+					for (GLuint s = 0; s < 7; s++)
+						e += RK_E[s] * k[s][i];
+					e2 += (hs * e) * (hs * e);
+					y2 += std::max(y[i] * y[i], scratch[i] * scratch[i]);
+				}
+				if (y2 > 0.0)
+					error = std::max(error, sqrt(e2 / y2) / tolerance);
+			}
+		}
+
+		/* Next substep length. */
+		double factor = (error > 0.0) ?
+			std::min(5.0, std::max(0.2, 0.9 * pow(error, -0.2))) : 5.0;
+
+		/* Accept: the last stage becomes the first of the next substep. */
+		if (error <= 1.0)
+		{
+			y.swap(scratch);
+			k[0].swap(k[6]);
+			t += hs;
+			h = (hs < h) ? std::max(h, hs * factor) : hs * factor;
+		}
+		else
+		{
+			rejected++;
+			h = hs * factor;
+		}
+	}
+	substep = h;
+
+	/* Unpack the state (the accelerations already match it). */
+	std::copy(y.begin(), y.begin() + n, bodies.px.begin());
+	std::copy(y.begin() + n, y.begin() + 2 * n, bodies.py.begin());
+	std::copy(y.begin() + 2 * n, y.begin() + 3 * n, bodies.pz.begin());
+	std::copy(y.begin() + 3 * n, y.begin() + 4 * n, bodies.vx.begin());
+	std::copy(y.begin() + 4 * n, y.begin() + 5 * n, bodies.vy.begin());
+	std::copy(y.begin() + 5 * n, y.end(), bodies.vz.begin());
+	std::copy(k[0].begin() + 3 * n, k[0].begin() + 4 * n, bodies.ax.begin());
+	std::copy(k[0].begin() + 4 * n, k[0].begin() + 5 * n, bodies.ay.begin());
+	std::copy(k[0].begin() + 5 * n, k[0].end(), bodies.az.begin());
+}
+
+/******************************************************************************
+*                                                                             *
+*           BlockTimestepIntegrator::BlockTimestepIntegrator (Constructor)    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param eta                                                                 *
+*           Accuracy parameter of the timestep criterion.                     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates an integrator which assigns levels on its first step.              *
+*                                                                             *
+*******************************************************************************/
+BlockTimestepIntegrator::BlockTimestepIntegrator(double eta) :
+	eta(eta), primed(false)
+{
+	/* Empty. */
+}
+
+/******************************************************************************
+*                                                                             *
+*                  BlockTimestepIntegrator::getDeepestLevel                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The finest level any body currently uses.                                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Used in the drift report.                                                  *
+*                                                                             *
+*******************************************************************************/
+GLuint BlockTimestepIntegrator::getDeepestLevel() const
+{
+	GLuint deepest = 0;
+	for (GLuint level : levels)
+		deepest = std::max(deepest, level);
+	return deepest;
+}
+
+/******************************************************************************
+*                                                                             *
+*                    BlockTimestepIntegrator::chooseLevel                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies (with current accelerations).                          *
+*  @param i                                                                   *
+*           Index of the body.                                                *
+*  @param dt                                                                  *
+*           Length of the full (level 0) step.                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The coarsest level whose step is at most eta * |a| / |da/dt|.             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  |a| / |da/dt| is the time over which the body's acceleration changes       *
+*  appreciably: for a moon it is set by its orbit around its planet, not by  *
+*  the much slower orbit around the star.                                     *
+*                                                                             *
+*******************************************************************************/
+GLuint BlockTimestepIntegrator::chooseLevel(const BodyArrays &bodies, GLuint i,
+                                            double dt) const
+{
+	double a = sqrt(bodies.ax[i] * bodies.ax[i] + bodies.ay[i] * bodies.ay[i] +
+		bodies.az[i] * bodies.az[i]);
+	double j = sqrt(jx[i] * jx[i] + jy[i] * jy[i] + jz[i] * jz[i]);
+	if (j <= 0.0)
+		return 0;
+
+	double timescale = eta * a / j;
+	GLuint level = 0;
+	while (level < MAX_BLOCK_LEVEL && dt / (double) (1u << level) > timescale)
+		level++;
+	return level;
+}
+
+/******************************************************************************
+*                                                                             *
+*                       BlockTimestepIntegrator::prime                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the full step.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Without a previous step there is no jerk estimate, so the bodies are      *
+*  drifted by the finest step, the accelerations are evaluated again and     *
+*  their difference gives the initial jerk. The bodies are then restored.    *
+*                                                                             *
+*******************************************************************************/
+void BlockTimestepIntegrator::prime(BodyArrays &bodies, GravitySolver &solver,
+                                    double gravity, double dt)
+{
+	const GLuint n = bodies.count;
+	const double h = dt / (double) (1u << MAX_BLOCK_LEVEL);
+	levels.assign(n, 0);
+	jx.resize(n); jy.resize(n); jz.resize(n);
+
+	/* Accelerations a little ahead... */
+	drift(bodies, h);
+	solver.computeAccelerations(bodies, gravity);
+	evaluations++;
+	oldX = bodies.ax; oldY = bodies.ay; oldZ = bodies.az;
+
+	/* ...and now. */
+	drift(bodies, -h);
+	solver.computeAccelerations(bodies, gravity);
+	evaluations++;
+
+	for (GLuint i = 0; i < n; i++)
+	{
+		jx[i] = (oldX[i] - bodies.ax[i]) / h;
+		jy[i] = (oldY[i] - bodies.ay[i]) / h;
+		jz[i] = (oldZ[i] - bodies.az[i]) / h;
+		levels[i] = chooseLevel(bodies, i, dt);
+	}
+	primed = true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        BlockTimestepIntegrator::step                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver used for the accelerations.                                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the full step.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Time is counted in ticks of dt / 2^MAX_BLOCK_LEVEL; a body at level k     *
+*  steps 2^(MAX_BLOCK_LEVEL - k) ticks. Every body opens its step with a     *
+*  half kick, the system drifts to the earliest end of any step, and the     *
+*  bodies ending there get new accelerations, a closing half kick, a new     *
+*  jerk estimate and level and, unless the full step is over, the opening    *
+*  half kick of their next step.                                              *
+*                                                                             *
+*******************************************************************************/
+void BlockTimestepIntegrator::step(BodyArrays &bodies, GravitySolver &solver,
+                                   double gravity, double dt)
+{
+	const GLuint n = bodies.count;
+	if (!primed || levels.size() != n)
+		prime(bodies, solver, gravity, dt);
+
+	const GLuint ticks = 1u << MAX_BLOCK_LEVEL;
+	const double tick = dt / (double) ticks;
+
+	/* Every body starts a step now. */
+	for (GLuint i = 0; i < n; i++)
+	{
+		double half = 0.5 * tick * (double) (ticks >> levels[i]);
+		bodies.vx[i] += bodies.ax[i] * half;
+		bodies.vy[i] += bodies.ay[i] * half;
+		bodies.vz[i] += bodies.az[i] * half;
+		oldX[i] = bodies.ax[i]; oldY[i] = bodies.ay[i]; oldZ[i] = bodies.az[i];
+	}
+
+	GLuint now = 0;
+	while (now < ticks)
+	{
+		/* Drift to the earliest end of a step. */
+		GLuint next = ticks;
+		for (GLuint i = 0; i < n; i++)
+		{
+			GLuint stride = ticks >> levels[i];
+			next = std::min(next, (now / stride + 1) * stride);
+		}
+		drift(bodies, (next - now) * tick);
+		now = next;
+
+		/* Bodies whose step ends here. */
+		active.clear();
+		for (GLuint i = 0; i < n; i++)
+		{
+			if (now % (ticks >> levels[i]) == 0)
+				active.push_back(i);
+		}
+		solver.computeActiveAccelerations(bodies, gravity, active);
+		evaluations++;
+
+		for (GLuint i : active)
+		{
+			/* Close the step. */
+			double length = tick * (double) (ticks >> levels[i]);
+			bodies.vx[i] += bodies.ax[i] * 0.5 * length;
+			bodies.vy[i] += bodies.ay[i] * 0.5 * length;
+			bodies.vz[i] += bodies.az[i] * 0.5 * length;
+
+			/* New level: finer at once, coarser only where synchronized. */
+			jx[i] = (bodies.ax[i] - oldX[i]) / length;
+			jy[i] = (bodies.ay[i] - oldY[i]) / length;
+			jz[i] = (bodies.az[i] - oldZ[i]) / length;
+			GLuint wanted = chooseLevel(bodies, i, dt);
+			while (levels[i] > wanted &&
+				now % (ticks >> (levels[i] - 1)) == 0)
+				levels[i]--;
+			if (wanted > levels[i])
+				levels[i] = wanted;
+
+			/* Open the next step (the next full step opens its own). */
+			if (now < ticks)
+			{
+				double half = 0.5 * tick * (double) (ticks >> levels[i]);
+				bodies.vx[i] += bodies.ax[i] * half;
+				bodies.vy[i] += bodies.ay[i] * half;
+				bodies.vz[i] += bodies.az[i] * half;
+				oldX[i] = bodies.ax[i]; oldY[i] = bodies.ay[i];
+				oldZ[i] = bodies.az[i];
+			}
+		}
+	}
+}
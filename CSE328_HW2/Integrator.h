@@ -0,0 +1,236 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <vector>
+#include "GravitySolver.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Default error tolerance of the adaptive Runge-Kutta integrator. */
+#define  DEFAULT_RK45_TOLERANCE     1.0e-10
+/* Deepest level of the block timestep hierarchy (step = dt / 2^level). */
+#define  MAX_BLOCK_LEVEL            12
+/* Default accuracy parameter of the block timestep criterion. */
+#define  DEFAULT_BLOCK_ETA          0.02
+
+/******************************************************************************
+*                                                                             *
+*                           Integrator  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  evaluations                                                                *
+*          Number of force evaluations requested so far.                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Interface of the time integrators. step advances the positions and        *
+*  velocities of the bodies by dt using the solver for the accelerations.    *
+*  Integrators may keep the accelerations of the previous step; reset must   *
+*  be called whenever the bodies are changed outside of step.                 *
+*                                                                             *
+*******************************************************************************/
+class Integrator
+{
+public:
+	/* Constructor. */
+	                 Integrator() : evaluations(0) {}
+
+	/* Advance the bodies by dt seconds. */
+	virtual void     step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) = 0;
+	/* Forget any state derived from the bodies. */
+	virtual void     reset() {}
+	/* Name of the method, for reporting. */
+	virtual const char* getName() const = 0;
+	/* Print (and reset) statistics particular to the method. */
+	virtual void     reportStats() {}
+
+	/* Getters. */
+	unsigned long long getNumEvaluations() const {  return evaluations;  }
+
+	/* Destructor. */
+	virtual          ~Integrator() {}
+
+protected:
+	unsigned long long evaluations;
+
+	/* Shared steps of the methods. */
+	static void      drift(BodyArrays &bodies, double dt);
+	static void      kick(BodyArrays &bodies, double dt);
+};
+
+/******************************************************************************
+*                                                                             *
+*                        LeapfrogIntegrator  (class)                          *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  primed                                                                     *
+*          Whether the accelerations of the bodies are current.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Second order symplectic kick-drift-kick leapfrog (velocity Verlet). The    *
+*  closing acceleration of a step is reused to open the next, so each step   *
+*  costs one force evaluation.                                                *
+*                                                                             *
+*******************************************************************************/
+class LeapfrogIntegrator : public Integrator
+{
+public:
+	                 LeapfrogIntegrator() : primed(false) {}
+
+	void             step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) override;
+	void             reset() override              {  primed = false;      }
+	const char*      getName() const override      {  return "leapfrog";   }
+
+private:
+	bool             primed;
+};
+
+/******************************************************************************
+*                                                                             *
+*                         YoshidaIntegrator  (class)                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Fourth order symplectic integrator: Yoshida's triple composition of        *
+*  drift-kick-drift leapfrog steps. Three force evaluations per step.         *
+*                                                                             *
+*******************************************************************************/
+class YoshidaIntegrator : public Integrator
+{
+public:
+	void             step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) override;
+	const char*      getName() const override      {  return "yoshida4";   }
+};
+
+/******************************************************************************
+*                                                                             *
+*                          RK45Integrator  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  tolerance                                                                  *
+*          Relative error allowed per substep.                                *
+*  substep                                                                    *
+*          Substep length which passed the error test last (0 if unknown).    *
+*  rejected                                                                   *
+*          Number of substeps which failed the error test.                    *
+*  y, k, scratch                                                              *
+*          State vector (positions then velocities), stage derivatives and    *
+*          stage state.                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Embedded Dormand-Prince 5(4) Runge-Kutta method with adaptive substeps.   *
+*  step covers dt with as many substeps as the tolerance requires, reusing   *
+*  the last stage as the first of the next substep. Not symplectic: its      *
+*  energy error grows with time, which the drift report makes visible.       *
+*                                                                             *
+*******************************************************************************/
+class RK45Integrator : public Integrator
+{
+public:
+	                 RK45Integrator(double tolerance = DEFAULT_RK45_TOLERANCE);
+
+	void             step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) override;
+	void             reset() override              {  substep = 0.0;       }
+	const char*      getName() const override      {  return "rk45";       }
+
+	/* Getters. */
+	double           getTolerance()          const {  return tolerance;    }
+	unsigned long long getNumRejected()      const {  return rejected;     }
+
+	/* Setters. */
+	void             setTolerance(double t)        {  tolerance = t;       }
+
+private:
+	double           tolerance;
+	double           substep;
+	unsigned long long rejected;
+	std::vector<double>  y, k[7], scratch;
+
+	/* Derivative (velocity, acceleration) of the state s. */
+	void             derivative(BodyArrays &bodies, GravitySolver &solver,
+	                            double gravity, const std::vector<double> &s,
+	                            std::vector<double> &ds);
+};
+
+/******************************************************************************
+*                                                                             *
+*                      BlockTimestepIntegrator  (class)                       *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  eta                                                                        *
+*          Accuracy parameter: a body's step is eta * |a| / |da/dt|.          *
+*  levels                                                                     *
+*          Level of each body; body i steps dt / 2^levels[i].                 *
+*  jx, jy, jz                                                                 *
+*          Finite difference estimate of each body's jerk (da/dt).            *
+*  oldX, oldY, oldZ                                                           *
+*          Acceleration of each body at the start of its current step.        *
+*  active                                                                     *
+*          Bodies whose step ends at the current tick.                        *
+*  primed                                                                     *
+*          Whether the accelerations and levels are current.                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Hierarchical (power of two) block timesteps on kick-drift-kick leapfrog.   *
+*  Every body is given the level whose step fits its own timescale, so a     *
+*  tightly bound pair such as the Earth and the Moon substeps while distant   *
+*  bodies take the full step. All bodies drift together between the ends of  *
+*  steps, and only the bodies whose step ends are kicked and have their       *
+*  accelerations recomputed (see computeActiveAccelerations). A body may move *
+*  to a finer level at the end of any of its steps and to a coarser level     *
+*  only where the coarser step would also end, which keeps the hierarchy     *
+*  synchronized.                                                              *
+*                                                                             *
+*******************************************************************************/
+class BlockTimestepIntegrator : public Integrator
+{
+public:
+	                 BlockTimestepIntegrator(double eta = DEFAULT_BLOCK_ETA);
+
+	void             step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) override;
+	void             reset() override              {  primed = false;      }
+	const char*      getName() const override      {  return "block";      }
+
+	/* Getters. */
+	double           getEta()                const {  return eta;          }
+	GLuint           getDeepestLevel()       const;
+
+	/* Setters. */
+	void             setEta(double e)              {  eta = e;             }
+
+private:
+	double           eta;
+	std::vector<GLuint>  levels;
+	std::vector<double>  jx, jy, jz;
+	std::vector<double>  oldX, oldY, oldZ;
+	std::vector<GLuint>  active;
+	bool             primed;
+
+	/* Level whose step fits body i's timescale. */
+	GLuint           chooseLevel(const BodyArrays &bodies, GLuint i,
+	                             double dt) const;
+	/* Compute accelerations, jerks and levels before the first step. */
+	void             prime(BodyArrays &bodies, GravitySolver &solver,
+	                       double gravity, double dt);
+};
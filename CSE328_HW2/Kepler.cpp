@@ -0,0 +1,506 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Kepler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Smallest number of bodies worth giving to a thread. */
+#define KEPLER_GRAIN    1024
+/* Below this |z| the Stumpff functions are summed as series. */
+#define STUMPFF_SERIES  1.0e-3
+/* Order of Laguerre's method. */
+#define LAGUERRE_ORDER  5.0
+/* One revolution in radians. */
+#define TWO_PI          6.28318530717958647692
+
+/******************************************************************************
+*                                                                             *
+*                           Kepler::stumpff (static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param z                                                                   *
+*           Argument, alpha * chi^2.                                          *
+*  @param c, s                                                                *
+*           Set to C(z) and S(z).                                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Trigonometric for z > 0 (ellipses), hyperbolic for z < 0, and a series    *
+*  near 0, where the closed forms lose their digits to cancellation.         *
+*                                                                             *
+*******************************************************************************/
+void Kepler::stumpff(double z, double &c, double &s)
+{
+	if (fabs(z) < STUMPFF_SERIES)
+	{
+		c = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z / 40320.0));
+		s = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z / 362880.0));
+	}
+	else if (z > 0.0)
+	{
+		double root = sqrt(z);
+		c = (1.0 - cos(root)) / z;
+		s = (root - sin(root)) / (z * root);
+	}
+	else
+	{
+		double root = sqrt(-z);
+		c = (cosh(root) - 1.0) / -z;
+		s = (sinh(root) - root) / (-z * root);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Kepler::propagate (static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param mu                                                                  *
+*           Gravitational parameter G (m1 + m2) of the pair.                  *
+*  @param r, v                                                                *
+*           Position and velocity relative to the parent; advanced in place. *
+*  @param dt                                                                  *
+*           Seconds to advance by (may be negative).                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False (leaving r and v unchanged) if the solver did not converge.         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Solves Kepler's equation in the universal anomaly chi,                    *
+*    sqrt(mu) dt = sigma0 chi^2 C + (1 - alpha r0) chi^3 S + r0 chi,          *
+*  where alpha = 1 / a and sigma0 = r0 . v0 / sqrt(mu), then maps the state  *
+*  with the Lagrange coefficients f, g and their derivatives. Whole periods *
+*  of an ellipse are removed from dt first, so long steps of short orbits    *
+*  start from a good guess.                                                  *
+*                                                                             *
+*******************************************************************************/
+bool Kepler::propagate(double mu, double r[3], double v[3], double dt)
+{
+	const double r0 = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+	if (mu <= 0.0 || r0 == 0.0)
+		return false;
+	const double v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+	const double sqrtMu = sqrt(mu);
+	const double sigma0 = (r[0] * v[0] + r[1] * v[1] + r[2] * v[2]) / sqrtMu;
+	const double alpha = 2.0 / r0 - v2 / mu;
+
+	if (alpha > 0.0)
+		dt = fmod(dt, TWO_PI / (sqrtMu * alpha * sqrt(alpha)));
+	if (dt == 0.0)
+		return true;
+
+	/* Laguerre iteration on F(chi) = 0; F' is the radius, so F rises. */
+	double chi = (alpha > 0.0) ? sqrtMu * alpha * dt : sqrtMu * dt / r0;
+	double c = 0.5, s = 1.0 / 6.0, z = 0.0;
+	bool converged = false;
+	for (GLuint k = 0; k < KEPLER_MAX_ITERATIONS && !converged; k++)
+	{
+		z = alpha * chi * chi;
+		stumpff(z, c, s);
+		double chi2 = chi * chi;
+		double F = sigma0 * chi2 * c + (1.0 - alpha * r0) * chi2 * chi * s +
+			r0 * chi - sqrtMu * dt;
+		double dF = sigma0 * chi * (1.0 - z * s) +
+			(1.0 - alpha * r0) * chi2 * c + r0;
+		double ddF = sigma0 * (1.0 - z * c) +
+			(1.0 - alpha * r0) * chi * (1.0 - z * s);
+
+		const double n = LAGUERRE_ORDER;
+		double root = sqrt(fabs((n - 1.0) * (n - 1.0) * dF * dF -
+			n * (n - 1.0) * F * ddF));
+		double delta = n * F / (dF + (dF < 0.0 ? -root : root));
+		chi -= delta;
+		converged = fabs(delta) <= KEPLER_TOLERANCE * fabs(chi) || F == 0.0;
+	}
+	if (!converged || chi != chi)
+		return false;
+
+	/* Lagrange coefficients. */
+	z = alpha * chi * chi;
+	stumpff(z, c, s);
+	const double chi2 = chi * chi;
+	const double f = 1.0 - chi2 * c / r0;
+	const double g = dt - chi2 * chi * s / sqrtMu;
+	double p[3];
+	for (GLuint d = 0; d < 3; d++)
+		p[d] = f * r[d] + g * v[d];
+	const double radius = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+	const double fDot = sqrtMu / (radius * r0) * chi * (z * s - 1.0);
+	const double gDot = 1.0 - chi2 * c / radius;
+	for (GLuint d = 0; d < 3; d++)
+	{
+		v[d] = fDot * r[d] + gDot * v[d];
+		r[d] = p[d];
+	}
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                 KeplerIntegrator::KeplerIntegrator (Constructor)            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param ratio                                                               *
+*           Perturbing / central acceleration below which bodies go analytic. *
+*  @param interval                                                            *
+*           Steps between full force evaluations and reclassifications.       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the integrator; every body is classified on the first step.       *
+*                                                                             *
+*******************************************************************************/
+KeplerIntegrator::KeplerIntegrator(double ratio, GLuint interval) :
+	ratio(ratio), interval(std::max(interval, 1u)), countdown(0),
+	targets(0), fullTargets(0), promoted(0), demoted(0)
+{
+}
+
+/******************************************************************************
+*                                                                             *
+*                         KeplerIntegrator::classify                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies, with every acceleration current.                      *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The parent of a body is whichever of the KEPLER_MAX_PARENTS heaviest      *
+*  bodies, heavier than it, has the largest m / r^2. The perturbation is    *
+*  the acceleration relative to the parent minus the two-body term           *
+*  -G (m + M) r / r^3. Bodies which are bound to their parent and whose      *
+*  perturbation is small go analytic. Analytic bodies are ordered heaviest   *
+*  first: a parent is always heavier than its children, so it is placed      *
+*  before them.                                                              *
+*                                                                             *
+*******************************************************************************/
+void KeplerIntegrator::classify(const BodyArrays &bodies, double gravity)
+{
+	const GLuint n = bodies.count;
+	/* Last classification (every body numeric if there was none). */
+	std::vector<GLuint> previous;
+	previous.swap(parent);
+	if (previous.size() != n)
+	{
+		previous.resize(n);
+		for (GLuint i = 0; i < n; i++)
+			previous[i] = i;
+	}
+	parent.resize(n);
+
+	/* Heavier than: by mass, then by index, so the order is strict. */
+	auto heavier = [&](GLuint a, GLuint b)
+	{
+		return bodies.mass[a] > bodies.mass[b] ||
+			(bodies.mass[a] == bodies.mass[b] && a < b);
+	};
+	std::vector<GLuint> candidates(n);
+	for (GLuint i = 0; i < n; i++)
+		candidates[i] = i;
+	GLuint numCandidates = std::min<GLuint>(n, KEPLER_MAX_PARENTS);
+	std::partial_sort(candidates.begin(), candidates.begin() + numCandidates,
+		candidates.end(), heavier);
+
+	Parallel::forRange(0, n, KEPLER_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			/* Dominant parent. */
+			GLuint best = i;
+			double bestPull = 0.0;
+			for (GLuint c = 0; c < numCandidates; c++)
+			{
+				GLuint j = candidates[c];
+				if (!heavier(j, i))
+					continue;
+				double dx = bodies.px[i] - bodies.px[j];
+				double dy = bodies.py[i] - bodies.py[j];
+				double dz = bodies.pz[i] - bodies.pz[j];
+				double pull = bodies.mass[j] / (dx * dx + dy * dy + dz * dz);
+				if (pull > bestPull)
+				{
+					best = j;
+					bestPull = pull;
+				}
+			}
+			parent[i] = i;
+			if (best == i)
+				continue;
+
+			/* Bound, and weakly perturbed? */
+			double r[3] = { bodies.px[i] - bodies.px[best],
+				bodies.py[i] - bodies.py[best], bodies.pz[i] - bodies.pz[best] };
+			double v[3] = { bodies.vx[i] - bodies.vx[best],
+				bodies.vy[i] - bodies.vy[best], bodies.vz[i] - bodies.vz[best] };
+			double r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+			double v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+			double radius = sqrt(r2);
+			double mu = gravity * (bodies.mass[i] + bodies.mass[best]);
+			if (2.0 / radius - v2 / mu <= 0.0)
+				continue;
+			double central = mu / r2;
+			double px = bodies.ax[i] - bodies.ax[best] + central * r[0] / radius;
+			double py = bodies.ay[i] - bodies.ay[best] + central * r[1] / radius;
+			double pz = bodies.az[i] - bodies.az[best] + central * r[2] / radius;
+			double perturbation = sqrt(px * px + py * py + pz * pz);
+			double limit = (previous[i] == best) ?
+				ratio * KEPLER_PROMOTE_FACTOR : ratio;
+			if (perturbation < limit * central)
+				parent[i] = best;
+		}
+	});
+
+	numeric.clear();
+	analytic.clear();
+	for (GLuint i = 0; i < n; i++)
+	{
+		bool was = previous[i] != i;
+		if (parent[i] == i)
+		{
+			numeric.push_back(i);
+			promoted += was ? 1 : 0;
+		}
+		else
+		{
+			analytic.push_back(i);
+			demoted += was ? 0 : 1;
+		}
+	}
+	std::sort(analytic.begin(), analytic.end(), heavier);
+	rx.resize(analytic.size()); ry.resize(analytic.size());
+	rz.resize(analytic.size()); vx.resize(analytic.size());
+	vy.resize(analytic.size()); vz.resize(analytic.size());
+}
+
+/******************************************************************************
+*                                                                             *
+*                        KeplerIntegrator::kickNumeric                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies.                                                       *
+*  @param dt                                                                  *
+*           Length of the kick in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Adds a * dt to the velocity of every numerically integrated body.         *
+*                                                                             *
+*******************************************************************************/
+void KeplerIntegrator::kickNumeric(BodyArrays &bodies, double dt)
+{
+	Parallel::forRange(0, numeric.size(), KEPLER_GRAIN,
+		[&](GLuint lo, GLuint hi)
+	{
+		for (GLuint k = lo; k < hi; k++)
+		{
+			GLuint i = numeric[k];
+			bodies.vx[i] += bodies.ax[i] * dt;
+			bodies.vy[i] += bodies.ay[i] * dt;
+			bodies.vz[i] += bodies.az[i] * dt;
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                           KeplerIntegrator::step                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be advanced.                                        *
+*  @param solver                                                              *
+*           Solver for the accelerations of the numeric bodies.               *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*  @param dt                                                                  *
+*           Length of the step in seconds.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Takes the relative states of the analytic bodies, kicks the numeric       *
+*  bodies by half a step and drifts them, propagates the relative states     *
+*  in parallel and places each analytic body at its (already moved) parent  *
+*  plus its new relative position. Accelerations are then computed for the  *
+*  numeric bodies only (for all bodies on a reclassification step), the      *
+*  numeric bodies get their second half kick, and the analytic velocities    *
+*  are rebuilt on their parents' final velocities.                           *
+*                                                                             *
+*******************************************************************************/
+void KeplerIntegrator::step(BodyArrays &bodies, GravitySolver &solver,
+                            double gravity, double dt)
+{
+	const GLuint n = bodies.count;
+	if (parent.size() != n)
+	{
+		solver.computeAccelerations(bodies, gravity);
+		evaluations++;
+		targets += n;
+		fullTargets += n;
+		classify(bodies, gravity);
+		countdown = interval;
+	}
+	const GLuint numAnalytic = analytic.size();
+
+	/* Relative states, taken before anything moves. */
+	Parallel::forRange(0, numAnalytic, KEPLER_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint k = lo; k < hi; k++)
+		{
+			GLuint i = analytic[k], p = parent[i];
+			rx[k] = bodies.px[i] - bodies.px[p];
+			ry[k] = bodies.py[i] - bodies.py[p];
+			rz[k] = bodies.pz[i] - bodies.pz[p];
+			vx[k] = bodies.vx[i] - bodies.vx[p];
+			vy[k] = bodies.vy[i] - bodies.vy[p];
+			vz[k] = bodies.vz[i] - bodies.vz[p];
+		}
+	});
+
+	/* Kick and drift the numeric bodies. */
+	kickNumeric(bodies, 0.5 * dt);
+	Parallel::forRange(0, numeric.size(), KEPLER_GRAIN,
+		[&](GLuint lo, GLuint hi)
+	{
+		for (GLuint k = lo; k < hi; k++)
+		{
+			GLuint i = numeric[k];
+			bodies.px[i] += bodies.vx[i] * dt;
+			bodies.py[i] += bodies.vy[i] * dt;
+			bodies.pz[i] += bodies.vz[i] * dt;
+		}
+	});
+
+	/* Two-body motion relative to the parents. */
+	std::atomic<GLuint> failed(0);
+	Parallel::forRange(0, numAnalytic, KEPLER_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint k = lo; k < hi; k++)
+		{
+			GLuint i = analytic[k];
+			double mu = gravity * (bodies.mass[i] + bodies.mass[parent[i]]);
+			double r[3] = { rx[k], ry[k], rz[k] };
+			double v[3] = { vx[k], vy[k], vz[k] };
+			if (!Kepler::propagate(mu, r, v, dt))
+			{
+				/* Drift instead, and reclassify at the end of the step. */
+				r[0] += v[0] * dt; r[1] += v[1] * dt; r[2] += v[2] * dt;
+				failed++;
+			}
+			rx[k] = r[0]; ry[k] = r[1]; rz[k] = r[2];
+			vx[k] = v[0]; vy[k] = v[1]; vz[k] = v[2];
+		}
+	});
+	for (GLuint k = 0; k < numAnalytic; k++)
+	{
+		GLuint i = analytic[k], p = parent[i];
+		bodies.px[i] = bodies.px[p] + rx[k];
+		bodies.py[i] = bodies.py[p] + ry[k];
+		bodies.pz[i] = bodies.pz[p] + rz[k];
+	}
+
+	/* Forces: all of them when reclassifying, else the numeric ones. */
+	bool full = --countdown == 0 || failed > 0;
+	if (full)
+	{
+		solver.computeAccelerations(bodies, gravity);
+		evaluations++;
+		targets += n;
+	}
+	else if (!numeric.empty())
+	{
+		solver.computeActiveAccelerations(bodies, gravity, numeric);
+		evaluations++;
+		targets += numeric.size();
+	}
+	fullTargets += n;
+
+	/* Close the step. */
+	kickNumeric(bodies, 0.5 * dt);
+	for (GLuint k = 0; k < numAnalytic; k++)
+	{
+		GLuint i = analytic[k], p = parent[i];
+		bodies.vx[i] = bodies.vx[p] + vx[k];
+		bodies.vy[i] = bodies.vy[p] + vy[k];
+		bodies.vz[i] = bodies.vz[p] + vz[k];
+	}
+
+	if (full)
+	{
+		classify(bodies, gravity);
+		countdown = interval;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        KeplerIntegrator::reportStats                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints how many bodies are analytic and the share of accelerations that   *
+*  was not computed, then resets the counters.                               *
+*                                                                             *
+*******************************************************************************/
+void KeplerIntegrator::reportStats()
+{
+	double saved = (fullTargets > 0) ?
+		100.0 * (1.0 - (double) targets / (double) fullTargets) : 0.0;
+	fprintf(stdout, "Stats: Kepler %u of %u bodies analytic, %llu of %llu "
+		"accelerations computed (%.1f%% saved), %u promoted, %u demoted\n",
+		(GLuint) analytic.size(), (GLuint) parent.size(), targets, fullTargets,
+		saved, promoted, demoted);
+	targets = fullTargets = 0;
+	promoted = demoted = 0;
+}
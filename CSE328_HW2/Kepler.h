@@ -0,0 +1,127 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <vector>
+#include "GravitySolver.h"
+#include "Integrator.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Perturbing / central acceleration below which a body goes analytic. */
+#define  DEFAULT_KEPLER_RATIO       1.0e-3
+/* Factor above the ratio at which an analytic body is integrated again. */
+#define  KEPLER_PROMOTE_FACTOR      2.0
+/* Steps between full force evaluations, which reclassify every body. */
+#define  DEFAULT_KEPLER_INTERVAL    16
+/* Heaviest bodies considered as parents. */
+#define  KEPLER_MAX_PARENTS         32
+/* Iteration limit and relative tolerance of the universal-variable solver. */
+#define  KEPLER_MAX_ITERATIONS      50
+#define  KEPLER_TOLERANCE           1.0e-12
+
+/******************************************************************************
+*                                                                             *
+*                             Kepler  (class)                                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Two-body propagation in universal variables. The same equations hold for  *
+*  elliptic, parabolic and hyperbolic orbits, and Kepler's equation in the   *
+*  universal anomaly is solved by Laguerre's method, which converges from    *
+*  any starting point on this equation (where Newton's method can cycle on   *
+*  eccentric orbits).                                                        *
+*                                                                             *
+*******************************************************************************/
+class Kepler
+{
+public:
+	/* Advance the relative state r, v around mass parameter mu by dt. */
+	static bool      propagate(double mu, double r[3], double v[3], double dt);
+
+private:
+	/* Stumpff functions C(z) and S(z). */
+	static void      stumpff(double z, double &c, double &s);
+};
+
+/******************************************************************************
+*                                                                             *
+*                        KeplerIntegrator  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  ratio, interval                                                            *
+*          Demotion threshold and steps between reclassifications.           *
+*  parent                                                                     *
+*          Dominant parent of each analytic body (the body itself when it is *
+*          integrated numerically).                                           *
+*  numeric, analytic                                                          *
+*          Numerically integrated bodies, and analytic bodies ordered so     *
+*          that every parent comes before its children.                       *
+*  rx .. vz                                                                   *
+*          State of each analytic body relative to its parent.                *
+*  countdown                                                                  *
+*          Steps until the next reclassification.                             *
+*  targets, fullTargets, promoted, demoted                                    *
+*          Accelerations computed, and that a full evaluation every step     *
+*          would have computed, and bodies moved between the two groups,      *
+*          since the last report.                                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Hybrid of analytic and kick-drift-kick leapfrog integration. Every body   *
+*  is given a dominant parent, the heavier body pulling hardest on it. When  *
+*  the body is bound to its parent and the acceleration relative to the      *
+*  parent is within ratio of the two-body acceleration, its motion relative   *
+*  to the parent is propagated with Kepler::propagate and no force is        *
+*  evaluated for it; the other bodies are integrated as usual, feeling the   *
+*  analytic ones at their current positions. Every interval steps all forces *
+*  are evaluated and every body is classified afresh; an analytic body goes  *
+*  back to numerical integration once its ratio exceeds KEPLER_PROMOTE_FACTOR *
+*  times the threshold, so bodies near it do not switch every check.         *
+*                                                                             *
+*******************************************************************************/
+class KeplerIntegrator : public Integrator
+{
+public:
+	                 KeplerIntegrator(double ratio = DEFAULT_KEPLER_RATIO,
+	                                  GLuint interval = DEFAULT_KEPLER_INTERVAL);
+
+	void             step(BodyArrays &bodies, GravitySolver &solver,
+	                      double gravity, double dt) override;
+	void             reset() override              {  countdown = 0;
+	                                                  parent.clear();      }
+	const char*      getName() const override      {  return "kepler";     }
+	void             reportStats() override;
+
+	/* Getters. */
+	GLuint           getNumAnalytic()        const {  return analytic.size(); }
+
+	/* Setters. */
+	void             setRatio(double r)            {  ratio = r;           }
+	void             setInterval(GLuint steps)     {  interval = (steps > 0) ?
+	                                                      steps : 1;       }
+
+private:
+	double           ratio;
+	GLuint           interval;
+	std::vector<GLuint>  parent;
+	std::vector<GLuint>  numeric, analytic;
+	std::vector<double>  rx, ry, rz, vx, vy, vz;
+	GLuint           countdown;
+	unsigned long long targets, fullTargets;
+	GLuint           promoted, demoted;
+
+	/* Choose the parent and the method of every body. */
+	void             classify(const BodyArrays &bodies, double gravity);
+	/* Kick the numeric bodies by dt. */
+	void             kickNumeric(BodyArrays &bodies, double dt);
+};
@@ -0,0 +1,431 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "LatencyMonitor.h"
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+/******************************************************************************
+*                                                                             *
+*                                Static Variables                             *
+*                                                                             *
+******************************************************************************/
+
+/* Names of the stages, in the order of LatencyStage. */
+static const char* STAGE_NAMES[NUM_LATENCY_STAGES] =
+{
+	"handled", "camera", "swapped", "gpu_done", "frame_time"
+};
+
+/******************************************************************************
+*                                                                             *
+*                  LatencyMonitor::LatencyMonitor (Constructor)               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the timestamp queries (when supported) and aligns the clocks.      *
+*                                                                             *
+*******************************************************************************/
+LatencyMonitor::LatencyMonitor() :
+	tickOffset(0.0), gpuOffset(0.0), pendingInput(-1.0), frameInput(-1.0),
+	lastSwap(-1.0), nextQuery(0)
+{
+	timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	for (GLuint i = 0; i < LATENCY_QUERY_DEPTH; i++)
+	{
+		queries[i] = 0;
+		queryInput[i] = -1.0;
+		queryBusy[i] = false;
+	}
+	if (timerQueries)
+		glGenQueries(LATENCY_QUERY_DEPTH, queries);
+	for (GLuint s = 0; s < NUM_LATENCY_STAGES; s++)
+	{
+		total[s].assign(LATENCY_NUM_BINS, 0);
+		interval[s].assign(LATENCY_NUM_BINS, 0);
+	}
+	calibrate();
+}
+
+/******************************************************************************
+*                                                                             *
+*                  LatencyMonitor::~LatencyMonitor (Destructor)               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Frees the queries if cleanUp has not.                                      *
+*                                                                             *
+*******************************************************************************/
+LatencyMonitor::~LatencyMonitor()
+{
+	cleanUp();
+}
+
+/******************************************************************************
+*                                                                             *
+*                          LatencyMonitor::now (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The performance counter in milliseconds.                                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The clock every stage is measured on.                                      *
+*                                                                             *
+*******************************************************************************/
+double LatencyMonitor::now()
+{
+	return SDL_GetPerformanceCounter() * 1000.0 /
+		SDL_GetPerformanceFrequency();
+}
+
+/******************************************************************************
+*                                                                             *
+*                           LatencyMonitor::calibrate                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Measures the offsets of the SDL tick clock (event timestamps) and of the   *
+*  GPU clock (nanoseconds) from now, so the clocks cannot drift apart for     *
+*  longer than a report interval.                                             *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::calibrate()
+{
+	tickOffset = now() - SDL_GetTicks();
+	if (timerQueries)
+	{
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		gpuOffset = now() - gpuTime / 1.0e6;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                            LatencyMonitor::record                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param stage                                                               *
+*           The stage measured.                                               *
+*  @param millis                                                              *
+*           The measured time.                                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Counts the sample in its one millisecond bin. Slightly negative times      *
+*  (from the millisecond event timestamps) count as zero.                     *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::record(LatencyStage stage, double millis)
+{
+	GLuint bin = (millis <= 0.0) ? 0 :
+		(GLuint) std::min(millis, LATENCY_NUM_BINS - 1.0);
+	total[stage][bin]++;
+	interval[stage][bin]++;
+}
+
+/******************************************************************************
+*                                                                             *
+*                  LatencyMonitor::inputHandled / inputApplied                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param timestamp                                                           *
+*           The timestamp of the handled event (SDL_GetTicks).                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  inputHandled records how long the event waited in the queue and keeps      *
+*  the oldest input not yet applied; inputApplied records its delay to the    *
+*  camera update and hands it to the frame being drawn.                       *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::inputHandled(Uint32 timestamp)
+{
+	const double input = timestamp + tickOffset;
+	record(LATENCY_HANDLED, now() - input);
+	if (pendingInput < 0.0 || input < pendingInput)
+		pendingInput = input;
+}
+void LatencyMonitor::inputApplied()
+{
+	if (pendingInput < 0.0)
+		return;
+	record(LATENCY_APPLIED, now() - pendingInput);
+	if (frameInput < 0.0 || pendingInput < frameInput)
+		frameInput = pendingInput;
+	pendingInput = -1.0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                   LatencyMonitor::beforeSwap / afterSwap                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  beforeSwap collects finished queries and, if the frame carries input and   *
+*  a query is free, timestamps the end of its commands on the GPU.            *
+*  afterSwap records the frame time and the input's delay to the present.     *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::beforeSwap()
+{
+	collectQueries();
+	if (!timerQueries || frameInput < 0.0 || queryBusy[nextQuery])
+		return;
+	glQueryCounter(queries[nextQuery], GL_TIMESTAMP);
+	queryInput[nextQuery] = frameInput;
+	queryBusy[nextQuery] = true;
+	nextQuery = (nextQuery + 1) % LATENCY_QUERY_DEPTH;
+}
+void LatencyMonitor::afterSwap()
+{
+	const double swapped = now();
+	if (lastSwap >= 0.0)
+		record(LATENCY_FRAME_TIME, swapped - lastSwap);
+	lastSwap = swapped;
+	if (frameInput >= 0.0)
+		record(LATENCY_SWAPPED, swapped - frameInput);
+	frameInput = -1.0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        LatencyMonitor::collectQueries                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Records the GPU completion of every frame whose timestamp is available,    *
+*  without waiting for the others.                                            *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::collectQueries()
+{
+	for (GLuint i = 0; i < LATENCY_QUERY_DEPTH; i++)
+	{
+		if (!queryBusy[i])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &gpuTime);
+		record(LATENCY_GPU_DONE, gpuTime / 1.0e6 + gpuOffset - queryInput[i]);
+		queryBusy[i] = false;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                      LatencyMonitor::percentile (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param histogram                                                           *
+*           Counts of one millisecond bins.                                   *
+*  @param fraction                                                            *
+*           Fraction of the samples, in (0, 1].                               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The upper edge, in milliseconds, of the bin reaching the fraction.         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  A result of LATENCY_NUM_BINS means at least LATENCY_NUM_BINS - 1 ms.       *
+*                                                                             *
+*******************************************************************************/
+GLuint LatencyMonitor::percentile(const std::vector<GLuint> &histogram,
+                                  double fraction)
+{
+	unsigned long long count = 0;
+	for (GLuint b = 0; b < histogram.size(); b++)
+		count += histogram[b];
+	const unsigned long long target =
+		(unsigned long long) std::ceil(fraction * count);
+	unsigned long long seen = 0;
+	for (GLuint b = 0; b < histogram.size(); b++)
+	{
+		seen += histogram[b];
+		if (seen >= target && seen > 0)
+			return b + 1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            LatencyMonitor::report                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints the median, 95th and 99th percentile and maximum of every stage     *
+*  with samples since the last report, then starts the next interval and      *
+*  realigns the clocks.                                                       *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::report()
+{
+	for (GLuint s = 0; s < NUM_LATENCY_STAGES; s++)
+	{
+		unsigned long long count = 0;
+		for (GLuint b = 0; b < LATENCY_NUM_BINS; b++)
+			count += interval[s][b];
+		if (count == 0)
+			continue;
+		fprintf(stdout, "Stats: Latency %-10s %7llu samples, p50 %3u ms, "
+			"p95 %3u ms, p99 %3u ms, max %3u ms\n", STAGE_NAMES[s], count,
+			percentile(interval[s], 0.50), percentile(interval[s], 0.95),
+			percentile(interval[s], 0.99), percentile(interval[s], 1.0));
+		interval[s].assign(LATENCY_NUM_BINS, 0);
+	}
+	calibrate();
+}
+
+/******************************************************************************
+*                                                                             *
+*                             LatencyMonitor::save                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param path                                                                *
+*           The CSV file to be written.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  true if the file was written.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes one row per millisecond bin (its lower edge) with the count of      *
+*  every stage over the whole run, frame times included, so latency and       *
+*  pacing can be plotted together.                                            *
+*                                                                             *
+*******************************************************************************/
+bool LatencyMonitor::save(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		std::cerr << "Error saving latency: cannot create " << path
+		          << std::endl;
+		return false;
+	}
+
+	fprintf(file, "millis");
+	for (GLuint s = 0; s < NUM_LATENCY_STAGES; s++)
+		fprintf(file, ",%s", STAGE_NAMES[s]);
+	fprintf(file, "\n");
+	for (GLuint b = 0; b < LATENCY_NUM_BINS; b++)
+	{
+		fprintf(file, "%u", b);
+		for (GLuint s = 0; s < NUM_LATENCY_STAGES; s++)
+			fprintf(file, ",%u", total[s][b]);
+		fprintf(file, "\n");
+	}
+
+	bool written = !ferror(file);
+	fclose(file);
+	if (!written)
+		std::cerr << "Error saving latency: cannot write " << path
+		          << std::endl;
+	return written;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           LatencyMonitor::cleanUp                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Deletes the queries. Must be called while the GL context still exists;     *
+*  calling it again does nothing.                                             *
+*                                                                             *
+*******************************************************************************/
+void LatencyMonitor::cleanUp()
+{
+	if (queries[0] != 0)
+		glDeleteQueries(LATENCY_QUERY_DEPTH, queries);
+	for (GLuint i = 0; i < LATENCY_QUERY_DEPTH; i++)
+	{
+		queries[i] = 0;
+		queryBusy[i] = false;
+	}
+	timerQueries = false;
+}
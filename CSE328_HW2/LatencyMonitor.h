@@ -0,0 +1,136 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <SDL\SDL.h>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flag naming the CSV file the histograms are written to. */
+#define  LATENCY_FLAG               "--latency"
+/* Frames whose GPU timestamps may be outstanding at once. */
+#define  LATENCY_QUERY_DEPTH        4
+/* Histogram bins of one millisecond (the last also counts longer times). */
+#define  LATENCY_NUM_BINS           100
+
+/******************************************************************************
+*                                                                             *
+*                          LatencyStage  (enum)                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The measured intervals: from the timestamp of an input event to its        *
+*  handling, to the camera update which applies it, to the return of the      *
+*  swap presenting it, and to the GPU finishing that frame; and the time      *
+*  between two swaps.                                                         *
+*                                                                             *
+*******************************************************************************/
+enum LatencyStage
+{
+	LATENCY_HANDLED,
+	LATENCY_APPLIED,
+	LATENCY_SWAPPED,
+	LATENCY_GPU_DONE,
+	LATENCY_FRAME_TIME,
+	NUM_LATENCY_STAGES
+};
+
+/******************************************************************************
+*                                                                             *
+*                        LatencyMonitor  (class)                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  tickOffset, gpuOffset                                                      *
+*          Milliseconds added to SDL_GetTicks and to GPU timestamps to put    *
+*          them on the performance counter clock.                             *
+*  pendingInput                                                               *
+*          Time of the oldest input handled but not yet applied (or -1).      *
+*  frameInput                                                                 *
+*          Time of the oldest input applied in the current frame (or -1).     *
+*  lastSwap                                                                   *
+*          Time the previous frame was presented (or -1).                     *
+*  queries, queryInput, queryBusy                                             *
+*          Ring of timestamp queries, the input each frame carried, and       *
+*          whether its result is still outstanding.                           *
+*  total, interval                                                            *
+*          Histograms per stage over the whole run and since the last         *
+*          report.                                                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Measures input-to-photon latency of the viewer. Every handled event        *
+*  contributes its handling delay; the oldest input of a frame (the worst     *
+*  case) is followed through the camera update and the swap, and a            *
+*  GL_TIMESTAMP query issued just before the swap tells when the GPU          *
+*  finished drawing it. Query results are collected frames later without      *
+*  stalling; if the ring is still busy the frame goes unmeasured instead.     *
+*                                                                             *
+*  All times are milliseconds on the SDL performance counter. SDL event       *
+*  timestamps only have millisecond resolution, and the GPU clock is          *
+*  aligned with a glGetInteger64v(GL_TIMESTAMP) at each report, which reads   *
+*  the time commands reach the GPU rather than finish. Without timer          *
+*  queries (GL 3.3 or ARB_timer_query) the GPU stage stays empty.             *
+*                                                                             *
+*  Needs the GL context to construct, update and clean up.                    *
+*                                                                             *
+*******************************************************************************/
+class LatencyMonitor
+{
+public:
+	/* Constructor / destructor (which frees the queries). */
+	                 LatencyMonitor();
+	                 ~LatencyMonitor();
+
+	/* An input event with the given SDL timestamp was handled. */
+	void             inputHandled(Uint32 timestamp);
+	/* The handled input was applied to the camera. */
+	void             inputApplied();
+	/* The frame is drawn and about to be swapped. */
+	void             beforeSwap();
+	/* The frame was presented. */
+	void             afterSwap();
+
+	/* Print the percentiles since the last report and start a new one. */
+	void             report();
+	/* Write the histograms of the whole run as CSV. */
+	bool             save(const char* path) const;
+
+	/* Free the queries. */
+	void             cleanUp();
+
+private:
+	double                   tickOffset;
+	double                   gpuOffset;
+	double                   pendingInput;
+	double                   frameInput;
+	double                   lastSwap;
+	bool                     timerQueries;
+	GLuint                   queries[LATENCY_QUERY_DEPTH];
+	double                   queryInput[LATENCY_QUERY_DEPTH];
+	bool                     queryBusy[LATENCY_QUERY_DEPTH];
+	GLuint                   nextQuery;
+	std::vector<GLuint>      total[NUM_LATENCY_STAGES];
+	std::vector<GLuint>      interval[NUM_LATENCY_STAGES];
+
+	/* Current time in milliseconds. */
+	static double    now();
+	/* Align the SDL tick and GPU clocks with now. */
+	void             calibrate();
+	/* Add a sample to a stage. */
+	void             record(LatencyStage stage, double millis);
+	/* Collect the finished timestamp queries. */
+	void             collectQueries();
+	/* Smallest time at or below which fraction of the samples lie. */
+	static GLuint    percentile(const std::vector<GLuint> &histogram,
+	                            double fraction);
+};
@@ -11,12 +11,31 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cstdlib>
+#include <algorithm>
 #include <vector>
+#include <cstdio>
 #include "Display.h"
 #include "Shader.h"
+#include "ShaderLibrary.h"
 #include "Geometry.h"
 #include "Camera.h"
 #include "EventManager.h"
+#include "AssetCache.h"
+#include "OrbitalSystem.h"
+#include "GravityBenchmark.h"
+#include "Simulation.h"
+#include "TaskScheduler.h"
+#include "TrajectoryLog.h"
+#include "OrbitTrails.h"
+#include "LatencyMonitor.h"
+#include "Picking.h"
+#include "SceneBenchmark.h"
+#include "Ephemeris.h"
+#include "Snapshot.h"
+#include "TransformSystem.h"
+#include "StartupProfiler.h"
+#include <functional>
 
 /*******************************************************************************
  *                                                                             *
@@ -32,6 +51,8 @@
 #define  TEXUTRES_PATH        "res/textures/";
 #define  SHADERS_PATH         "res/shaders/";
 #define  FRAMES_PER_SECOND    100
+#define  IDLE_WAIT_MILLIS     250
+#define  DRIFT_REPORT_MILLIS  5000
 #define  PROJECT_TITLE        "CSE 328 Homework 2"
 #define  PRINT(a)             std::cout << a << std::endl;
 
@@ -71,35 +92,235 @@ glm::vec3  bases[] =
  *******************************************************************************/
 int main(int argc, char* argv[])
 {
+	/* Time the startup up to the first frame. */
+	StartupProfiler::begin();
+
+	/* Start the task scheduler before anything submits work to it. */
+	TaskScheduler::get();
+
+	/* Time the gravity solvers instead of opening the viewer. */
+	if (argc > 1 && std::string(argv[1]) == GRAVITY_BENCHMARK_FLAG)
+	{
+		GravityBenchmark::run();
+		TaskScheduler::shutdown();
+		return 0;
+	}
+
+	/* Time the geometry, asset and rendering code and write the results. */
+	if (argc > 1 && std::string(argv[1]) == SCENE_BENCHMARK_FLAG)
+	{
+		bool written = SceneBenchmark::run((argc > 2) ? argv[2]
+		                                              : SCENE_BENCHMARK_JSON);
+		TaskScheduler::shutdown();
+		SDL_Quit();
+		return written ? 0 : 1;
+	}
+
+	/* System to load, log files to record to or replay from, */
+	/* ephemerides, and the checkpoint written on exit.       */
+	const char* systemFile = DEFAULT_SYSTEM_FILE;
+	const char* checkpointFile = NULL;
+	const char* convertInput = NULL;
+	const char* convertOutput = NULL;
+	const char* recordFile = NULL;
+	const char* replayFile = NULL;
+	const char* ephemerisFile = NULL;
+	const char* buildFile = NULL;
+	double      buildDays = 0.0;
+	const char* latencyFile = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (std::string(argv[i]) == SYSTEM_FILE_FLAG)
+			systemFile = argv[++i];
+		else if (std::string(argv[i]) == TRAJECTORY_RECORD_FLAG)
+			recordFile = argv[++i];
+		else if (std::string(argv[i]) == TRAJECTORY_REPLAY_FLAG)
+			replayFile = argv[++i];
+		else if (std::string(argv[i]) == EPHEMERIS_FLAG)
+			ephemerisFile = argv[++i];
+		else if (std::string(argv[i]) == EPHEMERIS_BUILD_FLAG && i + 2 < argc)
+		{
+			buildFile = argv[++i];
+			buildDays = atof(argv[++i]);
+		}
+		else if (std::string(argv[i]) == LATENCY_FLAG)
+			latencyFile = argv[++i];
+		else if (std::string(argv[i]) == SNAPSHOT_CHECKPOINT_FLAG)
+			checkpointFile = argv[++i];
+		else if (std::string(argv[i]) == SNAPSHOT_CONVERT_FLAG && i + 2 < argc)
+		{
+			convertInput = argv[++i];
+			convertOutput = argv[++i];
+		}
+	}
+
+	/* Convert between system.xml and a snapshot instead of opening the */
+	/* viewer.                                                           */
+	if (convertInput != NULL)
+	{
+		bool converted = Snapshot::convert(convertInput, convertOutput);
+		TaskScheduler::shutdown();
+		return converted ? 0 : 1;
+	}
+
+	/* Precompute an ephemeris instead of opening the viewer. */
+	if (buildFile != NULL)
+	{
+		AssetCache    assets;
+		OrbitalSystem system;
+		double        startTime = 0.0;
+		Snapshot::loadScene(systemFile, system, &assets, &startTime);
+		Simulation    simulation(&system);
+		simulation.start(startTime);
+		bool built = Ephemeris::build(buildFile, system, simulation,
+			buildDays * 86400.0);
+		TaskScheduler::shutdown();
+		return built ? 0 : 1;
+	}
+
 	/* Initialize SDL with all subsystems. */
 	SDL_Init(SDL_INIT_EVERYTHING);
+	StartupProfiler::mark("SDL_Init");
+
+	/* Build the shapes and load the orbital system or a snapshot of one   */
+	/* on the workers while the window, context and shaders are created.   */
+	/* The buffers are generated afterwards in one batch (the assets of    */
+	/* the system are loaded on first use).                                */
+	struct Shape
+	{
+		const char*             name;
+		std::function<Mesh*()>  make;
+		bool                    solid;
+	};
+	const Shape shapes[] =
+	{
+		{ "Icosohedron",   [] { return Geometry::makeSphere<0>(1); },    true },
+		{ "80-Triangle",   [] { return Geometry::makeSphere<1>(1); },   false },
+		{ "320-Triangle",  [] { return Geometry::makeSphere<2>(1); },    true },
+		{ "Ellipse",       [] { return Geometry::makeEllipse(1, 2, 1.5, 3); },
+		                                                                 true },
+		{ "Cylinder",      [] { return Geometry::makeCylinder(1, 4); },  true },
+		{ "Cube",          [] { return Geometry::makeCube(1); },         true },
+		{ "Tetrahedron",   [] { return Geometry::makeTetrahedron(1); },  true },
+		{ "Cone",          [] { return Geometry::makeCone(1, 4); },      true },
+		{ "Torus",         [] { return Geometry::makeTorus(); },         true },
+	};
+	const GLuint  numShapes = sizeof(shapes) / sizeof(*shapes);
+	std::vector<Mesh*> meshes(numShapes, (Mesh*) NULL);
+	AssetCache    assets;
+	OrbitalSystem system;
+	double        startTime = 0.0;
+	TaskGroup     startup;
+	Geometry::deferUploads = true;
+	for (GLuint i = 0; i < numShapes; i++)
+	{
+		TaskScheduler::get().submit(startup, [&shapes, &meshes, i]
+		{
+			Uint64 start = StartupProfiler::now();
+			meshes[i] = shapes[i].make();
+			if (meshes[i] != NULL)
+				meshes[i]->setIsSolid(shapes[i].solid);
+			StartupProfiler::recordTask(shapes[i].name, start);
+		});
+	}
+	TaskScheduler::get().submit(startup, [&]
+	{
+		Uint64 start = StartupProfiler::now();
+		Snapshot::loadScene(systemFile, system, &assets, &startTime);
+		StartupProfiler::recordTask("System", start);
+	});
 
-	/* Create the display, shader, camera, and event manager. */
-	Display      display(PROJECT_TITLE, DEFAULT_WIDTH, DEFAULT_HEIGHT);
-	Shader       shader(DEFAULT_VERTEX_SHADER, DEFAULT_FRAGMENT_SHADER);
-	Camera*      camera = display.getCamera();
+	/* Create the display, shaders, camera, and event manager. */
+	Display       display(PROJECT_TITLE, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+	StartupProfiler::mark("Window and GL context");
+	ShaderLibrary shaders(DEFAULT_VERTEX_SHADER, DEFAULT_FRAGMENT_SHADER);
+	Camera*       camera = display.getCamera();
+
+	/* Build every permutation up front (from the cache when possible). */
+	shaders.compileVariants({
+		SHADER_NONE,
+		SHADER_LIT,
+		SHADER_TEXTURED | SHADER_LIT,
+		SHADER_WIREFRAME,
+	});
+	Shader*       shader = shaders.getVariant(SHADER_NONE);
+	StartupProfiler::mark("Shaders");
 
 	/* Apply the shaders and maximize the display. */
-	Geometry::shader = &shader;
+	Geometry::shader = shader;
 	display.setShader(shader);
 	display.maximize();
 	GLfloat speed = 1.0f;
 	EventManager eventManager(camera, &speed);
+	StartupProfiler::mark("Display setup");
+
+	/* Finish the shapes and the system, then upload every shape at once. */
+	TaskScheduler::get().wait(startup);
+	Geometry::deferUploads = false;
+	StartupProfiler::mark("Waiting for workers");
+	meshes.erase(std::remove(meshes.begin(), meshes.end(), (Mesh*) NULL),
+		meshes.end());
+	Mesh::uploadAll(meshes);
+	StartupProfiler::mark("Mesh upload");
+
+	Simulation    simulation(&system);
+	TrajectoryWriter recorder;
+	if (recordFile != NULL &&
+		recorder.open(recordFile, system.getNumBodies()))
+		simulation.setRecorder(&recorder);
+	simulation.start(startTime);
+
+	/* Replay a log or an ephemeris instead of simulating, scrubbed with */
+	/* [ and ].                                                            */
+	TrajectoryReader replay;
+	Ephemeris     ephemeris;
+	bool          replaying = false;
+	bool          fromEphemeris = false;
+	double        replayTime = 0.0, replayStart = 0.0, replayEnd = 0.0;
+	if (ephemerisFile != NULL && ephemeris.open(ephemerisFile))
+	{
+		if (ephemeris.getNumBodies() == system.getNumBodies())
+		{
+			replaying = fromEphemeris = true;
+			replayStart = ephemeris.getStartTime();
+			replayEnd = ephemeris.getEndTime();
+		}
+		else
+			std::cerr << "Error replaying " << ephemerisFile << ": built for "
+			          << ephemeris.getNumBodies() << " bodies" << std::endl;
+	}
+	else if (replayFile != NULL && replay.open(replayFile))
+	{
+		if (replay.getNumBodies() == system.getNumBodies())
+		{
+			replaying = true;
+			replayStart = replay.getStartTime();
+			replayEnd = replay.getEndTime();
+		}
+		else
+			std::cerr << "Error replaying " << replayFile << ": recorded for "
+			          << replay.getNumBodies() << " bodies" << std::endl;
+	}
+	if (replaying)
+	{
+		replayTime = replayStart;
+		eventManager.setTimeline(&replayTime);
+	}
+
+	/* Keep a trail of every body, sampled once per frame. */
+	OrbitTrails   trails;
+	display.setTrails(&trails);
+
+	/* Draw the bodies with their meshes and textures, loaded on first use. */
+	display.setSystem(&system, &assets);
 
-	// Create mesh/transform vectors.
-	std::vector<Mesh*> meshes;
-	std::vector<glm::mat4*> transforms;
-	
-	// Create geometries.
-	meshes.push_back(Geometry::makeSphere(1, 0));        // Icosohedron.
-	meshes.push_back(Geometry::makeSphere(1, 1));        // 80-Triangle Sphere.
-	meshes.push_back(Geometry::makeSphere(1, 2));        // 320-Triangle Sphere.
-	meshes.push_back(Geometry::makeEllipse(1, 2, 1.5, 3)); // Ellipse.
-	meshes.push_back(Geometry::makeCylinder(1, 4));      // Cylinder.
-	meshes.push_back(Geometry::makeCube(1));
-	meshes.push_back(Geometry::makeTetrahedron(1));      // Tetrahedron.
-	meshes.push_back(Geometry::makeCone(1, 4));          // Cone.
-	meshes.push_back(Geometry::makeTorus());             // Torus.
+	/* Measure the latency from input events to the screen. */
+	LatencyMonitor latency;
+	display.setLatencyMonitor(&latency);
+	eventManager.setLatencyMonitor(&latency);
+
+	/* Select the shape under the cursor on a left click. */
+	ScenePicker   picker;
 
 	/* Place meshes in the world space. */
 	GLfloat s = (2 * M_PI) / meshes.size();
@@ -108,24 +329,29 @@ int main(int argc, char* argv[])
 	{
 		meshes[i]->translateModel(glm::vec3{ cosf(i * s) * radius, +0.0f, sinf(i * s) * radius });
 	}
-	
-	meshes[1]->setIsSolid(false);
-
-	/* Instantiate the event reference. */
-	SDL_Event event;
-	SDL_PollEvent(&event);	
 
 	/* Begin the milliseconds counter. */
-	GLuint startMillis = 0, tempMillis = 0, currentMillis = 0, 
+	GLuint startMillis = 0, currentMillis = 0, 
 		millisPerFrame = (GLuint)((1.0 / FRAMES_PER_SECOND) * MILLIS_PER_SECOND);
-	startMillis = tempMillis = currentMillis = SDL_GetTicks();	
+	startMillis = currentMillis = SDL_GetTicks();	
+
+	/* Draw the first frame right away. */
+	startMillis -= millisPerFrame;
+	GLuint reportMillis = startMillis;
+	double shownTime = replayTime;
 	GLfloat t = 0;
 
 	/* Main loop. */
-	while (event.type != SDL_QUIT)
+	bool running = true;
+	while (running)
 	{
-		/* Handle the new event. */
-		eventManager.handleSDLEvent(&event);
+		/* Sleep until the next frame is due (longer while minimized, when */
+		/* nothing is drawn), waking for input, and handle all of it.      */
+		currentMillis = SDL_GetTicks();
+		GLuint sinceFrame = currentMillis - startMillis;
+		GLuint waitMillis = display.isMinimized() ? IDLE_WAIT_MILLIS :
+			(sinceFrame < millisPerFrame) ? millisPerFrame - sinceFrame : 0;
+		running = eventManager.processEvents(waitMillis);
 
 		/* Get the new number of milliseconds. */
 		currentMillis = SDL_GetTicks();
@@ -133,23 +359,90 @@ int main(int argc, char* argv[])
 		/* If a new frame is to be drawn, update the display. */
 		if ((currentMillis - startMillis) >= millisPerFrame)
 		{
+			/* Advance the system by the elapsed time, scaled by the speeds. */
+			double elapsed = (currentMillis - startMillis) /
+				(double) MILLIS_PER_SECOND * system.getSpeed() * speed;
+			if (replaying)
+			{
+				/* Scrubbing backwards starts the trails afresh. */
+				replayTime = std::min(replayEnd, std::max(replayStart,
+					replayTime + elapsed));
+				if (replayTime < shownTime)
+					trails.clear();
+				shownTime = replayTime;
+				if (fromEphemeris)
+					ephemeris.seek(replayTime, system.getBodies());
+				else
+					replay.seek(replayTime, system.getBodies());
+			}
+			else
+				simulation.advance(elapsed);
+			trails.update(system.getBodies(), system.getScale());
+			if ((currentMillis - reportMillis) >= DRIFT_REPORT_MILLIS)
+			{
+				reportMillis = currentMillis;
+				if (!replaying)
+					simulation.reportDrift();
+				TaskScheduler::get().reportStats();
+				latency.report();
+			}
+
+			/* Pick against the frame on screen: before the input moves the */
+			/* camera, and with the transformations composed by the last    */
+			/* repaint (the rotations set after it wait for the next one).  */
+			glm::ivec2 click;
+			if (eventManager.takeClick(&click))
+			{
+				glm::vec3  origin, direction;
+				PickResult hit;
+				display.getPickRay(click.x, click.y, &origin, &direction);
+				Uint64 pickStart = SDL_GetPerformanceCounter();
+				bool   picked = picker.pick(meshes, origin, direction, &hit);
+				double micros = (SDL_GetPerformanceCounter() - pickStart) *
+					1.0e6 / SDL_GetPerformanceFrequency();
+				if (picked)
+					fprintf(stdout, "Stats: Picked mesh %u triangle %u "
+						"(u %.3f, v %.3f) at %.2f in %.1f us\n", hit.mesh,
+						hit.triangle, hit.barycentric.x, hit.barycentric.y,
+						hit.distance, micros);
+				else
+					fprintf(stdout, "Stats: Picked nothing in %.1f us\n",
+						micros);
+			}
+
+			/* Apply the frame's input to the camera. */
+			eventManager.update((currentMillis - startMillis) /
+				(GLfloat) MILLIS_PER_SECOND);
+
 			startMillis = currentMillis;
-			display.repaint(meshes);
-			for (Mesh* m : meshes)
+			if (!display.isMinimized())
 			{
-				m->rotateModel(t, glm::vec3{ +0.0f, +1.0f, +0.0f });
-				m->revolveModel(t, glm::vec3{ +0.0f, +1.0f, +1.0f });
+				display.repaint(meshes);
+				StartupProfiler::finish();
 			}
+
+			/* Spin every shape and revolve it about the origin. */
+			TransformSystem::get().setAllRotations(t,
+				glm::vec3{ +0.0f, +1.0f, +0.0f });
+			TransformSystem::get().setAllRevolutions(t,
+				glm::vec3{ +0.0f, +1.0f, +1.0f });
 			t += 0.003f;
 		}
-
-		/* Update the temporary millisecond counter. */
-		tempMillis = currentMillis;
-		
-		/* Get the next event. */
-		SDL_PollEvent(&event);
 	}
 
+	/* Checkpoint the simulated system so it can be resumed with --system. */
+	if (checkpointFile != NULL && !replaying)
+		Snapshot::save(checkpointFile, system, assets, simulation.getTime());
+
+	/* Save the latency histograms if asked to. */
+	if (latencyFile != NULL)
+		latency.save(latencyFile);
+
+	/* Finish the trajectory log and free the trails and queries. */
+	recorder.close();
+	trails.cleanUp();
+	latency.cleanUp();
+
 	/* Free the shapes. */
 	for (Mesh* m : meshes)
 	{
@@ -157,7 +450,11 @@ int main(int argc, char* argv[])
 		delete m;
 	}
 
-	/* Quit using SDL. */
+	/* Free the shared assets. */
+	assets.cleanUp();
+
+	/* Join the worker threads and quit using SDL. */
+	TaskScheduler::shutdown();
 	SDL_Quit();
 
 	/* Exit Success. */
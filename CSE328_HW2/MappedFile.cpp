@@ -0,0 +1,184 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "MappedFile.h"
+#include <iostream>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/******************************************************************************
+*                                                                             *
+*                      MappedFile::MappedFile (Constructor)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a closed mapping.                                                  *
+*                                                                             *
+*******************************************************************************/
+MappedFile::MappedFile() :
+	data(NULL), size(0), open_(false), file(NULL), mapping(NULL)
+{
+}
+
+/******************************************************************************
+*                                                                             *
+*                      MappedFile::~MappedFile (Destructor)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Unmaps the file.                                                           *
+*                                                                             *
+*******************************************************************************/
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/******************************************************************************
+*                                                                             *
+*                              MappedFile::open                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the file to be mapped.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was mapped (an empty file maps to NULL with size 0).      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Maps the whole file read-only.                                             *
+*                                                                             *
+*******************************************************************************/
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Error mapping " << filename << ": cannot open file"
+		          << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER length;
+	GetFileSizeEx(handle, &length);
+	file = handle;
+	size = (size_t) length.QuadPart;
+	if (size > 0)
+	{
+		HANDLE map = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0,
+			NULL);
+		void* view = (map != NULL) ?
+			MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (view == NULL)
+		{
+			std::cerr << "Error mapping " << filename << ": cannot map file"
+			          << std::endl;
+			if (map != NULL)
+				CloseHandle(map);
+			CloseHandle(handle);
+			file = NULL;
+			size = 0;
+			return false;
+		}
+		mapping = map;
+		data = (const unsigned char*) view;
+	}
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Error mapping " << filename << ": cannot open file"
+		          << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	fstat(fd, &info);
+	size = (size_t) info.st_size;
+	if (size > 0)
+	{
+		void* view = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			std::cerr << "Error mapping " << filename << ": cannot map file"
+			          << std::endl;
+			::close(fd);
+			size = 0;
+			return false;
+		}
+		data = (const unsigned char*) view;
+	}
+	::close(fd);
+#endif
+
+	open_ = true;
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                              MappedFile::close                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Unmaps the file; pointers into it become invalid.                          *
+*                                                                             *
+*******************************************************************************/
+void MappedFile::close()
+{
+#if defined(_WIN32)
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mapping != NULL)
+		CloseHandle((HANDLE) mapping);
+	if (file != NULL)
+		CloseHandle((HANDLE) file);
+#else
+	if (data != NULL)
+		munmap((void*) data, size);
+#endif
+	data = NULL;
+	size = 0;
+	open_ = false;
+	file = mapping = NULL;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <cstddef>
+
+/******************************************************************************
+*                                                                             *
+*                           MappedFile  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  data, size                                                                 *
+*          The mapped bytes of the file (NULL for an empty file).             *
+*  file, mapping                                                              *
+*          Operating system handles, kept opaque so the header does not pull  *
+*          in windows.h.                                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Read-only memory mapping of a whole file. Pages are read on first touch   *
+*  and shared with the file cache, so large logs and tables can be opened    *
+*  instantly and only the parts used are ever read from disk.                 *
+*                                                                             *
+*******************************************************************************/
+class MappedFile
+{
+public:
+	/* Constructor / destructor. */
+	                     MappedFile();
+	                     ~MappedFile();
+
+	/* Map filename (closing any previous mapping); false on error. */
+	bool                 open(const char* filename);
+	/* Unmap the file. */
+	void                 close();
+
+	/* Getters. */
+	const unsigned char* getData()   const {  return data;           }
+	size_t               getSize()   const {  return size;           }
+	bool                 isOpen()    const {  return open_;          }
+
+private:
+	const unsigned char* data;
+	size_t               size;
+	bool                 open_;
+	void*                file;
+	void*                mapping;
+
+	/* Mappings are not copied. */
+	                     MappedFile(const MappedFile&);
+	MappedFile&          operator=(const MappedFile&);
+};
@@ -0,0 +1,386 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "NormalGenerator.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Corner normals closer than this share a vertex. */
+#define  SAME_NORMAL_EPSILON        1e-4f
+/* Largest vertex count addressable by GLushort indices. */
+#define  MAX_VERTICES               65536
+
+/******************************************************************************
+*                                                                             *
+*                        PositionLess (file static)                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Orders vertex indices by position, x then y then z.                       *
+*                                                                             *
+*******************************************************************************/
+struct PositionLess
+{
+	const std::vector<Vertex>* vertices;
+
+	bool operator()(GLuint a, GLuint b) const
+	{
+		const glm::vec3 &p = (*vertices)[a].position;
+		const glm::vec3 &q = (*vertices)[b].position;
+		if (p.x != q.x)
+			return p.x < q.x;
+		if (p.y != q.y)
+			return p.y < q.y;
+		return p.z < q.z;
+	}
+};
+
+/******************************************************************************
+*                                                                             *
+*                     NormalGenerator::cornerAngles (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param p0, p1, p2                                                          *
+*           Corners of the triangle.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The interior angle at each corner (0 for a degenerate triangle).          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Uses atan2 of the sine and cosine, which stays accurate for angles near  *
+*  0 and pi, where acos of the dot product does not.                          *
+*                                                                             *
+*******************************************************************************/
+glm::vec3 NormalGenerator::cornerAngles(const glm::vec3 &p0,
+                                        const glm::vec3 &p1,
+                                        const glm::vec3 &p2)
+{
+	const glm::vec3 e01 = p1 - p0, e12 = p2 - p1, e20 = p0 - p2;
+	return glm::vec3(
+		atan2f(glm::length(glm::cross(e01, -e20)), glm::dot(e01, -e20)),
+		atan2f(glm::length(glm::cross(e12, -e01)), glm::dot(e12, -e01)),
+		atan2f(glm::length(glm::cross(e20, -e12)), glm::dot(e20, -e12)));
+}
+
+/******************************************************************************
+*                                                                             *
+*                     NormalGenerator::groupCorners (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param keyOf                                                               *
+*           Key of each vertex.                                               *
+*  @param numKeys                                                             *
+*           Number of distinct keys.                                          *
+*  @param indices                                                             *
+*           Three vertices per triangle; corner c is indices[c].              *
+*  @param start, list                                                         *
+*           Destination of the grouping.                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Counting sort of the corners by the key of their vertex.                  *
+*                                                                             *
+*******************************************************************************/
+void NormalGenerator::groupCorners(const std::vector<GLuint>   &keyOf,
+                                   GLuint                       numKeys,
+                                   const std::vector<GLushort> &indices,
+                                   std::vector<GLuint>*         start,
+                                   std::vector<GLuint>*         list)
+{
+	start->assign(numKeys + 1, 0);
+	for (GLuint c = 0; c < indices.size(); c++)
+		(*start)[keyOf[indices[c]] + 1]++;
+	for (GLuint k = 0; k < numKeys; k++)
+		(*start)[k + 1] += (*start)[k];
+
+	std::vector<GLuint> next(start->begin(), start->end() - 1);
+	list->resize(indices.size());
+	for (GLuint c = 0; c < indices.size(); c++)
+		(*list)[next[keyOf[indices[c]]]++] = c;
+}
+
+/******************************************************************************
+*                                                                             *
+*                   NormalGenerator::generateNormals (static)                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertices                                                            *
+*           The vertices; normals are replaced and split vertices appended.  *
+*  @param indices                                                             *
+*           Three vertices per triangle; redirected to split vertices.        *
+*  @param weighting                                                           *
+*           How the faces around a vertex are combined.                       *
+*  @param creaseAngle                                                         *
+*           Largest angle (degrees) between faces smoothed together;          *
+*           NO_CREASE_ANGLE smooths everything. Ignored for flat normals.     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Face normals and corner weights, grouping of the corners by position,   *
+*  normal of each corner from the faces within the crease angle, and then   *
+*  one vertex per distinct normal. Vertices not used by any triangle keep    *
+*  their normals.                                                             *
+*                                                                             *
+*******************************************************************************/
+void NormalGenerator::generateNormals(std::vector<Vertex>*   vertices,
+                                      std::vector<GLushort>* indices,
+                                      NormalWeighting        weighting,
+                                      GLfloat                creaseAngle)
+{
+	const GLuint numTriangles = indices->size() / 3;
+	const GLuint numCorners = 3 * numTriangles;
+	const GLuint numVertices = vertices->size();
+	if (numTriangles == 0)
+		return;
+	const Vertex* v = &(*vertices)[0];
+	const GLushort* index = &(*indices)[0];
+
+	/* Unit face normals and the weight of each corner. */
+	std::vector<glm::vec3> faceNormals(numTriangles);
+	std::vector<GLfloat>   weights(numCorners);
+	Parallel::forRange(0, numTriangles, NORMAL_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint t = lo; t < hi; t++)
+		{
+			const glm::vec3 &p0 = v[index[3 * t + 0]].position;
+			const glm::vec3 &p1 = v[index[3 * t + 1]].position;
+			const glm::vec3 &p2 = v[index[3 * t + 2]].position;
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			GLfloat area = glm::length(n);
+			faceNormals[t] = (area > 0.0f) ? n / area : glm::vec3();
+
+			glm::vec3 w(1.0f);
+			if (weighting == NORMALS_AREA_WEIGHTED)
+				w = glm::vec3(area);
+			else if (weighting == NORMALS_ANGLE_WEIGHTED)
+				w = cornerAngles(p0, p1, p2);
+			weights[3 * t + 0] = w.x;
+			weights[3 * t + 1] = w.y;
+			weights[3 * t + 2] = w.z;
+		}
+	});
+
+	/* Number the distinct positions and group the corners by them. */
+	std::vector<GLuint> order(numVertices), positionOf(numVertices);
+	for (GLuint i = 0; i < numVertices; i++)
+		order[i] = i;
+	PositionLess less = { vertices };
+	std::sort(order.begin(), order.end(), less);
+	GLuint numPositions = 0;
+	for (GLuint i = 0; i < numVertices; i++)
+	{
+		if (i > 0 && less(order[i - 1], order[i]))
+			numPositions++;
+		positionOf[order[i]] = numPositions;
+	}
+	numPositions++;
+	std::vector<GLuint> start, corners;
+	groupCorners(positionOf, numPositions, *indices, &start, &corners);
+
+	/* Normal of each corner from the faces around its position. */
+	const GLfloat cosCrease = cosf(glm::radians(std::min(creaseAngle,
+		NO_CREASE_ANGLE)));
+	std::vector<glm::vec3> cornerNormals(numCorners);
+	Parallel::forRange(0, numPositions, NORMAL_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint p = lo; p < hi; p++)
+		{
+			for (GLuint i = start[p]; i < start[p + 1]; i++)
+			{
+				const GLuint c = corners[i];
+				const glm::vec3 &face = faceNormals[c / 3];
+				if (weighting == NORMALS_FLAT)
+				{
+					cornerNormals[c] = face;
+					continue;
+				}
+
+				/* A degenerate face has no side; it takes every face. */
+				const bool degenerate = (face == glm::vec3());
+				glm::vec3 sum;
+				for (GLuint j = start[p]; j < start[p + 1]; j++)
+				{
+					const glm::vec3 &other = faceNormals[corners[j] / 3];
+					if (degenerate || glm::dot(face, other) >= cosCrease)
+						sum += weights[corners[j]] * other;
+				}
+				GLfloat length = glm::length(sum);
+				cornerNormals[c] = (length > 0.0f) ? sum / length : face;
+			}
+		}
+	});
+
+	/* One vertex per distinct normal; copies of a vertex are chained. */
+	std::vector<GLuint> nextCopy(numVertices, (GLuint) -1);
+	std::vector<unsigned char> assigned(numVertices, 0);
+	bool overflow = false;
+	for (GLuint c = 0; c < numCorners; c++)
+	{
+		GLuint u = (*indices)[c];
+		const glm::vec3 &n = cornerNormals[c];
+		if (!assigned[u])
+		{
+			(*vertices)[u].normal = n;
+			assigned[u] = 1;
+			continue;
+		}
+
+		/* Reuse the vertex or a copy with this normal, else copy. */
+		GLuint last = u;
+		for (; u != (GLuint) -1; last = u, u = nextCopy[u])
+			if (glm::length((*vertices)[u].normal - n) < SAME_NORMAL_EPSILON)
+				break;
+		if (u == (GLuint) -1)
+		{
+			if (vertices->size() >= MAX_VERTICES)
+			{
+				overflow = true;
+				continue;
+			}
+			u = vertices->size();
+			Vertex copy = (*vertices)[last];
+			copy.normal = n;
+			vertices->push_back(copy);
+			nextCopy.push_back((GLuint) -1);
+			nextCopy[last] = u;
+		}
+		(*indices)[c] = (GLushort) u;
+	}
+	if (overflow)
+		std::cerr << "Error generating normals: more than " << MAX_VERTICES
+		          << " vertices needed, some creases are smoothed"
+		          << std::endl;
+}
+
+/******************************************************************************
+*                                                                             *
+*                  NormalGenerator::generateTangents (static)                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertices                                                            *
+*           The vertices, with normals and texture coordinates.               *
+*  @param indices                                                             *
+*           Three vertices per triangle.                                      *
+*  @param tangents                                                            *
+*           Destination of one tangent per vertex.                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Each corner gets the directions of increasing u and v over its face,    *
+*  projected onto the plane of its vertex normal and normalized. A vertex   *
+*  sums those of its corners weighted by angle; w is the sign of the        *
+*  summed bitangent against cross(n, t). Vertices without texture space     *
+*  (no triangles, or degenerate texture coordinates) get any tangent        *
+*  perpendicular to the normal, with w = 1.                                  *
+*                                                                             *
+*******************************************************************************/
+void NormalGenerator::generateTangents(const std::vector<Vertex>   &vertices,
+                                       const std::vector<GLushort> &indices,
+                                       std::vector<glm::vec4>*      tangents)
+{
+	const GLuint numTriangles = indices.size() / 3;
+	const GLuint numVertices = vertices.size();
+	tangents->assign(numVertices, glm::vec4());
+	if (numVertices == 0)
+		return;
+
+	/* Texture space directions (weighted) at every corner. */
+	std::vector<glm::vec3> cornerT(3 * numTriangles), cornerB(3 * numTriangles);
+	Parallel::forRange(0, numTriangles, NORMAL_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint t = lo; t < hi; t++)
+		{
+			const Vertex* corner[3] = { &vertices[indices[3 * t + 0]],
+				&vertices[indices[3 * t + 1]], &vertices[indices[3 * t + 2]] };
+			const glm::vec3 dp1 = corner[1]->position - corner[0]->position;
+			const glm::vec3 dp2 = corner[2]->position - corner[0]->position;
+			const glm::vec2 duv1 = corner[1]->textureCoordinate -
+				corner[0]->textureCoordinate;
+			const glm::vec2 duv2 = corner[2]->textureCoordinate -
+				corner[0]->textureCoordinate;
+			const GLfloat det = duv1.x * duv2.y - duv2.x * duv1.y;
+			glm::vec3 s, r;
+			if (det != 0.0f)
+			{
+				s = (dp1 * duv2.y - dp2 * duv1.y) / det;
+				r = (dp2 * duv1.x - dp1 * duv2.x) / det;
+			}
+
+			const glm::vec3 angles = cornerAngles(corner[0]->position,
+				corner[1]->position, corner[2]->position);
+			for (GLuint k = 0; k < 3; k++)
+			{
+				const glm::vec3 &n = corner[k]->normal;
+				glm::vec3 ts = s - n * glm::dot(n, s);
+				glm::vec3 tr = r - n * glm::dot(n, r);
+				GLfloat ls = glm::length(ts), lr = glm::length(tr);
+				cornerT[3 * t + k] = (ls > 0.0f) ? ts * (angles[k] / ls) :
+					glm::vec3();
+				cornerB[3 * t + k] = (lr > 0.0f) ? tr * (angles[k] / lr) :
+					glm::vec3();
+			}
+		}
+	});
+
+	/* Sum by vertex. */
+	std::vector<GLuint> identity(numVertices), start, corners;
+	for (GLuint i = 0; i < numVertices; i++)
+		identity[i] = i;
+	groupCorners(identity, numVertices, indices, &start, &corners);
+	Parallel::forRange(0, numVertices, NORMAL_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint u = lo; u < hi; u++)
+		{
+			glm::vec3 t, b;
+			for (GLuint i = start[u]; i < start[u + 1]; i++)
+			{
+				t += cornerT[corners[i]];
+				b += cornerB[corners[i]];
+			}
+
+			const glm::vec3 &n = vertices[u].normal;
+			GLfloat length = glm::length(t);
+			if (length > 0.0f)
+				t /= length;
+			else
+			{
+				/* Any direction perpendicular to the normal. */
+				t = (fabsf(n.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) :
+					glm::vec3(0.0f, 1.0f, 0.0f);
+				t = t - n * glm::dot(n, t);
+				length = glm::length(t);
+				t = (length > 0.0f) ? t / length : glm::vec3(1.0f, 0.0f, 0.0f);
+			}
+			GLfloat w = (glm::dot(glm::cross(n, t), b) < 0.0f) ? -1.0f : 1.0f;
+			(*tangents)[u] = glm::vec4(t, w);
+		}
+	});
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+#include <vector>
+#include "Geometry.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Faces meeting at a larger angle (degrees) keep separate normals. */
+#define  DEFAULT_CREASE_ANGLE       60.0f
+/* Crease angle which smooths across every edge. */
+#define  NO_CREASE_ANGLE            180.0f
+/* Triangles (or vertices) per task. */
+#define  NORMAL_GRAIN               4096
+
+/******************************************************************************
+*                                                                             *
+*                         NormalWeighting  (enum)                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  How the faces around a vertex contribute to its normal: flat shading     *
+*  (the face's own normal), by face area, or by the angle of the face at    *
+*  the vertex (independent of how the surface is triangulated).              *
+*                                                                             *
+*******************************************************************************/
+enum NormalWeighting
+{
+	NORMALS_FLAT,
+	NORMALS_AREA_WEIGHTED,
+	NORMALS_ANGLE_WEIGHTED
+};
+
+/******************************************************************************
+*                                                                             *
+*                         NormalGenerator  (class)                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to compute the normals and tangents *
+*  of indexed triangle meshes, for generators and files which do not        *
+*  provide them. Face normals follow the winding (counter-clockwise seen    *
+*  from the front).                                                           *
+*                                                                             *
+*  Vertices at the same position are smoothed together even when they are  *
+*  separate vertices (for colors or texture seams). Each corner then sums   *
+*  the weighted normals of the corners at its position whose face lies      *
+*  within the crease angle of its own, so a hard edge stays hard. A vertex  *
+*  whose corners end up with different normals is split, the copies         *
+*  appended (up to the 16-bit index limit).                                   *
+*                                                                             *
+*  The work runs in parallel without atomics: faces and corner weights by   *
+*  triangle, corner normals by position (each corner belongs to exactly one *
+*  position), tangents by vertex. Only building the adjacency and splitting *
+*  are serial, both linear in the number of corners.                         *
+*                                                                             *
+*  Tangents follow the MikkTSpace conventions: per-corner texture space      *
+*  derivatives projected onto the plane of the vertex normal, weighted by    *
+*  corner angle, with the bitangent sign in w (bitangent = w cross(n, t)).   *
+*                                                                             *
+*******************************************************************************/
+class NormalGenerator
+{
+public:
+	/* Replace the normals, splitting vertices at creases. */
+	static void      generateNormals(std::vector<Vertex>*   vertices,
+	                                 std::vector<GLushort>* indices,
+	                                 NormalWeighting        weighting,
+	                                 GLfloat creaseAngle = DEFAULT_CREASE_ANGLE);
+	/* Compute a tangent (xyz) and bitangent sign (w) for every vertex. */
+	static void      generateTangents(const std::vector<Vertex>   &vertices,
+	                                  const std::vector<GLushort> &indices,
+	                                  std::vector<glm::vec4>*      tangents);
+
+private:
+	/* Corners grouped by key (CSR): corners of key k are */
+	/* list[start[k]] .. list[start[k + 1] - 1].          */
+	static void      groupCorners(const std::vector<GLuint>   &keyOf,
+	                              GLuint                       numKeys,
+	                              const std::vector<GLushort> &indices,
+	                              std::vector<GLuint>*         start,
+	                              std::vector<GLuint>*         list);
+	/* Angles of a triangle at its three corners. */
+	static glm::vec3 cornerAngles(const glm::vec3 &p0, const glm::vec3 &p1,
+	                              const glm::vec3 &p2);
+};
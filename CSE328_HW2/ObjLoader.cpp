@@ -0,0 +1,403 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "ObjLoader.h"
+#include "Parallel.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Bits per index in the deduplication key. */
+#define KEY_BITS    21
+
+/******************************************************************************
+*                                                                             *
+*                                 isBlank                                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param c                                                                   *
+*           Character to test.                                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True for the characters separating tokens on a line.                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Spaces, tabs and the carriage return of CRLF files.                        *
+*                                                                             *
+*******************************************************************************/
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/******************************************************************************
+*                                                                             *
+*                                readFloats                                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param p                                                                   *
+*           Start of the numbers.                                             *
+*  @param end                                                                 *
+*           End of the line.                                                  *
+*  @param count                                                               *
+*           Number of values to read.                                         *
+*  @param values                                                              *
+*           Array the values are appended to.                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Appends exactly count values, using 0 for any missing from the line, so   *
+*  a short line cannot shift the following vertices.                          *
+*                                                                             *
+*******************************************************************************/
+static void readFloats(const char* p, const char* end, GLuint count,
+                       std::vector<GLfloat> &values)
+{
+	for (GLuint i = 0; i < count; i++)
+	{
+		while (p < end && isBlank(*p))
+			p++;
+
+		GLfloat value = 0.0f;
+		if (p < end)
+		{
+			char* next;
+			value = strtof(p, &next);
+			p = next;
+		}
+		values.push_back(value);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        ObjLoader::parseCorner (static)                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param p                                                                   *
+*           Start of the corner.                                              *
+*  @param counts                                                              *
+*           Positions, texture coordinates and normals read so far in the     *
+*           chunk, for relative (negative) indices.                           *
+*  @param corner                                                              *
+*           Destination of the indices.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The first character after the corner.                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  A relative index is stored relative to the start of the chunk (and may   *
+*  be zero or negative, pointing into an earlier chunk) and flagged, to be   *
+*  offset by the number of elements before the chunk once that is known.     *
+*                                                                             *
+*******************************************************************************/
+const char* ObjLoader::parseCorner(const char* p, const GLuint counts[3],
+                                   Corner &corner)
+{
+	corner.index[0] = corner.index[1] = corner.index[2] = 0;
+	corner.relative = 0;
+
+	for (GLuint k = 0; k < 3; k++)
+	{
+		if ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+')
+		{
+			char* next;
+			long value = strtol(p, &next, 10);
+			p = next;
+			if (value < 0)
+			{
+				corner.index[k] = (int) (counts[k] + value + 1);
+				corner.relative |= 1 << k;
+			}
+			else
+				corner.index[k] = (int) value;
+		}
+		if (*p != '/')
+			break;
+		p++;
+	}
+	return p;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        ObjLoader::parseChunk (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param chunk                                                               *
+*           The chunk to be parsed; begin and end must be line-aligned.       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads the v, vt, vn and f lines of the chunk and records where group and  *
+*  object lines fall between its faces. Faces with fewer than three corners  *
+*  and every other statement are skipped.                                     *
+*                                                                             *
+*******************************************************************************/
+void ObjLoader::parseChunk(Chunk &chunk)
+{
+	const char* p = chunk.begin;
+	while (p < chunk.end)
+	{
+		/* Find the line. */
+		const char* line = (const char*) memchr(p, '\n', chunk.end - p);
+		const char* end = (line != NULL) ? line : chunk.end;
+		while (p < end && isBlank(*p))
+			p++;
+
+		/* Vertex data. */
+		if (end - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+			readFloats(p + 2, end, 3, chunk.positions);
+		else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+			readFloats(p + 3, end, 2, chunk.texcoords);
+		else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+			readFloats(p + 3, end, 3, chunk.normals);
+
+		/* Face. */
+		else if (end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+		{
+			GLuint counts[3] = { (GLuint) chunk.positions.size() / 3,
+				(GLuint) chunk.texcoords.size() / 2,
+				(GLuint) chunk.normals.size() / 3 };
+			GLuint size = 0;
+			p++;
+			for (;;)
+			{
+				while (p < end && isBlank(*p))
+					p++;
+				if (p >= end)
+					break;
+
+				Corner corner;
+				const char* next = parseCorner(p, counts, corner);
+				if (next == p ||
+					(corner.index[0] == 0 && !(corner.relative & 1)))
+					break;
+				chunk.corners.push_back(corner);
+				size++;
+				p = next;
+			}
+
+			if (size >= 3)
+				chunk.faceSizes.push_back(size);
+			else
+				chunk.corners.resize(chunk.corners.size() - size);
+		}
+
+		/* Group or object: ends the first shape. */
+		else if (end - p >= 1 && (p[0] == 'g' || p[0] == 'o') &&
+			(end - p == 1 || isBlank(p[1])))
+			chunk.breaks.push_back(chunk.faceSizes.size());
+
+		p = end + 1;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           ObjLoader::load (static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the OBJ file.                                             *
+*  @param mesh                                                                *
+*           Destination of the first shape of the file.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True on success, false if the file could not be read, has no faces or    *
+*  refers to elements it does not define.                                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Splits the file into chunks ending at line breaks, parses them in         *
+*  parallel, and then walks the faces of the first shape in file order,      *
+*  fan-triangulating polygons and creating one vertex per distinct corner.   *
+*                                                                             *
+*******************************************************************************/
+bool ObjLoader::load(const char* filename, ObjMesh* mesh)
+{
+	/* Read the whole file. */
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "Error loading obj: cannot open " << filename
+		          << std::endl;
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	std::string text((size_t) file.tellg(), '\0');
+	file.seekg(0, std::ios::beg);
+	file.read(&text[0], text.size());
+
+	/* Split it into line-aligned chunks. */
+	std::vector<Chunk> chunks;
+	const char* p = text.data();
+	const char* end = p + text.size();
+	while (p < end)
+	{
+		const char* q = (end - p > OBJ_CHUNK_SIZE) ? p + OBJ_CHUNK_SIZE : end;
+		const char* line = (const char*) memchr(q, '\n', end - q);
+		q = (line != NULL) ? line + 1 : end;
+
+		chunks.push_back(Chunk());
+		chunks.back().begin = p;
+		chunks.back().end = q;
+		p = q;
+	}
+
+	/* Parse the chunks. */
+	Parallel::forRange(0, chunks.size(), 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint c = lo; c < hi; c++)
+			parseChunk(chunks[c]);
+	});
+
+	/* Join the vertex data and find where the first shape ends. */
+	std::vector<GLfloat> positions, texcoords, normals;
+	GLuint faces = 0, lastFace = (GLuint) -1;
+	for (const Chunk &chunk : chunks)
+	{
+		positions.insert(positions.end(), chunk.positions.begin(),
+			chunk.positions.end());
+		texcoords.insert(texcoords.end(), chunk.texcoords.begin(),
+			chunk.texcoords.end());
+		normals.insert(normals.end(), chunk.normals.begin(),
+			chunk.normals.end());
+		for (GLuint b : chunk.breaks)
+		{
+			if (lastFace == (GLuint) -1 && faces + b > 0)
+				lastFace = faces + b;
+		}
+		faces += chunk.faceSizes.size();
+	}
+	if (lastFace > faces)
+		lastFace = faces;
+	if (lastFace == 0)
+	{
+		std::cerr << "Error loading obj: no faces in " << filename << std::endl;
+		return false;
+	}
+
+	const GLuint totals[3] = { (GLuint) positions.size() / 3,
+		(GLuint) texcoords.size() / 2, (GLuint) normals.size() / 3 };
+	if (totals[0] >= (1u << KEY_BITS) || totals[1] >= (1u << KEY_BITS) ||
+		totals[2] >= (1u << KEY_BITS))
+	{
+		std::cerr << "Error loading obj: too many vertices in " << filename
+		          << std::endl;
+		return false;
+	}
+
+	/* Triangulate and deduplicate the corners of the first shape. */
+	std::unordered_map<unsigned long long, GLuint> cache;
+	mesh->positions.clear();
+	mesh->normals.clear();
+	mesh->texcoords.clear();
+	mesh->indices.clear();
+	mesh->hasNormals = mesh->hasTexcoords = true;
+
+	std::vector<GLuint> vertex;
+	GLuint base[3] = { 0, 0, 0 };
+	GLuint face = 0;
+	for (GLuint c = 0; c < chunks.size() && face < lastFace; c++)
+	{
+		const Chunk &chunk = chunks[c];
+		GLuint first = 0;
+		for (GLuint f = 0; f < chunk.faceSizes.size() && face < lastFace;
+			f++, face++)
+		{
+			/* Resolve the corners of the face to vertices. */
+			GLuint size = chunk.faceSizes[f];
+			vertex.clear();
+			for (GLuint k = 0; k < size; k++)
+			{
+				const Corner &corner = chunk.corners[first + k];
+				GLuint index[3];
+				for (GLuint e = 0; e < 3; e++)
+				{
+					int value = corner.index[e];
+					if (corner.relative & (1 << e))
+						value += base[e];
+					else if (value == 0)
+					{
+						index[e] = 0;
+						continue;
+					}
+					if (value < 1 || (GLuint) value > totals[e])
+					{
+						std::cerr << "Error loading obj: index out of range in "
+						          << filename << std::endl;
+						return false;
+					}
+					index[e] = value;
+				}
+
+				unsigned long long key = index[0] |
+					((unsigned long long) index[1] << KEY_BITS) |
+					((unsigned long long) index[2] << (2 * KEY_BITS));
+				auto found = cache.find(key);
+				if (found == cache.end())
+				{
+					GLuint v = index[0] - 1, t = index[1] - 1, n = index[2] - 1;
+					mesh->positions.push_back(positions[3 * v + 0]);
+					mesh->positions.push_back(positions[3 * v + 1]);
+					mesh->positions.push_back(positions[3 * v + 2]);
+					for (GLuint d = 0; d < 3; d++)
+						mesh->normals.push_back((index[2] != 0) ?
+							normals[3 * n + d] : 0.0f);
+					for (GLuint d = 0; d < 2; d++)
+						mesh->texcoords.push_back((index[1] != 0) ?
+							texcoords[2 * t + d] : 0.0f);
+					mesh->hasNormals &= (index[2] != 0);
+					mesh->hasTexcoords &= (index[1] != 0);
+
+					found = cache.insert(std::make_pair(key,
+						(GLuint) cache.size())).first;
+				}
+				vertex.push_back(found->second);
+			}
+			first += size;
+
+			/* Fan. */
+			for (GLuint k = 1; k + 1 < vertex.size(); k++)
+			{
+				mesh->indices.push_back(vertex[0]);
+				mesh->indices.push_back(vertex[k]);
+				mesh->indices.push_back(vertex[k + 1]);
+			}
+		}
+
+		base[0] += chunk.positions.size() / 3;
+		base[1] += chunk.texcoords.size() / 2;
+		base[2] += chunk.normals.size() / 3;
+	}
+	return true;
+}
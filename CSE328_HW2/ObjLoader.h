@@ -0,0 +1,100 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Approximate number of bytes of an OBJ file parsed by one task. */
+#define  OBJ_CHUNK_SIZE             (64 * 1024)
+
+/******************************************************************************
+*                                                                             *
+*                             ObjMesh  (struct)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  positions                                                                  *
+*          x, y, z of each vertex.                                            *
+*  normals                                                                    *
+*          x, y, z of the normal of each vertex (zero if the file has none).  *
+*  texcoords                                                                  *
+*          u, v of each vertex (zero if the file has none).                   *
+*  indices                                                                    *
+*          Three vertices per triangle.                                       *
+*  hasNormals, hasTexcoords                                                   *
+*          Whether every vertex had a normal / texture coordinate in the file.*
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Indexed triangle mesh read from an OBJ file. Each distinct combination of *
+*  position, texture coordinate and normal indices becomes one vertex.       *
+*                                                                             *
+*******************************************************************************/
+struct ObjMesh
+{
+	std::vector<GLfloat> positions;
+	std::vector<GLfloat> normals;
+	std::vector<GLfloat> texcoords;
+	std::vector<GLuint>  indices;
+	bool                 hasNormals;
+	bool                 hasTexcoords;
+
+	ObjMesh() : hasNormals(false), hasTexcoords(false) {}
+};
+
+/******************************************************************************
+*                                                                             *
+*                            ObjLoader  (class)                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to load the first shape of an OBJ     *
+*  file. The file is read whole and split into line-aligned chunks which are *
+*  parsed in parallel on the task scheduler; the per-chunk counts are then   *
+*  summed so relative indices resolve as if the file was read in one pass,  *
+*  and the faces are triangulated and deduplicated serially. As the loader  *
+*  it replaces, only faces up to the first group or object after a face are *
+*  kept, and materials are ignored.                                           *
+*                                                                             *
+*******************************************************************************/
+class ObjLoader
+{
+public:
+	/* Load the first shape of filename; false (with a message) on error. */
+	static bool      load(const char* filename, ObjMesh* mesh);
+
+private:
+	/* Indices of one face corner (1-based; 0 if absent). */
+	struct Corner
+	{
+		int              index[3];
+		unsigned char    relative;
+	};
+	/* Everything parsed from one chunk. */
+	struct Chunk
+	{
+		const char*          begin;
+		const char*          end;
+		std::vector<GLfloat> positions, normals, texcoords;
+		std::vector<Corner>  corners;
+		std::vector<GLuint>  faceSizes;
+		std::vector<GLuint>  breaks;
+	};
+
+	/* Parse the lines of a chunk. */
+	static void      parseChunk(Chunk &chunk);
+	/* Parse one v, v/t, v//n or v/t/n face corner. */
+	static const char* parseCorner(const char* p, const GLuint counts[3],
+	                               Corner &corner);
+};
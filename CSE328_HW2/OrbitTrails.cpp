@@ -0,0 +1,272 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "OrbitTrails.h"
+#include <algorithm>
+#include "Parallel.h"
+#include "TaskScheduler.h"
+
+/******************************************************************************
+*                                                                             *
+*                    OrbitTrails::OrbitTrails (Constructor)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param length                                                              *
+*           Number of samples kept per body.                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates empty trails. The buffers are created on the first update and the *
+*  program on the first draw, so no GL state changes here.                   *
+*                                                                             *
+*******************************************************************************/
+OrbitTrails::OrbitTrails(GLuint length) :
+	length(std::max(length, 2u)), bodies(0), head(0), filled(0),
+	vertexArrayID(0), shader(NULL)
+{
+	bufferIDs[0] = bufferIDs[1] = 0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                    OrbitTrails::~OrbitTrails (Destructor)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Frees the buffers and the program (if cleanUp was not called already).    *
+*                                                                             *
+*******************************************************************************/
+OrbitTrails::~OrbitTrails()
+{
+	cleanUp();
+}
+
+/******************************************************************************
+*                                                                             *
+*                           OrbitTrails::allocate                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param n                                                                   *
+*           Number of bodies.                                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the sample buffer (length + 1 rows of n positions, left          *
+*  undefined) and the index buffer listing the rows of each body in turn,    *
+*  and empties the ring.                                                     *
+*                                                                             *
+*******************************************************************************/
+void OrbitTrails::allocate(GLuint n)
+{
+	if (vertexArrayID == 0)
+	{
+		glGenVertexArrays(1, &vertexArrayID);
+		glGenBuffers(2, bufferIDs);
+	}
+	bodies = n;
+	head = filled = 0;
+	counts.assign(2 * n, 0);
+	offsets.assign(2 * n, (const GLvoid*) NULL);
+
+	/* Index of row r of body b is r * n + b. */
+	const GLuint rows = length + 1;
+	std::vector<GLuint> indices((size_t) rows * n);
+	Parallel::forRange(0, n, TRAIL_SAMPLE_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint b = lo; b < hi; b++)
+			for (GLuint r = 0; r < rows; r++)
+				indices[(size_t) b * rows + r] = r * n + b;
+	});
+
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferIDs[0]);
+	glBufferData(GL_ARRAY_BUFFER, (size_t) rows * n * 3 * sizeof(GLfloat),
+		NULL, GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferIDs[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+		indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
+/******************************************************************************
+*                                                                             *
+*                            OrbitTrails::update                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies, at the time of the new sample.                        *
+*  @param scale                                                               *
+*           Meters per world unit.                                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Advances the head and sends the positions of every body to its row, in   *
+*  one glBufferSubData (two when the head is row 0, which is mirrored at the *
+*  end of the ring). A change in the number of bodies starts new trails.     *
+*                                                                             *
+*******************************************************************************/
+void OrbitTrails::update(const BodyArrays &bodies, double scale)
+{
+	const GLuint n = bodies.count;
+	if (n == 0)
+		return;
+	if (n != this->bodies || vertexArrayID == 0)
+		allocate(n);
+	head = (filled == 0) ? 0 : (head + 1) % length;
+	filled = std::min(filled + 1, length);
+
+	/* Convert the positions to world units in scratch memory. */
+	ScratchArena &scratch = TaskScheduler::get().getScratch();
+	ScratchArena::Mark mark = scratch.getMark();
+	GLfloat* row = scratch.allocate<GLfloat>(3 * n);
+	const double inverseScale = 1.0 / scale;
+	Parallel::forRange(0, n, TRAIL_SAMPLE_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			row[3 * i + 0] = (GLfloat) (bodies.px[i] * inverseScale);
+			row[3 * i + 1] = (GLfloat) (bodies.py[i] * inverseScale);
+			row[3 * i + 2] = (GLfloat) (bodies.pz[i] * inverseScale);
+		}
+	});
+
+	/* Send only the new row. */
+	const GLsizeiptr rowBytes = 3 * n * sizeof(GLfloat);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferIDs[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, head * rowBytes, rowBytes, row);
+	if (head == 0)
+		glBufferSubData(GL_ARRAY_BUFFER, length * rowBytes, rowBytes, row);
+	scratch.release(mark);
+}
+
+/******************************************************************************
+*                                                                             *
+*                             OrbitTrails::draw                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param worldToProjection                                                   *
+*           World to projection transformation of the camera.                 *
+*  @param color                                                               *
+*           Color of the newest samples; older samples fade out.              *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Draws every trail as line strips in a single glMultiDrawElements: for    *
+*  each body the strip from the oldest row to the end of the ring (once it  *
+*  has wrapped), then the strip from row 0 to the head. Trails are blended   *
+*  without writing depth, and leave the trail program in use.               *
+*                                                                             *
+*******************************************************************************/
+void OrbitTrails::draw(const glm::mat4 &worldToProjection,
+                       const glm::vec4 &color)
+{
+	if (filled < 2)
+		return;
+
+	/* Build the program on first use. */
+	if (shader == NULL)
+	{
+		shader = new Shader(TRAIL_VERTEX_SHADER, TRAIL_FRAGMENT_SHADER);
+		worldToProjectionUniform = shader->getUniformIndex(
+			"worldToProjectionMatrix");
+		colorUniform = shader->getUniformIndex("trailColor");
+		headUniform = shader->getUniformIndex("trailHead");
+		lengthUniform = shader->getUniformIndex("trailLength");
+		bodiesUniform = shader->getUniformIndex("trailBodies");
+	}
+
+	/* Two strips per body: head + 1 .. length, then 0 .. head. */
+	const GLuint rows = length + 1;
+	const GLsizei olderCount = (filled == length) ? length - head : 0;
+	for (GLuint b = 0; b < bodies; b++)
+	{
+		const size_t base = (size_t) b * rows;
+		counts[2 * b + 0] = olderCount;
+		offsets[2 * b + 0] = (const GLvoid*) ((base + head + 1) *
+			sizeof(GLuint));
+		counts[2 * b + 1] = head + 1;
+		offsets[2 * b + 1] = (const GLvoid*) (base * sizeof(GLuint));
+	}
+
+	shader->use();
+	shader->setUniform(worldToProjectionUniform, worldToProjection);
+	shader->setUniform(colorUniform, color);
+	shader->setUniform(headUniform, (GLint) head);
+	shader->setUniform(lengthUniform, (GLint) length);
+	shader->setUniform(bodiesUniform, (GLint) bodies);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(vertexArrayID);
+	glMultiDrawElements(GL_LINE_STRIP, counts.data(), GL_UNSIGNED_INT,
+		offsets.data(), 2 * bodies);
+	glBindVertexArray(0);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
+
+/******************************************************************************
+*                                                                             *
+*                            OrbitTrails::cleanUp                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Deletes the buffers and the program. Must be called while the GL context *
+*  still exists; calling it again does nothing.                              *
+*                                                                             *
+*******************************************************************************/
+void OrbitTrails::cleanUp()
+{
+	if (vertexArrayID != 0)
+	{
+		glDeleteBuffers(2, bufferIDs);
+		glDeleteVertexArrays(1, &vertexArrayID);
+		bufferIDs[0] = bufferIDs[1] = vertexArrayID = 0;
+	}
+	if (shader != NULL)
+		glDeleteProgram(shader->getProgram());
+	delete shader;
+	shader = NULL;
+	bodies = head = filled = 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+#include <vector>
+#include "OrbitalSystem.h"
+#include "Shader.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Samples kept per body. */
+#define  DEFAULT_TRAIL_LENGTH       256
+/* Trail vertex and fragment shader source files. */
+#define  TRAIL_VERTEX_SHADER        "res/shaders/trail.vs"
+#define  TRAIL_FRAGMENT_SHADER      "res/shaders/trail.fs"
+/* Bodies per task when converting the newest samples. */
+#define  TRAIL_SAMPLE_GRAIN         4096
+
+/******************************************************************************
+*                                                                             *
+*                          OrbitTrails  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  length                                                                     *
+*          Samples kept per body.                                             *
+*  bodies                                                                     *
+*          Number of bodies the buffers were created for.                     *
+*  head                                                                       *
+*          Row holding the newest samples.                                    *
+*  filled                                                                     *
+*          Rows holding samples (length once the ring has wrapped).           *
+*  vertexArrayID, bufferIDs                                                   *
+*          Vertex array, and the sample (0) and index (1) buffers.            *
+*  counts, offsets                                                            *
+*          Arguments of the multi-draw: two strips per body.                  *
+*  shader                                                                     *
+*          Program drawing the trails, and its uniform indices.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Orbit trails of every body, kept in a ring buffer on the GPU. The sample  *
+*  buffer is laid out by row: row r holds the position of every body at one  *
+*  sample time, so each frame's new samples are a single contiguous range    *
+*  sent with one glBufferSubData, and nothing older is ever sent again. A    *
+*  static index buffer walks the rows of each body in order. The ring has    *
+*  one extra row mirroring row 0, so the strip from the oldest sample up to  *
+*  the end of the ring ends exactly where the strip from row 0 to the head   *
+*  begins; all trails are then drawn with one glMultiDrawElements of two     *
+*  strips per body. The shader fades each vertex by the age of its row.      *
+*                                                                             *
+*******************************************************************************/
+class OrbitTrails
+{
+public:
+	/* Constructor / destructor (which frees the buffers). */
+	                 OrbitTrails(GLuint length = DEFAULT_TRAIL_LENGTH);
+	                 ~OrbitTrails();
+
+	/* Append the current positions, in world units, as the newest samples. */
+	void             update(const BodyArrays &bodies, double scale);
+	/* Forget every sample (after a jump in time). */
+	void             clear()                    {  filled = 0;          }
+	/* Draw the trails; the caller's program must be used again after. */
+	void             draw(const glm::mat4 &worldToProjection,
+	                      const glm::vec4 &color);
+
+	/* Free the GL objects. */
+	void             cleanUp();
+
+private:
+	GLuint                   length;
+	GLuint                   bodies;
+	GLuint                   head;
+	GLuint                   filled;
+	GLuint                   vertexArrayID;
+	GLuint                   bufferIDs[2];
+	std::vector<GLsizei>     counts;
+	std::vector<const GLvoid*> offsets;
+	Shader*                  shader;
+	GLint                    worldToProjectionUniform;
+	GLint                    colorUniform;
+	GLint                    headUniform;
+	GLint                    lengthUniform;
+	GLint                    bodiesUniform;
+
+	/* (Re)create the buffers for n bodies. */
+	void             allocate(GLuint n);
+};
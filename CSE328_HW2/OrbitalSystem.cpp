@@ -0,0 +1,664 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "OrbitalSystem.h"
+#include "MappedFile.h"
+#include "tinyxml2.h"
+#include <algorithm>
+#include <iostream>
+
+/******************************************************************************
+*                                                                             *
+*                            nextChild (file static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param parser                                                              *
+*           Parser positioned inside an element.                              *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True at the start of the next child element, false at the end of the      *
+*  element (or on error).                                                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Steps over the text between child elements such as the <body>s of        *
+*  <bodies>.                                                                  *
+*                                                                             *
+*******************************************************************************/
+static bool nextChild(tinyxml2::XMLPullParser &parser)
+{
+	tinyxml2::XMLPullEvent event;
+	while ((event = parser.Next()) == tinyxml2::XML_TEXT)
+		;
+	return event == tinyxml2::XML_START_ELEMENT;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            readDouble (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param parser                                                              *
+*           Parser at the start of the element to be read.                    *
+*  @param value                                                               *
+*           Destination, left unchanged if the text is not a number.          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads a numeric element such as <mass>5.972e24</mass>.                     *
+*                                                                             *
+*******************************************************************************/
+static void readDouble(tinyxml2::XMLPullParser &parser, double &value)
+{
+	const char* text = parser.ReadElementText();
+	if (text != NULL)
+		tinyxml2::XMLUtil::ToDouble(text, &value);
+}
+
+/******************************************************************************
+*                                                                             *
+*                            readString (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param parser                                                              *
+*           Parser at the start of the element to be read.                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The text of the element, or an empty string.                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads a text element such as <meshFile>...</meshFile>.                     *
+*                                                                             *
+*******************************************************************************/
+static std::string readString(tinyxml2::XMLPullParser &parser)
+{
+	const char* text = parser.ReadElementText();
+	return (text != NULL) ? std::string(text) : std::string();
+}
+
+/******************************************************************************
+*                                                                             *
+*                            readVector (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param parser                                                              *
+*           Parser at the start of an element containing <x>, <y> and <z>.    *
+*  @param x, y, z                                                             *
+*           Destination of the three components (0 if missing).               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads a vector element such as <position>.                                 *
+*                                                                             *
+*******************************************************************************/
+static void readVector(tinyxml2::XMLPullParser &parser,
+                       double &x, double &y, double &z)
+{
+	static const char* const axes[3] = { "x", "y", "z" };
+	double xyz[3] = { 0.0, 0.0, 0.0 };
+	parser.ReadDoubleChildren(axes, 3, xyz);
+	x = xyz[0];
+	y = xyz[1];
+	z = xyz[2];
+}
+
+/******************************************************************************
+*                                                                             *
+*                       pushDouble, pushFloat (file static)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param printer                                                             *
+*           Printer the element is written to.                                *
+*  @param name                                                                *
+*           Name of the element.                                              *
+*  @param value                                                               *
+*           Its value.                                                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes a numeric element such as <mass>5.972e24</mass>.                    *
+*                                                                             *
+*******************************************************************************/
+static void pushDouble(tinyxml2::XMLPrinter &printer, const char* name,
+                       double value)
+{
+	printer.OpenElement(name);
+	printer.PushText(value);
+	printer.CloseElement();
+}
+static void pushFloat(tinyxml2::XMLPrinter &printer, const char* name,
+                      GLfloat value)
+{
+	printer.OpenElement(name);
+	printer.PushText(value);
+	printer.CloseElement();
+}
+
+/******************************************************************************
+*                                                                             *
+*                            pushString (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param printer                                                             *
+*           Printer the element is written to.                                *
+*  @param name                                                                *
+*           Name of the element.                                              *
+*  @param text                                                                *
+*           Its text.                                                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes a text element such as <meshFile>...</meshFile>.                    *
+*                                                                             *
+*******************************************************************************/
+static void pushString(tinyxml2::XMLPrinter &printer, const char* name,
+                       const std::string &text)
+{
+	printer.OpenElement(name);
+	printer.PushText(text.c_str());
+	printer.CloseElement();
+}
+
+/******************************************************************************
+*                                                                             *
+*                            pushVector (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param printer                                                             *
+*           Printer the element is written to.                                *
+*  @param name                                                                *
+*           Name of the element.                                              *
+*  @param x, y, z                                                             *
+*           The three components.                                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes a vector element such as <position>.                                *
+*                                                                             *
+*******************************************************************************/
+static void pushVector(tinyxml2::XMLPrinter &printer, const char* name,
+                       double x, double y, double z)
+{
+	printer.OpenElement(name);
+	pushDouble(printer, "x", x);
+	pushDouble(printer, "y", y);
+	pushDouble(printer, "z", z);
+	printer.CloseElement();
+}
+
+/******************************************************************************
+*                                                                             *
+*                              BodyArrays::resize                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param n                                                                   *
+*           The new number of bodies.                                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Resizes every array to hold n bodies.                                      *
+*                                                                             *
+*******************************************************************************/
+void BodyArrays::resize(GLuint n)
+{
+	count = n;
+	px.resize(n); py.resize(n); pz.resize(n);
+	vx.resize(n); vy.resize(n); vz.resize(n);
+	ax.resize(n); ay.resize(n); az.resize(n);
+	mass.resize(n);
+	radius.resize(n);
+	tilt.resize(n);
+	rotationalSpeed.resize(n);
+	rotation.resize(n);
+	mesh.resize(n);
+	texture.resize(n);
+	name.resize(n);
+}
+
+/******************************************************************************
+*                                                                             *
+*                                compactArray                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param array                                                               *
+*           One of the arrays of a BodyArrays.                                *
+*  @param removed                                                             *
+*           Flag per element, true for the elements to drop.                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Moves the kept elements down over the removed ones and shrinks the array. *
+*                                                                             *
+*******************************************************************************/
+template <typename T>
+static void compactArray(std::vector<T> &array, const std::vector<bool> &removed)
+{
+	GLuint kept = 0;
+	for (GLuint i = 0; i < array.size(); i++)
+	{
+		if (!removed[i])
+		{
+			if (kept != i)
+				array[kept] = array[i];
+			kept++;
+		}
+	}
+	array.resize(kept);
+}
+
+/******************************************************************************
+*                                                                             *
+*                              BodyArrays::remove                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param removed                                                             *
+*           Flag per body, true for the bodies to remove.                     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Removes bodies from every array. The remaining bodies keep their relative *
+*  order, but their indices change.                                           *
+*                                                                             *
+*******************************************************************************/
+void BodyArrays::remove(const std::vector<bool> &removed)
+{
+	compactArray(px, removed); compactArray(py, removed);
+	compactArray(pz, removed);
+	compactArray(vx, removed); compactArray(vy, removed);
+	compactArray(vz, removed);
+	compactArray(ax, removed); compactArray(ay, removed);
+	compactArray(az, removed);
+	compactArray(mass, removed);
+	compactArray(radius, removed);
+	compactArray(tilt, removed);
+	compactArray(rotationalSpeed, removed);
+	compactArray(rotation, removed);
+	compactArray(mesh, removed);
+	compactArray(texture, removed);
+	compactArray(name, removed);
+	count = px.size();
+}
+
+/******************************************************************************
+*                                                                             *
+*                               BodyArrays::swap                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param other                                                               *
+*           The arrays to exchange with.                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Swaps every array's storage, so a system can be loaded aside and put in  *
+*  place at no cost.                                                          *
+*                                                                             *
+*******************************************************************************/
+void BodyArrays::swap(BodyArrays &other)
+{
+	std::swap(count, other.count);
+	px.swap(other.px); py.swap(other.py); pz.swap(other.pz);
+	vx.swap(other.vx); vy.swap(other.vy); vz.swap(other.vz);
+	ax.swap(other.ax); ay.swap(other.ay); az.swap(other.az);
+	mass.swap(other.mass);
+	radius.swap(other.radius);
+	tilt.swap(other.tilt);
+	rotationalSpeed.swap(other.rotationalSpeed);
+	rotation.swap(other.rotation);
+	mesh.swap(other.mesh);
+	texture.swap(other.texture);
+	name.swap(other.name);
+}
+
+/******************************************************************************
+*                                                                             *
+*                     OrbitalSystem::OrbitalSystem (Constructor)              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates an empty system with default constants.                            *
+*                                                                             *
+*******************************************************************************/
+OrbitalSystem::OrbitalSystem() :
+	gravity(DEFAULT_GRAVITY), scale(1.0), speed(1.0),
+	backgroundMesh(-1), backgroundTexture(-1),
+	backgroundRadius(0.0), backgroundTilt(0.0f)
+{
+	/* Empty. */
+}
+
+/******************************************************************************
+*                                                                             *
+*                         OrbitalSystem::setBackground                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param mesh, texture                                                       *
+*           AssetCache handles of the background sphere (-1 for none).        *
+*  @param radius, tilt                                                        *
+*           Size and tilt of the background sphere.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Replaces the background sphere.                                            *
+*                                                                             *
+*******************************************************************************/
+void OrbitalSystem::setBackground(GLuint mesh, GLuint texture, double radius,
+                                  GLfloat tilt)
+{
+	backgroundMesh = mesh;
+	backgroundTexture = texture;
+	backgroundRadius = radius;
+	backgroundTilt = tilt;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            OrbitalSystem::loadXml                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path to an XML file following orbitalSystem.xsd.                  *
+*  @param assets                                                              *
+*           Cache in which the mesh and texture paths are registered.         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was loaded, false otherwise.                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Maps the file and fills the body arrays in one pass with the streaming   *
+*  parser, so no DOM is built and memory does not grow with the file beyond *
+*  the arrays themselves. The arrays grow by doubling and are trimmed at the *
+*  end. Everything is read into a new system which replaces this one only   *
+*  if the whole file parsed. Asset paths are interned in the cache and only *
+*  their handles are stored per body.                                         *
+*                                                                             *
+*******************************************************************************/
+bool OrbitalSystem::loadXml(const char* filename, AssetCache* assets)
+{
+	/* Map the document. */
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		std::cerr << "Error loading system: " << filename
+		          << " could not be opened" << std::endl;
+		return false;
+	}
+	tinyxml2::XMLPullParser parser((const char*) file.getData(),
+		file.getSize());
+
+	/* Validate the root element. */
+	if (!nextChild(parser) || !parser.NameIs("system"))
+	{
+		if (parser.Error())
+			std::cerr << "Error loading system: " << filename << " ("
+			          << parser.ErrorName() << ")" << std::endl;
+		else
+			std::cerr << "Error loading system: " << filename
+			          << " has no <system> element" << std::endl;
+		return false;
+	}
+
+	OrbitalSystem loaded;
+	GLuint n = 0;
+	while (nextChild(parser))
+	{
+		/* System constants. */
+		if (parser.NameIs("g"))
+			readDouble(parser, loaded.gravity);
+		else if (parser.NameIs("scale"))
+			readDouble(parser, loaded.scale);
+		else if (parser.NameIs("speed"))
+			readDouble(parser, loaded.speed);
+
+		/* Background sphere. */
+		else if (parser.NameIs("background"))
+		{
+			std::string mesh, texture;
+			double tilt = 0.0;
+			while (nextChild(parser))
+			{
+				if (parser.NameIs("meshFile"))
+					mesh = readString(parser);
+				else if (parser.NameIs("textureFile"))
+					texture = readString(parser);
+				else if (parser.NameIs("radius"))
+					readDouble(parser, loaded.backgroundRadius);
+				else if (parser.NameIs("tilt"))
+					readDouble(parser, tilt);
+				else
+					parser.SkipElement();
+			}
+			loaded.backgroundMesh = assets->addMesh(mesh);
+			loaded.backgroundTexture = assets->addTexture(texture);
+			loaded.backgroundTilt = (GLfloat) tilt;
+		}
+
+		/* Bodies, each written directly into its slot. */
+		else if (parser.NameIs("bodies"))
+		{
+			BodyArrays &b = loaded.bodies;
+			while (nextChild(parser))
+			{
+				if (!parser.NameIs("body"))
+				{
+					parser.SkipElement();
+					continue;
+				}
+				if (n == b.count)
+					b.resize((n > 0) ? 2 * n : 64);
+
+				std::string mesh, texture;
+				double tilt = 0.0, rotationalSpeed = 0.0;
+				b.mass[n] = b.radius[n] = 0.0;
+				b.px[n] = b.py[n] = b.pz[n] = 0.0;
+				b.vx[n] = b.vy[n] = b.vz[n] = 0.0;
+				while (nextChild(parser))
+				{
+					if (parser.NameIs("name"))
+						b.name[n] = readString(parser);
+					else if (parser.NameIs("mass"))
+						readDouble(parser, b.mass[n]);
+					else if (parser.NameIs("radius"))
+						readDouble(parser, b.radius[n]);
+					else if (parser.NameIs("meshFile"))
+						mesh = readString(parser);
+					else if (parser.NameIs("textureFile"))
+						texture = readString(parser);
+					else if (parser.NameIs("position"))
+						readVector(parser, b.px[n], b.py[n], b.pz[n]);
+					else if (parser.NameIs("velocity"))
+						readVector(parser, b.vx[n], b.vy[n], b.vz[n]);
+					else if (parser.NameIs("tilt"))
+						readDouble(parser, tilt);
+					else if (parser.NameIs("rotationalSpeed"))
+						readDouble(parser, rotationalSpeed);
+					else
+						parser.SkipElement();
+				}
+				b.mesh[n] = assets->addMesh(mesh);
+				b.texture[n] = assets->addTexture(texture);
+				b.tilt[n] = (GLfloat) tilt;
+				b.rotationalSpeed[n] = (GLfloat) rotationalSpeed;
+				n++;
+			}
+		}
+		else
+			parser.SkipElement();
+	}
+
+	/* Nothing is kept from a file which did not parse. */
+	if (parser.Error())
+	{
+		std::cerr << "Error loading system: " << filename << " ("
+		          << parser.ErrorName() << " at byte "
+		          << parser.ErrorOffset() << ")" << std::endl;
+		return false;
+	}
+	loaded.bodies.resize(n);
+	bodies.swap(loaded.bodies);
+	gravity = loaded.gravity;
+	scale = loaded.scale;
+	speed = loaded.speed;
+	backgroundMesh = loaded.backgroundMesh;
+	backgroundTexture = loaded.backgroundTexture;
+	backgroundRadius = loaded.backgroundRadius;
+	backgroundTilt = loaded.backgroundTilt;
+
+	/* Show what was loaded. */
+	fprintf(stdout, "Stats: Loaded %u bodies from %s\n", n, filename);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            OrbitalSystem::saveXml                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the XML file to be written.                               *
+*  @param assets                                                              *
+*           Cache holding the paths of the mesh and texture handles.          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was written, false otherwise.                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Streams the system out in the layout loadXml reads, without building a   *
+*  DOM. Doubles are written with enough digits to be read back exactly.     *
+*                                                                             *
+*******************************************************************************/
+bool OrbitalSystem::saveXml(const char* filename,
+                            const AssetCache &assets) const
+{
+	FILE* file = fopen(filename, "w");
+	if (file == NULL)
+	{
+		std::cerr << "Error saving system: cannot create " << filename
+		          << std::endl;
+		return false;
+	}
+
+	tinyxml2::XMLPrinter printer(file);
+	printer.PushHeader(false, true);
+	printer.OpenElement("system");
+	pushDouble(printer, "g", gravity);
+	pushDouble(printer, "scale", scale);
+	pushDouble(printer, "speed", speed);
+
+	/* Background sphere. */
+	if (backgroundMesh < assets.getNumMeshes())
+	{
+		printer.OpenElement("background");
+		pushString(printer, "meshFile", assets.getMeshFile(backgroundMesh));
+		pushString(printer, "textureFile",
+			(backgroundTexture < assets.getNumTextures()) ?
+			assets.getTextureFile(backgroundTexture) : std::string());
+		pushDouble(printer, "radius", backgroundRadius);
+		pushFloat(printer, "tilt", backgroundTilt);
+		printer.CloseElement();
+	}
+
+	/* Bodies. */
+	printer.OpenElement("bodies");
+	for (GLuint i = 0; i < bodies.count; i++)
+	{
+		printer.OpenElement("body");
+		pushString(printer, "name", bodies.name[i]);
+		pushDouble(printer, "mass", bodies.mass[i]);
+		pushDouble(printer, "radius", bodies.radius[i]);
+		pushString(printer, "meshFile", (bodies.mesh[i] < assets.getNumMeshes()) ?
+			assets.getMeshFile(bodies.mesh[i]) : std::string());
+		pushString(printer, "textureFile",
+			(bodies.texture[i] < assets.getNumTextures()) ?
+			assets.getTextureFile(bodies.texture[i]) : std::string());
+		pushVector(printer, "position", bodies.px[i], bodies.py[i],
+			bodies.pz[i]);
+		pushVector(printer, "velocity", bodies.vx[i], bodies.vy[i],
+			bodies.vz[i]);
+		pushFloat(printer, "tilt", bodies.tilt[i]);
+		pushFloat(printer, "rotationalSpeed", bodies.rotationalSpeed[i]);
+		printer.CloseElement();
+	}
+	printer.CloseElement();
+	printer.CloseElement();
+
+	bool written = !ferror(file);
+	if (fclose(file) != 0 || !written)
+	{
+		std::cerr << "Error saving system: cannot write " << filename
+		          << std::endl;
+		return false;
+	}
+	fprintf(stdout, "Stats: Saved %u bodies to %s\n", bodies.count, filename);
+	return true;
+}
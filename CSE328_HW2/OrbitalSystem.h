@@ -0,0 +1,156 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <string>
+#include <vector>
+#include "AssetCache.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Default orbital system description. */
+#define  DEFAULT_SYSTEM_FILE        "res/data/system.xml"
+/* Command line flag loading another system description. */
+#define  SYSTEM_FILE_FLAG           "--system"
+/* Gravitational constant used when the file does not specify one. */
+#define  DEFAULT_GRAVITY            6.67384e-11
+
+/******************************************************************************
+*                                                                             *
+*                           BodyArrays  (struct)                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  count                                                                      *
+*          Number of bodies stored in every array.                            *
+*  px, py, pz                                                                 *
+*          Position of each body in meters (double precision).                *
+*  vx, vy, vz                                                                 *
+*          Velocity of each body in meters per second (double precision).     *
+*  ax, ay, az                                                                 *
+*          Gravitational acceleration of each body, written by the solvers.   *
+*  mass                                                                       *
+*          Mass of each body in kilograms.                                    *
+*  radius                                                                     *
+*          Radius of each body in meters.                                     *
+*  tilt                                                                       *
+*          Axial tilt of each body in degrees.                                *
+*  rotationalSpeed                                                            *
+*          Rotational speed of each body in degrees per second.               *
+*  rotation                                                                   *
+*          Current rotation of each body about its axis in degrees.           *
+*  mesh, texture                                                              *
+*          AssetCache handles of each body's mesh and texture.                *
+*  name                                                                       *
+*          Name of each body.                                                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Structure-of-arrays storage for the bodies of an orbital system. Every     *
+*  field lives in its own contiguous array so the force and integration       *
+*  loops stream only the fields they touch. Body i is element i of every      *
+*  array.                                                                     *
+*                                                                             *
+*******************************************************************************/
+struct BodyArrays
+{
+	GLuint                   count;
+	std::vector<double>      px, py, pz;
+	std::vector<double>      vx, vy, vz;
+	std::vector<double>      ax, ay, az;
+	std::vector<double>      mass;
+	std::vector<double>      radius;
+	std::vector<GLfloat>     tilt;
+	std::vector<GLfloat>     rotationalSpeed;
+	std::vector<GLfloat>     rotation;
+	std::vector<GLuint>      mesh;
+	std::vector<GLuint>      texture;
+	std::vector<std::string> name;
+
+	/* Constructor. */
+	                         BodyArrays() : count(0) {}
+	/* Resize every array to n bodies. */
+	void                     resize(GLuint n);
+	/* Remove the bodies flagged in removed, keeping the others in order. */
+	void                     remove(const std::vector<bool> &removed);
+	/* Exchange the contents with other without copying. */
+	void                     swap(BodyArrays &other);
+};
+
+/******************************************************************************
+*                                                                             *
+*                          OrbitalSystem  (class)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  bodies                                                                     *
+*          Structure-of-arrays storage of every body in the system.           *
+*  gravity                                                                    *
+*          Gravitational constant (<g>).                                      *
+*  scale                                                                      *
+*          Meters per world unit when rendering (<scale>).                    *
+*  speed                                                                      *
+*          Simulated seconds per real second (<speed>).                       *
+*  backgroundMesh, backgroundTexture                                          *
+*          AssetCache handles of the background sphere.                       *
+*  backgroundRadius, backgroundTilt                                           *
+*          Size and tilt of the background sphere.                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class holding an orbital system described by orbitalSystem.xsd. The same  *
+*  arrays are read by the simulation and by the renderer.                     *
+*                                                                             *
+*******************************************************************************/
+class OrbitalSystem
+{
+public:
+	/* Constructor. */
+	               OrbitalSystem();
+
+	/* Load the system from an XML file, registering assets in the cache. */
+	bool           loadXml(const char* filename, AssetCache* assets);
+	/* Write the system as XML, with the asset paths from the cache. */
+	bool           saveXml(const char* filename,
+	                       const AssetCache &assets) const;
+
+	/* Getters. */
+	BodyArrays&    getBodies()                 {  return bodies;            }
+	const BodyArrays& getBodies()        const {  return bodies;            }
+	GLuint         getNumBodies()        const {  return bodies.count;      }
+	double         getGravity()          const {  return gravity;           }
+	double         getScale()            const {  return scale;             }
+	double         getSpeed()            const {  return speed;             }
+	GLuint         getBackgroundMesh()   const {  return backgroundMesh;    }
+	GLuint         getBackgroundTexture()const {  return backgroundTexture; }
+	double         getBackgroundRadius() const {  return backgroundRadius;  }
+	GLfloat        getBackgroundTilt()   const {  return backgroundTilt;    }
+
+	/* Setters. */
+	void           setGravity(double g)        {  gravity = g;              }
+	void           setScale(double s)          {  scale = s;                }
+	void           setSpeed(double s)          {  speed = s;                }
+	void           setBackground(GLuint mesh, GLuint texture, double radius,
+	                             GLfloat tilt);
+
+private:
+	/* Body data. */
+	BodyArrays     bodies;
+	/* System constants. */
+	double         gravity;
+	double         scale;
+	double         speed;
+	/* Background. */
+	GLuint         backgroundMesh;
+	GLuint         backgroundTexture;
+	double         backgroundRadius;
+	GLfloat        backgroundTilt;
+};
@@ -0,0 +1,101 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Parallel.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Pieces per thread, so stealing can even out uneven pieces. */
+#define PIECES_PER_THREAD   4
+
+/******************************************************************************
+*                                                                             *
+*                        Parallel::getNumThreads (static)                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The number of threads of the task scheduler (at least 1).                  *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Returns the number of threads a parallel loop is spread over.              *
+*                                                                             *
+*******************************************************************************/
+GLuint Parallel::getNumThreads()
+{
+	return TaskScheduler::get().getNumThreads();
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Parallel::forRange (static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param begin                                                               *
+*           First index of the range.                                         *
+*  @param end                                                                 *
+*           One past the last index of the range.                             *
+*  @param grain                                                               *
+*           Smallest number of indices worth handing to a thread.             *
+*  @param body                                                                *
+*           Function called with each sub-range [lo, hi).                     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Splits the range into up to PIECES_PER_THREAD contiguous pieces per        *
+*  thread (fewer if the pieces would be smaller than the grain) and submits  *
+*  them to the task scheduler. The calling thread runs the first piece and   *
+*  then helps with the rest until every piece is done. May be called from    *
+*  inside a task.                                                             *
+*                                                                             *
+*******************************************************************************/
+void Parallel::forRange(GLuint begin, GLuint end, GLuint grain,
+                        const std::function<void(GLuint, GLuint)> &body)
+{
+	/* Nothing to do for an empty range. */
+	if (end <= begin)
+		return;
+
+	/* Decide how many pieces are worth creating. */
+	TaskScheduler &scheduler = TaskScheduler::get();
+	GLuint n = end - begin;
+	GLuint pieces = std::min(scheduler.getNumThreads() * PIECES_PER_THREAD,
+		std::max(1u, n / std::max(1u, grain)));
+
+	/* Run small ranges directly. */
+	if (pieces <= 1 || scheduler.getNumThreads() == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	/* Submit every piece but the first. */
+	TaskGroup group;
+	for (GLuint p = pieces - 1; p > 0; p--)
+	{
+		GLuint lo = begin + (GLuint) ((unsigned long long) n * p / pieces);
+		GLuint hi = begin + (GLuint) ((unsigned long long) n * (p + 1) / pieces);
+		scheduler.submit(group, [&body, lo, hi]() { body(lo, hi); });
+	}
+
+	/* Do the first piece here, then help with the rest. */
+	body(begin, begin + (GLuint) ((unsigned long long) n / pieces));
+	scheduler.wait(group);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <functional>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                              Parallel  (class)                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to split loops over the threads of   *
+*  the task scheduler. The calling thread always takes part in the work, and  *
+*  the call returns once every part of the range has been processed.          *
+*                                                                             *
+*******************************************************************************/
+class Parallel
+{
+public:
+	/* Number of threads (including the caller) used by forRange. */
+	static GLuint   getNumThreads();
+
+	/* Call body(lo, hi) on disjoint sub-ranges covering [begin, end). */
+	static void     forRange(GLuint begin, GLuint end, GLuint grain,
+	                         const std::function<void(GLuint, GLuint)> &body);
+
+	/* Deterministic reduction of map(lo, hi) over [begin, end). */
+	template <typename T, typename Map, typename Combine>
+	static T        reduce(GLuint begin, GLuint end, GLuint grain, T identity,
+	                       const Map &map, const Combine &combine);
+};
+
+/******************************************************************************
+*                                                                             *
+*                           Parallel::reduce (static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param begin                                                               *
+*           First index of the range.                                         *
+*  @param end                                                                 *
+*           One past the last index of the range.                             *
+*  @param grain                                                               *
+*           Size of the blocks the range is reduced in.                       *
+*  @param identity                                                            *
+*           Result for an empty range.                                        *
+*  @param map                                                                 *
+*           Function returning the partial result of a block [lo, hi).        *
+*  @param combine                                                             *
+*           Function combining two partial results.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The combination of the partial results of every block.                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The blocks depend only on the range and the grain, not on the number of   *
+*  threads or which thread ran which block, and their results are combined   *
+*  left to right. Floating point sums are therefore identical run to run and *
+*  machine to machine.                                                        *
+*                                                                             *
+*******************************************************************************/
+template <typename T, typename Map, typename Combine>
+T Parallel::reduce(GLuint begin, GLuint end, GLuint grain, T identity,
+                   const Map &map, const Combine &combine)
+{
+	if (end <= begin)
+		return identity;
+	if (grain == 0)
+		grain = 1;
+
+	GLuint blocks = (end - begin + grain - 1) / grain;
+	std::vector<T> partial(blocks, identity);
+	forRange(0, blocks, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint b = lo; b < hi; b++)
+		{
+			GLuint first = begin + b * grain;
+			GLuint last = (end - first > grain) ? first + grain : end;
+			partial[b] = map(first, last);
+		}
+	});
+
+	T result = identity;
+	for (GLuint b = 0; b < blocks; b++)
+		result = combine(result, partial[b]);
+	return result;
+}
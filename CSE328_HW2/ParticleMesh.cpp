@@ -0,0 +1,802 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "ParticleMesh.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Bodies per task. */
+#define BODY_GRAIN      4096
+/* Grid lines per task of a transform. */
+#define LINE_GRAIN      64
+/* Smallest supported mesh. */
+#define MIN_MESH_SIZE   8
+/* One revolution in radians. */
+#define TWO_PI          6.28318530717958647692
+
+/******************************************************************************
+*                                                                             *
+*                             Bounds  (struct)                                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bounding box of a range of bodies, for Parallel::reduce.                   *
+*                                                                             *
+*******************************************************************************/
+struct Bounds
+{
+	double lower[3];
+	double upper[3];
+};
+
+/******************************************************************************
+*                                                                             *
+*              ParticleMeshSolver::ParticleMeshSolver (Constructor)           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param size                                                                *
+*           Mesh nodes per axis (rounded up to a power of two).               *
+*  @param softening                                                           *
+*           Softening length of the short range pair forces.                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the solver without the short range correction. The grids are     *
+*  allocated on the first call.                                              *
+*                                                                             *
+*******************************************************************************/
+ParticleMeshSolver::ParticleMeshSolver(GLuint size, double softening) :
+	size(0), softening(softening), shortRange(false), spacing(1.0)
+{
+	origin[0] = origin[1] = origin[2] = 0.0;
+	setSize(size);
+}
+
+/******************************************************************************
+*                                                                             *
+*                        ParticleMeshSolver::setSize                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param n                                                                   *
+*           Mesh nodes per axis (rounded up to a power of two).               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Changes the resolution; the Green's function is recomputed on the next   *
+*  call.                                                                     *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::setSize(GLuint n)
+{
+	GLuint rounded = MIN_MESH_SIZE;
+	while (rounded < n)
+		rounded *= 2;
+	if (rounded != size)
+	{
+		size = rounded;
+		green.clear();
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           ParticleMeshSolver::fft                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data                                                                *
+*           The values to be transformed in place.                            *
+*  @param length                                                              *
+*           Number of values, a power of two dividing 2N.                     *
+*  @param invert                                                              *
+*           Whether to transform with exp(+2 pi i k / length) (unscaled).     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Iterative radix-2 Cooley-Tukey: bit reversal, then butterflies of        *
+*  doubling span, reading the twiddles of the 2N point table at a stride.    *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::fft(Complex* data, GLuint length, bool invert) const
+{
+	for (GLuint i = 1, j = 0; i < length; i++)
+	{
+		GLuint bit = length >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(data[i], data[j]);
+	}
+
+	const GLuint full = 2 * size;
+	for (GLuint half = 1; half < length; half *= 2)
+	{
+		const GLuint stride = full / (2 * half);
+		for (GLuint start = 0; start < length; start += 2 * half)
+		{
+			for (GLuint k = 0; k < half; k++)
+			{
+				Complex w = twiddles[k * stride];
+				if (invert)
+					w = std::conj(w);
+				Complex a = data[start + k];
+				Complex b = data[start + k + half] * w;
+				data[start + k] = a + b;
+				data[start + k + half] = a - b;
+			}
+		}
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                         ParticleMeshSolver::forward                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Transforms grid into spectrum. Each x line of 2N reals is packed into N  *
+*  complex values (even samples real, odd imaginary), transformed, and      *
+*  unpacked into its N + 1 non-redundant frequencies. The y and z lines are *
+*  then transformed in place. Lines which only cross the zero padding stay  *
+*  zero and are skipped, unless the whole grid is filled (the Green's       *
+*  function).                                                                 *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::forward()
+{
+	const GLuint n = size, m = 2 * size, h = size + 1;
+	const bool padded = green.size() == (size_t) h * m * m;
+
+	/* x: real to complex. */
+	Parallel::forRange(0, m * m, LINE_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		std::vector<Complex> z(n);
+		for (GLuint line = lo; line < hi; line++)
+		{
+			Complex* out = &spectrum[(size_t) line * h];
+			if (padded && (line % m >= n || line / m >= n))
+			{
+				std::fill(out, out + h, Complex(0.0, 0.0));
+				continue;
+			}
+			const double* in = &grid[(size_t) line * m];
+			for (GLuint k = 0; k < n; k++)
+				z[k] = Complex(in[2 * k], in[2 * k + 1]);
+			fft(z.data(), n, false);
+			for (GLuint k = 0; k <= n; k++)
+			{
+				Complex zk = z[k % n];
+				Complex zc = std::conj(z[(n - k) % n]);
+				Complex even = 0.5 * (zk + zc);
+				Complex odd = (zk - zc) * Complex(0.0, -0.5);
+				out[k] = even + twiddles[k] * odd;
+			}
+		}
+	});
+
+	/* y, then z: complex. */
+	for (GLuint axis = 1; axis <= 2; axis++)
+	{
+		const size_t stride = (axis == 1) ? h : (size_t) h * m;
+		Parallel::forRange(0, h * m, LINE_GRAIN, [&](GLuint lo, GLuint hi)
+		{
+			std::vector<Complex> line(m);
+			for (GLuint l = lo; l < hi; l++)
+			{
+				/* Line l: kx = l % h and the other coordinate l / h. */
+				GLuint other = l / h;
+				if (axis == 1 && padded && other >= n)
+					continue;
+				Complex* base = &spectrum[(axis == 1) ?
+					(size_t) other * m * h + l % h : (size_t) other * h + l % h];
+				for (GLuint k = 0; k < m; k++)
+					line[k] = base[k * stride];
+				fft(line.data(), m, false);
+				for (GLuint k = 0; k < m; k++)
+					base[k * stride] = line[k];
+			}
+		});
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                         ParticleMeshSolver::inverse                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Transforms spectrum back into grid (scaled by (2N)^3 / 2), reversing the *
+*  steps of forward. Only the planes and lines holding the nodes of the     *
+*  mesh and their neighbours, which the differences read, are finished.     *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::inverse()
+{
+	const GLuint n = size, m = 2 * size, h = size + 1;
+
+	/* Whether potential coordinate c (-1 .. N with wrap around) is needed. */
+	auto needed = [&](GLuint c) { return c <= n || c == m - 1; };
+
+	/* z, then y: complex. */
+	for (GLuint axis = 2; axis >= 1; axis--)
+	{
+		const size_t stride = (axis == 1) ? h : (size_t) h * m;
+		Parallel::forRange(0, h * m, LINE_GRAIN, [&](GLuint lo, GLuint hi)
+		{
+			std::vector<Complex> line(m);
+			for (GLuint l = lo; l < hi; l++)
+			{
+				GLuint other = l / h;
+				if (axis == 1 && !needed(other))
+					continue;
+				Complex* base = &spectrum[(axis == 1) ?
+					(size_t) other * m * h + l % h : (size_t) other * h + l % h];
+				for (GLuint k = 0; k < m; k++)
+					line[k] = base[k * stride];
+				fft(line.data(), m, true);
+				for (GLuint k = 0; k < m; k++)
+					base[k * stride] = line[k];
+			}
+		});
+	}
+
+	/* x: complex to real. */
+	Parallel::forRange(0, m * m, LINE_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		std::vector<Complex> z(n);
+		for (GLuint line = lo; line < hi; line++)
+		{
+			if (!needed(line % m) || !needed(line / m))
+				continue;
+			const Complex* in = &spectrum[(size_t) line * h];
+			for (GLuint k = 0; k < n; k++)
+			{
+				Complex xk = in[k];
+				Complex xc = std::conj(in[n - k]);
+				Complex even = 0.5 * (xk + xc);
+				Complex odd = 0.5 * (xk - xc) * std::conj(twiddles[k]);
+				z[k] = even + Complex(0.0, 1.0) * odd;
+			}
+			fft(z.data(), n, true);
+			double* out = &grid[(size_t) line * m];
+			for (GLuint k = 0; k < n; k++)
+			{
+				out[2 * k] = z[k].real();
+				out[2 * k + 1] = z[k].imag();
+			}
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                       ParticleMeshSolver::computeGreen                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Allocates the grids and transforms -1 / r for unit spacing, with r the   *
+*  shortest distance around the (2N)^3 grid and softened by half a cell so  *
+*  a node's own mass is finite. The function is even, so its transform is   *
+*  real. Other spacings scale it by 1 / spacing.                              *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::computeGreen()
+{
+	const GLuint n = size, m = 2 * size, h = size + 1;
+	grid.assign((size_t) m * m * m, 0.0);
+	spectrum.assign((size_t) h * m * m, Complex(0.0, 0.0));
+	meshX.assign((size_t) n * n * n, 0.0);
+	meshY.assign((size_t) n * n * n, 0.0);
+	meshZ.assign((size_t) n * n * n, 0.0);
+	twiddles.resize(n + 1);
+	for (GLuint k = 0; k <= n; k++)
+		twiddles[k] = std::polar(1.0, -TWO_PI * k / m);
+
+	green.clear();
+	Parallel::forRange(0, m, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint z = lo; z < hi; z++)
+		{
+			double dz = std::min(z, m - z);
+			for (GLuint y = 0; y < m; y++)
+			{
+				double dy = std::min(y, m - y);
+				double* row = &grid[((size_t) z * m + y) * m];
+				for (GLuint x = 0; x < m; x++)
+				{
+					double dx = std::min(x, m - x);
+					row[x] = -1.0 / sqrt(dx * dx + dy * dy + dz * dz + 0.25);
+				}
+			}
+		}
+	});
+	forward();
+
+	green.resize((size_t) h * m * m);
+	for (size_t i = 0; i < green.size(); i++)
+		green[i] = spectrum[i].real();
+}
+
+/******************************************************************************
+*                                                                             *
+*                        ParticleMeshSolver::placeMesh                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies to be covered.                                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Centres the mesh on the bounding box of the bodies with half a cell to   *
+*  spare on every side, so each cloud's 2 x 2 x 2 nodes lie in the mesh.     *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::placeMesh(const BodyArrays &bodies)
+{
+	Bounds empty;
+	for (GLuint d = 0; d < 3; d++)
+	{
+		empty.lower[d] = HUGE_VAL;
+		empty.upper[d] = -HUGE_VAL;
+	}
+	Bounds box = Parallel::reduce(0, bodies.count, BODY_GRAIN, empty,
+		[&](GLuint lo, GLuint hi)
+	{
+		Bounds b = empty;
+		const double* p[3] = { &bodies.px[0], &bodies.py[0], &bodies.pz[0] };
+		for (GLuint i = lo; i < hi; i++)
+		{
+			for (GLuint d = 0; d < 3; d++)
+			{
+				b.lower[d] = std::min(b.lower[d], p[d][i]);
+				b.upper[d] = std::max(b.upper[d], p[d][i]);
+			}
+		}
+		return b;
+	}, [](const Bounds &a, const Bounds &b)
+	{
+		Bounds c;
+		for (GLuint d = 0; d < 3; d++)
+		{
+			c.lower[d] = std::min(a.lower[d], b.lower[d]);
+			c.upper[d] = std::max(a.upper[d], b.upper[d]);
+		}
+		return c;
+	});
+
+	double extent = 0.0;
+	for (GLuint d = 0; d < 3; d++)
+		extent = std::max(extent, box.upper[d] - box.lower[d]);
+	spacing = (extent > 0.0) ? extent / (size - 2) : 1.0;
+	for (GLuint d = 0; d < 3; d++)
+		origin[d] = 0.5 * (box.lower[d] + box.upper[d]) -
+			0.5 * spacing * (size - 1);
+}
+
+/******************************************************************************
+*                                                                             *
+*                         ParticleMeshSolver::deposit                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose mass is spread.                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sorts the bodies by the lowest z plane of their cloud (counting sort),   *
+*  clears the grid, and adds each mass to its 8 nodes with weights linear   *
+*  in the distance, the even planes in parallel and then the odd ones.      *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::deposit(const BodyArrays &bodies)
+{
+	const GLuint n = size, m = 2 * size, count = bodies.count;
+	const double inverse = 1.0 / spacing;
+
+	/* Sort by plane. */
+	cellOf.resize(count);
+	Parallel::forRange(0, count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			double u = (bodies.pz[i] - origin[2]) * inverse;
+			cellOf[i] = std::min((GLuint) std::max(u, 0.0), n - 2);
+		}
+	});
+	planeStart.assign(n + 1, 0);
+	for (GLuint i = 0; i < count; i++)
+		planeStart[cellOf[i] + 1]++;
+	for (GLuint z = 0; z < n; z++)
+		planeStart[z + 1] += planeStart[z];
+	order.resize(count);
+	{
+		std::vector<GLuint> next(planeStart.begin(), planeStart.end() - 1);
+		for (GLuint i = 0; i < count; i++)
+			order[next[cellOf[i]]++] = i;
+	}
+
+	/* Clear the x lines forward reads (the rest is taken to be zero). */
+	Parallel::forRange(0, n, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint z = lo; z < hi; z++)
+			for (GLuint y = 0; y < n; y++)
+				std::fill_n(&grid[((size_t) z * m + y) * m], m, 0.0);
+	});
+
+	/* Even planes, then odd planes. */
+	for (GLuint parity = 0; parity < 2; parity++)
+	{
+		Parallel::forRange(0, (n - 1 - parity + 1) / 2, 1,
+			[&](GLuint lo, GLuint hi)
+		{
+			for (GLuint p = lo; p < hi; p++)
+			{
+				GLuint plane = 2 * p + parity;
+				for (GLuint k = planeStart[plane]; k < planeStart[plane + 1];
+					k++)
+				{
+					GLuint i = order[k];
+					double u[3] = {
+						(bodies.px[i] - origin[0]) * inverse,
+						(bodies.py[i] - origin[1]) * inverse,
+						(bodies.pz[i] - origin[2]) * inverse };
+					GLuint c[3];
+					double f[3];
+					for (GLuint d = 0; d < 3; d++)
+					{
+						c[d] = std::min((GLuint) std::max(u[d], 0.0), n - 2);
+						f[d] = std::min(1.0, std::max(0.0, u[d] - c[d]));
+					}
+					const double mass = bodies.mass[i];
+					for (GLuint dz = 0; dz < 2; dz++)
+					{
+						double wz = mass * (dz ? f[2] : 1.0 - f[2]);
+						for (GLuint dy = 0; dy < 2; dy++)
+						{
+							double wy = wz * (dy ? f[1] : 1.0 - f[1]);
+							double* node = &grid[((size_t) (c[2] + dz) * m +
+								c[1] + dy) * m + c[0]];
+							node[0] += wy * (1.0 - f[0]);
+							node[1] += wy * f[0];
+						}
+					}
+				}
+			}
+		});
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                      ParticleMeshSolver::solvePotential                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Convolves the deposited masses with G times the Green's function: a     *
+*  product in frequency space, including the 1 / spacing of the Green's    *
+*  function and the 2 / (2N)^3 undoing the unscaled transforms.             *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::solvePotential(double gravity)
+{
+	const GLuint m = 2 * size;
+	const double scale = gravity / spacing * 2.0 / ((double) m * m * m);
+	forward();
+	Parallel::forRange(0, m * m, LINE_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		const size_t h = size + 1;
+		for (size_t i = lo * h; i < hi * h; i++)
+			spectrum[i] *= green[i] * scale;
+	});
+	inverse();
+}
+
+/******************************************************************************
+*                                                                             *
+*                      ParticleMeshSolver::differentiate                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The acceleration at every mesh node is minus the central difference of  *
+*  the potential; the neighbours of the edge nodes come from the padding   *
+*  (wrapping around to 2N - 1 below 0), where the potential is also exact.  *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::differentiate()
+{
+	const GLuint n = size, m = 2 * size;
+	const double factor = -0.5 / spacing;
+	Parallel::forRange(0, n, 1, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint z = lo; z < hi; z++)
+		{
+			GLuint zm = (z + m - 1) % m;
+			for (GLuint y = 0; y < n; y++)
+			{
+				GLuint ym = (y + m - 1) % m;
+				const double* row = &grid[((size_t) z * m + y) * m];
+				const double* below = &grid[((size_t) z * m + ym) * m];
+				const double* above = &grid[((size_t) z * m + y + 1) * m];
+				const double* back = &grid[((size_t) zm * m + y) * m];
+				const double* front = &grid[((size_t) (z + 1) * m + y) * m];
+				size_t node = ((size_t) z * n + y) * n;
+				for (GLuint x = 0; x < n; x++)
+				{
+					meshX[node + x] = factor * (row[x + 1] - row[(x + m - 1) % m]);
+					meshY[node + x] = factor * (above[x] - below[x]);
+					meshZ[node + x] = factor * (front[x] - back[x]);
+				}
+			}
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                       ParticleMeshSolver::interpolate                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are written.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads the mesh accelerations at each body with its deposit weights.      *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::interpolate(BodyArrays &bodies)
+{
+	const GLuint n = size;
+	const double inverse = 1.0 / spacing;
+	Parallel::forRange(0, bodies.count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			double u[3] = {
+				(bodies.px[i] - origin[0]) * inverse,
+				(bodies.py[i] - origin[1]) * inverse,
+				(bodies.pz[i] - origin[2]) * inverse };
+			GLuint c[3];
+			double f[3];
+			for (GLuint d = 0; d < 3; d++)
+			{
+				c[d] = std::min((GLuint) std::max(u[d], 0.0), n - 2);
+				f[d] = std::min(1.0, std::max(0.0, u[d] - c[d]));
+			}
+			double a[3] = { 0.0, 0.0, 0.0 };
+			for (GLuint dz = 0; dz < 2; dz++)
+			{
+				double wz = dz ? f[2] : 1.0 - f[2];
+				for (GLuint dy = 0; dy < 2; dy++)
+				{
+					double wy = wz * (dy ? f[1] : 1.0 - f[1]);
+					size_t node = ((size_t) (c[2] + dz) * n + c[1] + dy) * n +
+						c[0];
+					double w0 = wy * (1.0 - f[0]), w1 = wy * f[0];
+					a[0] += w0 * meshX[node] + w1 * meshX[node + 1];
+					a[1] += w0 * meshY[node] + w1 * meshY[node + 1];
+					a[2] += w0 * meshZ[node] + w1 * meshZ[node + 1];
+				}
+			}
+			bodies.ax[i] = a[0];
+			bodies.ay[i] = a[1];
+			bodies.az[i] = a[2];
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                    ParticleMeshSolver::correctShortRange                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies, with their mesh accelerations.                        *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bins the bodies into cubes as wide as the cutoff and, for every pair in *
+*  neighbouring bins closer than the cutoff, adds the softened exact force  *
+*  and removes the mesh's estimate of it. Each body only writes its own     *
+*  acceleration, so bodies are corrected in parallel.                        *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::correctShortRange(BodyArrays &bodies, double gravity)
+{
+	const GLuint count = bodies.count;
+	const double cutoff = P3M_CUTOFF_CELLS * spacing;
+	const double inverse = 1.0 / cutoff;
+	const GLuint bins = (GLuint) ceil(size / P3M_CUTOFF_CELLS) + 1;
+	auto binOf = [&](GLuint i, GLuint d) -> GLuint
+	{
+		const double* p[3] = { &bodies.px[0], &bodies.py[0], &bodies.pz[0] };
+		double u = (p[d][i] - origin[d]) * inverse;
+		return std::min((GLuint) std::max(u, 0.0), bins - 1);
+	};
+
+	/* Counting sort into bins. */
+	cellOf.resize(count);
+	Parallel::forRange(0, count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+			cellOf[i] = (binOf(i, 2) * bins + binOf(i, 1)) * bins + binOf(i, 0);
+	});
+	binStart.assign((size_t) bins * bins * bins + 1, 0);
+	for (GLuint i = 0; i < count; i++)
+		binStart[cellOf[i] + 1]++;
+	for (size_t b = 0; b + 1 < binStart.size(); b++)
+		binStart[b + 1] += binStart[b];
+	binOrder.resize(count);
+	{
+		std::vector<GLuint> next(binStart.begin(), binStart.end() - 1);
+		for (GLuint i = 0; i < count; i++)
+			binOrder[next[cellOf[i]]++] = i;
+	}
+
+	const double eps2 = softening * softening;
+	const double mesh2 = 0.25 * spacing * spacing;
+	const double cutoff2 = cutoff * cutoff;
+	Parallel::forRange(0, count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			GLuint b[3] = { binOf(i, 0), binOf(i, 1), binOf(i, 2) };
+			double a[3] = { 0.0, 0.0, 0.0 };
+			for (GLuint z = (b[2] > 0 ? b[2] - 1 : 0);
+				z <= std::min(b[2] + 1, bins - 1); z++)
+			for (GLuint y = (b[1] > 0 ? b[1] - 1 : 0);
+				y <= std::min(b[1] + 1, bins - 1); y++)
+			for (GLuint x = (b[0] > 0 ? b[0] - 1 : 0);
+				x <= std::min(b[0] + 1, bins - 1); x++)
+			{
+				size_t bin = ((size_t) z * bins + y) * bins + x;
+				for (GLuint k = binStart[bin]; k < binStart[bin + 1]; k++)
+				{
+					GLuint j = binOrder[k];
+					double dx = bodies.px[j] - bodies.px[i];
+					double dy = bodies.py[j] - bodies.py[i];
+					double dz = bodies.pz[j] - bodies.pz[i];
+					double r2 = dx * dx + dy * dy + dz * dz;
+					if (j == i || r2 >= cutoff2)
+						continue;
+					double exact = r2 + eps2, smooth = r2 + mesh2;
+					double s = bodies.mass[j] * (1.0 / (exact * sqrt(exact)) -
+						1.0 / (smooth * sqrt(smooth)));
+					a[0] += s * dx;
+					a[1] += s * dy;
+					a[2] += s * dz;
+				}
+			}
+			bodies.ax[i] += gravity * a[0];
+			bodies.ay[i] += gravity * a[1];
+			bodies.az[i] += gravity * a[2];
+		}
+	});
+}
+
+/******************************************************************************
+*                                                                             *
+*                   ParticleMeshSolver::computeAccelerations                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bodies                                                              *
+*           The bodies whose accelerations are to be computed.                *
+*  @param gravity                                                             *
+*           The gravitational constant.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Places the mesh, deposits the masses, solves for the potential,          *
+*  differentiates and interpolates it, then applies the short range         *
+*  correction if enabled.                                                     *
+*                                                                             *
+*******************************************************************************/
+void ParticleMeshSolver::computeAccelerations(BodyArrays &bodies,
+                                              double gravity)
+{
+	if (bodies.count == 0)
+		return;
+	const GLuint m = 2 * size;
+	if (green.size() != (size_t) (size + 1) * m * m)
+		computeGreen();
+
+	placeMesh(bodies);
+	deposit(bodies);
+	solvePotential(gravity);
+	differentiate();
+	interpolate(bodies);
+	if (shortRange)
+		correctShortRange(bodies, gravity);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <complex>
+#include <vector>
+#include "GravitySolver.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Default mesh nodes per axis (a power of two). */
+#define  DEFAULT_MESH_SIZE          64
+/* Short range correction radius, in mesh cells. */
+#define  P3M_CUTOFF_CELLS           3.0
+
+/******************************************************************************
+*                                                                             *
+*                       ParticleMeshSolver  (class)                           *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  size                                                                       *
+*          Mesh nodes per axis, N. The transforms run on a 2N grid.           *
+*  softening                                                                  *
+*          Softening length of the short range pair forces.                   *
+*  shortRange                                                                 *
+*          Whether the P3M short range correction is applied.                 *
+*  origin, spacing                                                            *
+*          Position of node (0, 0, 0) and the distance between nodes.        *
+*  grid                                                                       *
+*          Real (2N)^3 grid: the deposited masses, then the potential.        *
+*  spectrum                                                                   *
+*          Its transform, (N + 1) x 2N x 2N (x halved by symmetry).           *
+*  green                                                                      *
+*          Transform of the Green's function for unit spacing (real).         *
+*  twiddles                                                                   *
+*          exp(-2 pi i k / 2N) for the FFTs.                                  *
+*  meshX, meshY, meshZ                                                        *
+*          Acceleration at each of the N^3 nodes.                             *
+*  cellOf, order, planeStart                                                  *
+*          Lowest z plane of each body's cloud, and the bodies sorted by it. *
+*  binStart, binOrder                                                         *
+*          Bodies sorted into P3M_CUTOFF_CELLS wide bins (short range).       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Particle-mesh gravity with isolated boundaries (Hockney and Eastwood).    *
+*  The masses are spread cloud-in-cell over the N^3 nodes of a cube around   *
+*  the bodies, which sits in one corner of a zero padded (2N)^3 grid, so the *
+*  cyclic convolution with the Green's function -G / r computed by FFT      *
+*  equals the open-space sum. The transforms are real-to-complex along x    *
+*  and complex along y and z, line by line in parallel. The accelerations   *
+*  are central differences of the potential, interpolated back to the bodies *
+*  with the same cloud-in-cell weights (so a body does not pull on itself).  *
+*  Deposits run in parallel over z planes: a cloud covers its plane and the  *
+*  next, so the even planes are done together, then the odd ones, and no    *
+*  two tasks write the same node. The cost is O(n + N^3 log N) per step.     *
+*                                                                             *
+*  The mesh resolves nothing smaller than a cell. With the P3M correction,   *
+*  pairs closer than P3M_CUTOFF_CELLS cells have their mesh force (taken as *
+*  that of a mass smoothed over half a cell) replaced by the softened exact *
+*  force, found through a grid of bins of the cutoff width.                  *
+*                                                                             *
+*******************************************************************************/
+class ParticleMeshSolver : public GravitySolver
+{
+public:
+	/* Constructor. */
+	               ParticleMeshSolver(GLuint size = DEFAULT_MESH_SIZE,
+	                                  double softening = DEFAULT_SOFTENING);
+
+	/* Compute the acceleration of every body. */
+	void           computeAccelerations(BodyArrays &bodies,
+	                                    double      gravity) override;
+
+	/* Getters. */
+	GLuint         getSize()                 const {  return size;         }
+	double         getSpacing()              const {  return spacing;      }
+	bool           getShortRange()           const {  return shortRange;   }
+
+	/* Setters. */
+	void           setSize(GLuint n);
+	void           setShortRange(bool enabled)     {  shortRange = enabled; }
+	void           setSoftening(double s)          {  softening = s;       }
+
+private:
+	typedef std::complex<double> Complex;
+
+	/* Parameters. */
+	GLuint         size;
+	double         softening;
+	bool           shortRange;
+	/* Mesh placement. */
+	double         origin[3];
+	double         spacing;
+	/* Grids. */
+	std::vector<double>   grid;
+	std::vector<Complex>  spectrum;
+	std::vector<double>   green;
+	std::vector<Complex>  twiddles;
+	std::vector<double>   meshX, meshY, meshZ;
+	/* Deposit order. */
+	std::vector<GLuint>   cellOf, order, planeStart;
+	/* Short range bins. */
+	std::vector<GLuint>   binStart, binOrder;
+
+	/* Steps of computeAccelerations. */
+	void           placeMesh(const BodyArrays &bodies);
+	void           deposit(const BodyArrays &bodies);
+	void           solvePotential(double gravity);
+	void           differentiate();
+	void           interpolate(BodyArrays &bodies);
+	void           correctShortRange(BodyArrays &bodies, double gravity);
+	/* Transforms of the whole grid. */
+	void           forward();
+	void           inverse();
+	void           computeGreen();
+	/* In-place complex FFT of a power of two length (stride into twiddles).*/
+	void           fft(Complex* data, GLuint length, bool invert) const;
+};
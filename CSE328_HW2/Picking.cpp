@@ -0,0 +1,94 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Picking.h"
+#include <cfloat>
+
+/******************************************************************************
+*                                                                             *
+*                              ScenePicker::pick                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param meshes                                                              *
+*           The meshes to test, in world space.                               *
+*  @param origin, direction                                                   *
+*           The ray in world space (direction need not be normalized).        *
+*  @param result                                                              *
+*           Set to the closest hit, if any.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  true if any triangle was hit.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bounds every triangle mesh in world space (building its BVH if this is     *
+*  its first query), builds the top level over them, then walks it nearest    *
+*  first, handing the ray to each instance it reaches. Each hit shortens      *
+*  the ray, so boxes behind it are skipped at both levels. Meshes with a      *
+*  singular transformation (scaled to nothing) cannot be hit.                 *
+*                                                                             *
+*******************************************************************************/
+bool ScenePicker::pick(const std::vector<Mesh*> &meshes,
+                       const glm::vec3 &origin, const glm::vec3 &direction,
+                       PickResult* result)
+{
+	/* Bound each instance in world space. */
+	instances.clear();
+	toModel.clear();
+	lower.clear();
+	upper.clear();
+	for (GLuint i = 0; i < meshes.size(); i++)
+	{
+		const TriangleBVH* bvh = meshes[i]->getBVH();
+		if (bvh == NULL || bvh->empty())
+			continue;
+		glm::mat4 toWorld = meshes[i]->getTransform();
+		if (glm::determinant(toWorld) == 0.0f)
+			continue;
+
+		const BVHNode &box = bvh->getBounds();
+		glm::vec3 boxLower(FLT_MAX), boxUpper(-FLT_MAX);
+		for (GLuint c = 0; c < 8; c++)
+		{
+			glm::vec4 corner((c & 1) ? box.upper.x : box.lower.x,
+			                 (c & 2) ? box.upper.y : box.lower.y,
+			                 (c & 4) ? box.upper.z : box.lower.z, 1.0f);
+			glm::vec3 p = glm::vec3(toWorld * corner);
+			boxLower = glm::min(boxLower, p);
+			boxUpper = glm::max(boxUpper, p);
+		}
+		instances.push_back(i);
+		toModel.push_back(glm::inverse(toWorld));
+		lower.push_back(boxLower);
+		upper.push_back(boxUpper);
+	}
+	tree.build(lower, upper);
+
+	/* Walk the instances nearest first, shortening the ray at each hit. */
+	const std::vector<GLuint> &order = tree.getOrder();
+	GLfloat maxT = FLT_MAX;
+	bool    hit = false;
+	tree.traverse(origin, direction, &maxT, [&](GLuint i)
+	{
+		GLuint    k = order[i];
+		glm::vec3 modelOrigin = glm::vec3(toModel[k] * glm::vec4(origin, 1.0f));
+		glm::vec3 modelDirection =
+			glm::vec3(toModel[k] * glm::vec4(direction, 0.0f));
+		GLuint    triangle;
+		glm::vec2 barycentric;
+		if (meshes[instances[k]]->getBVH()->intersect(modelOrigin,
+			modelDirection, &maxT, &triangle, &barycentric))
+		{
+			result->mesh = instances[k];
+			result->triangle = triangle;
+			result->barycentric = barycentric;
+			result->distance = maxT;
+			hit = true;
+		}
+	});
+	return hit;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+#include <vector>
+#include "BVH.h"
+#include "Geometry.h"
+
+/******************************************************************************
+*                                                                             *
+*                             PickResult  (struct)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  mesh                                                                       *
+*          Index of the mesh hit in the list given to ScenePicker::pick.      *
+*  triangle                                                                   *
+*          Index of the triangle hit within the mesh (first index / 3).       *
+*  barycentric                                                                *
+*          Weights of the triangle's second and third corners at the hit      *
+*          (the first has 1 - u - v).                                         *
+*  distance                                                                   *
+*          Distance from the ray origin to the hit, in units of the ray       *
+*          direction.                                                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The closest triangle along a picking ray.                                  *
+*                                                                             *
+*******************************************************************************/
+struct PickResult
+{
+	GLuint         mesh;
+	GLuint         triangle;
+	glm::vec2      barycentric;
+	GLfloat        distance;
+};
+
+/******************************************************************************
+*                                                                             *
+*                             ScenePicker  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  tree                                                                       *
+*          Top level BVH over the world bounds of the meshes.                 *
+*  instances                                                                  *
+*          Index of the mesh behind each primitive of the tree.               *
+*  toModel                                                                    *
+*          World to model transformation of each instance.                    *
+*  lower, upper                                                               *
+*          World bounds of each instance while building.                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Two level ray queries against a list of meshes. The meshes move every      *
+*  frame, so the top level is rebuilt at each query from the root boxes of    *
+*  their triangle BVHs carried through getTransform() (as of the last         *
+*  TransformSystem update, i.e. what was drawn). That costs one pass over     *
+*  the meshes; the triangles are only touched by the per-mesh BVHs, which     *
+*  are built once. A ray reaching an instance's box is taken into its model   *
+*  space unnormalized, so distances along it need no conversion.              *
+*                                                                             *
+*******************************************************************************/
+class ScenePicker
+{
+public:
+	/* Closest triangle hit by the ray; returns false on a miss. */
+	bool             pick(const std::vector<Mesh*> &meshes,
+	                      const glm::vec3 &origin, const glm::vec3 &direction,
+	                      PickResult* result);
+
+private:
+	BVH                     tree;
+	std::vector<GLuint>     instances;
+	std::vector<glm::mat4>  toModel;
+	std::vector<glm::vec3>  lower;
+	std::vector<glm::vec3>  upper;
+};
@@ -0,0 +1,690 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "SceneBenchmark.h"
+#include "AssetCache.h"
+#include "Display.h"
+#include "Geometry.h"
+#include "OrbitalSystem.h"
+#include "Parallel.h"
+#include "ShaderLibrary.h"
+#include "TransformSystem.h"
+#include "tiny_obj_loader.h"
+#include "tinyxml2.h"
+#include <SDL\SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Window of the repaint benchmark. */
+#define BENCHMARK_WIDTH   800
+#define BENCHMARK_HEIGHT  600
+
+/******************************************************************************
+*                                                                             *
+*                              writeString (file static)                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param file                                                                *
+*           Output file.                                                      *
+*  @param text                                                                *
+*           The string.                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes text as a quoted JSON string, escaping quotes, backslashes and      *
+*  control characters (the renderer name comes from the driver).              *
+*                                                                             *
+*******************************************************************************/
+static void writeString(FILE* file, const std::string &text)
+{
+	fputc('"', file);
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if ((unsigned char) c < 0x20)
+			fprintf(file, "\\u%04x", (unsigned char) c);
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+/******************************************************************************
+*                                                                             *
+*                         SceneBenchmark::measure (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param name                                                                *
+*           Name of the benchmark in the results.                             *
+*  @param ops                                                                 *
+*           Operations done by one call of body.                              *
+*  @param body                                                                *
+*           The timed code.                                                   *
+*  @param reset                                                               *
+*           Untimed code run after each call (may be empty), e.g. to free     *
+*           what body made.                                                   *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  One untimed call warms the caches first. The median is printed as the      *
+*  benchmark finishes.                                                        *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::measure(const std::string &name, GLuint ops,
+                             const std::function<void()> &body,
+                             const std::function<void()> &reset,
+                             std::vector<Result>* results)
+{
+	const double frequency = (double) SDL_GetPerformanceFrequency();
+	Result result;
+	result.name = name;
+	result.ops = ops;
+
+	body();
+	if (reset)
+		reset();
+
+	double total = 0.0;
+	while (result.seconds.size() < SCENE_BENCHMARK_MIN_SAMPLES ||
+		(total < SCENE_BENCHMARK_SECONDS &&
+		 result.seconds.size() < SCENE_BENCHMARK_MAX_SAMPLES))
+	{
+		Uint64 start = SDL_GetPerformanceCounter();
+		body();
+		double seconds = (SDL_GetPerformanceCounter() - start) / frequency;
+		result.seconds.push_back(seconds);
+		total += seconds;
+		if (reset)
+			reset();
+	}
+
+	std::vector<double> sorted(result.seconds);
+	std::sort(sorted.begin(), sorted.end());
+	fprintf(stdout, "Stats: %-44s %12.3f us/op (%u samples)\n", name.c_str(),
+		sorted[sorted.size() / 2] * 1.0e6 / ops, (GLuint) sorted.size());
+	results->push_back(result);
+}
+
+/******************************************************************************
+*                                                                             *
+*                      SceneBenchmark::benchGeometry (static)                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The sphere at every level, both copied from the tables of makeSphere       *
+*  <Level> and tesselated by makeSphere(radius, level); middlePointIndex      *
+*  over every edge of a level 3 sphere; and the cube, cylinder and cone.      *
+*  Freeing the meshes is not timed.                                           *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::benchGeometry(std::vector<Result>* results)
+{
+	Geometry::deferUploads = true;
+	Mesh* mesh = NULL;
+	auto freeMesh = [&mesh]
+	{
+		mesh->cleanUp();
+		delete mesh;
+		mesh = NULL;
+	};
+
+	/* Copies of the tabulated spheres. */
+	measure("Geometry::makeSphere<0>", 1,
+		[&] { mesh = Geometry::makeSphere<0>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<1>", 1,
+		[&] { mesh = Geometry::makeSphere<1>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<2>", 1,
+		[&] { mesh = Geometry::makeSphere<2>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<3>", 1,
+		[&] { mesh = Geometry::makeSphere<3>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<4>", 1,
+		[&] { mesh = Geometry::makeSphere<4>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<5>", 1,
+		[&] { mesh = Geometry::makeSphere<5>(); }, freeMesh, results);
+	measure("Geometry::makeSphere<6>", 1,
+		[&] { mesh = Geometry::makeSphere<6>(); }, freeMesh, results);
+
+	/* Spheres tesselated on every call. */
+	for (GLuint level = 0; level <= MAX_SPHERE_LEVEL; level++)
+		measure("Geometry::makeSphere(1, " + std::to_string(level) + ")", 1,
+			[&] { mesh = Geometry::makeSphere(1.0f, level); }, freeMesh,
+			results);
+
+	/* One midpoint per edge of every triangle, from an empty cache. */
+	std::vector<Vertex>   sphere;
+	std::vector<GLushort> indices;
+	Geometry::buildSphere(3, 1.0f, &sphere, &indices);
+	std::vector<Vertex>   vertices(sphere);
+	std::map<GLuint, GLushort> cache;
+	measure("Geometry::middlePointIndex", indices.size(), [&]
+	{
+		for (GLuint i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Geometry::middlePointIndex(indices[i], indices[i + 1],
+				&vertices, &cache);
+			Geometry::middlePointIndex(indices[i + 1], indices[i + 2],
+				&vertices, &cache);
+			Geometry::middlePointIndex(indices[i + 2], indices[i],
+				&vertices, &cache);
+		}
+	}, [&]
+	{
+		vertices = sphere;
+		cache.clear();
+	}, results);
+
+	/* The other builders. */
+	measure("Geometry::makeCube", 1,
+		[&] { mesh = Geometry::makeCube(1.0f); }, freeMesh, results);
+	measure("Geometry::makeCylinder", 1,
+		[&] { mesh = Geometry::makeCylinder(1.0f, 4.0f); }, freeMesh, results);
+	measure("Geometry::makeCone", 1,
+		[&] { mesh = Geometry::makeCone(1.0f, 4.0f); }, freeMesh, results);
+
+	Geometry::deferUploads = false;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        SceneBenchmark::benchObj (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Loads generated grids of two sizes (the larger close to the 16-bit         *
+*  index limit) with Geometry::loadObj and with tinyobj::LoadObj.             *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::benchObj(std::vector<Result>* results)
+{
+	const GLuint sides[] = { 64, 255 };
+	Geometry::deferUploads = true;
+	Mesh* mesh = NULL;
+	for (GLuint side : sides)
+	{
+		if (!writeObj(SCENE_BENCHMARK_OBJ, side))
+			continue;
+		const std::string size = " (" + std::to_string(side * side) +
+			" vertices)";
+
+		measure("Geometry::loadObj" + size, 1,
+			[&] { mesh = Geometry::loadObj(SCENE_BENCHMARK_OBJ); }, [&]
+		{
+			if (mesh != NULL)
+			{
+				mesh->cleanUp();
+				delete mesh;
+				mesh = NULL;
+			}
+		}, results);
+		measure("tinyobj::LoadObj" + size, 1, []
+		{
+			std::vector<tinyobj::shape_t>    shapes;
+			std::vector<tinyobj::material_t> materials;
+			tinyobj::LoadObj(shapes, materials, SCENE_BENCHMARK_OBJ);
+		}, nullptr, results);
+	}
+	remove(SCENE_BENCHMARK_OBJ);
+	Geometry::deferUploads = false;
+}
+
+/******************************************************************************
+*                                                                             *
+*                     SceneBenchmark::benchTransforms (static)                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads the transformation of SCENE_BENCHMARK_TRANSFORMS meshes, and         *
+*  turns all of them and composes the matrices again as a frame does.         *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::benchTransforms(std::vector<Result>* results)
+{
+	std::vector<Mesh*> meshes(SCENE_BENCHMARK_TRANSFORMS);
+	for (GLuint i = 0; i < meshes.size(); i++)
+	{
+		meshes[i] = new Mesh();
+		meshes[i]->translateModel(glm::vec3((GLfloat) i, 0.0f, 0.0f));
+		meshes[i]->rotateModel(0.01f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	TransformSystem::get().update();
+
+	/* Sum the matrices so the reads are not optimized away. */
+	glm::mat4 sum(0.0f);
+	measure("Mesh::getTransform", meshes.size(), [&]
+	{
+		for (Mesh* m : meshes)
+			sum += m->getTransform();
+	}, nullptr, results);
+
+	GLfloat angle = 0.0f;
+	measure("TransformSystem::update (all turned)", meshes.size(), [&]
+	{
+		angle += 0.01f;
+		TransformSystem::get().setAllRotations(angle,
+			glm::vec3(0.0f, 1.0f, 0.0f));
+		TransformSystem::get().update();
+	}, nullptr, results);
+
+	if (sum[3][3] == 0.0f)
+		fprintf(stdout, "Stats: No transformations were read\n");
+	for (Mesh* m : meshes)
+	{
+		m->cleanUp();
+		delete m;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        SceneBenchmark::benchXml (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Parses generated systems of two sizes into a tinyxml2 document (from       *
+*  memory, so only the parse is timed) and loads them with                    *
+*  OrbitalSystem::loadXml (the streaming parser, from the file).              *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::benchXml(std::vector<Result>* results)
+{
+	const GLuint sizes[] = { 1000, 10000 };
+	for (GLuint n : sizes)
+	{
+		if (!writeSystem(SCENE_BENCHMARK_XML, n))
+			continue;
+		std::ifstream in(SCENE_BENCHMARK_XML, std::ios::binary);
+		const std::string text((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+		in.close();
+		const std::string size = " (" + std::to_string(n) + " bodies)";
+
+		measure("tinyxml2::XMLDocument::Parse" + size, 1, [&]
+		{
+			tinyxml2::XMLDocument document;
+			document.Parse(text.c_str(), text.size());
+		}, nullptr, results);
+		measure("OrbitalSystem::loadXml" + size, 1, []
+		{
+			AssetCache    assets;
+			OrbitalSystem system;
+			system.loadXml(SCENE_BENCHMARK_XML, &assets);
+		}, nullptr, results);
+	}
+	remove(SCENE_BENCHMARK_XML);
+}
+
+/******************************************************************************
+*                                                                             *
+*                      SceneBenchmark::benchRepaint (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param results                                                             *
+*           The samples are appended here.                                    *
+*  @param renderer                                                            *
+*           Set to the GL renderer the scene was drawn with.                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Draws SCENE_BENCHMARK_MESHES shapes in a ring, turning them every frame    *
+*  as the viewer does. Vertical sync is turned off and each sample waits      *
+*  for the GL to finish, so a sample is the whole cost of a frame.            *
+*                                                                             *
+*******************************************************************************/
+void SceneBenchmark::benchRepaint(std::vector<Result>* results,
+                                  std::string* renderer)
+{
+	if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0 ||
+		SDL_GetNumVideoDisplays() < 1)
+	{
+		fprintf(stdout, "Stats: No display, repaint not measured\n");
+		return;
+	}
+
+	{
+		Display display("Scene Benchmark", BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+		if (SDL_GL_GetCurrentContext() == NULL)
+		{
+			fprintf(stdout, "Stats: No GL context, repaint not measured\n");
+			SDL_QuitSubSystem(SDL_INIT_VIDEO);
+			return;
+		}
+		SDL_GL_SetSwapInterval(0);
+		*renderer = (const char*) glGetString(GL_RENDERER);
+
+		ShaderLibrary shaders(DEFAULT_VERTEX_SHADER, DEFAULT_FRAGMENT_SHADER);
+		shaders.compileVariants({ SHADER_NONE });
+		Geometry::shader = shaders.getVariant(SHADER_NONE);
+		display.setShader(Geometry::shader);
+
+		/* A ring of the four kinds of shape. */
+		std::vector<Mesh*> meshes;
+		for (GLuint i = 0; i < SCENE_BENCHMARK_MESHES; i++)
+		{
+			Mesh* m;
+			switch (i % 4)
+			{
+			case 0:  m = Geometry::makeSphere<3>(1.0f);        break;
+			case 1:  m = Geometry::makeCube(1.0f);             break;
+			case 2:  m = Geometry::makeCylinder(1.0f, 2.0f);   break;
+			default: m = Geometry::makeCone(1.0f, 2.0f);       break;
+			}
+			GLfloat a = (GLfloat) (2 * M_PI * i / SCENE_BENCHMARK_MESHES);
+			m->translateModel(glm::vec3(cosf(a) * 6.0f, 0.0f, sinf(a) * 6.0f));
+			m->scaleModel(glm::vec3(0.5f));
+			meshes.push_back(m);
+		}
+
+		GLfloat t = 0.0f;
+		measure("Display::repaint (" + std::to_string(meshes.size()) +
+			" meshes)", 1, [&]
+		{
+			t += 0.003f;
+			TransformSystem::get().setAllRotations(t,
+				glm::vec3(0.0f, 1.0f, 0.0f));
+			display.repaint(meshes);
+			glFinish();
+		}, nullptr, results);
+
+		for (Mesh* m : meshes)
+		{
+			m->cleanUp();
+			delete m;
+		}
+		Geometry::shader = NULL;
+	}
+	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+/******************************************************************************
+*                                                                             *
+*                        SceneBenchmark::writeObj (static)                    *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param path                                                                *
+*           File to write.                                                    *
+*  @param side                                                                *
+*           Vertices along each side of the grid (at most 256).               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was written.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  A rippled square with positions, texture coordinates and normals, two      *
+*  triangles per cell. Every corner uses the same index for all three, so     *
+*  the loaded mesh has exactly side * side vertices.                          *
+*                                                                             *
+*******************************************************************************/
+bool SceneBenchmark::writeObj(const char* path, GLuint side)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		std::cerr << "Error writing benchmark input: " << path
+		          << " could not be opened" << std::endl;
+		return false;
+	}
+
+	const GLfloat step = 2.0f / (side - 1);
+	for (GLuint j = 0; j < side; j++)
+		for (GLuint i = 0; i < side; i++)
+			fprintf(file, "v %f %f %f\n", -1.0f + i * step,
+				0.1f * sinf(8.0f * i * step), -1.0f + j * step);
+	for (GLuint j = 0; j < side; j++)
+		for (GLuint i = 0; i < side; i++)
+			fprintf(file, "vt %f %f\n", i * step * 0.5f, j * step * 0.5f);
+	for (GLuint j = 0; j < side; j++)
+		for (GLuint i = 0; i < side; i++)
+		{
+			glm::vec3 n = glm::normalize(glm::vec3(
+				-0.8f * cosf(8.0f * i * step), 1.0f, 0.0f));
+			fprintf(file, "vn %f %f %f\n", n.x, n.y, n.z);
+		}
+	for (GLuint j = 0; j + 1 < side; j++)
+		for (GLuint i = 0; i + 1 < side; i++)
+		{
+			GLuint a = j * side + i + 1, b = a + 1;
+			GLuint c = a + side, d = c + 1;
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n",
+				a, a, a, c, c, c, b, b, b);
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n",
+				b, b, b, c, c, c, d, d, d);
+		}
+
+	bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
+
+/******************************************************************************
+*                                                                             *
+*                      SceneBenchmark::writeSystem (static)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param path                                                                *
+*           File to write.                                                    *
+*  @param n                                                                   *
+*           Number of bodies.                                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was written.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  A disc of random bodies (the same on every run) saved with                 *
+*  OrbitalSystem::saveXml, so the file has the layout of a real one.          *
+*                                                                             *
+*******************************************************************************/
+bool SceneBenchmark::writeSystem(const char* path, GLuint n)
+{
+	std::mt19937 generator(328);
+	std::normal_distribution<double> disc(0.0, 1.5e11);
+	std::normal_distribution<double> speed(0.0, 3.0e4);
+	std::uniform_real_distribution<double> mass(1.0e22, 1.0e25);
+
+	AssetCache    assets;
+	OrbitalSystem system;
+	BodyArrays   &bodies = system.getBodies();
+	bodies.resize(n);
+	for (GLuint i = 0; i < n; i++)
+	{
+		bodies.name[i] = "Body " + std::to_string(i);
+		bodies.px[i] = disc(generator);
+		bodies.py[i] = 0.05 * disc(generator);
+		bodies.pz[i] = disc(generator);
+		bodies.vx[i] = speed(generator);
+		bodies.vy[i] = 0.05 * speed(generator);
+		bodies.vz[i] = speed(generator);
+		bodies.mass[i] = mass(generator);
+		bodies.radius[i] = 1.0e6;
+	}
+	return system.saveXml(path, assets);
+}
+
+/******************************************************************************
+*                                                                             *
+*                        SceneBenchmark::writeJson (static)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param path                                                                *
+*           File to write.                                                    *
+*  @param results                                                             *
+*           Samples of every benchmark.                                       *
+*  @param renderer                                                            *
+*           GL renderer of the repaint benchmark ("none" if not run).         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was written.                                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  One object per benchmark with its operations per sample, number of         *
+*  samples and the summary of nanoseconds per operation. The standard         *
+*  deviation is of the samples (n - 1); ci95 is the half width of the         *
+*  normal 95% confidence interval of the mean. Percentiles are nearest        *
+*  rank.                                                                      *
+*                                                                             *
+*******************************************************************************/
+bool SceneBenchmark::writeJson(const char* path,
+                               const std::vector<Result> &results,
+                               const std::string &renderer)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		std::cerr << "Error writing benchmark results: " << path
+		          << " could not be opened" << std::endl;
+		return false;
+	}
+
+	fprintf(file, "{\n  \"suite\": \"scene\",\n  \"threads\": %u,\n"
+		"  \"renderer\": ", Parallel::getNumThreads());
+	writeString(file, renderer);
+	fprintf(file, ",\n  \"benchmarks\": [\n");
+	for (GLuint r = 0; r < results.size(); r++)
+	{
+		const Result &result = results[r];
+		std::vector<double> ns(result.seconds);
+		for (double &s : ns)
+			s *= 1.0e9 / result.ops;
+		std::sort(ns.begin(), ns.end());
+
+		const GLuint count = ns.size();
+		double mean = 0.0;
+		for (double s : ns)
+			mean += s;
+		mean /= count;
+		double variance = 0.0;
+		for (double s : ns)
+			variance += (s - mean) * (s - mean);
+		double deviation = (count > 1) ? sqrt(variance / (count - 1)) : 0.0;
+		GLuint p95 = (GLuint) ceil(0.95 * count) - 1;
+
+		fprintf(file, "    { \"name\": ");
+		writeString(file, result.name);
+		fprintf(file, ", \"ops\": %u, \"samples\": %u,\n"
+			"      \"ns_per_op\": { \"mean\": %.6g, \"stddev\": %.6g, "
+			"\"ci95\": %.6g, \"min\": %.6g, \"median\": %.6g, "
+			"\"p95\": %.6g, \"max\": %.6g } }%s\n", result.ops, count, mean,
+			deviation, 1.96 * deviation / sqrt((double) count), ns[0],
+			ns[(count - 1) / 2], ns[p95], ns[count - 1],
+			(r + 1 < results.size()) ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           SceneBenchmark::run (static)                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param jsonFile                                                            *
+*           File the results are written to.                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the results were written.                                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs the CPU benchmarks, then the repaint benchmark if a display can be    *
+*  opened, printing each median as it goes.                                   *
+*                                                                             *
+*******************************************************************************/
+bool SceneBenchmark::run(const char* jsonFile)
+{
+	fprintf(stdout, "Stats: Scene benchmark on %u threads\n",
+		Parallel::getNumThreads());
+
+	std::vector<Result> results;
+	std::string renderer = "none";
+	benchGeometry(&results);
+	benchObj(&results);
+	benchTransforms(&results);
+	benchXml(&results);
+	benchRepaint(&results, &renderer);
+
+	if (!writeJson(jsonFile, results, renderer))
+		return false;
+	fprintf(stdout, "Stats: Wrote %u benchmarks to %s\n",
+		(GLuint) results.size(), jsonFile);
+	return true;
+}
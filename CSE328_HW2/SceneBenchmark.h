@@ -0,0 +1,97 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flag which runs the suite instead of the viewer, followed */
+/* by the JSON file to write (SCENE_BENCHMARK_JSON if none).               */
+#define  SCENE_BENCHMARK_FLAG       "--benchmark-scene"
+#define  SCENE_BENCHMARK_JSON       "benchmark.json"
+/* Minimum measured time per benchmark, in seconds. */
+#define  SCENE_BENCHMARK_SECONDS    0.5
+/* Samples taken per benchmark however long they take, and at most. */
+#define  SCENE_BENCHMARK_MIN_SAMPLES 10
+#define  SCENE_BENCHMARK_MAX_SAMPLES 10000
+/* Generated input files (removed afterwards). */
+#define  SCENE_BENCHMARK_OBJ        "res/cache/benchmark.obj"
+#define  SCENE_BENCHMARK_XML        "res/cache/benchmark.xml"
+/* Meshes whose transformations are read per sample. */
+#define  SCENE_BENCHMARK_TRANSFORMS 4096
+/* Meshes drawn per frame in the repaint benchmark. */
+#define  SCENE_BENCHMARK_MESHES     64
+
+/******************************************************************************
+*                                                                             *
+*                          SceneBenchmark  (class)                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to time the geometry, asset and       *
+*  rendering code: the shape builders, OBJ and system.xml loading on          *
+*  generated files, reading mesh transformations, and repainting a scene.     *
+*  Each benchmark is repeated until it has run SCENE_BENCHMARK_SECONDS and    *
+*  at least SCENE_BENCHMARK_MIN_SAMPLES times, one sample per call (calls     *
+*  doing many small operations are divided by their count). The results       *
+*  are written as JSON with the mean, standard deviation, 95% confidence      *
+*  interval, minimum, median, 95th percentile and maximum of each, in         *
+*  nanoseconds per operation, so runs can be stored and compared per          *
+*  commit.                                                                    *
+*                                                                             *
+*  The CPU benchmarks leave the GL buffers unmade (Geometry::deferUploads)    *
+*  and need no display. The repaint benchmark needs a window and context;     *
+*  on a machine without a GPU, run it under a virtual X server with Mesa's    *
+*  software renderer (LIBGL_ALWAYS_SOFTWARE=1, llvmpipe). The renderer is     *
+*  recorded in the output, and the benchmark is skipped without a display.    *
+*                                                                             *
+*******************************************************************************/
+class SceneBenchmark
+{
+public:
+	/* Run every benchmark and write the results; false on a write error. */
+	static bool     run(const char* jsonFile);
+
+private:
+	/* Samples of one benchmark, in seconds per call. */
+	struct Result
+	{
+		std::string          name;
+		GLuint               ops;
+		std::vector<double>  seconds;
+	};
+
+	/* Time body (which does ops operations) until enough samples. */
+	static void     measure(const std::string &name, GLuint ops,
+	                        const std::function<void()> &body,
+	                        const std::function<void()> &reset,
+	                        std::vector<Result>* results);
+
+	/* The benchmarks of each subsystem. */
+	static void     benchGeometry(std::vector<Result>* results);
+	static void     benchObj(std::vector<Result>* results);
+	static void     benchTransforms(std::vector<Result>* results);
+	static void     benchXml(std::vector<Result>* results);
+	static void     benchRepaint(std::vector<Result>* results,
+	                             std::string* renderer);
+
+	/* Generate a square grid OBJ with side * side vertices. */
+	static bool     writeObj(const char* path, GLuint side);
+	/* Generate a system.xml with n random bodies. */
+	static bool     writeSystem(const char* path, GLuint n);
+	/* Write the summaries of every result. */
+	static bool     writeJson(const char* path,
+	                          const std::vector<Result> &results,
+	                          const std::string &renderer);
+};
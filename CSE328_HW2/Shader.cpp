@@ -6,6 +6,55 @@
 #include "Shader.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <algorithm>
+
+/******************************************************************************
+*                                                                             *
+*                        uniformTypeSize (file static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param type                                                                *
+*           GL type of a uniform as reported by glGetActiveUniform.           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           Number of bytes in one element of the indicated type.             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sizes the shadow copy of a uniform. Samplers and booleans are set through  *
+*  glUniform1i and therefore take the size of a GLint.                        *
+*                                                                             *
+******************************************************************************/
+static GLuint uniformTypeSize(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT_VEC2:
+	case GL_INT_VEC2:
+	case GL_BOOL_VEC2:
+		return 2 * sizeof(GLfloat);
+	case GL_FLOAT_VEC3:
+	case GL_INT_VEC3:
+	case GL_BOOL_VEC3:
+		return 3 * sizeof(GLfloat);
+	case GL_FLOAT_VEC4:
+	case GL_INT_VEC4:
+	case GL_BOOL_VEC4:
+	case GL_FLOAT_MAT2:
+		return 4 * sizeof(GLfloat);
+	case GL_FLOAT_MAT3:
+		return 9 * sizeof(GLfloat);
+	case GL_FLOAT_MAT4:
+		return 16 * sizeof(GLfloat);
+	default:
+		/* Scalars, booleans and samplers. */
+		return sizeof(GLfloat);
+	}
+}
 
 /******************************************************************************
 *                                                                             *
@@ -17,6 +66,8 @@
 *           Path to the GLSL file containing the vertex shader source code.   *
 *  @param fragmentShaderFilepath                                              *
 *           Path to the GLSL file containing the fragment shader soruce code. *
+*  @param features                                                            *
+*           Bitmask of ShaderFeature flags to compile the sources with.       *
 *                                                                             *
 *******************************************************************************
 * RETURNS                                                                     *
@@ -31,12 +82,56 @@
 *                                                                             *
 ******************************************************************************/
 Shader::Shader(std::string vertexShaderFilepath, 
-               std::string fragmentShaderFilepath)
+               std::string fragmentShaderFilepath,
+               GLuint      features) :
+	program(0), features(features)
 {
 	/* Load the source code (GLSL) into the indicated strings.*/
-	std::string vertexShaderSource = loadShaderSource(vertexShaderFilepath);
-	std::string fragmentShaderSource = loadShaderSource(fragmentShaderFilepath);
+	std::string vertexShaderSource = preprocess(
+		loadShaderSource(vertexShaderFilepath), features);
+	std::string fragmentShaderSource = preprocess(
+		loadShaderSource(fragmentShaderFilepath), features);
+
+	/* Compile and link the program, then wait for the result. */
+	submit(vertexShaderSource, fragmentShaderSource, false);
+
+	/* If compiling or linking failed, return. */
+	if (!finish())
+		return;
+
+	/* Tell OpenGL to use this program. */
+	glUseProgram(program);
+}
 
+/******************************************************************************
+*                                                                             *
+*                              Shader::submit                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertexSource                                                        *
+*           Preprocessed GLSL source code of the vertex shader.               *
+*  @param fragmentSource                                                      *
+*           Preprocessed GLSL source code of the fragment shader.             *
+*  @param retrievable                                                         *
+*           Whether the driver should keep the linked binary retrievable.     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the shader objects and the program and issues the compile and     *
+*  link commands. No status is queried here, so drivers which compile in the  *
+*  background (KHR_parallel_shader_compile) are free to overlap the work of   *
+*  several programs until finish() is called on each of them.                 *
+*                                                                             *
+******************************************************************************/
+void Shader::submit(const std::string &vertexSource,
+                    const std::string &fragmentSource,
+                    bool               retrievable)
+{
 	/* Create the shader program. */
 	program = glCreateProgram();
 
@@ -46,15 +141,57 @@ Shader::Shader(std::string vertexShaderFilepath,
 
 	/* Add the source code to the shaders. */
 	const char* input[1];
-	input[0] = vertexShaderSource.c_str();
+	input[0] = vertexSource.c_str();
 	glShaderSource(shaders[0], 1, input, 0);
-	input[0] = fragmentShaderSource.c_str();
+	input[0] = fragmentSource.c_str();
 	glShaderSource(shaders[1], 1, input, 0);
 
 	/* Compile the added source code. */
 	glCompileShader(shaders[0]);
 	glCompileShader(shaders[1]); 
 
+	/* Attach the shaders to the program. */
+	glAttachShader(program, shaders[0]);
+	glAttachShader(program, shaders[1]);
+
+	/* Bind the indicated data attributes to the variables. */
+	glBindAttribLocation(program, 0, "modelPosition");
+	glBindAttribLocation(program, 1, "modelColor");
+	glBindAttribLocation(program, 2, "modelNormal");
+	glBindAttribLocation(program, 3, "modelTexCoord");
+	glBindAttribLocation(program, INSTANCE_ATTRIBUTE_LOCATION, 
+		"instanceModelToWorld");
+
+	/* Ask the driver to keep the binary around for the program cache. */
+	if (retrievable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 
+			GL_TRUE);
+
+	/* Link the shader objects. */
+	glLinkProgram(program);
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Shader::finish                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           True if the program compiled and linked, false otherwise.         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Waits for a program issued by submit() and reports any compile or link     *
+*  errors. The shader objects are released once the program is linked.        *
+*                                                                             *
+******************************************************************************/
+bool Shader::finish()
+{
 	/* If either of the shaders did not compile correctly, return. */
 	bool flag = false;
 	if (checkShaderError(shaders[0]))
@@ -67,28 +204,318 @@ Shader::Shader(std::string vertexShaderFilepath,
 		std::cerr << "Error with fragment shader!" << std::endl;
 		flag = true;
 	}
-	if(flag)
-		return;
 
-	/* Attach the shaders to the program. */
-	glAttachShader(program, shaders[0]);
-	glAttachShader(program, shaders[1]);
+	/* If linking failed, flag the error. */
+	if (!flag && checkProgramError(program))
+		flag = true;
 
-	/* Bind the indicated data attributes to the variables. */
-	glBindAttribLocation(program, 0, "modelPosition");
-	glBindAttribLocation(program, 1, "modelColor");
-	glBindAttribLocation(program, 2, "modelNormal");
-	glBindAttribLocation(program, 3, "modelTexCoord");
+	/* The linked program no longer needs the shader objects. */
+	glDetachShader(program, shaders[0]);
+	glDetachShader(program, shaders[1]);
+	glDeleteShader(shaders[0]);
+	glDeleteShader(shaders[1]);
+	shaders[0] = shaders[1] = 0;
 
-	/* Link the shader objects. */
-	glLinkProgram(program);
+	/* Build the uniform and attribute tables of the linked program. */
+	if (!flag)
+		reflect();
 
-	/* If linking failed, return. */
-	if (checkProgramError(program))
-		return;
+	/* Return whether the program is usable. */
+	return !flag;
+}
 
-	/* Tell OpenGL to use this program. */
-	glUseProgram(program);
+/******************************************************************************
+*                                                                             *
+*                             Shader::loadBinary                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param format                                                              *
+*           Driver specific format returned by glGetProgramBinary.            *
+*  @param binary                                                              *
+*           Bytes of the program binary.                                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           True if the driver accepted the binary, false otherwise.          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the program directly from a cached binary, skipping compilation.   *
+*  Drivers may reject a binary at any time (e.g. after an update), in which   *
+*  case the program is deleted and the caller must compile from source.       *
+*                                                                             *
+******************************************************************************/
+bool Shader::loadBinary(GLenum format, const std::vector<char> &binary)
+{
+	/* Create the program and hand the binary to the driver. */
+	program = glCreateProgram();
+	shaders[0] = shaders[1] = 0;
+	glProgramBinary(program, format, binary.data(), (GLsizei) binary.size());
+
+	/* Check the link status without reporting (a stale cache is expected). */
+	GLint linkStatus;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		program = 0;
+		return false;
+	}
+
+	/* Build the uniform and attribute tables of the loaded program. */
+	reflect();
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                               Shader::reflect                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Queries every active uniform and attribute of the linked program once and  *
+*  stores name, type, size and location in compact tables. Each uniform also  *
+*  receives a slot in the shadow buffer used to skip redundant updates.       *
+*                                                                             *
+******************************************************************************/
+void Shader::reflect()
+{
+	/* Start from empty tables. */
+	uniforms.clear();
+	attributes.clear();
+	uniformValues.clear();
+
+	/* Size the name buffer for the longest uniform or attribute name. */
+	GLint maxUniformLength = 0, maxAttributeLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxUniformLength);
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, 
+		&maxAttributeLength);
+	std::vector<GLchar> name(std::max(maxUniformLength, maxAttributeLength) 
+		+ 1);
+
+	/* Reflect the uniforms. */
+	GLint count = 0;
+	GLuint offset = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	uniforms.reserve(count);
+	for (GLint i = 0; i < count; i++)
+	{
+		ShaderUniform u;
+		GLsizei length = 0;
+		glGetActiveUniform(program, i, (GLsizei) name.size(), &length, 
+			&u.size, &u.type, name.data());
+		u.name.assign(name.data(), length);
+
+		/* Arrays are reported as "name[0]"; store them as "name". */
+		if (u.name.size() > 3 && 
+			u.name.compare(u.name.size() - 3, 3, "[0]") == 0)
+			u.name.resize(u.name.size() - 3);
+
+		/* Uniforms inside blocks have no location and are skipped. */
+		u.location = glGetUniformLocation(program, name.data());
+		if (u.location < 0)
+			continue;
+
+		u.bytes = uniformTypeSize(u.type);
+		u.offset = offset;
+		u.set = false;
+		offset += u.bytes;
+		uniforms.push_back(u);
+	}
+	uniformValues.resize(offset);
+
+	/* Reflect the attributes. */
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	attributes.reserve(count);
+	for (GLint i = 0; i < count; i++)
+	{
+		ShaderAttribute a;
+		GLsizei length = 0;
+		glGetActiveAttrib(program, i, (GLsizei) name.size(), &length, 
+			&a.size, &a.type, name.data());
+		a.name.assign(name.data(), length);
+		a.location = glGetAttribLocation(program, name.data());
+		attributes.push_back(a);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           Shader::getUniformIndex                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param name                                                                *
+*           Name of the uniform in the GLSL source.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           Index of the uniform in the table, or -1 if it is not active.     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Looks a uniform up by name. Intended to be called once per program, with   *
+*  the index kept by the caller for the per-draw setters. An index of -1 is   *
+*  accepted (and ignored) by every setter, so optimized-out uniforms need no  *
+*  special handling.                                                          *
+*                                                                             *
+******************************************************************************/
+GLint Shader::getUniformIndex(const char* name) const
+{
+	for (GLuint i = 0; i < uniforms.size(); i++)
+	{
+		if (uniforms[i].name == name)
+			return i;
+	}
+	return -1;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         Shader::getAttributeLocation                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param name                                                                *
+*           Name of the attribute in the GLSL source.                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           Location of the attribute, or -1 if it is not active.             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Looks an attribute up by name in the reflected table.                      *
+*                                                                             *
+******************************************************************************/
+GLint Shader::getAttributeLocation(const char* name) const
+{
+	for (const ShaderAttribute &a : attributes)
+	{
+		if (a.name == name)
+			return a.location;
+	}
+	return -1;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Shader::updateShadow                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param index                                                               *
+*           Index of the uniform in the table.                                *
+*  @param value                                                               *
+*           Pointer to the new value.                                         *
+*  @param bytes                                                               *
+*           Size of the new value in bytes.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           True if the value must be sent to OpenGL, false otherwise.        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Compares the new value against the shadow copy and stores it if it has     *
+*  changed. Invalid indices and values larger than the uniform are rejected.  *
+*                                                                             *
+******************************************************************************/
+bool Shader::updateShadow(GLint index, const void* value, GLuint bytes)
+{
+	/* Ignore uniforms which are not active in this program. */
+	if (index < 0 || index >= (GLint) uniforms.size())
+		return false;
+
+	/* Reject values which do not fit the uniform. */
+	ShaderUniform &u = uniforms[index];
+	if (bytes > u.bytes)
+	{
+		std::cerr << "Uniform type mismatch: " << u.name << std::endl;
+		return false;
+	}
+
+	/* Skip the update if the value has not changed. */
+	unsigned char* shadow = &uniformValues[u.offset];
+	if (u.set && memcmp(shadow, value, bytes) == 0)
+		return false;
+
+	/* Remember the new value. */
+	memcpy(shadow, value, bytes);
+	u.set = true;
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                       Shader::setUniform (overloaded)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param index                                                               *
+*           Index of the uniform in the table (see getUniformIndex).          *
+*  @param value                                                               *
+*           The new value of the uniform.                                     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sends the value to the current program only if it differs from the value  *
+*  last sent. This program must be in use when the setters are called.       *
+*                                                                             *
+******************************************************************************/
+void Shader::setUniform(GLint index, GLint value)
+{
+	if (updateShadow(index, &value, sizeof(value)))
+		glUniform1i(uniforms[index].location, value);
+}
+void Shader::setUniform(GLint index, GLfloat value)
+{
+	if (updateShadow(index, &value, sizeof(value)))
+		glUniform1f(uniforms[index].location, value);
+}
+void Shader::setUniform(GLint index, const glm::vec2 &value)
+{
+	if (updateShadow(index, &value[0], sizeof(value)))
+		glUniform2fv(uniforms[index].location, 1, &value[0]);
+}
+void Shader::setUniform(GLint index, const glm::vec3 &value)
+{
+	if (updateShadow(index, &value[0], sizeof(value)))
+		glUniform3fv(uniforms[index].location, 1, &value[0]);
+}
+void Shader::setUniform(GLint index, const glm::vec4 &value)
+{
+	if (updateShadow(index, &value[0], sizeof(value)))
+		glUniform4fv(uniforms[index].location, 1, &value[0]);
+}
+void Shader::setUniform(GLint index, const glm::mat3 &value)
+{
+	if (updateShadow(index, &value[0][0], sizeof(value)))
+		glUniformMatrix3fv(uniforms[index].location, 1, GL_FALSE, 
+			&value[0][0]);
+}
+void Shader::setUniform(GLint index, const glm::mat4 &value)
+{
+	if (updateShadow(index, &value[0][0], sizeof(value)))
+		glUniformMatrix4fv(uniforms[index].location, 1, GL_FALSE, 
+			&value[0][0]);
 }
 
 /******************************************************************************
@@ -108,7 +535,8 @@ Shader::Shader(std::string vertexShaderFilepath,
 *******************************************************************************
 * DESCRIPTION                                                                 *
 *  This function opens a GLSL source code file and copies the entire contents *
-*  of the file to a string and returns it to the caller.                      *
+*  of the file to a string and returns it to the caller. The file is read in  *
+*  a single call into a string sized up front.                                *
 *                                                                             *
 ******************************************************************************/
 std::string Shader::loadShaderSource(std::string shaderFilepath)
@@ -117,22 +545,19 @@ std::string Shader::loadShaderSource(std::string shaderFilepath)
 	std::ifstream file;
 	std::string output;
 
-	/* Open the indicated file. */
-	file.open(shaderFilepath.c_str());
+	/* Open the indicated file at the end to get its size. */
+	file.open(shaderFilepath.c_str(), std::ios::in | std::ios::binary |
+		std::ios::ate);
 	
 	/* If the file opened, read the contents. */
 	if (file.is_open())
 	{
-		/* Buffer for reading lines from the file. */
-		std::string buffer;
-
-		/* While not EOF / Error. */
-		while (file.good())
-		{
-			/* Read the line and append it to the output string. */
-			std::getline(file, buffer);
-			output.append(buffer + "\n");
-		}
+		/* Size the output once and read the whole file into it. */
+		std::streamoff size = file.tellg();
+		output.resize((size_t) size);
+		file.seekg(0, std::ios::beg);
+		if (size > 0)
+			file.read(&output[0], size);
 	}
 	/* If the file was not opened, output the error. */
 	else
@@ -140,12 +565,70 @@ std::string Shader::loadShaderSource(std::string shaderFilepath)
 		std::cerr << "Unable to load shader: " << shaderFilepath << std::endl;
 	}
 
-	/* For ensuring the source code is read correctly. */
-	//std::cout << output << std::endl; 
 	/* Return the string to the caller. */
 	return output;
 }
 
+/******************************************************************************
+*                                                                             *
+*                             Shader::preprocess                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param sourceCode                                                          *
+*           The GLSL source code to be specialized.                           *
+*  @param features                                                            *
+*           Bitmask of ShaderFeature flags to define.                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  @return                                                                    *
+*           The source code with the feature #defines inserted.               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Inserts one #define per enabled feature directly after the #version line   *
+*  (which GLSL requires to come first), followed by a #line directive so that *
+*  compiler errors still refer to the line numbers of the original file.      *
+*                                                                             *
+******************************************************************************/
+std::string Shader::preprocess(const std::string &sourceCode, GLuint features)
+{
+	/* Names of the defines, in ShaderFeature bit order. */
+	static const char* FEATURE_NAMES[] = 
+	{
+		"TEXTURED", "LIT", "INSTANCED", "WIREFRAME",
+	};
+
+	/* Build the block of defines. */
+	std::string defines;
+	for (GLuint i = 0; i < sizeof(FEATURE_NAMES) / sizeof(*FEATURE_NAMES); i++)
+	{
+		if (features & (1 << i))
+			defines.append("#define ").append(FEATURE_NAMES[i]).append("\n");
+	}
+
+	/* Find the end of the #version line, if there is one. */
+	size_t insert = 0;
+	GLuint line = 1;
+	if (sourceCode.compare(0, 8, "#version") == 0)
+	{
+		size_t newline = sourceCode.find('\n');
+		insert = (newline == std::string::npos) ? sourceCode.size() 
+		                                         : newline + 1;
+		line = 2;
+	}
+
+	/* Splice the defines in and restore the original line numbering. */
+	std::string output;
+	output.reserve(sourceCode.size() + defines.size() + 16);
+	output.append(sourceCode, 0, insert);
+	output.append(defines);
+	output.append("#line ").append(std::to_string(line)).append("\n");
+	output.append(sourceCode, insert, std::string::npos);
+	return output;
+}
+
 /******************************************************************************
 *                                                                             *
 *                           Shader::checkShaderError                          *
@@ -6,7 +6,112 @@
 *                                                                             *
 ******************************************************************************/
 #include <string>
+#include <vector>
 #include <gl\glew.h>
+#include <glm\glm.hpp>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Attribute location of the first column of the per-instance matrix. */
+#define  INSTANCE_ATTRIBUTE_LOCATION   4
+
+/******************************************************************************
+*                                                                             *
+*                             ShaderFeature Enum                              *
+*                                                                             *
+*******************************************************************************
+*  SHADER_TEXTURED                                                            *
+*          Sample the bound 2-D texture for the surface color.                *
+*  SHADER_LIT                                                                 *
+*          Apply ambient and diffuse lighting from the light source.          *
+*  SHADER_INSTANCED                                                           *
+*          Read the model to world matrix from a per-instance attribute.      *
+*  SHADER_WIREFRAME                                                           *
+*          Output the flat wireframe color instead of the surface color.      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bit flags selecting a permutation of the shader source. Each set flag is   *
+*  emitted as a #define of the same name (without the SHADER_ prefix).        *
+*                                                                             *
+*******************************************************************************/
+enum ShaderFeature
+{
+	SHADER_NONE      = 0x00,
+	SHADER_TEXTURED  = 0x01,
+	SHADER_LIT       = 0x02,
+	SHADER_INSTANCED = 0x04,
+	SHADER_WIREFRAME = 0x08,
+};
+
+/******************************************************************************
+*                                                                             *
+*                          ShaderUniform (struct)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  name                                                                       *
+*          Name of the uniform (without a trailing "[0]" for arrays).         *
+*  type                                                                       *
+*          GL type of the uniform (GL_FLOAT_VEC3, GL_SAMPLER_2D, etc.).       *
+*  size                                                                       *
+*          Number of array elements (1 for non-arrays).                       *
+*  location                                                                   *
+*          Location of the uniform in the program.                            *
+*  offset                                                                     *
+*          Offset of the shadow copy of the value in the shadow buffer.       *
+*  bytes                                                                      *
+*          Size of one element of the uniform in bytes.                       *
+*  set                                                                        *
+*          Whether a value has been sent since the program was linked.        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Entry of the reflected uniform table of a Shader.                          *
+*                                                                             *
+*******************************************************************************/
+struct ShaderUniform
+{
+	std::string    name;
+	GLenum         type;
+	GLint          size;
+	GLint          location;
+	GLuint         offset;
+	GLuint         bytes;
+	bool           set;
+};
+
+/******************************************************************************
+*                                                                             *
+*                         ShaderAttribute (struct)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  name                                                                       *
+*          Name of the attribute.                                             *
+*  type                                                                       *
+*          GL type of the attribute.                                          *
+*  size                                                                       *
+*          Number of array elements (1 for non-arrays).                       *
+*  location                                                                   *
+*          Location the attribute was bound to.                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Entry of the reflected attribute table of a Shader.                        *
+*                                                                             *
+*******************************************************************************/
+struct ShaderAttribute
+{
+	std::string    name;
+	GLenum         type;
+	GLint          size;
+	GLint          location;
+};
 
 /******************************************************************************
 *																			  *
@@ -18,10 +123,21 @@
  *          this object.                                                      *
  *  program                                                                   *
  *          ID of the program associated with this object.                    *
+ *  features                                                                  *
+ *          Bitmask of ShaderFeature flags this program was compiled with.    *
+ *  uniforms                                                                  *
+ *          Table of the active uniforms, reflected once after linking.       *
+ *  attributes                                                                *
+ *          Table of the active attributes, reflected once after linking.     *
+ *  uniformValues                                                             *
+ *          Shadow copy of the last value sent to each uniform.               *
  *                                                                            *
  ******************************************************************************
  * DESCRIPTION                                                                *
  *  Class which manages the compilation and linking of shader programs.       *
+ *  Uniforms are addressed by their index in the reflected table; the typed   *
+ *  setters compare against the shadow copy and skip the glUniform* call when *
+ *  the value has not changed. The setters assume this program is in use.    *
  *                                                                            *
  ******************************************************************************/
 class Shader
@@ -30,15 +146,41 @@ class Shader
 public:
 
 	/* Constructors. */
-	       Shader(std::string vertexShaderFilepath, 
-	              std::string fragmentShaderFilepath);
-	       Shader() {}
+	       Shader(std::string vertexShaderFilepath,
+	              std::string fragmentShaderFilepath,
+	              GLuint      features = SHADER_NONE);
+	       Shader() : program(0), features(SHADER_NONE) {}
 
 	/* Tell OpenGL to use this program. */
 	void   use();
 
 	/* Getters. */
-	GLuint getProgram() const { return program; }
+	GLuint getProgram()  const { return program;  }
+	GLuint getFeatures() const { return features; }
+	const std::vector<ShaderUniform>&   getUniforms()   const
+	                           { return uniforms;   }
+	const std::vector<ShaderAttribute>& getAttributes() const
+	                           { return attributes; }
+
+	/* Find the table index of a uniform (-1 if it is not active). */
+	GLint  getUniformIndex(const char* name)       const;
+	/* Find the location of an attribute (-1 if it is not active). */
+	GLint  getAttributeLocation(const char* name)  const;
+
+	/* Typed uniform setters (skip redundant updates). */
+	void   setUniform(GLint index, GLint            value);
+	void   setUniform(GLint index, GLfloat          value);
+	void   setUniform(GLint index, const glm::vec2 &value);
+	void   setUniform(GLint index, const glm::vec3 &value);
+	void   setUniform(GLint index, const glm::vec4 &value);
+	void   setUniform(GLint index, const glm::mat3 &value);
+	void   setUniform(GLint index, const glm::mat4 &value);
+
+	/* Load the entire contents of a GLSL file. */
+	static std::string loadShaderSource(std::string shaderFilepath);
+	/* Insert the #defines for the indicated features into the source. */
+	static std::string preprocess(const std::string &sourceCode,
+	                              GLuint             features);
 
 	/* Destructor. */
 	       ~Shader() {}
@@ -46,15 +188,31 @@ public:
 /* Private Members.*/
 private:
 
+	/* The ShaderLibrary drives the asynchronous compile path. */
+	friend class ShaderLibrary;
+
 	/* Shader handles (Vertex, Fragment). */
 	GLuint      shaders[2];
 	/* Program handle. */
 	GLuint      program;
-	/* loadShaderSource */
-	std::string loadShaderSource(std::string shaderFilepath);
-	/* compileShader */
-	void        compileShader(std::string sourceCode, 
-	                          GLenum      shaderType);
+	/* Feature flags of this permutation. */
+	GLuint      features;
+	/* Reflected interface of the linked program. */
+	std::vector<ShaderUniform>   uniforms;
+	std::vector<ShaderAttribute> attributes;
+	std::vector<unsigned char>   uniformValues;
+	/* Build the uniform and attribute tables. */
+	void        reflect();
+	/* Update the shadow copy, returning whether the value changed. */
+	bool        updateShadow(GLint index, const void* value, GLuint bytes);
+	/* Issue the compile and link commands without waiting on the driver. */
+	void        submit(const std::string &vertexSource,
+	                   const std::string &fragmentSource,
+	                   bool               retrievable);
+	/* Wait for a submitted program and validate it. */
+	bool        finish();
+	/* Create the program from a previously retrieved binary. */
+	bool        loadBinary(GLenum format, const std::vector<char> &binary);
 	/* checkShaderError */
 	bool        checkShaderError(GLuint shaderID);
 	/* checkProgramError */
@@ -0,0 +1,432 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "ShaderLibrary.h"
+#include <SDL\SDL.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* KHR_parallel_shader_compile is newer than the bundled GLEW. */
+typedef void (GLAPIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+
+/* FNV-1a 64-bit parameters. */
+#define FNV_OFFSET_BASIS   0xcbf29ce484222325ULL
+#define FNV_PRIME          0x00000100000001b3ULL
+
+/******************************************************************************
+*                                                                             *
+*                             fnv1a (file static)                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param hash                                                                *
+*           The running hash value.                                           *
+*  @param text                                                                *
+*           The bytes to be added to the hash.                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The updated hash value.                                                    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Adds the indicated string to a 64-bit FNV-1a hash.                         *
+*                                                                             *
+*******************************************************************************/
+static unsigned long long fnv1a(unsigned long long hash,
+                                const std::string &text)
+{
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		hash ^= (unsigned char) text[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+/******************************************************************************
+*                                                                             *
+*                   ShaderLibrary::ShaderLibrary (Constructor)                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertexShaderFilepath                                                *
+*           Path to the GLSL file containing the vertex shader source code.   *
+*  @param fragmentShaderFilepath                                              *
+*           Path to the GLSL file containing the fragment shader source code. *
+*  @param cacheDirectory                                                      *
+*           Directory in which the program binaries are stored.               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads the shader sources once, records the driver string used to validate  *
+*  cached binaries and checks whether program binaries can be retrieved.      *
+*  Requires a current GL context.                                             *
+*                                                                             *
+*******************************************************************************/
+ShaderLibrary::ShaderLibrary(std::string vertexShaderFilepath,
+                             std::string fragmentShaderFilepath,
+                             std::string cacheDirectory) :
+	cacheDirectory(cacheDirectory), binaryCacheEnabled(false)
+{
+	/* Load the source code once for every permutation. */
+	vertexSource = Shader::loadShaderSource(vertexShaderFilepath);
+	fragmentSource = Shader::loadShaderSource(fragmentShaderFilepath);
+
+	/* A binary is only valid for the exact driver that produced it. */
+	const GLubyte* strings[] =
+	{
+		glGetString(GL_VENDOR), glGetString(GL_RENDERER),
+		glGetString(GL_VERSION), glGetString(GL_SHADING_LANGUAGE_VERSION),
+	};
+	for (const GLubyte* s : strings)
+	{
+		if (s != NULL)
+			driverString.append((const char*) s);
+		driverString.append("\n");
+	}
+
+	/* The cache needs program binaries and at least one binary format. */
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+	{
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		binaryCacheEnabled = (numFormats > 0);
+	}
+
+	/* Let the driver spread the compile work over its own threads. */
+	enableParallelCompile();
+}
+
+/******************************************************************************
+*                                                                             *
+*                       ShaderLibrary::compileVariants                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param featureSets                                                         *
+*           List of ShaderFeature bitmasks, one per permutation to build.     *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Builds every requested permutation. Permutations found in the binary cache *
+*  are loaded directly. The rest are all submitted to the driver before any   *
+*  of them is checked, so that their compilation overlaps; each one is then   *
+*  validated and written back to the cache.                                   *
+*                                                                             *
+*******************************************************************************/
+void ShaderLibrary::compileVariants(const std::vector<GLuint> &featureSets)
+{
+	/* Programs which were submitted to the compiler, with their keys. */
+	std::vector<std::pair<Shader*, unsigned long long> > pending;
+	GLuint cached = 0;
+
+	for (GLuint features : featureSets)
+	{
+		/* Skip permutations which already exist. */
+		if (variants.count(features) != 0)
+			continue;
+
+		/* Specialize the sources for this permutation. */
+		std::string vertex = Shader::preprocess(vertexSource, features);
+		std::string fragment = Shader::preprocess(fragmentSource, features);
+		unsigned long long key = variantKey(vertex, fragment);
+
+		Shader* shader = new Shader();
+		shader->features = features;
+		variants[features] = shader;
+
+		/* Warm start: take the binary if the driver still accepts it. */
+		if (binaryCacheEnabled && loadCachedBinary(shader, key))
+		{
+			cached++;
+			continue;
+		}
+
+		/* Cold start: issue the compile, but do not wait on it yet. */
+		shader->submit(vertex, fragment, binaryCacheEnabled);
+		pending.push_back(std::make_pair(shader, key));
+	}
+
+	/* Collect the results of the overlapped compiles. */
+	for (auto &p : pending)
+	{
+		if (p.first->finish())
+		{
+			if (binaryCacheEnabled)
+				saveCachedBinary(p.first, p.second);
+		}
+		else
+		{
+			std::cerr << "Error with shader variant " << p.first->features
+			          << "!" << std::endl;
+		}
+	}
+
+	/* Show how much of the work was avoided. */
+	fprintf(stdout, "Stats: %u shader variants compiled, %u loaded from "
+		"cache\n", (GLuint) pending.size(), cached);
+}
+
+/******************************************************************************
+*                                                                             *
+*                         ShaderLibrary::getVariant                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param features                                                            *
+*           ShaderFeature bitmask of the permutation.                         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Pointer to the permutation, owned by this library.                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Returns the indicated permutation, building it on demand if it was not     *
+*  part of an earlier call to compileVariants.                                *
+*                                                                             *
+*******************************************************************************/
+Shader* ShaderLibrary::getVariant(GLuint features)
+{
+	if (variants.count(features) == 0)
+		compileVariants(std::vector<GLuint>(1, features));
+	return variants.at(features);
+}
+
+/******************************************************************************
+*                                                                             *
+*                          ShaderLibrary::variantKey                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param vertex                                                              *
+*           Preprocessed vertex shader source.                                *
+*  @param fragment                                                            *
+*           Preprocessed fragment shader source.                              *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  64-bit key identifying the permutation on this driver.                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Hashes the driver string and both sources. Any change to the GLSL files or *
+*  a driver update therefore results in a new key and a fresh compile.        *
+*                                                                             *
+*******************************************************************************/
+unsigned long long ShaderLibrary::variantKey(const std::string &vertex,
+                                             const std::string &fragment) const
+{
+	unsigned long long hash = FNV_OFFSET_BASIS;
+	hash = fnv1a(hash, driverString);
+	hash = fnv1a(hash, vertex);
+	hash = fnv1a(hash, "\n--\n");
+	hash = fnv1a(hash, fragment);
+	return hash;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           ShaderLibrary::cachePath                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param key                                                                 *
+*           Key of the permutation.                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Path of the cache file for the key.                                        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Formats the key as 16 hexadecimal digits inside the cache directory.       *
+*                                                                             *
+*******************************************************************************/
+std::string ShaderLibrary::cachePath(unsigned long long key) const
+{
+	std::ostringstream path;
+	path << cacheDirectory << std::hex << std::setw(16) << std::setfill('0')
+	     << key << ".bin";
+	return path.str();
+}
+
+/******************************************************************************
+*                                                                             *
+*                       ShaderLibrary::loadCachedBinary                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param shader                                                              *
+*           The shader whose program is to be created.                        *
+*  @param key                                                                 *
+*           Key of the permutation.                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the program was created from the cache, false otherwise.           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads the cache file (header followed by the raw binary) and hands it to   *
+*  the driver. Missing, truncated or rejected files simply report a miss.     *
+*                                                                             *
+*******************************************************************************/
+bool ShaderLibrary::loadCachedBinary(Shader* shader, unsigned long long key)
+{
+	/* Open the cache file, if there is one. */
+	std::ifstream file(cachePath(key).c_str(), std::ios::in |
+		std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	/* Header: magic, version, binary format, binary length. */
+	GLuint header[4];
+	file.read((char*) header, sizeof(header));
+	if (!file.good() || header[0] != SHADER_CACHE_MAGIC ||
+		header[1] != SHADER_CACHE_VERSION || header[3] == 0)
+		return false;
+
+	/* Read the binary itself. */
+	std::vector<char> binary(header[3]);
+	file.read(binary.data(), binary.size());
+	if (!file.good())
+		return false;
+
+	/* The driver has the final say on whether the binary is usable. */
+	return shader->loadBinary((GLenum) header[2], binary);
+}
+
+/******************************************************************************
+*                                                                             *
+*                       ShaderLibrary::saveCachedBinary                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param shader                                                              *
+*           The shader whose linked program is to be saved.                   *
+*  @param key                                                                 *
+*           Key of the permutation.                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Retrieves the linked program with glGetProgramBinary and writes it to the  *
+*  cache directory. Failure to write is not an error; the next start simply  *
+*  compiles again.                                                            *
+*                                                                             *
+*******************************************************************************/
+void ShaderLibrary::saveCachedBinary(Shader* shader, unsigned long long key)
+{
+	/* Get the size of the binary. */
+	GLint length = 0;
+	glGetProgramiv(shader->getProgram(), GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	/* Retrieve the binary. */
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(shader->getProgram(), length, &written, &format,
+		binary.data());
+	if (written <= 0)
+		return;
+
+	/* Write the header and the binary. */
+	std::ofstream file(cachePath(key).c_str(), std::ios::out |
+		std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return;
+	GLuint header[4] =
+	{
+		SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, format, (GLuint) written
+	};
+	file.write((const char*) header, sizeof(header));
+	file.write(binary.data(), written);
+}
+
+/******************************************************************************
+*                                                                             *
+*                  ShaderLibrary::enableParallelCompile (static)              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  If the driver exposes KHR_parallel_shader_compile (or the ARB version),    *
+*  removes the limit on its compiler threads. Without the extension the       *
+*  submit-all-then-check order in compileVariants still lets drivers that     *
+*  defer compilation overlap the work.                                        *
+*                                                                             *
+*******************************************************************************/
+void ShaderLibrary::enableParallelCompile()
+{
+	const char* entryPoint = NULL;
+	if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile"))
+		entryPoint = "glMaxShaderCompilerThreadsKHR";
+	else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile"))
+		entryPoint = "glMaxShaderCompilerThreadsARB";
+
+	if (entryPoint != NULL)
+	{
+		MaxShaderCompilerThreadsProc maxThreads =
+			(MaxShaderCompilerThreadsProc) SDL_GL_GetProcAddress(entryPoint);
+		if (maxThreads != NULL)
+			maxThreads(0xFFFFFFFF);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                    ShaderLibrary::~ShaderLibrary (Destructor)               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Deletes the programs of every permutation.                                 *
+*                                                                             *
+*******************************************************************************/
+ShaderLibrary::~ShaderLibrary()
+{
+	for (auto &v : variants)
+	{
+		glDeleteProgram(v.second->getProgram());
+		delete v.second;
+	}
+}
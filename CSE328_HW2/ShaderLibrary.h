@@ -0,0 +1,98 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <string>
+#include <vector>
+#include <map>
+#include <gl\glew.h>
+#include "Shader.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Directory in which linked program binaries are cached. */
+#define  DEFAULT_SHADER_CACHE_DIRECTORY   "res/cache/"
+/* Magic number and version written at the start of every cache file. */
+#define  SHADER_CACHE_MAGIC               0x42444853
+#define  SHADER_CACHE_VERSION             1
+
+/******************************************************************************
+*                                                                             *
+*                            ShaderLibrary Class                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  vertexSource                                                               *
+*          Unprocessed GLSL source code of the vertex shader.                 *
+*  fragmentSource                                                             *
+*          Unprocessed GLSL source code of the fragment shader.               *
+*  cacheDirectory                                                             *
+*          Directory in which program binaries are stored.                    *
+*  driverString                                                               *
+*          Vendor, renderer and version of the current GL driver. Binaries    *
+*          are only valid for the driver which produced them.                 *
+*  binaryCacheEnabled                                                         *
+*          Whether the driver supports retrieving program binaries.           *
+*  variants                                                                   *
+*          Compiled permutations, keyed by their ShaderFeature bitmask.       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class which owns every permutation of one vertex/fragment shader pair.     *
+*  Permutations are compiled together so the driver can work on them in       *
+*  parallel, and each linked program is saved with glGetProgramBinary under a *
+*  key hashed from its preprocessed source and the driver string, so that a   *
+*  warm start loads every program without compiling anything.                 *
+*                                                                             *
+*******************************************************************************/
+class ShaderLibrary
+{
+/* Public Members. */
+public:
+
+	/* Constructor. */
+	               ShaderLibrary(std::string vertexShaderFilepath,
+	                             std::string fragmentShaderFilepath,
+	                             std::string cacheDirectory =
+	                                 DEFAULT_SHADER_CACHE_DIRECTORY);
+
+	/* Load or compile all of the indicated permutations at once. */
+	void           compileVariants(const std::vector<GLuint> &featureSets);
+	/* Get a permutation, compiling it if it has not been requested yet. */
+	Shader*        getVariant(GLuint features);
+
+	/* Destructor. */
+	               ~ShaderLibrary();
+
+/* Private Members. */
+private:
+
+	/* Source code of the shader pair. */
+	std::string    vertexSource;
+	std::string    fragmentSource;
+	/* Program binary cache. */
+	std::string    cacheDirectory;
+	std::string    driverString;
+	bool           binaryCacheEnabled;
+	/* Compiled permutations. */
+	std::map<GLuint, Shader*> variants;
+
+	/* Hash the preprocessed sources and the driver into a cache key. */
+	unsigned long long variantKey(const std::string &vertex,
+	                              const std::string &fragment) const;
+	/* Path of the cache file for the indicated key. */
+	std::string    cachePath(unsigned long long key) const;
+	/* Try to create the program from the binary cache. */
+	bool           loadCachedBinary(Shader* shader, unsigned long long key);
+	/* Write the linked program to the binary cache. */
+	void           saveCachedBinary(Shader* shader, unsigned long long key);
+	/* Tell the driver to use as many compiler threads as it likes. */
+	static void    enableParallelCompile();
+};
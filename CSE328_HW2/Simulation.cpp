@@ -0,0 +1,370 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Simulation.h"
+#include "Parallel.h"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Seconds per day, for reporting. */
+#define SECONDS_PER_DAY 86400.0
+
+/******************************************************************************
+*                                                                             *
+*                       Simulation::Simulation (Constructor)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param system                                                              *
+*           The orbital system to be advanced.                                *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a simulation using the hybrid Kepler integrator and the default    *
+*  step.                                                                      *
+*                                                                             *
+*******************************************************************************/
+Simulation::Simulation(OrbitalSystem* system) :
+	system(system), integrator(&kepler), timeStep(DEFAULT_TIME_STEP),
+	time(0.0), pending(0.0), dropped(0.0), steps(0), energy0(0.0),
+	recorder(NULL)
+{
+	momentum0[0] = momentum0[1] = momentum0[2] = 0.0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Simulation::getSolver                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The solver suited to the size of the system.                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Exact forces are affordable, and preferable, for small systems. The mesh   *
+*  costs O(n) for millions of bodies, where the tree's O(n log n) walks       *
+*  become too slow for interactive rates.                                     *
+*                                                                             *
+*******************************************************************************/
+GravitySolver* Simulation::getSolver()
+{
+	if (system->getNumBodies() <= DIRECT_SUM_MAX_BODIES)
+		return &direct;
+	if (system->getNumBodies() <= TREE_MAX_BODIES)
+		return &tree;
+	return &mesh;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Simulation::setIntegrator                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param type                                                                *
+*           The integration method.                                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Switches method. The new integrator is reset as the bodies may have moved  *
+*  since it was last used.                                                    *
+*                                                                             *
+*******************************************************************************/
+void Simulation::setIntegrator(IntegratorType type)
+{
+	switch (type)
+	{
+	case INTEGRATOR_LEAPFROG:  integrator = &leapfrog;  break;
+	case INTEGRATOR_YOSHIDA:   integrator = &yoshida;   break;
+	case INTEGRATOR_RK45:      integrator = &rk45;      break;
+	case INTEGRATOR_BLOCK:     integrator = &block;     break;
+	default:                   integrator = &kepler;    break;
+	}
+	integrator->reset();
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Simulation::start                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param startTime                                                           *
+*           Simulated time of the loaded state (non-zero for a checkpoint).   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Called once the system is loaded (and whenever it is replaced).            *
+*                                                                             *
+*******************************************************************************/
+void Simulation::start(double startTime)
+{
+	time = startTime;
+	pending = dropped = 0.0;
+	steps = 0;
+	integrator->reset();
+	collisions.reset();
+	energy0 = hasExactEnergy() ? computeEnergy() : 0.0;
+	computeAngularMomentum(momentum0);
+	if (recorder != NULL)
+		recorder->append(time, system->getBodies());
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Simulation::advance                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param seconds                                                             *
+*           Simulated seconds to advance by.                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Takes as many whole steps as fit in the requested time plus what was left  *
+*  over from previous calls. At most MAX_STEPS_PER_ADVANCE steps are taken so *
+*  a slow step cannot stall the frame loop; the remainder is dropped and      *
+*  counted, which shows up as less simulated time per wall second.            *
+*                                                                             *
+*******************************************************************************/
+void Simulation::advance(double seconds)
+{
+	BodyArrays &bodies = system->getBodies();
+	if (bodies.count == 0)
+		return;
+
+	pending += seconds;
+	GLuint taken = 0;
+	while (pending >= timeStep && taken < MAX_STEPS_PER_ADVANCE)
+	{
+		integrator->step(bodies, *getSolver(), system->getGravity(), timeStep);
+		collide();
+		pending -= timeStep;
+		time += timeStep;
+		steps++;
+		taken++;
+	}
+	if (pending >= timeStep)
+	{
+		dropped += pending;
+		pending = 0.0;
+	}
+
+	/* Spin the bodies by the time actually simulated. */
+	double spun = taken * timeStep;
+	for (GLuint i = 0; i < bodies.count; i++)
+	{
+		bodies.rotation[i] = (GLfloat) fmod(bodies.rotation[i] +
+			bodies.rotationalSpeed[i] * spun, 360.0);
+	}
+
+	/* Log the new state. */
+	if (recorder != NULL && taken > 0)
+		recorder->append(time, bodies);
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Simulation::collide                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs collision detection on the step just taken and merges what touched.   *
+*  After a merge the integrator restarts (its per-body state no longer        *
+*  matches the bodies), the drift references are reset, and recording stops   *
+*  as a trajectory log holds a fixed number of bodies.                        *
+*                                                                             *
+*******************************************************************************/
+void Simulation::collide()
+{
+	BodyArrays &bodies = system->getBodies();
+	if (collisions.detect(bodies, timeStep) == 0 ||
+		collisions.merge(bodies) == 0)
+		return;
+
+	integrator->reset();
+	energy0 = hasExactEnergy() ? computeEnergy() : 0.0;
+	computeAngularMomentum(momentum0);
+	if (recorder != NULL)
+	{
+		std::cerr << "Error recording trajectory: bodies merged at t=" <<
+			time / SECONDS_PER_DAY << " days, recording stopped" << std::endl;
+		recorder->close();
+		recorder = NULL;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          Simulation::computeEnergy                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Total kinetic plus potential energy in joules.                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  O(n^2), computed in parallel. The potential uses the same softening as the *
+*  solvers, so it is the quantity the integrators conserve. Partial sums are  *
+*  combined in a fixed order so the result does not depend on the threads.    *
+*  Only called while hasExactEnergy(): beyond DIRECT_SUM_MAX_BODIES the pair  *
+*  loop would stall the viewer at every drift report.                         *
+*                                                                             *
+*******************************************************************************/
+double Simulation::computeEnergy() const
+{
+	const BodyArrays &bodies = system->getBodies();
+	const GLuint n = bodies.count;
+	const double eps2 = DEFAULT_SOFTENING * DEFAULT_SOFTENING;
+	const double gravity = system->getGravity();
+
+	return Parallel::reduce(0, n, 64, 0.0, [&](GLuint lo, GLuint hi)
+	{
+		double energy = 0.0;
+		for (GLuint i = lo; i < hi; i++)
+		{
+			double v2 = bodies.vx[i] * bodies.vx[i] +
+				bodies.vy[i] * bodies.vy[i] + bodies.vz[i] * bodies.vz[i];
+			double potential = 0.0;
+			for (GLuint j = i + 1; j < n; j++)
+			{
+				double dx = bodies.px[j] - bodies.px[i];
+				double dy = bodies.py[j] - bodies.py[i];
+				double dz = bodies.pz[j] - bodies.pz[i];
+				potential += bodies.mass[j] /
+					sqrt(dx * dx + dy * dy + dz * dz + eps2);
+			}
+			energy += bodies.mass[i] * (0.5 * v2 - gravity * potential);
+		}
+		return energy;
+	}, [](double a, double b) { return a + b; });
+}
+
+/******************************************************************************
+*                                                                             *
+*                     Simulation::computeAngularMomentum                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param momentum                                                            *
+*           Destination of the total angular momentum about the origin.       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sum of m (r x v) over the bodies.                                          *
+*                                                                             *
+*******************************************************************************/
+void Simulation::computeAngularMomentum(double momentum[3]) const
+{
+	const BodyArrays &bodies = system->getBodies();
+	momentum[0] = momentum[1] = momentum[2] = 0.0;
+	for (GLuint i = 0; i < bodies.count; i++)
+	{
+		const double m = bodies.mass[i];
+		momentum[0] += m * (bodies.py[i] * bodies.vz[i] -
+			bodies.pz[i] * bodies.vy[i]);
+		momentum[1] += m * (bodies.pz[i] * bodies.vx[i] -
+			bodies.px[i] * bodies.vz[i]);
+		momentum[2] += m * (bodies.px[i] * bodies.vy[i] -
+			bodies.py[i] * bodies.vx[i]);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           Simulation::reportDrift                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints the relative change of the total energy and angular momentum since  *
+*  start, with the method, step and force evaluations used to get there.      *
+*                                                                             *
+*******************************************************************************/
+void Simulation::reportDrift()
+{
+	if (system->getNumBodies() == 0)
+		return;
+
+	double momentum[3];
+	computeAngularMomentum(momentum);
+
+	double dL = 0.0, L0 = 0.0;
+	for (GLuint d = 0; d < 3; d++)
+	{
+		dL += (momentum[d] - momentum0[d]) * (momentum[d] - momentum0[d]);
+		L0 += momentum0[d] * momentum0[d];
+	}
+	dL = (L0 > 0.0) ? sqrt(dL / L0) : 0.0;
+
+	fprintf(stdout, "Stats: t=%.2f days, %s dt=%.0f s, %llu steps, %llu force "
+		"evaluations, ", time / SECONDS_PER_DAY, integrator->getName(),
+		timeStep, steps, integrator->getNumEvaluations());
+	/* The energy is exact only while the pair loop is affordable. */
+	if (hasExactEnergy())
+	{
+		double energy = computeEnergy();
+		double dE = (energy0 != 0.0) ? fabs((energy - energy0) / energy0) : 0.0;
+		fprintf(stdout, "dE/E=%.3e, ", dE);
+	}
+	else
+		fprintf(stdout, "dE/E not tracked above %u bodies, ",
+			DIRECT_SUM_MAX_BODIES);
+	fprintf(stdout, "dL/L=%.3e, dropped %.2f days\n", dL,
+		dropped / SECONDS_PER_DAY);
+	integrator->reportStats();
+	collisions.reportStats();
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include "OrbitalSystem.h"
+#include "DirectSum.h"
+#include "BarnesHut.h"
+#include "ParticleMesh.h"
+#include "Integrator.h"
+#include "Kepler.h"
+#include "TrajectoryLog.h"
+#include "Collision.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Largest system integrated with the exact direct sum. */
+#define  DIRECT_SUM_MAX_BODIES      4096
+/* Largest system integrated with the tree (the particle mesh above). */
+#define  TREE_MAX_BODIES            1048576
+/* Default integration step in simulated seconds. */
+#define  DEFAULT_TIME_STEP          3600.0
+/* Most steps taken by one call to advance (the rest of the time is dropped).*/
+#define  MAX_STEPS_PER_ADVANCE      64
+
+/******************************************************************************
+*                                                                             *
+*                          IntegratorType  (enum)                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Integration methods a simulation can use.                                  *
+*                                                                             *
+*******************************************************************************/
+enum IntegratorType
+{
+	INTEGRATOR_LEAPFROG = 0,
+	INTEGRATOR_YOSHIDA  = 1,
+	INTEGRATOR_RK45     = 2,
+	INTEGRATOR_BLOCK    = 3,
+	INTEGRATOR_KEPLER   = 4
+};
+
+/******************************************************************************
+*                                                                             *
+*                           Simulation  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  system                                                                     *
+*          The orbital system being advanced.                                 *
+*  direct, tree, mesh                                                         *
+*          The gravity solvers; the direct sum is used for systems of up to   *
+*          DIRECT_SUM_MAX_BODIES bodies, the tree for up to TREE_MAX_BODIES   *
+*          and the particle mesh above that.                                  *
+*  leapfrog, yoshida, rk45, block, kepler                                     *
+*          The integrators; integrator points at the selected one.            *
+*  collisions                                                                 *
+*          Detects bodies touching during each step so they can be merged.    *
+*  timeStep                                                                   *
+*          Length of one integration step in simulated seconds.               *
+*  time                                                                       *
+*          Simulated seconds since start.                                     *
+*  pending                                                                    *
+*          Simulated time requested but shorter than a step.                  *
+*  dropped                                                                    *
+*          Simulated time skipped because advance hit its step limit.         *
+*  steps                                                                      *
+*          Number of steps taken since start.                                 *
+*  energy0, momentum0                                                         *
+*          Total energy and angular momentum at start (the energy only while  *
+*          hasExactEnergy()).                                                 *
+*  recorder                                                                   *
+*          Trajectory log the body positions are appended to (or NULL).       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class advancing an orbital system in fixed steps of simulated time. The    *
+*  total energy and angular momentum are measured at start so their relative  *
+*  drift can be reported while running; the largest step (and so the most     *
+*  simulated time per wall second) which keeps the drift acceptable can then  *
+*  be read off the report. The exact energy is an O(n^2) pair sum, so above   *
+*  DIRECT_SUM_MAX_BODIES only the angular momentum is tracked. Body spins     *
+*  are advanced by rotationalSpeed. With a recorder, one frame is logged at   *
+*  start and after every advance that took a step. Bodies which touch         *
+*  during a step are merged; as that is an inelastic collision, the drift     *
+*  references are taken afresh.                                               *
+*                                                                             *
+*******************************************************************************/
+class Simulation
+{
+public:
+	/* Constructor. */
+	                 Simulation(OrbitalSystem* system);
+
+	/* Reset the clock and drift references to the current state. */
+	void             start(double startTime = 0.0);
+	/* Advance by the given number of simulated seconds. */
+	void             advance(double seconds);
+	/* Print the energy and angular momentum drift. */
+	void             reportDrift();
+
+	/* Merge the bodies which touched during the last step. */
+	void             collide();
+
+	/* Diagnostics of the current state. */
+	double           computeEnergy() const;
+	bool             hasExactEnergy() const
+	                 {  return system->getNumBodies() <= DIRECT_SUM_MAX_BODIES; }
+	void             computeAngularMomentum(double momentum[3]) const;
+
+	/* Getters. */
+	double           getTime()                const {  return time;       }
+	double           getTimeStep()            const {  return timeStep;   }
+	Integrator*      getIntegrator()                {  return integrator; }
+	GravitySolver*   getSolver();
+
+	/* Setters. */
+	void             setTimeStep(double dt)         {  timeStep = dt;     }
+	void             setIntegrator(IntegratorType type);
+	void             setRecorder(TrajectoryWriter* r) {  recorder = r;     }
+
+private:
+	OrbitalSystem*   system;
+	/* Solvers. */
+	DirectSumSolver  direct;
+	BarnesHutSolver  tree;
+	ParticleMeshSolver mesh;
+	/* Integrators. */
+	LeapfrogIntegrator       leapfrog;
+	YoshidaIntegrator        yoshida;
+	RK45Integrator           rk45;
+	BlockTimestepIntegrator  block;
+	KeplerIntegrator         kepler;
+	Integrator*      integrator;
+	/* Collisions. */
+	CollisionDetector collisions;
+	/* Clock. */
+	double           timeStep;
+	double           time;
+	double           pending;
+	double           dropped;
+	unsigned long long steps;
+	/* Drift references. */
+	double           energy0;
+	double           momentum0[3];
+	/* Trajectory log. */
+	TrajectoryWriter* recorder;
+};
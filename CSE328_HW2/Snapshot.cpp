@@ -0,0 +1,535 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "Snapshot.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Alignment of every column in the file. */
+#define COLUMN_ALIGNMENT 8
+
+/******************************************************************************
+*                                                                             *
+*                        buildStringTable (file static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param strings                                                             *
+*           The strings, in order.                                            *
+*  @param table                                                               *
+*           Destination of the encoded table.                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False if the strings do not fit 32 bit offsets.                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Encodes a string table as described at SnapshotColumn.                     *
+*                                                                             *
+*******************************************************************************/
+static bool buildStringTable(const std::vector<std::string> &strings,
+                             std::vector<unsigned char> &table)
+{
+	const GLuint count = strings.size();
+	unsigned long long characters = 0;
+	for (GLuint i = 0; i < count; i++)
+		characters += strings[i].size() + 1;
+	if (characters > 0xFFFFFFFFull)
+		return false;
+
+	table.resize(sizeof(GLuint) * (count + 2) + (size_t) characters);
+	GLuint* header = (GLuint*) &table[0];
+	char* chars = (char*) &header[count + 2];
+	header[0] = count;
+	GLuint offset = 0;
+	for (GLuint i = 0; i < count; i++)
+	{
+		header[i + 1] = offset;
+		memcpy(chars + offset, strings[i].c_str(), strings[i].size() + 1);
+		offset += strings[i].size() + 1;
+	}
+	header[count + 1] = offset;
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                         readStringTable (file static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data, size                                                          *
+*           The encoded table, inside the mapping.                            *
+*  @param strings                                                             *
+*           Destination of a pointer to each string, inside the mapping.      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False if the table is malformed.                                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Checks every offset before use, so a damaged file cannot lead outside    *
+*  the mapping or to an unterminated string.                                  *
+*                                                                             *
+*******************************************************************************/
+static bool readStringTable(const unsigned char* data,
+                            unsigned long long size,
+                            std::vector<const char*> &strings)
+{
+	if (size < sizeof(GLuint))
+		return false;
+	const GLuint* header = (const GLuint*) data;
+	const unsigned long long count = header[0];
+	const unsigned long long start = sizeof(GLuint) * (count + 2);
+	if (start > size)
+		return false;
+	const char* chars = (const char*) data + start;
+	const unsigned long long length = size - start;
+
+	strings.resize((size_t) count);
+	for (GLuint i = 0; i < count; i++)
+	{
+		GLuint begin = header[i + 1], end = header[i + 2];
+		if (begin >= end || end > length || chars[end - 1] != '\0')
+			return false;
+		strings[i] = chars + begin;
+	}
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                               Snapshot::save                                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the snapshot to be written.                               *
+*  @param system                                                              *
+*           The system to be saved.                                           *
+*  @param assets                                                              *
+*           Cache holding the paths of the mesh and texture handles.          *
+*  @param time                                                                *
+*           Simulated time of the system in seconds.                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the snapshot was written, false otherwise.                         *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Lays out the directory, then writes the header, the directory and every *
+*  column, the body columns straight from the body arrays. The mesh and    *
+*  texture handles are stored as they are, with the cache's paths as the    *
+*  tables they index.                                                        *
+*                                                                             *
+*******************************************************************************/
+bool Snapshot::save(const char* filename, const OrbitalSystem &system,
+                    const AssetCache &assets, double time)
+{
+	const BodyArrays &bodies = system.getBodies();
+	const GLuint n = bodies.count;
+
+	/* String tables. */
+	std::vector<std::string> meshPaths, texturePaths;
+	for (GLuint h = 0; h < assets.getNumMeshes(); h++)
+		meshPaths.push_back(assets.getMeshFile(h));
+	for (GLuint h = 0; h < assets.getNumTextures(); h++)
+		texturePaths.push_back(assets.getTextureFile(h));
+	std::vector<unsigned char> names, meshTable, textureTable;
+	if (!buildStringTable(bodies.name, names) ||
+		!buildStringTable(meshPaths, meshTable) ||
+		!buildStringTable(texturePaths, textureTable))
+	{
+		std::cerr << "Error saving snapshot: names too long" << std::endl;
+		return false;
+	}
+
+	/* Columns and where their data is. */
+	struct Source
+	{
+		GLuint        id;
+		GLuint        width;
+		const void*   data;
+		size_t        size;
+	};
+	const Source sources[] = {
+		{ SNAPSHOT_PX, 8, n ? &bodies.px[0] : NULL, 8 * n },
+		{ SNAPSHOT_PY, 8, n ? &bodies.py[0] : NULL, 8 * n },
+		{ SNAPSHOT_PZ, 8, n ? &bodies.pz[0] : NULL, 8 * n },
+		{ SNAPSHOT_VX, 8, n ? &bodies.vx[0] : NULL, 8 * n },
+		{ SNAPSHOT_VY, 8, n ? &bodies.vy[0] : NULL, 8 * n },
+		{ SNAPSHOT_VZ, 8, n ? &bodies.vz[0] : NULL, 8 * n },
+		{ SNAPSHOT_MASS, 8, n ? &bodies.mass[0] : NULL, 8 * n },
+		{ SNAPSHOT_RADIUS, 8, n ? &bodies.radius[0] : NULL, 8 * n },
+		{ SNAPSHOT_TILT, 4, n ? &bodies.tilt[0] : NULL, 4 * n },
+		{ SNAPSHOT_ROTATIONAL_SPEED, 4,
+			n ? &bodies.rotationalSpeed[0] : NULL, 4 * n },
+		{ SNAPSHOT_ROTATION, 4, n ? &bodies.rotation[0] : NULL, 4 * n },
+		{ SNAPSHOT_MESH, 4, n ? &bodies.mesh[0] : NULL, 4 * n },
+		{ SNAPSHOT_TEXTURE, 4, n ? &bodies.texture[0] : NULL, 4 * n },
+		{ SNAPSHOT_NAMES, 0, &names[0], names.size() },
+		{ SNAPSHOT_MESH_PATHS, 0, &meshTable[0], meshTable.size() },
+		{ SNAPSHOT_TEXTURE_PATHS, 0, &textureTable[0], textureTable.size() },
+	};
+	const GLuint columns = sizeof(sources) / sizeof(sources[0]);
+
+	/* Header and directory. */
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.bodies = n;
+	header.columns = columns;
+	header.time = time;
+	header.gravity = system.getGravity();
+	header.scale = system.getScale();
+	header.speed = system.getSpeed();
+	header.backgroundRadius = system.getBackgroundRadius();
+	header.backgroundTilt = system.getBackgroundTilt();
+	header.backgroundMesh = system.getBackgroundMesh();
+	header.backgroundTexture = system.getBackgroundTexture();
+
+	std::vector<SnapshotColumn> directory(columns);
+	unsigned long long offset = sizeof(header) +
+		columns * sizeof(SnapshotColumn);
+	for (GLuint c = 0; c < columns; c++)
+	{
+		offset = (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1ull);
+		directory[c].id = sources[c].id;
+		directory[c].width = sources[c].width;
+		directory[c].offset = offset;
+		directory[c].size = sources[c].size;
+		offset += sources[c].size;
+	}
+
+	/* Write everything out. */
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		std::cerr << "Error saving snapshot: cannot create " << filename
+		          << std::endl;
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(&directory[0], sizeof(SnapshotColumn), columns, file);
+	unsigned long long position = sizeof(header) +
+		columns * sizeof(SnapshotColumn);
+	static const char padding[COLUMN_ALIGNMENT] = { 0 };
+	for (GLuint c = 0; c < columns; c++)
+	{
+		fwrite(padding, 1, (size_t) (directory[c].offset - position), file);
+		if (sources[c].size > 0)
+			fwrite(sources[c].data, 1, sources[c].size, file);
+		position = directory[c].offset + directory[c].size;
+	}
+	bool written = !ferror(file);
+	if (fclose(file) != 0 || !written)
+	{
+		std::cerr << "Error saving snapshot: cannot write " << filename
+		          << std::endl;
+		return false;
+	}
+
+	fprintf(stdout, "Stats: Saved %u bodies to %s (%.1f MB)\n", n, filename,
+		position / 1048576.0);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                               Snapshot::load                                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the snapshot to be read.                                  *
+*  @param system                                                              *
+*           The system to be replaced.                                        *
+*  @param assets                                                              *
+*           Cache in which the mesh and texture paths are registered.         *
+*  @param time                                                                *
+*           If not NULL, receives the simulated time of the snapshot.         *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the snapshot was loaded, false otherwise.                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Maps the file and validates the header and the whole directory before    *
+*  touching the system. Each known body column is then copied into its      *
+*  array; missing ones are left zero. Only the path tables are interned in *
+*  the cache (once per path), and the stored indices are translated to the  *
+*  cache's handles.                                                          *
+*                                                                             *
+*******************************************************************************/
+bool Snapshot::load(const char* filename, OrbitalSystem &system,
+                    AssetCache* assets, double* time)
+{
+	MappedFile map;
+	if (!map.open(filename))
+	{
+		std::cerr << "Error loading snapshot: " << filename
+		          << " could not be opened" << std::endl;
+		return false;
+	}
+	const unsigned char* data = map.getData();
+	const unsigned long long size = map.getSize();
+
+	/* Header. */
+	SnapshotHeader header;
+	if (size < sizeof(header))
+	{
+		std::cerr << "Error loading snapshot: " << filename
+		          << " is truncated" << std::endl;
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION)
+	{
+		std::cerr << "Error loading snapshot: " << filename
+		          << " is not a version " << SNAPSHOT_VERSION << " snapshot"
+		          << std::endl;
+		return false;
+	}
+
+	/* Directory: every column inside the file, body columns full length. */
+	const GLuint n = header.bodies;
+	if (size < sizeof(header) +
+		(unsigned long long) header.columns * sizeof(SnapshotColumn))
+	{
+		std::cerr << "Error loading snapshot: " << filename
+		          << " is truncated" << std::endl;
+		return false;
+	}
+	const SnapshotColumn* directory =
+		(const SnapshotColumn*) (data + sizeof(header));
+	const SnapshotColumn* byId[SNAPSHOT_TEXTURE_PATHS + 1] = { NULL };
+	for (GLuint c = 0; c < header.columns; c++)
+	{
+		const SnapshotColumn &column = directory[c];
+		if (column.offset > size || column.size > size - column.offset ||
+			column.offset % COLUMN_ALIGNMENT != 0 ||
+			(column.width > 0 && column.size != (unsigned long long)
+			column.width * n))
+		{
+			std::cerr << "Error loading snapshot: " << filename
+			          << " has a damaged column " << column.id << std::endl;
+			return false;
+		}
+		if (column.id <= SNAPSHOT_TEXTURE_PATHS)
+			byId[column.id] = &column;
+	}
+
+	/* String tables. */
+	std::vector<const char*> names, meshPaths, texturePaths;
+	const SnapshotColumnId tables[3] = {
+		SNAPSHOT_NAMES, SNAPSHOT_MESH_PATHS, SNAPSHOT_TEXTURE_PATHS };
+	std::vector<const char*>* strings[3] = {
+		&names, &meshPaths, &texturePaths };
+	for (GLuint t = 0; t < 3; t++)
+	{
+		const SnapshotColumn* column = byId[tables[t]];
+		if (column != NULL && (column->width != 0 || !readStringTable(
+			data + column->offset, column->size, *strings[t])))
+		{
+			std::cerr << "Error loading snapshot: " << filename
+			          << " has a damaged string table" << std::endl;
+			return false;
+		}
+	}
+	if (byId[SNAPSHOT_NAMES] != NULL && names.size() != n)
+	{
+		std::cerr << "Error loading snapshot: " << filename
+		          << " has " << names.size() << " names for " << n
+		          << " bodies" << std::endl;
+		return false;
+	}
+
+	/* Body columns, copied as they are. */
+	BodyArrays loaded;
+	loaded.resize(n);
+	struct Destination
+	{
+		SnapshotColumnId id;
+		GLuint           width;
+		void*            data;
+	};
+	const Destination destinations[] = {
+		{ SNAPSHOT_PX, 8, n ? &loaded.px[0] : NULL },
+		{ SNAPSHOT_PY, 8, n ? &loaded.py[0] : NULL },
+		{ SNAPSHOT_PZ, 8, n ? &loaded.pz[0] : NULL },
+		{ SNAPSHOT_VX, 8, n ? &loaded.vx[0] : NULL },
+		{ SNAPSHOT_VY, 8, n ? &loaded.vy[0] : NULL },
+		{ SNAPSHOT_VZ, 8, n ? &loaded.vz[0] : NULL },
+		{ SNAPSHOT_MASS, 8, n ? &loaded.mass[0] : NULL },
+		{ SNAPSHOT_RADIUS, 8, n ? &loaded.radius[0] : NULL },
+		{ SNAPSHOT_TILT, 4, n ? &loaded.tilt[0] : NULL },
+		{ SNAPSHOT_ROTATIONAL_SPEED, 4, n ? &loaded.rotationalSpeed[0] : NULL },
+		{ SNAPSHOT_ROTATION, 4, n ? &loaded.rotation[0] : NULL },
+		{ SNAPSHOT_MESH, 4, n ? &loaded.mesh[0] : NULL },
+		{ SNAPSHOT_TEXTURE, 4, n ? &loaded.texture[0] : NULL },
+	};
+	for (GLuint d = 0; d < sizeof(destinations) / sizeof(destinations[0]); d++)
+	{
+		const SnapshotColumn* column = byId[destinations[d].id];
+		if (column == NULL || n == 0)
+			continue;
+		if (column->width != destinations[d].width)
+		{
+			std::cerr << "Error loading snapshot: " << filename
+			          << " has column " << column->id << " of width "
+			          << column->width << std::endl;
+			return false;
+		}
+		memcpy(destinations[d].data, data + column->offset,
+			(size_t) column->size);
+	}
+	for (GLuint i = 0; i < names.size(); i++)
+		loaded.name[i] = names[i];
+
+	/* Asset indices to cache handles (-1 stays -1, as for no background). */
+	std::vector<GLuint> meshHandles(meshPaths.size()),
+		textureHandles(texturePaths.size());
+	for (GLuint i = 0; i < meshPaths.size(); i++)
+		meshHandles[i] = assets->addMesh(meshPaths[i]);
+	for (GLuint i = 0; i < texturePaths.size(); i++)
+		textureHandles[i] = assets->addTexture(texturePaths[i]);
+	for (GLuint i = 0; i < n; i++)
+	{
+		GLuint mesh = loaded.mesh[i], texture = loaded.texture[i];
+		loaded.mesh[i] = (mesh < meshHandles.size()) ?
+			meshHandles[mesh] : (GLuint) -1;
+		loaded.texture[i] = (texture < textureHandles.size()) ?
+			textureHandles[texture] : (GLuint) -1;
+	}
+
+	/* Replace the system. */
+	system.getBodies().swap(loaded);
+	system.setGravity(header.gravity);
+	system.setScale(header.scale);
+	system.setSpeed(header.speed);
+	system.setBackground(
+		(header.backgroundMesh < meshHandles.size()) ?
+		meshHandles[header.backgroundMesh] : (GLuint) -1,
+		(header.backgroundTexture < textureHandles.size()) ?
+		textureHandles[header.backgroundTexture] : (GLuint) -1,
+		header.backgroundRadius, header.backgroundTilt);
+	if (time != NULL)
+		*time = header.time;
+
+	fprintf(stdout, "Stats: Loaded %u bodies from %s (t = %.0f s)\n", n,
+		filename, header.time);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            Snapshot::isSnapshot                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the file to be checked.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file starts with SNAPSHOT_MAGIC.                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reads only the first four bytes.                                           *
+*                                                                             *
+*******************************************************************************/
+bool Snapshot::isSnapshot(const char* filename)
+{
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL)
+		return false;
+	GLuint magic = 0;
+	bool read = fread(&magic, sizeof(magic), 1, file) == 1;
+	fclose(file);
+	return read && magic == SNAPSHOT_MAGIC;
+}
+
+/******************************************************************************
+*                                                                             *
+*                             Snapshot::loadScene                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of a snapshot or of a system.xml.                            *
+*  @param system                                                              *
+*           The system to be replaced.                                        *
+*  @param assets                                                              *
+*           Cache in which the mesh and texture paths are registered.         *
+*  @param time                                                                *
+*           If not NULL, receives the simulated time (0 for XML).             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the file was loaded, false otherwise.                              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Chooses the format by the magic number rather than the file name.        *
+*                                                                             *
+*******************************************************************************/
+bool Snapshot::loadScene(const char* filename, OrbitalSystem &system,
+                         AssetCache* assets, double* time)
+{
+	if (isSnapshot(filename))
+		return load(filename, system, assets, time);
+	if (time != NULL)
+		*time = 0.0;
+	return system.loadXml(filename, assets);
+}
+
+/******************************************************************************
+*                                                                             *
+*                              Snapshot::convert                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param input                                                               *
+*           Path of a snapshot or of a system.xml.                            *
+*  @param output                                                              *
+*           Path of the file in the other format.                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the output was written, false otherwise.                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Loads the input into a scratch system and writes it in the other         *
+*  format. Only paths are registered in the scratch cache; nothing is        *
+*  loaded.                                                                    *
+*                                                                             *
+*******************************************************************************/
+bool Snapshot::convert(const char* input, const char* output)
+{
+	AssetCache    assets;
+	OrbitalSystem system;
+	double        time = 0.0;
+	if (isSnapshot(input))
+		return load(input, system, &assets, &time) &&
+			system.saveXml(output, assets);
+	return system.loadXml(input, &assets) &&
+		save(output, system, assets, time);
+}
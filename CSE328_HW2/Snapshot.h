@@ -0,0 +1,162 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include "AssetCache.h"
+#include "OrbitalSystem.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flags converting between formats (IN OUT), and writing a */
+/* snapshot of the running system on exit.                                */
+#define  SNAPSHOT_CONVERT_FLAG      "--convert"
+#define  SNAPSHOT_CHECKPOINT_FLAG   "--checkpoint"
+/* Format identification. */
+#define  SNAPSHOT_MAGIC             0x50414E53   /* "SNAP" */
+#define  SNAPSHOT_VERSION           1
+
+/******************************************************************************
+*                                                                             *
+*                          SnapshotColumnId  (enum)                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Identifiers of the columns of a snapshot. Body columns hold one fixed    *
+*  width value per body: doubles for the state, floats for the spin, and     *
+*  indices into the path tables for the assets. The names and the asset     *
+*  paths are string tables. New columns get new identifiers; readers skip   *
+*  the ones they do not know.                                               *
+*                                                                             *
+*******************************************************************************/
+enum SnapshotColumnId
+{
+	SNAPSHOT_PX               = 0,
+	SNAPSHOT_PY               = 1,
+	SNAPSHOT_PZ               = 2,
+	SNAPSHOT_VX               = 3,
+	SNAPSHOT_VY               = 4,
+	SNAPSHOT_VZ               = 5,
+	SNAPSHOT_MASS             = 6,
+	SNAPSHOT_RADIUS           = 7,
+	SNAPSHOT_TILT             = 8,
+	SNAPSHOT_ROTATIONAL_SPEED = 9,
+	SNAPSHOT_ROTATION         = 10,
+	SNAPSHOT_MESH             = 11,
+	SNAPSHOT_TEXTURE          = 12,
+	SNAPSHOT_NAMES            = 13,
+	SNAPSHOT_MESH_PATHS       = 14,
+	SNAPSHOT_TEXTURE_PATHS    = 15
+};
+
+/******************************************************************************
+*                                                                             *
+*                         SnapshotHeader  (struct)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  magic, version                                                             *
+*          SNAPSHOT_MAGIC and SNAPSHOT_VERSION.                               *
+*  bodies                                                                     *
+*          Number of bodies.                                                  *
+*  columns                                                                    *
+*          Number of SnapshotColumn entries following the header.             *
+*  time                                                                       *
+*          Simulated time of the snapshot in seconds.                         *
+*  gravity, scale, speed                                                      *
+*          System constants.                                                  *
+*  backgroundRadius, backgroundTilt                                           *
+*          Size and tilt of the background sphere.                            *
+*  backgroundMesh, backgroundTexture                                          *
+*          Indices into the path tables (-1 for no background).              *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Start of a snapshot file, followed by the column directory and then the  *
+*  columns, each starting on a multiple of 8 bytes so it can be used in     *
+*  place from a mapping of the file. All values are little-endian.          *
+*                                                                             *
+*******************************************************************************/
+struct SnapshotHeader
+{
+	GLuint           magic;
+	GLuint           version;
+	GLuint           bodies;
+	GLuint           columns;
+	double           time;
+	double           gravity;
+	double           scale;
+	double           speed;
+	double           backgroundRadius;
+	GLfloat          backgroundTilt;
+	GLuint           backgroundMesh;
+	GLuint           backgroundTexture;
+	GLuint           reserved;
+};
+
+/******************************************************************************
+*                                                                             *
+*                         SnapshotColumn  (struct)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  id                                                                         *
+*          A SnapshotColumnId.                                                *
+*  width                                                                      *
+*          Bytes per body, or 0 for a string table.                           *
+*  offset, size                                                               *
+*          Position and length of the column in the file, in bytes.          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Entry of the column directory. A string table is a count, count + 1      *
+*  offsets (32 bit) into the characters which follow, and the characters,   *
+*  each string null terminated.                                              *
+*                                                                             *
+*******************************************************************************/
+struct SnapshotColumn
+{
+	GLuint             id;
+	GLuint             width;
+	unsigned long long offset;
+	unsigned long long size;
+};
+
+/******************************************************************************
+*                                                                             *
+*                            Snapshot  (class)                                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to save and restore an orbital      *
+*  system as a binary snapshot, the counterpart of system.xml for large     *
+*  systems and checkpoints. Saving writes each body array as it is held in  *
+*  memory; loading maps the file and copies the columns straight into the   *
+*  body arrays, so neither formats nor parses a number.                       *
+*                                                                             *
+*******************************************************************************/
+class Snapshot
+{
+public:
+	/* Write the system (at simulated time) to filename; false on error. */
+	static bool      save(const char* filename, const OrbitalSystem &system,
+	                      const AssetCache &assets, double time = 0.0);
+	/* Replace the system with the snapshot in filename; false on error. */
+	static bool      load(const char* filename, OrbitalSystem &system,
+	                      AssetCache* assets, double* time = NULL);
+
+	/* Whether filename starts like a snapshot. */
+	static bool      isSnapshot(const char* filename);
+	/* Load a snapshot or, if it is not one, a system.xml. */
+	static bool      loadScene(const char* filename, OrbitalSystem &system,
+	                           AssetCache* assets, double* time = NULL);
+	/* Convert a system.xml to a snapshot, or a snapshot to system.xml. */
+	static bool      convert(const char* input, const char* output);
+};
@@ -0,0 +1,150 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "StartupProfiler.h"
+#include "TaskScheduler.h"
+#include <cstdio>
+
+/******************************************************************************
+*                                                                             *
+*                                Static Variables                             *
+*                                                                             *
+******************************************************************************/
+Uint64                                 StartupProfiler::origin = 0;
+Uint64                                 StartupProfiler::phaseStart = 0;
+bool                                   StartupProfiler::finished = false;
+std::vector<StartupProfiler::Interval> StartupProfiler::phases;
+std::vector<StartupProfiler::Interval> StartupProfiler::tasks;
+std::mutex                             StartupProfiler::taskLock;
+
+/******************************************************************************
+*                                                                             *
+*                         StartupProfiler::begin (static)                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Sets the origin of every reported time. Call first thing in main.          *
+*                                                                             *
+*******************************************************************************/
+void StartupProfiler::begin()
+{
+	origin = phaseStart = now();
+}
+
+/******************************************************************************
+*                                                                             *
+*                         StartupProfiler::mark (static)                      *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param phase                                                               *
+*           Name of the phase which just ended (a string literal).            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Records the time since the previous mark (or begin) as the phase, and      *
+*  starts the next one. Main thread only; ignored once finished.              *
+*                                                                             *
+*******************************************************************************/
+void StartupProfiler::mark(const char* phase)
+{
+	if (finished)
+		return;
+	Interval interval = { phase, 0, phaseStart, now() };
+	phases.push_back(interval);
+	phaseStart = interval.end;
+}
+
+/******************************************************************************
+*                                                                             *
+*                       StartupProfiler::recordTask (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param task                                                                *
+*           Name of the task (a string literal).                              *
+*  @param start                                                               *
+*           Value of now() when the task started.                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Records a task which ends now, with the scheduler slot that ran it.        *
+*                                                                             *
+*******************************************************************************/
+void StartupProfiler::recordTask(const char* task, Uint64 start)
+{
+	Interval interval = { task, TaskScheduler::getThreadIndex(), start, now() };
+	std::lock_guard<std::mutex> guard(taskLock);
+	if (!finished)
+		tasks.push_back(interval);
+}
+
+/******************************************************************************
+*                                                                             *
+*                        StartupProfiler::finish (static)                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Ends the last phase and prints every phase and task with its start and     *
+*  duration in milliseconds, then the total time to the first frame and how   *
+*  much task time overlapped the main thread. Call after the first swap.      *
+*                                                                             *
+*******************************************************************************/
+void StartupProfiler::finish()
+{
+	if (finished)
+		return;
+	mark("First frame");
+	std::lock_guard<std::mutex> guard(taskLock);
+	finished = true;
+
+	const double toMillis = 1000.0 / SDL_GetPerformanceFrequency();
+	fprintf(stdout, "Stats: Startup %-26s %9s %9s\n", "phase", "start ms",
+		"ms");
+	for (GLuint i = 0; i < phases.size(); i++)
+		fprintf(stdout, "Stats: Startup %-26s %9.2f %9.2f\n", phases[i].name,
+			(phases[i].start - origin) * toMillis,
+			(phases[i].end - phases[i].start) * toMillis);
+
+	double taskMillis = 0.0;
+	for (GLuint i = 0; i < tasks.size(); i++)
+	{
+		const double millis = (tasks[i].end - tasks[i].start) * toMillis;
+		fprintf(stdout, "Stats: Startup   %-12s (thread %2u) %9.2f %9.2f\n",
+			tasks[i].name, tasks[i].thread,
+			(tasks[i].start - origin) * toMillis, millis);
+		taskMillis += millis;
+	}
+
+	fprintf(stdout, "Stats: Startup took %.2f ms to the first frame "
+		"(%.2f ms of tasks on %u threads)\n", (phaseStart - origin) * toMillis,
+		taskMillis, TaskScheduler::get().getNumThreads());
+	phases.clear();
+	tasks.clear();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <SDL\SDL.h>
+#include <mutex>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                         StartupProfiler  (class)                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to time the startup of the viewer,    *
+*  from the start of main to the first swap of the window. The main thread    *
+*  marks the end of each phase (so the phases tile the whole time), and       *
+*  tasks run on the workers meanwhile record their own start and duration.    *
+*  finish prints both as Stats lines, once; later calls do nothing.           *
+*                                                                             *
+*  Times come from SDL_GetPerformanceCounter, which works before SDL_Init.    *
+*                                                                             *
+*******************************************************************************/
+class StartupProfiler
+{
+public:
+	/* Start timing (the first phase begins here). */
+	static void     begin();
+	/* End the current phase of the main thread. */
+	static void     mark(const char* phase);
+	/* Record a task which started at start (any thread). */
+	static void     recordTask(const char* task, Uint64 start);
+	/* Print the phases and tasks, the first time only. */
+	static void     finish();
+
+	/* Current time, for recordTask. */
+	static Uint64   now()   {  return SDL_GetPerformanceCounter();  }
+
+private:
+	/* A timed interval. */
+	struct Interval
+	{
+		const char* name;
+		GLuint      thread;
+		Uint64      start;
+		Uint64      end;
+	};
+
+	static Uint64                origin;
+	static Uint64                phaseStart;
+	static bool                  finished;
+	static std::vector<Interval> phases;
+	static std::vector<Interval> tasks;
+	static std::mutex            taskLock;
+};
@@ -0,0 +1,616 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Visual Studio 2013 has no thread_local; both of these work on PODs. */
+#if defined(_MSC_VER)
+#define THREAD_LOCAL    __declspec(thread)
+#else
+#define THREAD_LOCAL    __thread
+#endif
+
+/* The shared scheduler. */
+static TaskScheduler* instance = NULL;
+/* Slot of the current thread and how many tasks it is nested in. */
+static THREAD_LOCAL GLuint threadIndex = 0;
+static THREAD_LOCAL GLuint taskDepth = 0;
+
+/******************************************************************************
+*                                                                             *
+*                           ScratchArena::allocate                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param bytes                                                               *
+*           Number of bytes needed.                                           *
+*  @param align                                                               *
+*           Alignment of the returned address (a power of two).               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Uninitialized memory valid until the arena is released below it.          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Bumps through the current block, moving on to the next (or a new, twice  *
+*  as large) block when the request does not fit.                             *
+*                                                                             *
+*******************************************************************************/
+void* ScratchArena::allocate(size_t bytes, size_t align)
+{
+	for (;;)
+	{
+		/* Try the current block. */
+		if (block < blocks.size())
+		{
+			std::vector<char> &b = blocks[block];
+			size_t base = (size_t) &b[0];
+			size_t offset = ((base + used + align - 1) & ~(align - 1)) - base;
+			if (offset + bytes <= b.size())
+			{
+				used = offset + bytes;
+				return &b[offset];
+			}
+			block++;
+			used = 0;
+			continue;
+		}
+
+		/* Add a block large enough for the request. */
+		size_t size = blocks.empty() ? SCRATCH_BLOCK_SIZE :
+			2 * blocks.back().size();
+		while (size < bytes + align)
+			size *= 2;
+		blocks.push_back(std::vector<char>(size));
+		block = blocks.size() - 1;
+		used = 0;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                        TaskScheduler::get (static)                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The shared scheduler.                                                      *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the scheduler with one slot per hardware thread on first use. The *
+*  first call must come from the main thread (Visual Studio 2013 statics are *
+*  not initialized thread-safely).                                            *
+*                                                                             *
+*******************************************************************************/
+TaskScheduler& TaskScheduler::get()
+{
+	if (instance == NULL)
+		instance = new TaskScheduler(
+			std::max(1u, std::thread::hardware_concurrency()));
+	return *instance;
+}
+
+/******************************************************************************
+*                                                                             *
+*                      TaskScheduler::shutdown (static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Joins the workers before the program exits. Must not be called while     *
+*  tasks are running.                                                         *
+*                                                                             *
+*******************************************************************************/
+void TaskScheduler::shutdown()
+{
+	delete instance;
+	instance = NULL;
+}
+
+/******************************************************************************
+*                                                                             *
+*                     TaskScheduler::getThreadIndex (static)                  *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The slot of the calling thread: 0 for the main thread, 1 .. n - 1 for the  *
+*  workers.                                                                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Lets code index per-thread arrays without locking.                         *
+*                                                                             *
+*******************************************************************************/
+GLuint TaskScheduler::getThreadIndex()
+{
+	return threadIndex;
+}
+
+/******************************************************************************
+*                                                                             *
+*                     TaskScheduler::now (static)                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The current time in nanoseconds.                                           *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Clock used for the utilization counters.                                   *
+*                                                                             *
+*******************************************************************************/
+unsigned long long TaskScheduler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/******************************************************************************
+*                                                                             *
+*                   TaskScheduler::TaskScheduler (Constructor)                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param threads                                                             *
+*           Number of threads running tasks, including the main thread.       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates every slot before starting the workers, as they steal from all    *
+*  of them.                                                                   *
+*                                                                             *
+*******************************************************************************/
+TaskScheduler::TaskScheduler(GLuint threads) :
+	queued(0), stopping(false), reportTicks(now())
+{
+	for (GLuint i = 0; i < threads; i++)
+		slots.push_back(new Slot());
+	for (GLuint i = 1; i < threads; i++)
+		slots[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i);
+}
+
+/******************************************************************************
+*                                                                             *
+*                   TaskScheduler::~TaskScheduler (Destructor)                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Wakes and joins the workers, then frees the slots.                         *
+*                                                                             *
+*******************************************************************************/
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (GLuint i = 1; i < slots.size(); i++)
+		slots[i]->thread.join();
+	for (Slot* slot : slots)
+		delete slot;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TaskScheduler::submit                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param group                                                               *
+*           Group the task is counted in.                                     *
+*  @param task                                                                *
+*           Work to be done.                                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Pushes the task on the back of the calling thread's deque and wakes a     *
+*  sleeping worker to steal it.                                               *
+*                                                                             *
+*******************************************************************************/
+void TaskScheduler::submit(TaskGroup &group, const std::function<void()> &task)
+{
+	Task t = { task, &group };
+	group.pending++;
+
+	Slot* slot = slots[threadIndex];
+	{
+		std::lock_guard<std::mutex> guard(slot->lock);
+		slot->tasks.push_back(t);
+	}
+	queued++;
+
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	wake.notify_one();
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TaskScheduler::runOne                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param self                                                                *
+*           Slot of the calling thread.                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if a task was run, false if every deque was empty.                    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Pops the newest task of the thread's own deque or, failing that, steals  *
+*  the oldest task of the next non-empty deque. Only the outermost task of a *
+*  thread counts towards its busy time, so helping inside wait is not        *
+*  counted twice.                                                             *
+*                                                                             *
+*******************************************************************************/
+bool TaskScheduler::runOne(GLuint self)
+{
+	const GLuint n = slots.size();
+	Task task;
+	bool found = false, stolen = false;
+
+	/* Own deque, newest first. */
+	{
+		Slot* own = slots[self];
+		std::lock_guard<std::mutex> guard(own->lock);
+		if (!own->tasks.empty())
+		{
+			task = own->tasks.back();
+			own->tasks.pop_back();
+			found = true;
+		}
+	}
+
+	/* Other deques, oldest first. */
+	for (GLuint k = 1; !found && k < n; k++)
+	{
+		Slot* victim = slots[(self + k) % n];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->tasks.empty())
+		{
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+			found = stolen = true;
+		}
+	}
+
+	if (!found)
+		return false;
+	queued--;
+
+	/* Run it. */
+	Slot* slot = slots[self];
+	unsigned long long start = (taskDepth == 0) ? now() : 0;
+	taskDepth++;
+	task.function();
+	taskDepth--;
+	if (taskDepth == 0)
+		slot->busyTicks += now() - start;
+	slot->executed++;
+	if (stolen)
+		slot->steals++;
+
+	task.group->pending--;
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TaskScheduler::wait                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param group                                                               *
+*           The group to wait for.                                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs tasks (of any group) until the group has no pending tasks.            *
+*                                                                             *
+*******************************************************************************/
+void TaskScheduler::wait(TaskGroup &group)
+{
+	const GLuint self = threadIndex;
+	while (group.pending > 0)
+	{
+		if (!runOne(self))
+			std::this_thread::yield();
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TaskScheduler::workerLoop                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param self                                                                *
+*           Slot of this worker.                                              *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs tasks while there are any and sleeps until more are submitted.       *
+*                                                                             *
+*******************************************************************************/
+void TaskScheduler::workerLoop(GLuint self)
+{
+	threadIndex = self;
+	for (;;)
+	{
+		if (runOne(self))
+			continue;
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this]() { return stopping || queued > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TaskScheduler::getScratch                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The scratch arena of the calling thread.                                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Slot 0 is shared by every non-worker thread; only the main thread may use *
+*  it.                                                                        *
+*                                                                             *
+*******************************************************************************/
+ScratchArena& TaskScheduler::getScratch()
+{
+	return slots[threadIndex]->scratch;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TaskScheduler::reportStats                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Prints, per thread, the share of the time since the last report spent in *
+*  tasks and the number of tasks run and stolen, then resets the counters.   *
+*                                                                             *
+*******************************************************************************/
+void TaskScheduler::reportStats()
+{
+	unsigned long long current = now();
+	double elapsed = (double) std::max(1ull, current - reportTicks);
+	reportTicks = current;
+
+	for (GLuint i = 0; i < slots.size(); i++)
+	{
+		unsigned long long busy = slots[i]->busyTicks.exchange(0);
+		unsigned long long executed = slots[i]->executed.exchange(0);
+		unsigned long long steals = slots[i]->steals.exchange(0);
+		fprintf(stdout, "Stats: Thread %2u: %5.1f%% busy, %llu tasks, "
+			"%llu steals\n", i, 100.0 * busy / elapsed, executed, steals);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                               TaskGraph::add                                *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param function                                                            *
+*           Work of the new node.                                             *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Index of the new node.                                                     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Adds a node without dependencies.                                          *
+*                                                                             *
+*******************************************************************************/
+GLuint TaskGraph::add(const std::function<void()> &function)
+{
+	functions.push_back(function);
+	successors.push_back(std::vector<GLuint>());
+	predecessors.push_back(0);
+	return functions.size() - 1;
+}
+
+/******************************************************************************
+*                                                                             *
+*                             TaskGraph::precede                              *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param before                                                              *
+*           Node which must finish first.                                     *
+*  @param after                                                               *
+*           Node which waits for it.                                          *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Adds a dependency edge.                                                    *
+*                                                                             *
+*******************************************************************************/
+void TaskGraph::precede(GLuint before, GLuint after)
+{
+	successors[before].push_back(after);
+	predecessors[after]++;
+}
+
+/******************************************************************************
+*                                                                             *
+*                              TaskGraph::run                                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param scheduler                                                           *
+*           Scheduler to run the nodes on.                                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if every node ran, false if the graph has a cycle.                    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Checks the graph is acyclic (a cycle would never finish), then launches  *
+*  the nodes without predecessors and waits for the whole graph.              *
+*                                                                             *
+*******************************************************************************/
+bool TaskGraph::run(TaskScheduler &scheduler)
+{
+	const GLuint n = functions.size();
+	if (n == 0)
+		return true;
+
+	/* Topological sort to find cycles. */
+	std::vector<GLuint> indegree(predecessors), ready;
+	for (GLuint i = 0; i < n; i++)
+	{
+		if (indegree[i] == 0)
+			ready.push_back(i);
+	}
+	for (GLuint k = 0; k < ready.size(); k++)
+	{
+		for (GLuint s : successors[ready[k]])
+		{
+			if (--indegree[s] == 0)
+				ready.push_back(s);
+		}
+	}
+	if (ready.size() != n)
+	{
+		std::cerr << "Error running task graph: dependencies form a cycle"
+		          << std::endl;
+		return false;
+	}
+
+	/* Run. */
+	remaining.reset(new std::atomic<GLuint>[n]);
+	for (GLuint i = 0; i < n; i++)
+		remaining[i] = predecessors[i];
+	TaskGroup group;
+	for (GLuint i = 0; i < n; i++)
+	{
+		if (predecessors[i] == 0)
+			launch(scheduler, group, i);
+	}
+	scheduler.wait(group);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                             TaskGraph::launch                               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param scheduler                                                           *
+*           Scheduler to run the node on.                                     *
+*  @param group                                                               *
+*           Group of the whole graph.                                         *
+*  @param node                                                                *
+*           Node to be run.                                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Submits the node; when it finishes, each successor whose last             *
+*  predecessor it was is launched in turn (before the node counts as done,   *
+*  so the group cannot empty early).                                          *
+*                                                                             *
+*******************************************************************************/
+void TaskGraph::launch(TaskScheduler &scheduler, TaskGroup &group, GLuint node)
+{
+	scheduler.submit(group, [this, &scheduler, &group, node]()
+	{
+		functions[node]();
+		for (GLuint s : successors[node])
+		{
+			if (--remaining[s] == 0)
+				launch(scheduler, group, s);
+		}
+	});
+}
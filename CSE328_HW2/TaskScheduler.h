@@ -0,0 +1,234 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Size of the first block of a scratch arena. */
+#define  SCRATCH_BLOCK_SIZE         (256 * 1024)
+
+/******************************************************************************
+*                                                                             *
+*                           TaskGroup  (struct)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  pending                                                                    *
+*          Number of submitted tasks of the group which have not finished.    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Set of tasks which can be waited for together. A group must outlive the  *
+*  wait on it.                                                                *
+*                                                                             *
+*******************************************************************************/
+struct TaskGroup
+{
+	std::atomic<GLuint> pending;
+
+	TaskGroup() : pending(0) {}
+};
+
+/******************************************************************************
+*                                                                             *
+*                         ScratchArena  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  blocks                                                                     *
+*          Memory blocks, each larger than the one before.                    *
+*  block, used                                                                *
+*          Current block and the bytes used in it.                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Per-thread bump allocator for temporary arrays. Callers take a mark,      *
+*  allocate, and release back to the mark when done, in stack order. Blocks  *
+*  are kept between uses, so steady-state frames do not touch the heap, and  *
+*  earlier allocations never move when a new block is added.                  *
+*                                                                             *
+*******************************************************************************/
+class ScratchArena
+{
+public:
+	/* Position to release back to. */
+	struct Mark { GLuint block; size_t used; };
+
+	                 ScratchArena() : block(0), used(0) {}
+
+	/* Allocate bytes aligned to align (a power of two). */
+	void*            allocate(size_t bytes, size_t align = 16);
+	/* Allocate an uninitialized array of count elements. */
+	template <typename T>
+	T*               allocate(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T),
+			__alignof(T) > 16 ? __alignof(T) : 16));
+	}
+
+	/* Stack discipline. */
+	Mark             getMark()          const {  Mark m = { block, used };
+	                                             return m;                  }
+	void             release(Mark m)          {  block = m.block;
+	                                             used = m.used;             }
+
+private:
+	std::vector<std::vector<char> > blocks;
+	GLuint           block;
+	size_t           used;
+};
+
+/******************************************************************************
+*                                                                             *
+*                         TaskScheduler  (class)                              *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  slots                                                                      *
+*          One per thread: slot 0 belongs to the threads which are not        *
+*          workers (the main thread), slots 1 .. n - 1 to the workers. Each   *
+*          has a task deque, a scratch arena and counters.                    *
+*  queued                                                                     *
+*          Number of tasks in all deques, used to put idle workers to sleep.  *
+*  stopping                                                                   *
+*          Set when the workers are to exit.                                  *
+*  reportTicks                                                                *
+*          Time of the last statistics report.                                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Work-stealing task scheduler shared by the whole application. A thread    *
+*  pushes and pops tasks at the back of its own deque (so recently split     *
+*  work stays in its cache) while idle threads steal from the front of the   *
+*  others' deques (taking the largest, oldest pieces). Waiting for a group   *
+*  runs tasks instead of blocking, so tasks may submit and wait for further  *
+*  tasks without deadlock. Created on first use from the main thread and    *
+*  destroyed with shutdown.                                                   *
+*                                                                             *
+*******************************************************************************/
+class TaskScheduler
+{
+public:
+	/* Shared scheduler (created on first use). */
+	static TaskScheduler& get();
+	/* Stop and join the workers of the shared scheduler. */
+	static void      shutdown();
+
+	/* Number of threads running tasks, including the caller of wait. */
+	GLuint           getNumThreads() const {  return slots.size();  }
+	/* Slot of the calling thread (0 for non-workers). */
+	static GLuint    getThreadIndex();
+
+	/* Queue a task in the calling thread's deque. */
+	void             submit(TaskGroup &group, const std::function<void()> &task);
+	/* Run tasks until every task of the group has finished. */
+	void             wait(TaskGroup &group);
+
+	/* Scratch memory of the calling thread. */
+	ScratchArena&    getScratch();
+
+	/* Print and reset the utilization, task and steal counters. */
+	void             reportStats();
+
+private:
+	/* A queued task. */
+	struct Task
+	{
+		std::function<void()> function;
+		TaskGroup*       group;
+	};
+	/* Per-thread state. */
+	struct Slot
+	{
+		std::mutex       lock;
+		std::deque<Task> tasks;
+		std::thread      thread;
+		ScratchArena     scratch;
+		std::atomic<unsigned long long> executed;
+		std::atomic<unsigned long long> steals;
+		std::atomic<unsigned long long> busyTicks;
+
+		Slot() : executed(0), steals(0), busyTicks(0) {}
+	};
+
+	std::vector<Slot*>      slots;
+	std::atomic<GLuint>     queued;
+	std::mutex              sleepLock;
+	std::condition_variable wake;
+	bool                    stopping;
+	unsigned long long      reportTicks;
+
+	/* Created and destroyed through get and shutdown only. */
+	                 TaskScheduler(GLuint threads);
+	                 ~TaskScheduler();
+
+	/* Take and run one task (own deque first, then steal). */
+	bool             runOne(GLuint self);
+	/* Body of the worker threads. */
+	void             workerLoop(GLuint self);
+	/* Current time in ticks of the clock used for utilization. */
+	static unsigned long long now();
+};
+
+/******************************************************************************
+*                                                                             *
+*                            TaskGraph  (class)                               *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  functions                                                                  *
+*          Work of each node.                                                 *
+*  successors                                                                 *
+*          Nodes which may only start once the node has finished.             *
+*  predecessors                                                               *
+*          Number of nodes each node waits for.                               *
+*  remaining                                                                  *
+*          Predecessors still running during run.                             *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Acyclic graph of tasks with dependencies. run submits the nodes without   *
+*  predecessors and every finished node submits the successors it was the   *
+*  last to unblock, so independent branches run in parallel.                  *
+*                                                                             *
+*******************************************************************************/
+class TaskGraph
+{
+public:
+	/* Add a node and return its index. */
+	GLuint           add(const std::function<void()> &function);
+	/* Make after wait for before. */
+	void             precede(GLuint before, GLuint after);
+	/* Run every node once; false (and nothing run) if there is a cycle. */
+	bool             run(TaskScheduler &scheduler = TaskScheduler::get());
+
+	/* Getters. */
+	GLuint           getNumNodes() const {  return functions.size();  }
+
+private:
+	std::vector<std::function<void()> > functions;
+	std::vector<std::vector<GLuint> >   successors;
+	std::vector<GLuint>                 predecessors;
+	std::unique_ptr<std::atomic<GLuint>[]> remaining;
+
+	/* Submit a node whose predecessors have finished. */
+	void             launch(TaskScheduler &scheduler, TaskGroup &group,
+	                        GLuint node);
+};
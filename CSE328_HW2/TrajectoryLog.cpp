@@ -0,0 +1,644 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "TrajectoryLog.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+/******************************************************************************
+*                                                                             *
+*                           Macros and Static Variables                       *
+*                                                                             *
+******************************************************************************/
+
+/* Bodies per task when writing replayed positions. */
+#define BODY_GRAIN 4096
+
+/******************************************************************************
+*                                                                             *
+*                                 putVarint                                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param out                                                                 *
+*           Buffer the value is appended to.                                  *
+*  @param value                                                               *
+*           Signed value to be stored.                                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Zigzag-maps the value so small magnitudes of either sign are small, then *
+*  stores it 7 bits per byte with the high bit marking continuation.         *
+*                                                                             *
+*******************************************************************************/
+static inline void putVarint(std::vector<unsigned char> &out, long long value)
+{
+	unsigned long long u = ((unsigned long long) value << 1) ^
+		(unsigned long long) (value >> 63);
+	while (u >= 0x80)
+	{
+		out.push_back((unsigned char) (u | 0x80));
+		u >>= 7;
+	}
+	out.push_back((unsigned char) u);
+}
+
+/******************************************************************************
+*                                                                             *
+*                                 getVarint                                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param p                                                                   *
+*           Read position, advanced past the value.                           *
+*  @param end                                                                 *
+*           End of the payload.                                               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The value stored by putVarint (0 if the payload ends first).               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Inverse of putVarint.                                                      *
+*                                                                             *
+*******************************************************************************/
+static inline long long getVarint(const unsigned char* &p,
+                                  const unsigned char* end)
+{
+	unsigned long long u = 0;
+	for (GLuint shift = 0; p < end && shift < 64; shift += 7)
+	{
+		unsigned char byte = *p++;
+		u |= (unsigned long long) (byte & 0x7F) << shift;
+		if (byte < 0x80)
+			break;
+	}
+	return (long long) (u >> 1) ^ -(long long) (u & 1);
+}
+
+/******************************************************************************
+*                                                                             *
+*                   TrajectoryWriter::TrajectoryWriter (Constructor)          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a closed writer.                                                   *
+*                                                                             *
+*******************************************************************************/
+TrajectoryWriter::TrajectoryWriter() :
+	file(NULL), frames(0), startTime(0.0), totalFrames(0), totalBytes(0)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+/******************************************************************************
+*                                                                             *
+*                   TrajectoryWriter::~TrajectoryWriter (Destructor)          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Closes the log, writing any partial chunk.                                 *
+*                                                                             *
+*******************************************************************************/
+TrajectoryWriter::~TrajectoryWriter()
+{
+	close();
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryWriter::open                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the log to create (replacing any existing file).          *
+*  @param bodies                                                              *
+*           Number of bodies in every frame.                                  *
+*  @param quantum                                                             *
+*           Position resolution in meters.                                    *
+*  @param keyframeInterval                                                    *
+*           Frames per chunk.                                                 *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the log was created.                                               *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes the header. A shorter keyframe interval makes seeking cheaper and  *
+*  the log larger.                                                            *
+*                                                                             *
+*******************************************************************************/
+bool TrajectoryWriter::open(const char* filename, GLuint bodies,
+                            double quantum, GLuint keyframeInterval)
+{
+	close();
+
+	file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		std::cerr << "Error recording trajectory: cannot create " << filename
+		          << std::endl;
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = TRAJECTORY_MAGIC;
+	header.version = TRAJECTORY_VERSION;
+	header.bodies = bodies;
+	header.keyframeInterval = std::max(1u, keyframeInterval);
+	header.quantum = quantum;
+	fwrite(&header, sizeof(header), 1, file);
+
+	chunk.clear();
+	frames = 0;
+	previous.assign(3 * bodies, 0);
+	older.assign(3 * bodies, 0);
+	totalFrames = 0;
+	totalBytes = sizeof(header);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TrajectoryWriter::append                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param time                                                                *
+*           Simulated time of the frame in seconds (increasing).              *
+*  @param bodies                                                              *
+*           The bodies, as many as the log was opened for.                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Encodes the frame into the current chunk (see TrajectoryHeader) and      *
+*  writes the chunk out once it holds keyframeInterval frames.               *
+*                                                                             *
+*******************************************************************************/
+void TrajectoryWriter::append(double time, const BodyArrays &bodies)
+{
+	if (file == NULL || bodies.count != header.bodies)
+		return;
+
+	/* Frame time. */
+	const GLuint n = header.bodies;
+	const double inverse = 1.0 / header.quantum;
+	unsigned char raw[sizeof(double)];
+	memcpy(raw, &time, sizeof(double));
+	chunk.insert(chunk.end(), raw, raw + sizeof(double));
+	if (frames == 0)
+		startTime = time;
+
+	/* Positions. */
+	for (GLuint i = 0; i < n; i++)
+	{
+		const double p[3] = { bodies.px[i], bodies.py[i], bodies.pz[i] };
+		for (GLuint d = 0; d < 3; d++)
+		{
+			const GLuint k = 3 * i + d;
+			long long q = (long long) floor(p[d] * inverse + 0.5);
+
+			if (frames == 0)
+			{
+				unsigned char bytes[sizeof(long long)];
+				memcpy(bytes, &q, sizeof(long long));
+				chunk.insert(chunk.end(), bytes, bytes + sizeof(long long));
+			}
+			else if (frames == 1)
+				putVarint(chunk, q - previous[k]);
+			else
+				putVarint(chunk, q - (2 * previous[k] - older[k]));
+
+			older[k] = previous[k];
+			previous[k] = q;
+		}
+	}
+
+	/* Close the chunk when full. */
+	frames++;
+	totalFrames++;
+	if (frames == header.keyframeInterval)
+		flush();
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryWriter::flush                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes the chunk being built, if it has any frames, and starts a new one *
+*  (whose first frame will be a keyframe).                                    *
+*                                                                             *
+*******************************************************************************/
+void TrajectoryWriter::flush()
+{
+	if (file == NULL || frames == 0)
+		return;
+
+	TrajectoryChunkHeader chunkHeader;
+	memset(&chunkHeader, 0, sizeof(chunkHeader));
+	chunkHeader.magic = TRAJECTORY_CHUNK_MAGIC;
+	chunkHeader.frames = frames;
+	chunkHeader.bytes = chunk.size();
+	chunkHeader.startTime = startTime;
+	fwrite(&chunkHeader, sizeof(chunkHeader), 1, file);
+	fwrite(chunk.data(), 1, chunk.size(), file);
+	fflush(file);
+
+	totalBytes += sizeof(chunkHeader) + chunk.size();
+	chunk.clear();
+	frames = 0;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryWriter::close                          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Writes the partial chunk and reports the size of the log against the 24 *
+*  bytes per body per frame of uncompressed double positions.                 *
+*                                                                             *
+*******************************************************************************/
+void TrajectoryWriter::close()
+{
+	if (file == NULL)
+		return;
+
+	flush();
+	fclose(file);
+	file = NULL;
+
+	if (totalFrames > 0 && header.bodies > 0)
+	{
+		fprintf(stdout, "Stats: Recorded %llu frames of %u bodies, %.2f bytes "
+			"per position (24 uncompressed)\n", totalFrames, header.bodies,
+			(double) totalBytes / (totalFrames * header.bodies));
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                   TrajectoryReader::TrajectoryReader (Constructor)          *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates a reader with no log.                                              *
+*                                                                             *
+*******************************************************************************/
+TrajectoryReader::TrajectoryReader() :
+	endTime(0.0)
+{
+	memset(&header, 0, sizeof(header));
+	current.chunk = ahead.chunk = (GLuint) -1;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryReader::open                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param filename                                                            *
+*           Path of the log.                                                  *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  True if the log has a valid header and at least one complete chunk.        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Maps the log and follows the chunk headers to index the chunks. Only the *
+*  headers and the last chunk (for the end time) are read; a truncated last  *
+*  chunk is ignored.                                                          *
+*                                                                             *
+*******************************************************************************/
+bool TrajectoryReader::open(const char* filename)
+{
+	chunks.clear();
+	current.chunk = ahead.chunk = (GLuint) -1;
+	if (!map.open(filename))
+		return false;
+
+	/* Header. */
+	const unsigned char* data = map.getData();
+	const size_t size = map.getSize();
+	if (size < sizeof(header))
+	{
+		std::cerr << "Error replaying " << filename << ": file too short"
+		          << std::endl;
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != TRAJECTORY_MAGIC ||
+		header.version != TRAJECTORY_VERSION || header.quantum <= 0.0)
+	{
+		std::cerr << "Error replaying " << filename << ": not a version "
+		          << TRAJECTORY_VERSION << " trajectory log" << std::endl;
+		return false;
+	}
+
+	/* Chunks. */
+	size_t offset = sizeof(header);
+	while (offset + sizeof(TrajectoryChunkHeader) <= size)
+	{
+		TrajectoryChunkHeader chunkHeader;
+		memcpy(&chunkHeader, data + offset, sizeof(chunkHeader));
+		offset += sizeof(chunkHeader);
+		if (chunkHeader.magic != TRAJECTORY_CHUNK_MAGIC ||
+			chunkHeader.frames == 0 || chunkHeader.bytes > size - offset)
+			break;
+
+		Chunk chunk;
+		chunk.payload = data + offset;
+		chunk.end = chunk.payload + chunkHeader.bytes;
+		chunk.frames = chunkHeader.frames;
+		chunk.startTime = chunkHeader.startTime;
+		chunks.push_back(chunk);
+		offset += chunkHeader.bytes;
+	}
+	if (chunks.empty())
+	{
+		std::cerr << "Error replaying " << filename << ": no complete chunks"
+		          << std::endl;
+		return false;
+	}
+
+	/* End time. */
+	loadKeyframe(current, chunks.size() - 1);
+	while (step(current))
+		;
+	endTime = current.time;
+	current.chunk = (GLuint) -1;
+
+	fprintf(stdout, "Stats: Replaying %u bodies from %s, %u chunks, "
+		"%.2f days\n", header.bodies, filename, (GLuint) chunks.size(),
+		(endTime - getStartTime()) / 86400.0);
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        TrajectoryReader::getStartTime                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Time of the first frame (0 without a log).                                 *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The first chunk starts with the first frame.                               *
+*                                                                             *
+*******************************************************************************/
+double TrajectoryReader::getStartTime() const
+{
+	return chunks.empty() ? 0.0 : chunks[0].startTime;
+}
+
+/******************************************************************************
+*                                                                             *
+*                        TrajectoryReader::loadKeyframe                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param cursor                                                              *
+*           Destination of the frame.                                         *
+*  @param chunk                                                               *
+*           Index of the chunk.                                               *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Copies the raw positions of the first frame of the chunk.                  *
+*                                                                             *
+*******************************************************************************/
+void TrajectoryReader::loadKeyframe(Cursor &cursor, GLuint chunk) const
+{
+	const GLuint values = 3 * header.bodies;
+	const Chunk &c = chunks[chunk];
+	cursor.chunk = chunk;
+	cursor.frame = 0;
+	cursor.q.resize(values);
+	cursor.previous.resize(values);
+
+	const unsigned char* p = c.payload;
+	const size_t bytes = sizeof(double) + values * sizeof(long long);
+	if ((size_t) (c.end - p) < bytes)
+	{
+		/* Damaged chunk: hold the start time with zero positions. */
+		cursor.time = c.startTime;
+		std::fill(cursor.q.begin(), cursor.q.end(), 0);
+		cursor.next = c.end;
+	}
+	else
+	{
+		memcpy(&cursor.time, p, sizeof(double));
+		memcpy(cursor.q.data(), p + sizeof(double), values * sizeof(long long));
+		cursor.next = p + bytes;
+	}
+	cursor.previous = cursor.q;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryReader::step                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param cursor                                                              *
+*           The frame to advance from.                                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False if cursor was at the last frame of the log.                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Applies the next delta frame of the chunk, or loads the keyframe of the  *
+*  next chunk after its last frame.                                           *
+*                                                                             *
+*******************************************************************************/
+bool TrajectoryReader::step(Cursor &cursor) const
+{
+	const Chunk &c = chunks[cursor.chunk];
+	if (cursor.frame + 1 >= c.frames ||
+		(size_t) (c.end - cursor.next) < sizeof(double))
+	{
+		if (cursor.chunk + 1 >= chunks.size())
+			return false;
+		loadKeyframe(cursor, cursor.chunk + 1);
+		return true;
+	}
+
+	const unsigned char* p = cursor.next;
+	memcpy(&cursor.time, p, sizeof(double));
+	p += sizeof(double);
+
+	const GLuint values = 3 * header.bodies;
+	const bool predict = (cursor.frame > 0);
+	for (GLuint k = 0; k < values; k++)
+	{
+		long long q = cursor.q[k];
+		long long estimate = predict ? 2 * q - cursor.previous[k] : q;
+		cursor.previous[k] = q;
+		cursor.q[k] = estimate + getVarint(p, c.end);
+	}
+
+	cursor.next = p;
+	cursor.frame++;
+	return true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                            TrajectoryReader::seek                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param time                                                                *
+*           Time to show in seconds (clamped to the log).                     *
+*  @param bodies                                                              *
+*           Bodies to update, as many as the log holds.                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  False if there is no log or the body counts differ.                        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Positions are interpolated linearly between the frames around the time   *
+*  and velocities taken from the same two frames. Spins are rotationalSpeed  *
+*  times the time, as the simulation computes them.                          *
+*                                                                             *
+*******************************************************************************/
+bool TrajectoryReader::seek(double time, BodyArrays &bodies)
+{
+	if (chunks.empty() || bodies.count != header.bodies)
+		return false;
+
+	/* Find the chunk: the last one starting at or before the time. */
+	struct Before
+	{
+		bool operator()(double t, const Chunk &c) const
+		{
+			return t < c.startTime;
+		}
+	};
+	GLuint chunk = std::upper_bound(chunks.begin(), chunks.end(), time,
+		Before()) - chunks.begin();
+	chunk = (chunk > 0) ? chunk - 1 : 0;
+
+	/* Start from its keyframe unless already between it and the time. */
+	if (current.chunk != chunk || current.time > time)
+		loadKeyframe(current, chunk);
+
+	/* Walk the deltas up to the time. */
+	bool between = false;
+	for (;;)
+	{
+		ahead.chunk = current.chunk;
+		ahead.frame = current.frame;
+		ahead.next = current.next;
+		ahead.time = current.time;
+		ahead.q = current.q;
+		ahead.previous = current.previous;
+		if (!step(ahead))
+			break;
+		if (ahead.time > time)
+		{
+			between = true;
+			break;
+		}
+		std::swap(current, ahead);
+	}
+
+	/* Interpolate. */
+	const double quantum = header.quantum;
+	double span = between ? ahead.time - current.time : 0.0;
+	double alpha = (span > 0.0) ?
+		std::min(1.0, std::max(0.0, (time - current.time) / span)) : 0.0;
+	const long long* q0 = current.q.data();
+	const long long* q1 = between ? ahead.q.data() : q0;
+	Parallel::forRange(0, bodies.count, BODY_GRAIN, [&](GLuint lo, GLuint hi)
+	{
+		for (GLuint i = lo; i < hi; i++)
+		{
+			double* p[3] = { &bodies.px[i], &bodies.py[i], &bodies.pz[i] };
+			double* v[3] = { &bodies.vx[i], &bodies.vy[i], &bodies.vz[i] };
+			for (GLuint d = 0; d < 3; d++)
+			{
+				double a = (double) q0[3 * i + d];
+				double b = (double) q1[3 * i + d];
+				*p[d] = (a + alpha * (b - a)) * quantum;
+				*v[d] = (span > 0.0) ? (b - a) * quantum / span : 0.0;
+			}
+			bodies.rotation[i] = (GLfloat) fmod(bodies.rotationalSpeed[i] *
+				time, 360.0);
+		}
+	});
+	return true;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <cstdio>
+#include <vector>
+#include "MappedFile.h"
+#include "OrbitalSystem.h"
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Command line flags recording to, or replaying from, a trajectory log. */
+#define  TRAJECTORY_RECORD_FLAG     "--record"
+#define  TRAJECTORY_REPLAY_FLAG     "--replay"
+/* Format identification. */
+#define  TRAJECTORY_MAGIC           0x5442524F   /* "ORBT" */
+#define  TRAJECTORY_CHUNK_MAGIC     0x4B4E4843   /* "CHNK" */
+#define  TRAJECTORY_VERSION         1
+/* Frames per chunk; each chunk starts with a keyframe. */
+#define  DEFAULT_KEYFRAME_INTERVAL  64
+/* Position resolution in meters. */
+#define  DEFAULT_TRAJECTORY_QUANTUM 1000.0
+
+/******************************************************************************
+*                                                                             *
+*                      TrajectoryHeader  (struct)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  magic, version                                                             *
+*          TRAJECTORY_MAGIC and TRAJECTORY_VERSION.                           *
+*  bodies                                                                     *
+*          Number of bodies in every frame.                                   *
+*  keyframeInterval                                                           *
+*          Largest number of frames in a chunk.                               *
+*  quantum                                                                    *
+*          Meters per unit of the stored integer positions.                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Start of a trajectory log, followed by the chunks. A chunk is a           *
+*  TrajectoryChunkHeader and payload bytes holding its frames. Every frame   *
+*  is its time (a double) and the quantized x, y, z of each body: raw 64-bit *
+*  integers for the first frame of the chunk (the keyframe), zigzag varints  *
+*  of the difference to the previous frame for the second, and of the error  *
+*  of a linear prediction from the two previous frames after that. Smooth    *
+*  orbits therefore cost a byte or two per coordinate. All values are        *
+*  little-endian.                                                             *
+*                                                                             *
+*******************************************************************************/
+struct TrajectoryHeader
+{
+	GLuint           magic;
+	GLuint           version;
+	GLuint           bodies;
+	GLuint           keyframeInterval;
+	double           quantum;
+	GLuint           reserved[2];
+};
+
+/******************************************************************************
+*                                                                             *
+*                    TrajectoryChunkHeader  (struct)                          *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  magic                                                                      *
+*          TRAJECTORY_CHUNK_MAGIC.                                            *
+*  frames                                                                     *
+*          Number of frames in the chunk.                                     *
+*  bytes                                                                      *
+*          Size of the payload following the header.                          *
+*  startTime                                                                  *
+*          Time of the keyframe, so chunks can be found without decoding.     *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Header of one chunk of a trajectory log. A chunk is written only once     *
+*  complete, so a log cut short by a crash loses at most its last chunk.     *
+*                                                                             *
+*******************************************************************************/
+struct TrajectoryChunkHeader
+{
+	GLuint           magic;
+	GLuint           frames;
+	GLuint           bytes;
+	GLuint           reserved;
+	double           startTime;
+};
+
+/******************************************************************************
+*                                                                             *
+*                       TrajectoryWriter  (class)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  file                                                                       *
+*          The log being written (NULL when closed).                          *
+*  header                                                                     *
+*          Header of the log.                                                 *
+*  chunk                                                                      *
+*          Payload of the chunk being built.                                  *
+*  frames, startTime                                                          *
+*          Frames in the chunk being built and the time of its keyframe.      *
+*  previous, older                                                            *
+*          Quantized positions of the two previous frames.                    *
+*  totalFrames, totalBytes                                                    *
+*          Written so far, for the statistics.                                *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Appends body positions to a trajectory log (see TrajectoryHeader).        *
+*                                                                             *
+*******************************************************************************/
+class TrajectoryWriter
+{
+public:
+	/* Constructor / destructor (which closes the log). */
+	                 TrajectoryWriter();
+	                 ~TrajectoryWriter();
+
+	/* Create the log; false on error. */
+	bool             open(const char* filename, GLuint bodies,
+	                      double quantum = DEFAULT_TRAJECTORY_QUANTUM,
+	                      GLuint keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+	/* Append the positions of the bodies at time seconds. */
+	void             append(double time, const BodyArrays &bodies);
+	/* Write the last chunk and close the log. */
+	void             close();
+
+	/* Getters. */
+	bool             isOpen()           const {  return file != NULL;  }
+
+private:
+	FILE*                    file;
+	TrajectoryHeader         header;
+	std::vector<unsigned char> chunk;
+	GLuint                   frames;
+	double                   startTime;
+	std::vector<long long>   previous, older;
+	unsigned long long       totalFrames, totalBytes;
+
+	/* Write the chunk being built. */
+	void             flush();
+};
+
+/******************************************************************************
+*                                                                             *
+*                       TrajectoryReader  (class)                             *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  map                                                                        *
+*          The mapped log.                                                    *
+*  header                                                                     *
+*          Header of the log.                                                 *
+*  chunks                                                                     *
+*          Location, frame count and start time of each complete chunk.       *
+*  endTime                                                                    *
+*          Time of the last frame.                                            *
+*  current, ahead                                                             *
+*          Decoding position: the frame at or before the last seek time, and *
+*          the frame after it (for interpolation).                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Replays a trajectory log without simulating. Seeking finds the chunk by   *
+*  binary search on the chunk start times, decodes its keyframe and walks    *
+*  the deltas up to the requested time; seeking forward within the chunk    *
+*  (as playback does) continues from the last frame instead, so streaming    *
+*  costs one frame decode per frame shown.                                   *
+*                                                                             *
+*******************************************************************************/
+class TrajectoryReader
+{
+public:
+	/* Constructor. */
+	                 TrajectoryReader();
+
+	/* Map and index the log; false on error. */
+	bool             open(const char* filename);
+	/* Write the positions (and spins) at time seconds into bodies. */
+	bool             seek(double time, BodyArrays &bodies);
+
+	/* Getters. */
+	GLuint           getNumBodies()     const {  return header.bodies; }
+	GLuint           getNumChunks()     const {  return chunks.size(); }
+	double           getStartTime()     const;
+	double           getEndTime()       const {  return endTime;       }
+
+private:
+	/* A complete chunk. */
+	struct Chunk
+	{
+		const unsigned char* payload;
+		const unsigned char* end;
+		GLuint           frames;
+		double           startTime;
+	};
+	/* A decoded frame and where the next one starts. */
+	struct Cursor
+	{
+		GLuint           chunk;
+		GLuint           frame;
+		const unsigned char* next;
+		double           time;
+		std::vector<long long> q, previous;
+	};
+
+	MappedFile           map;
+	TrajectoryHeader     header;
+	std::vector<Chunk>   chunks;
+	double               endTime;
+	Cursor               current, ahead;
+
+	/* Decode the keyframe of a chunk into cursor. */
+	void             loadKeyframe(Cursor &cursor, GLuint chunk) const;
+	/* Decode the frame after cursor; false at the end of the log. */
+	bool             step(Cursor &cursor) const;
+};
@@ -0,0 +1,435 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "TransformSystem.h"
+#include "Parallel.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                                Global Variables                             *
+*                                                                             *
+******************************************************************************/
+
+/* The shared store. */
+static TransformSystem* instance = NULL;
+static std::once_flag   instanceOnce;
+
+/******************************************************************************
+*                                                                             *
+*                        quaternion (file static)                             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param theta                                                               *
+*           Angle in radians.                                                 *
+*  @param axis                                                                *
+*           Axis of the rotation (need not be unit length).                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The unit quaternion (x, y, z, w) of the rotation.                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Same rotation as glm::rotate(theta, axis).                                 *
+*                                                                             *
+*******************************************************************************/
+static glm::vec4 quaternion(GLfloat theta, const glm::vec3 &axis)
+{
+	glm::vec3 n = glm::normalize(axis) * sinf(0.5f * theta);
+	return glm::vec4(n, cosf(0.5f * theta));
+}
+
+/******************************************************************************
+*                                                                             *
+*                        TransformSystem::get (static)                        *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The shared store.                                                          *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Creates the store on first use. The first meshes are made by startup       *
+*  tasks on the workers, so creation is guarded by a once flag rather than    *
+*  left to the main thread.                                                   *
+*                                                                             *
+*******************************************************************************/
+TransformSystem& TransformSystem::get()
+{
+	std::call_once(instanceOnce, []
+	{
+		instance = new TransformSystem();
+	});
+	return *instance;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TransformSystem::create                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  Handle of a new identity transform.                                        *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Reuses a released handle if there is one. Otherwise the arrays grow by a   *
+*  whole group, the unused lanes holding identities, so the kernel never      *
+*  needs a remainder loop.                                                    *
+*                                                                             *
+*******************************************************************************/
+GLuint TransformSystem::create()
+{
+	std::lock_guard<std::mutex> guard(handleLock);
+	GLuint handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		clear(handle);
+		return handle;
+	}
+
+	handle = world.size();
+	if (handle == px.size())
+	{
+		const GLuint size = px.size() + TRANSFORM_LANES;
+		px.resize(size, 0.0f);  py.resize(size, 0.0f);  pz.resize(size, 0.0f);
+		qx.resize(size, 0.0f);  qy.resize(size, 0.0f);  qz.resize(size, 0.0f);
+		qw.resize(size, 1.0f);
+		rx.resize(size, 0.0f);  ry.resize(size, 0.0f);  rz.resize(size, 0.0f);
+		rw.resize(size, 1.0f);
+		sx.resize(size, 1.0f);  sy.resize(size, 1.0f);  sz.resize(size, 1.0f);
+		groupDirty.resize(size / TRANSFORM_LANES, 0);
+	}
+	world.push_back(glm::mat4());
+	clear(handle);
+	return handle;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TransformSystem::release                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param handle                                                              *
+*           Handle returned by create, no longer used.                        *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  The slot keeps its values (and is still composed) until reused.            *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::release(GLuint handle)
+{
+	std::lock_guard<std::mutex> guard(handleLock);
+	freeHandles.push_back(handle);
+}
+
+/******************************************************************************
+*                                                                             *
+*                TransformSystem::setTranslation / setRotation /              *
+*                        setScale / setRevolution / clear                     *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param handle                                                              *
+*           The transform to change.                                          *
+*  @param position / scale                                                    *
+*           Translation or scale vector.                                      *
+*  @param theta, axis                                                         *
+*           Angle (radians) and axis of the rotation or revolution.           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Store the component; the matrix follows on the next update.                *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::setTranslation(GLuint handle, const glm::vec3 &position)
+{
+	px[handle] = position.x;
+	py[handle] = position.y;
+	pz[handle] = position.z;
+	touch(handle);
+}
+
+void TransformSystem::setRotation(GLuint handle, GLfloat theta,
+                                  const glm::vec3 &axis)
+{
+	glm::vec4 q = quaternion(theta, axis);
+	qx[handle] = q.x;
+	qy[handle] = q.y;
+	qz[handle] = q.z;
+	qw[handle] = q.w;
+	touch(handle);
+}
+
+void TransformSystem::setScale(GLuint handle, const glm::vec3 &scale)
+{
+	sx[handle] = scale.x;
+	sy[handle] = scale.y;
+	sz[handle] = scale.z;
+	touch(handle);
+}
+
+void TransformSystem::setRevolution(GLuint handle, GLfloat theta,
+                                    const glm::vec3 &axis)
+{
+	glm::vec4 r = quaternion(theta, axis);
+	rx[handle] = r.x;
+	ry[handle] = r.y;
+	rz[handle] = r.z;
+	rw[handle] = r.w;
+	touch(handle);
+}
+
+void TransformSystem::clear(GLuint handle)
+{
+	px[handle] = py[handle] = pz[handle] = 0.0f;
+	qx[handle] = qy[handle] = qz[handle] = 0.0f;
+	rx[handle] = ry[handle] = rz[handle] = 0.0f;
+	qw[handle] = rw[handle] = 1.0f;
+	sx[handle] = sy[handle] = sz[handle] = 1.0f;
+	touch(handle);
+}
+
+/******************************************************************************
+*                                                                             *
+*            TransformSystem::setAllRotations / setAllRevolutions             *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param theta, axis                                                         *
+*           Angle (radians) and axis of the rotation or revolution.           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  One quaternion is computed and written to every transform (padding         *
+*  included), and every group is marked stale without listing them.           *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::setAllRotations(GLfloat theta, const glm::vec3 &axis)
+{
+	glm::vec4 q = quaternion(theta, axis);
+	std::fill(qx.begin(), qx.end(), q.x);
+	std::fill(qy.begin(), qy.end(), q.y);
+	std::fill(qz.begin(), qz.end(), q.z);
+	std::fill(qw.begin(), qw.end(), q.w);
+	allDirty = true;
+}
+
+void TransformSystem::setAllRevolutions(GLfloat theta, const glm::vec3 &axis)
+{
+	glm::vec4 r = quaternion(theta, axis);
+	std::fill(rx.begin(), rx.end(), r.x);
+	std::fill(ry.begin(), ry.end(), r.y);
+	std::fill(rz.begin(), rz.end(), r.z);
+	std::fill(rw.begin(), rw.end(), r.w);
+	allDirty = true;
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TransformSystem::touch                            *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param handle                                                              *
+*           The changed transform.                                            *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Lists the group of the transform once per update.                          *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::touch(GLuint handle)
+{
+	GLuint group = handle / TRANSFORM_LANES;
+	if (!allDirty && !groupDirty[group])
+	{
+		groupDirty[group] = 1;
+		dirtyGroups.push_back(group);
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                           TransformSystem::update                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Composes the stale groups in parallel, then clears the change tracking.    *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::update()
+{
+	if (allDirty)
+	{
+		Parallel::forRange(0, groupDirty.size(), TRANSFORM_GRAIN,
+			[&](GLuint lo, GLuint hi)
+		{
+			compose(NULL, lo, hi);
+		});
+	}
+	else if (!dirtyGroups.empty())
+	{
+		const GLuint* list = &dirtyGroups[0];
+		Parallel::forRange(0, dirtyGroups.size(), TRANSFORM_GRAIN,
+			[&](GLuint lo, GLuint hi)
+		{
+			compose(list, lo, hi);
+		});
+	}
+
+	for (GLuint i = 0; i < dirtyGroups.size(); i++)
+		groupDirty[dirtyGroups[i]] = 0;
+	dirtyGroups.clear();
+	allDirty = false;
+}
+
+/******************************************************************************
+*                                                                             *
+*                          TransformSystem::compose                           *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param list                                                                *
+*           Groups to compose, or NULL for the groups first .. last - 1.      *
+*  @param first, last                                                         *
+*           Range of list (or of the groups) to compose.                      *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  SSE kernel, one transform per lane. With t = r q (revolution after         *
+*  rotation) and u, w the vector and scalar parts of r, the matrix is         *
+*                                                                             *
+*      [ R(t) diag(s)  |  p + w c + u x c ],   c = 2 u x p,                   *
+*                                                                             *
+*  which equals revolve * translate * rotate * scale. Each column comes out   *
+*  as four registers of x, y, z, w across the lanes and is transposed into    *
+*  the four matrices.                                                         *
+*                                                                             *
+*******************************************************************************/
+void TransformSystem::compose(const GLuint* list, GLuint first, GLuint last)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (GLuint g = first; g < last; g++)
+	{
+		const GLuint i = TRANSFORM_LANES * (list != NULL ? list[g] : g);
+
+		/* t = r q. */
+		const __m128 Qx = _mm_loadu_ps(&qx[i]), Qy = _mm_loadu_ps(&qy[i]);
+		const __m128 Qz = _mm_loadu_ps(&qz[i]), Qw = _mm_loadu_ps(&qw[i]);
+		const __m128 Rx = _mm_loadu_ps(&rx[i]), Ry = _mm_loadu_ps(&ry[i]);
+		const __m128 Rz = _mm_loadu_ps(&rz[i]), Rw = _mm_loadu_ps(&rw[i]);
+		const __m128 Tw = _mm_sub_ps(_mm_mul_ps(Rw, Qw), _mm_add_ps(
+			_mm_mul_ps(Rx, Qx), _mm_add_ps(_mm_mul_ps(Ry, Qy),
+			_mm_mul_ps(Rz, Qz))));
+		const __m128 Tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Rw, Qx),
+			_mm_mul_ps(Rx, Qw)), _mm_sub_ps(_mm_mul_ps(Ry, Qz),
+			_mm_mul_ps(Rz, Qy)));
+		const __m128 Ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Rw, Qy),
+			_mm_mul_ps(Ry, Qw)), _mm_sub_ps(_mm_mul_ps(Rz, Qx),
+			_mm_mul_ps(Rx, Qz)));
+		const __m128 Tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Rw, Qz),
+			_mm_mul_ps(Rz, Qw)), _mm_sub_ps(_mm_mul_ps(Rx, Qy),
+			_mm_mul_ps(Ry, Qx)));
+
+		/* Rotation matrix of t, columns scaled. */
+		const __m128 x2 = _mm_mul_ps(two, Tx), y2 = _mm_mul_ps(two, Ty);
+		const __m128 z2 = _mm_mul_ps(two, Tz);
+		const __m128 xx = _mm_mul_ps(Tx, x2), yy = _mm_mul_ps(Ty, y2);
+		const __m128 zz = _mm_mul_ps(Tz, z2);
+		const __m128 xy = _mm_mul_ps(Tx, y2), xz = _mm_mul_ps(Tx, z2);
+		const __m128 yz = _mm_mul_ps(Ty, z2);
+		const __m128 wx = _mm_mul_ps(Tw, x2), wy = _mm_mul_ps(Tw, y2);
+		const __m128 wz = _mm_mul_ps(Tw, z2);
+		const __m128 Sx = _mm_loadu_ps(&sx[i]), Sy = _mm_loadu_ps(&sy[i]);
+		const __m128 Sz = _mm_loadu_ps(&sz[i]);
+		__m128 columns[4][4] = {
+			{ _mm_mul_ps(Sx, _mm_sub_ps(one, _mm_add_ps(yy, zz))),
+			  _mm_mul_ps(Sx, _mm_add_ps(xy, wz)),
+			  _mm_mul_ps(Sx, _mm_sub_ps(xz, wy)), zero },
+			{ _mm_mul_ps(Sy, _mm_sub_ps(xy, wz)),
+			  _mm_mul_ps(Sy, _mm_sub_ps(one, _mm_add_ps(xx, zz))),
+			  _mm_mul_ps(Sy, _mm_add_ps(yz, wx)), zero },
+			{ _mm_mul_ps(Sz, _mm_add_ps(xz, wy)),
+			  _mm_mul_ps(Sz, _mm_sub_ps(yz, wx)),
+			  _mm_mul_ps(Sz, _mm_sub_ps(one, _mm_add_ps(xx, yy))), zero },
+			{ zero, zero, zero, one },
+		};
+
+		/* Translation revolved: p + w c + u x c, c = 2 u x p. */
+		const __m128 Px = _mm_loadu_ps(&px[i]), Py = _mm_loadu_ps(&py[i]);
+		const __m128 Pz = _mm_loadu_ps(&pz[i]);
+		const __m128 Cx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(Ry, Pz),
+			_mm_mul_ps(Rz, Py)));
+		const __m128 Cy = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(Rz, Px),
+			_mm_mul_ps(Rx, Pz)));
+		const __m128 Cz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(Rx, Py),
+			_mm_mul_ps(Ry, Px)));
+		columns[3][0] = _mm_add_ps(_mm_add_ps(Px, _mm_mul_ps(Rw, Cx)),
+			_mm_sub_ps(_mm_mul_ps(Ry, Cz), _mm_mul_ps(Rz, Cy)));
+		columns[3][1] = _mm_add_ps(_mm_add_ps(Py, _mm_mul_ps(Rw, Cy)),
+			_mm_sub_ps(_mm_mul_ps(Rz, Cx), _mm_mul_ps(Rx, Cz)));
+		columns[3][2] = _mm_add_ps(_mm_add_ps(Pz, _mm_mul_ps(Rw, Cz)),
+			_mm_sub_ps(_mm_mul_ps(Rx, Cy), _mm_mul_ps(Ry, Cx)));
+
+		/* Lanes to matrices. The last group may be partly unallocated. */
+		const GLuint lanes = std::min<GLuint>(TRANSFORM_LANES,
+			world.size() - i);
+		for (GLuint c = 0; c < 4; c++)
+		{
+			_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2],
+				columns[c][3]);
+			for (GLuint k = 0; k < lanes; k++)
+				_mm_storeu_ps(&world[i + k][c][0], columns[c][k]);
+		}
+	}
+}
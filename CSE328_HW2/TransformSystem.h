@@ -0,0 +1,122 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+#include <mutex>
+#include <vector>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Transforms composed together by the vector kernel. */
+#define  TRANSFORM_LANES            4
+/* Groups of TRANSFORM_LANES transforms per task when composing. */
+#define  TRANSFORM_GRAIN            256
+
+/******************************************************************************
+*                                                                             *
+*                         TransformSystem  (class)                            *
+*                                                                             *
+*******************************************************************************
+* MEMBERS                                                                     *
+*  px, py, pz                                                                 *
+*          Translation (model space to world space).                          *
+*  qx, qy, qz, qw                                                             *
+*          Rotation quaternion, applied in model space before translation.    *
+*  rx, ry, rz, rw                                                             *
+*          Revolution quaternion, applied in world space after translation.   *
+*  sx, sy, sz                                                                 *
+*          Scale, applied first.                                              *
+*  world                                                                      *
+*          Composed model to world matrix of each transform.                  *
+*  groupDirty, dirtyGroups                                                    *
+*          Flag per group of TRANSFORM_LANES transforms whose matrices are    *
+*          stale, and the list of such groups.                                *
+*  allDirty                                                                   *
+*          Set when every group is stale (no list is kept then).              *
+*  freeHandles                                                                *
+*          Released handles, reused before the arrays grow.                   *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Dense store of the transformations of every mesh. The components are       *
+*  kept in separate arrays, padded to whole groups of TRANSFORM_LANES, so     *
+*  update composes four transforms per iteration with SSE: the product of     *
+*  the revolution and the rotation, its matrix scaled column by column, and   *
+*  the revolved translation, giving revolve * translate * rotate * scale.     *
+*  Setters only store components and mark the group; nothing is composed      *
+*  until update, which runs once per frame over the stale groups in           *
+*  parallel. Angles become quaternions with one sine and cosine each, and     *
+*  the bulk setters share that work across all transforms.                    *
+*                                                                             *
+*  Handles stay valid until released. Meshes may be created and freed on      *
+*  any thread (create and release lock) while no update runs; only the main   *
+*  thread may set or update, and getWorld may be called from any thread       *
+*  between updates.                                                           *
+*                                                                             *
+*******************************************************************************/
+class TransformSystem
+{
+public:
+	/* Shared store of the mesh transformations. */
+	static TransformSystem& get();
+
+	/* Add an identity transform and return its handle. */
+	GLuint           create();
+	/* Return a handle for reuse. */
+	void             release(GLuint handle);
+
+	/* Set one component of a transform. */
+	void             setTranslation(GLuint handle, const glm::vec3 &position);
+	void             setRotation(GLuint handle, GLfloat theta,
+	                             const glm::vec3 &axis);
+	void             setScale(GLuint handle, const glm::vec3 &scale);
+	void             setRevolution(GLuint handle, GLfloat theta,
+	                               const glm::vec3 &axis);
+	/* Set one component of every transform. */
+	void             setAllRotations(GLfloat theta, const glm::vec3 &axis);
+	void             setAllRevolutions(GLfloat theta, const glm::vec3 &axis);
+	/* Reset a transform to the identity. */
+	void             clear(GLuint handle);
+
+	/* Compose the matrices of every changed transform. */
+	void             update();
+	/* Matrix of a transform as of the last update. */
+	const glm::mat4& getWorld(GLuint handle) const {  return world[handle];  }
+
+	/* Getters. */
+	GLuint           getNumTransforms()      const
+	                                    {  return world.size() -
+	                                              freeHandles.size();       }
+
+private:
+	/* Components. */
+	std::vector<GLfloat>   px, py, pz;
+	std::vector<GLfloat>   qx, qy, qz, qw;
+	std::vector<GLfloat>   rx, ry, rz, rw;
+	std::vector<GLfloat>   sx, sy, sz;
+	/* Output. */
+	std::vector<glm::mat4> world;
+	/* Change tracking. */
+	std::vector<unsigned char> groupDirty;
+	std::vector<GLuint>    dirtyGroups;
+	bool                   allDirty;
+	/* Reuse. */
+	std::vector<GLuint>    freeHandles;
+	std::mutex             handleLock;
+
+	                 TransformSystem() : allDirty(false) {}
+
+	/* Mark the group of a transform stale. */
+	void             touch(GLuint handle);
+	/* Compose the groups [first, last) of list (or all of them). */
+	void             compose(const GLuint* list, GLuint first, GLuint last);
+};
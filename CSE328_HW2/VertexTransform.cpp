@@ -0,0 +1,205 @@
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include "VertexTransform.h"
+#include "Parallel.h"
+#include <emmintrin.h>
+#include <cmath>
+
+/******************************************************************************
+*                                                                             *
+*                          transformRange (file static)                       *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data, stride                                                        *
+*           The vectors, as for VertexTransform::transformPoints.             *
+*  @param lo, hi                                                              *
+*           Range of vectors to transform; vector hi - 1 must be followed by *
+*           a readable float.                                                 *
+*  @param columns                                                             *
+*           The matrix columns (the fourth is the translation, or zero).     *
+*  @param normalize                                                           *
+*           Whether the results are scaled to unit length.                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  r = c0 x + c1 y + c2 z + c3, four lanes at once. The length uses the      *
+*  exact square root rather than the estimate, since baked normals are not  *
+*  recomputed.                                                                *
+*                                                                             *
+*******************************************************************************/
+static void transformRange(GLfloat* data, GLuint stride, GLuint lo, GLuint hi,
+                           const __m128 columns[4], bool normalize)
+{
+	const __m128 keep = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	const __m128 zero = _mm_setzero_ps();
+	for (GLuint i = lo; i < hi; i++)
+	{
+		GLfloat* v = data + (size_t) i * stride;
+		const __m128 in = _mm_loadu_ps(v);
+		__m128 r = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(columns[0], _mm_shuffle_ps(in, in, 0x00)),
+			           _mm_mul_ps(columns[1], _mm_shuffle_ps(in, in, 0x55))),
+			_mm_add_ps(_mm_mul_ps(columns[2], _mm_shuffle_ps(in, in, 0xAA)),
+			           columns[3]));
+		if (normalize)
+		{
+			/* Squared length in every lane (the fourth lane is zero). */
+			r = _mm_andnot_ps(keep, r);
+			__m128 d = _mm_mul_ps(r, r);
+			d = _mm_add_ps(d, _mm_shuffle_ps(d, d, 0x4E));
+			d = _mm_add_ps(d, _mm_shuffle_ps(d, d, 0xB1));
+			r = _mm_and_ps(_mm_div_ps(r, _mm_sqrt_ps(d)),
+				_mm_cmpgt_ps(d, zero));
+		}
+		_mm_storeu_ps(v, _mm_or_ps(_mm_andnot_ps(keep, r),
+			_mm_and_ps(keep, in)));
+	}
+}
+
+/******************************************************************************
+*                                                                             *
+*                          transformAll (file static)                         *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data, stride, count                                                 *
+*           The vectors.                                                      *
+*  @param m                                                                   *
+*           The transformation; its fourth column is used as the offset.     *
+*  @param normalize                                                           *
+*           Whether the results are scaled to unit length.                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Runs transformRange over all but the last vector (in parallel unless     *
+*  they are packed), and the last one in scalar code.                         *
+*                                                                             *
+*******************************************************************************/
+static void transformAll(GLfloat* data, GLuint stride, GLuint count,
+                         const glm::mat4 &m, bool normalize)
+{
+	if (count == 0)
+		return;
+
+	__m128 columns[4];
+	for (GLuint c = 0; c < 4; c++)
+		columns[c] = _mm_setr_ps(m[c][0], m[c][1], m[c][2], 0.0f);
+	/* Packed vectors share their fourth float with the next vector, which  */
+	/* another task could be writing, so those are done on this thread.    */
+	if (stride < 4)
+		transformRange(data, stride, 0, count - 1, columns, normalize);
+	else
+		Parallel::forRange(0, count - 1, VERTEX_TRANSFORM_GRAIN,
+			[&](GLuint lo, GLuint hi)
+		{
+			transformRange(data, stride, lo, hi, columns, normalize);
+		});
+
+	GLfloat* v = data + (size_t) (count - 1) * stride;
+	glm::vec3 r = glm::vec3(m * glm::vec4(v[0], v[1], v[2], 1.0f));
+	if (normalize)
+	{
+		GLfloat length = glm::length(r);
+		r = (length > 0.0f) ? r / length : glm::vec3();
+	}
+	v[0] = r.x;
+	v[1] = r.y;
+	v[2] = r.z;
+}
+
+/******************************************************************************
+*                                                                             *
+*                   VertexTransform::transformPoints (static)                 *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data                                                                *
+*           x of the first point.                                             *
+*  @param stride                                                              *
+*           Floats from one point to the next (at least 3).                   *
+*  @param count                                                               *
+*           Number of points.                                                 *
+*  @param transform                                                           *
+*           Affine transformation to apply.                                   *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Replaces each point p with transform * (p, 1).                             *
+*                                                                             *
+*******************************************************************************/
+void VertexTransform::transformPoints(GLfloat* data, GLuint stride,
+                                      GLuint count, const glm::mat4 &transform)
+{
+	transformAll(data, stride, count, transform, false);
+}
+
+/******************************************************************************
+*                                                                             *
+*                 VertexTransform::transformDirections (static)               *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param data, stride, count                                                 *
+*           The directions, as for transformPoints.                           *
+*  @param matrix                                                              *
+*           Linear transformation to apply (normalMatrix for normals).        *
+*  @param normalize                                                           *
+*           Whether the results are scaled to unit length.                    *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  void                                                                       *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Replaces each direction d with matrix * d.                                 *
+*                                                                             *
+*******************************************************************************/
+void VertexTransform::transformDirections(GLfloat* data, GLuint stride,
+                                          GLuint count,
+                                          const glm::mat3 &matrix,
+                                          bool normalize)
+{
+	glm::mat4 linear = glm::mat4(matrix);
+	linear[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	transformAll(data, stride, count, linear, normalize);
+}
+
+/******************************************************************************
+*                                                                             *
+*                    VertexTransform::normalMatrix (static)                   *
+*                                                                             *
+*******************************************************************************
+* PARAMETERS                                                                  *
+*  @param transform                                                           *
+*           Affine transformation of the positions.                           *
+*                                                                             *
+*******************************************************************************
+* RETURNS                                                                     *
+*  The inverse transpose of its upper 3x3.                                    *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Keeps normals perpendicular to transformed tangents.                       *
+*                                                                             *
+*******************************************************************************/
+glm::mat3 VertexTransform::normalMatrix(const glm::mat4 &transform)
+{
+	return glm::transpose(glm::inverse(glm::mat3(transform)));
+}
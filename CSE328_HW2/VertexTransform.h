@@ -0,0 +1,53 @@
+#pragma once
+
+/******************************************************************************
+*                                                                             *
+*                              Included Header Files                          *
+*                                                                             *
+******************************************************************************/
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+/******************************************************************************
+*                                                                             *
+*                        Defined Constants and Macros                         *
+*                                                                             *
+******************************************************************************/
+
+/* Vectors per task when transforming in parallel. */
+#define  VERTEX_TRANSFORM_GRAIN     8192
+
+/******************************************************************************
+*                                                                             *
+*                         VertexTransform  (class)                            *
+*                                                                             *
+*******************************************************************************
+* DESCRIPTION                                                                 *
+*  Class consisting of static functions to bake a transformation into       *
+*  vertex data. The vectors are read in place from interleaved arrays: the  *
+*  first at data, the next stride floats further, so positions, normals and *
+*  any later attribute of a Vertex array are handled alike. Each vector is  *
+*  transformed with SSE as a whole (a column per lane); the three results   *
+*  are stored with the float which follows them merged back unchanged, and *
+*  the last vector, whose next float may be out of bounds, is done scalar.  *
+*                                                                             *
+*  Positions take the full affine transformation. Normals (and tangents)    *
+*  take the inverse transpose of its upper 3x3 and are renormalized, so they *
+*  stay perpendicular to the surface under non-uniform scales; zero vectors  *
+*  stay zero. Large arrays are split over the task scheduler.                 *
+*                                                                             *
+*******************************************************************************/
+class VertexTransform
+{
+public:
+	/* Apply transform (w = 1) to count points. */
+	static void      transformPoints(GLfloat* data, GLuint stride,
+	                                 GLuint count, const glm::mat4 &transform);
+	/* Apply matrix to count directions, optionally renormalizing them. */
+	static void      transformDirections(GLfloat* data, GLuint stride,
+	                                     GLuint count, const glm::mat3 &matrix,
+	                                     bool normalize);
+
+	/* Matrix for the normals of a transformation. */
+	static glm::mat3 normalMatrix(const glm::mat4 &transform);
+};
@@ -5,6 +5,7 @@ precision highp float;
 uniform sampler2D texture;
 uniform vec3 lightSource;
 uniform vec4 ambientLight;
+uniform vec4 wireframeColor;
 
 varying vec4 outPosition;
 varying vec3 outColor;
@@ -13,9 +14,20 @@ varying vec3 outNormal;
 
 void main()
 {
+#ifdef WIREFRAME
+	gl_FragColor = wireframeColor;
+#else
+#ifdef TEXTURED
+	vec4 surfaceColor = texture2D(texture, outTexCoord);
+#else
+	vec4 surfaceColor = vec4(outColor, 1.0);
+#endif
+#ifdef LIT
 	vec3 worldLight = normalize(lightSource - vec3(outPosition));
-	float brightness = clamp(dot(outNormal, worldLight), 0.0, 1.0);
+	float brightness = clamp(dot(normalize(outNormal), worldLight), 0.0, 1.0);
 	vec4 diffuseLight = vec4(brightness, brightness, brightness, 1.0);
-	//gl_FragColor = texture2D (texture, outTexCoord) * (ambientLight + diffuseLight);
-    gl_FragColor = vec4(outColor, 1.0);// * (ambientLight + diffuseLight);
+	surfaceColor *= (ambientLight + diffuseLight);
+#endif
+	gl_FragColor = surfaceColor;
+#endif
 }
@@ -4,11 +4,17 @@ precision highp float;
 
 uniform mat4 modelToProjectionMatrix;
 uniform mat4 modelToWorldMatrix;
+#ifdef INSTANCED
+uniform mat4 worldToProjectionMatrix;
+#endif
 
 attribute vec4 modelPosition;
 attribute vec3 modelColor;
 attribute vec3 modelNormal;
 attribute vec2 modelTexCoord;
+#ifdef INSTANCED
+attribute mat4 instanceModelToWorld;
+#endif
 
 varying vec4 outPosition;
 varying vec3 outColor;
@@ -17,12 +23,19 @@ varying vec3 outNormal;
 
 void main()
 {
+#ifdef INSTANCED
+	mat4 modelToWorld = instanceModelToWorld;
+	outPosition = modelToWorld * modelPosition;
+	gl_Position = worldToProjectionMatrix * outPosition;
+#else
+	mat4 modelToWorld = modelToWorldMatrix;
 	gl_Position = modelToProjectionMatrix * modelPosition;
-	outPosition = modelToWorldMatrix * modelPosition;
+	outPosition = modelToWorld * modelPosition;
+#endif
 
 	outTexCoord = modelTexCoord;
 
 	outColor = modelColor;
 
-	outNormal = normalize(vec3(modelToWorldMatrix * vec4(modelNormal, 0.0)));
+	outNormal = normalize(vec3(modelToWorld * vec4(modelNormal, 0.0)));
 }
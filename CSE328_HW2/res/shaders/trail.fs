@@ -0,0 +1,10 @@
+#version 130
+
+precision highp float;
+
+varying vec4 outColor;
+
+void main()
+{
+	gl_FragColor = outColor;
+}
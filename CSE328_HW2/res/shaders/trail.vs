@@ -0,0 +1,28 @@
+#version 130
+
+precision highp float;
+
+uniform mat4 worldToProjectionMatrix;
+uniform vec4 trailColor;
+uniform int trailHead;
+uniform int trailLength;
+uniform int trailBodies;
+
+attribute vec4 modelPosition;
+
+varying vec4 outColor;
+
+void main()
+{
+	/* Row of the ring this sample is in; the last row mirrors row 0. */
+	int row = gl_VertexID / trailBodies;
+	if (row == trailLength)
+		row = 0;
+
+	/* Fade from the newest sample (age 0) to the oldest. */
+	int age = (trailHead - row + trailLength) % trailLength;
+	float fade = 1.0 - float(age) / float(trailLength);
+
+	outColor = vec4(trailColor.rgb, trailColor.a * fade);
+	gl_Position = worldToProjectionMatrix * modelPosition;
+}
@@ -26,8 +26,10 @@ distribution.
 #include <new>		// yes, this one new style header, is in the Android SDK.
 #if defined(ANDROID_NDK) || defined(__QNXNTO__)
 #   include <stddef.h>
+#   include <math.h>
 #else
 #   include <cstddef>
+#   include <cmath>
 #endif
 
 static const char LINE_FEED				= (char)0x0a;			// all line endings are normalized to LF
@@ -422,53 +424,346 @@ const char* XMLUtil::GetCharacterRef( const char* p, char* value, int* length )
 }
 
 
+/*
+	Number conversions. sscanf and snprintf parse a format string and consult
+	the locale on every call, which dominates loading and saving documents
+	full of numbers, so the common cases are converted by hand and only the
+	rare ones fall back to the C library.
+
+	Decimals are read with Clinger's fast path: when the significant digits
+	fit in the significand and the power of ten is exactly representable,
+	one correctly rounded multiplication or division gives the correctly
+	rounded result. Other input (long mantissas, huge exponents, inf, nan)
+	goes to strtof or strtod.
+*/
+static const double EXACT_POWERS_OF_TEN[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const float EXACT_FLOAT_POWERS_OF_TEN[11] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const unsigned long long DOUBLE_SIGNIFICAND_LIMIT = 1ULL << 53;
+static const unsigned long long FLOAT_SIGNIFICAND_LIMIT = 1ULL << 24;
+
+
+// Reads [sign] digits [. digits] [e [sign] digits] as mantissa * 10^exponent.
+// Returns false if there are no digits. exact is false if digits were dropped.
+static bool ScanDecimal( const char* p, bool* negative, unsigned long long* mantissa,
+                         int* exponent, bool* exact )
+{
+    p = XMLUtil::SkipWhiteSpace( p );
+    *negative = ( *p == '-' );
+    if ( *p == '-' || *p == '+' ) {
+        ++p;
+    }
+    *mantissa = 0;
+    *exponent = 0;
+    *exact = true;
+    int digits = 0;
+    bool any = false;
+    for( ; *p >= '0' && *p <= '9'; ++p ) {
+        any = true;
+        if ( digits < 19 ) {
+            *mantissa = *mantissa * 10 + ( *p - '0' );
+            digits += ( *mantissa != 0 );
+        }
+        else {
+            *exponent += 1;
+            *exact = *exact && ( *p == '0' );
+        }
+    }
+    if ( *p == '.' ) {
+        for( ++p; *p >= '0' && *p <= '9'; ++p ) {
+            any = true;
+            if ( digits < 19 ) {
+                *mantissa = *mantissa * 10 + ( *p - '0' );
+                digits += ( *mantissa != 0 );
+                *exponent -= 1;
+            }
+            else {
+                *exact = *exact && ( *p == '0' );
+            }
+        }
+    }
+    if ( !any ) {
+        return false;
+    }
+    if ( *p == 'e' || *p == 'E' ) {
+        const char* q = p + 1;
+        bool negativeExponent = ( *q == '-' );
+        if ( *q == '-' || *q == '+' ) {
+            ++q;
+        }
+        if ( *q >= '0' && *q <= '9' ) {
+            int e = 0;
+            for( ; *q >= '0' && *q <= '9'; ++q ) {
+                if ( e < 100000 ) {
+                    e = e * 10 + ( *q - '0' );
+                }
+            }
+            *exponent += negativeExponent ? -e : e;
+        }
+        // else the 'e' is trailing text, as for sscanf.
+    }
+    return true;
+}
+
+
+// Writes mantissa * 10^-scale (mantissa != 0, no trailing zeros) as %g would
+// with the given precision. Returns false if the buffer is too small.
+static bool FormatDecimal( bool negative, unsigned long long mantissa, int scale,
+                           int precision, char* buffer, int bufferSize )
+{
+    char digits[24];
+    int n = 0;
+    for( unsigned long long m = mantissa; m; m /= 10 ) {
+        digits[n++] = (char)( '0' + m % 10 );
+    }
+    for( int i=0; i<n/2; ++i ) {
+        char c = digits[i];
+        digits[i] = digits[n-1-i];
+        digits[n-1-i] = c;
+    }
+    const int exponent = n - 1 - scale;
+
+    char out[48];
+    int length = 0;
+    if ( negative ) {
+        out[length++] = '-';
+    }
+    if ( exponent < -4 || exponent >= precision ) {
+        out[length++] = digits[0];
+        if ( n > 1 ) {
+            out[length++] = '.';
+            for( int i=1; i<n; ++i ) {
+                out[length++] = digits[i];
+            }
+        }
+        out[length++] = 'e';
+        out[length++] = exponent < 0 ? '-' : '+';
+        int e = exponent < 0 ? -exponent : exponent;
+        if ( e >= 100 ) {
+            out[length++] = (char)( '0' + e / 100 );
+        }
+        out[length++] = (char)( '0' + e / 10 % 10 );
+        out[length++] = (char)( '0' + e % 10 );
+    }
+    else if ( exponent < 0 ) {
+        out[length++] = '0';
+        out[length++] = '.';
+        for( int i=0; i < -exponent-1; ++i ) {
+            out[length++] = '0';
+        }
+        for( int i=0; i<n; ++i ) {
+            out[length++] = digits[i];
+        }
+    }
+    else {
+        for( int i=0; i<=exponent; ++i ) {
+            out[length++] = i < n ? digits[i] : '0';
+        }
+        if ( n > exponent+1 ) {
+            out[length++] = '.';
+            for( int i=exponent+1; i<n; ++i ) {
+                out[length++] = digits[i];
+            }
+        }
+    }
+    if ( length >= bufferSize ) {
+        return false;
+    }
+    memcpy( buffer, out, length );
+    buffer[length] = 0;
+    return true;
+}
+
+
+// Finds the shortest decimal of at most 'digits' significant digits which
+// converts back to v exactly, using only correctly rounded operations on
+// exact operands so the check is the one a correct reader makes. Returns
+// false (to fall back to snprintf) if there is none or it can't be proven.
+static bool ShortestDecimal( double v, int digits, bool isFloat,
+                             bool* negative, unsigned long long* mantissa, int* scale )
+{
+    *negative = v < 0;
+    const double a = *negative ? -v : v;
+    if ( !( a > 0 ) || a > 1e300 ) {
+        return false;   // zero, inf, nan
+    }
+    const double low = EXACT_POWERS_OF_TEN[digits-1];
+    const double high = EXACT_POWERS_OF_TEN[digits];
+    int k = digits - 1 - (int) floor( log10( a ) );
+    double scaled = 0;
+    for( int attempt = 0; attempt < 3; ++attempt ) {
+        if ( k > 22 || k < -22 ) {
+            return false;
+        }
+        scaled = ( k >= 0 ) ? a * EXACT_POWERS_OF_TEN[k] : a / EXACT_POWERS_OF_TEN[-k];
+        if ( scaled >= high ) {
+            --k;
+        }
+        else if ( scaled < low ) {
+            ++k;
+        }
+        else {
+            break;
+        }
+    }
+    if ( scaled < low || scaled >= high ) {
+        return false;
+    }
+    unsigned long long m = (unsigned long long)( scaled + 0.5 );
+    while ( m % 10 == 0 ) {
+        m /= 10;
+        --k;
+    }
+
+    if ( isFloat ) {
+        if ( m > FLOAT_SIGNIFICAND_LIMIT || k > 10 || k < -10 ) {
+            return false;
+        }
+        float back = ( k >= 0 ) ? (float) m / EXACT_FLOAT_POWERS_OF_TEN[k]
+                                : (float) m * EXACT_FLOAT_POWERS_OF_TEN[-k];
+        if ( back != (float) a ) {
+            return false;
+        }
+    }
+    else {
+        if ( m > DOUBLE_SIGNIFICAND_LIMIT || k > 22 || k < -22 ) {
+            return false;
+        }
+        double back = ( k >= 0 ) ? (double) m / EXACT_POWERS_OF_TEN[k]
+                                 : (double) m * EXACT_POWERS_OF_TEN[-k];
+        if ( back != a ) {
+            return false;
+        }
+    }
+    *mantissa = m;
+    *scale = k;
+    return true;
+}
+
+
+// Writes the decimal digits of v, with a leading '-' if negative.
+static void FormatInteger( bool negative, unsigned long long v, char* buffer, int bufferSize )
+{
+    char out[24];
+    int length = 0;
+    do {
+        out[length++] = (char)( '0' + v % 10 );
+        v /= 10;
+    } while ( v );
+    if ( negative ) {
+        out[length++] = '-';
+    }
+    int i = 0;
+    for( ; i < length && i < bufferSize-1; ++i ) {
+        buffer[i] = out[length-1-i];
+    }
+    if ( bufferSize > 0 ) {
+        buffer[i] = 0;
+    }
+}
+
+
 void XMLUtil::ToStr( int v, char* buffer, int bufferSize )
 {
-    TIXML_SNPRINTF( buffer, bufferSize, "%d", v );
+    long long w = v;
+    FormatInteger( w < 0, (unsigned long long)( w < 0 ? -w : w ), buffer, bufferSize );
 }
 
 
 void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
 {
-    TIXML_SNPRINTF( buffer, bufferSize, "%u", v );
+    FormatInteger( false, v, buffer, bufferSize );
 }
 
 
 void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
 {
-    TIXML_SNPRINTF( buffer, bufferSize, "%d", v ? 1 : 0 );
+    FormatInteger( false, v ? 1 : 0, buffer, bufferSize );
 }
 
 /*
 	ToStr() of a number is a very tricky topic.
 	https://github.com/leethomason/tinyxml2/issues/106
+	Values with a short exact decimal (most hand written ones) are written
+	that way; the rest as before, with enough digits to read back the same.
 */
 void XMLUtil::ToStr( float v, char* buffer, int bufferSize )
 {
-    TIXML_SNPRINTF( buffer, bufferSize, "%.8g", v );
+    bool negative = false;
+    unsigned long long mantissa = 0;
+    int scale = 0;
+    if ( v == 0 ) {
+        FormatInteger( false, 0, buffer, bufferSize );
+    }
+    else if ( !ShortestDecimal( v, 7, true, &negative, &mantissa, &scale )
+            || !FormatDecimal( negative, mantissa, scale, 8, buffer, bufferSize ) ) {
+        TIXML_SNPRINTF( buffer, bufferSize, "%.8g", v );
+    }
 }
 
 
 void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
 {
-    TIXML_SNPRINTF( buffer, bufferSize, "%.17g", v );
+    bool negative = false;
+    unsigned long long mantissa = 0;
+    int scale = 0;
+    if ( v == 0 ) {
+        FormatInteger( false, 0, buffer, bufferSize );
+    }
+    else if ( !ShortestDecimal( v, 15, false, &negative, &mantissa, &scale )
+            || !FormatDecimal( negative, mantissa, scale, 17, buffer, bufferSize ) ) {
+        TIXML_SNPRINTF( buffer, bufferSize, "%.17g", v );
+    }
 }
 
 
 bool XMLUtil::ToInt( const char* str, int* value )
 {
-    if ( TIXML_SSCANF( str, "%d", value ) == 1 ) {
-        return true;
+    const char* p = SkipWhiteSpace( str );
+    bool negative = ( *p == '-' );
+    if ( *p == '-' || *p == '+' ) {
+        ++p;
     }
-    return false;
+    if ( !( *p >= '0' && *p <= '9' ) ) {
+        return false;
+    }
+    long long v = 0;
+    for( ; *p >= '0' && *p <= '9'; ++p ) {
+        v = v * 10 + ( *p - '0' );
+        if ( v > (long long) INT_MAX + 1 ) {
+            return false;
+        }
+    }
+    if ( !negative && v > INT_MAX ) {
+        return false;
+    }
+    *value = (int)( negative ? -v : v );
+    return true;
 }
 
 bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
 {
-    if ( TIXML_SSCANF( str, "%u", value ) == 1 ) {
-        return true;
+    const char* p = SkipWhiteSpace( str );
+    if ( *p == '+' ) {
+        ++p;
     }
-    return false;
+    if ( !( *p >= '0' && *p <= '9' ) ) {
+        // Including "-1", which sscanf wraps around.
+        return TIXML_SSCANF( str, "%u", value ) == 1;
+    }
+    unsigned long long v = 0;
+    for( ; *p >= '0' && *p <= '9'; ++p ) {
+        v = v * 10 + ( *p - '0' );
+        if ( v > UINT_MAX ) {
+            return false;
+        }
+    }
+    *value = (unsigned) v;
+    return true;
 }
 
 bool XMLUtil::ToBool( const char* str, bool* value )
@@ -492,18 +787,62 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
-    if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
-        return true;
+    bool negative = false, exact = false;
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    if ( ScanDecimal( str, &negative, &mantissa, &exponent, &exact ) && exact ) {
+        if ( mantissa == 0 ) {
+            *value = negative ? -0.0f : 0.0f;
+            return true;
+        }
+        if ( mantissa <= FLOAT_SIGNIFICAND_LIMIT && exponent >= -10 && exponent <= 10 ) {
+            float f = (float) mantissa;
+            f = ( exponent < 0 ) ? f / EXACT_FLOAT_POWERS_OF_TEN[-exponent]
+                                 : f * EXACT_FLOAT_POWERS_OF_TEN[exponent];
+            *value = negative ? -f : f;
+            return true;
+        }
     }
-    return false;
+    // strtof rounds once; going through double could round twice.
+    char* end = 0;
+    float f = strtof( str, &end );
+    if ( end == str ) {
+        return false;
+    }
+    *value = f;
+    return true;
 }
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
-    if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
-        return true;
+    bool negative = false, exact = false;
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    if ( ScanDecimal( str, &negative, &mantissa, &exponent, &exact ) && exact ) {
+        if ( mantissa == 0 ) {
+            *value = negative ? -0.0 : 0.0;
+            return true;
+        }
+        // 12e30 is 12000000000e22: move surplus powers into the mantissa.
+        while ( exponent > 22 && mantissa < DOUBLE_SIGNIFICAND_LIMIT / 10 ) {
+            mantissa *= 10;
+            --exponent;
+        }
+        if ( mantissa <= DOUBLE_SIGNIFICAND_LIMIT && exponent >= -22 && exponent <= 22 ) {
+            double d = (double) mantissa;
+            d = ( exponent < 0 ) ? d / EXACT_POWERS_OF_TEN[-exponent]
+                                 : d * EXACT_POWERS_OF_TEN[exponent];
+            *value = negative ? -d : d;
+            return true;
+        }
     }
-    return false;
+    char* end = 0;
+    double d = strtod( str, &end );
+    if ( end == str ) {
+        return false;
+    }
+    *value = d;
+    return true;
 }
 
 
@@ -1415,6 +1754,64 @@ XMLError XMLElement::QueryFloatText( float* fval ) const
 }
 
 
+static bool ToNumber( const char* str, double* value )
+{
+    return XMLUtil::ToDouble( str, value );
+}
+
+static bool ToNumber( const char* str, float* value )
+{
+    return XMLUtil::ToFloat( str, value );
+}
+
+template< class T >
+static XMLError QueryChildren( const XMLElement* element, const char* const* names,
+                               int count, T* values )
+{
+    DynArray< bool, 16 > found;
+    for( int i=0; i<count; ++i ) {
+        found.Push( false );
+    }
+    XMLError result = XML_SUCCESS;
+    for( const XMLElement* child = element->FirstChildElement(); child;
+            child = child->NextSiblingElement() ) {
+        int i = 0;
+        while ( i < count && ( found[i] || !XMLUtil::StringEqual( child->Name(), names[i] ) ) ) {
+            ++i;
+        }
+        if ( i == count ) {
+            continue;
+        }
+        found[i] = true;
+        const char* text = child->GetText();
+        if ( text && !ToNumber( text, &values[i] ) ) {
+            result = XML_CAN_NOT_CONVERT_TEXT;
+        }
+        else if ( !text && result == XML_SUCCESS ) {
+            result = XML_NO_TEXT_NODE;
+        }
+    }
+    for( int i=0; i<count && result == XML_SUCCESS; ++i ) {
+        if ( !found[i] ) {
+            result = XML_NO_TEXT_NODE;
+        }
+    }
+    return result;
+}
+
+
+XMLError XMLElement::QueryDoubleChildren( const char* const* names, int count, double* values ) const
+{
+    return QueryChildren( this, names, count, values );
+}
+
+
+XMLError XMLElement::QueryFloatChildren( const char* const* names, int count, float* values ) const
+{
+    return QueryChildren( this, names, count, values );
+}
+
+
 
 XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
@@ -2005,10 +2402,23 @@ void XMLPrinter::Print( const char* format, ... )
 }
 
 
+void XMLPrinter::Write( const char* data, size_t size )
+{
+    if ( _fp ) {
+        fwrite( data, sizeof(char), size, _fp );
+    }
+    else {
+        char* p = _buffer.PushArr( static_cast<int>( size ) ) - 1;	// back up over the null terminator.
+        memcpy( p, data, size );
+        p[size] = 0;
+    }
+}
+
+
 void XMLPrinter::PrintSpace( int depth )
 {
     for( int i=0; i<depth; ++i ) {
-        Print( "    " );
+        Write( "    ", 4 );
     }
 }
 
@@ -2027,13 +2437,13 @@ void XMLPrinter::PrintString( const char* p, bool restricted )
                 // the stream up until the entity, write the
                 // entity, and keep looking.
                 if ( flag[(unsigned char)(*q)] ) {
-                    while ( p < q ) {
-                        Print( "%c", *p );
-                        ++p;
-                    }
+                    Write( p, q - p );
+                    p = q;
                     for( int i=0; i<NUM_ENTITIES; ++i ) {
                         if ( entities[i].value == *q ) {
-                            Print( "&%s;", entities[i].pattern );
+                            Write( "&", 1 );
+                            Write( entities[i].pattern, entities[i].length );
+                            Write( ";", 1 );
                             break;
                         }
                     }
@@ -2046,7 +2456,7 @@ void XMLPrinter::PrintString( const char* p, bool restricted )
     // Flush the remaining string. This will be the entire
     // string if an entity wasn't found.
     if ( !_processEntities || (q-p > 0) ) {
-        Print( "%s", p );
+        Write( p );
     }
 }
 
@@ -2055,7 +2465,7 @@ void XMLPrinter::PushHeader( bool writeBOM, bool writeDec )
 {
     if ( writeBOM ) {
         static const unsigned char bom[] = { TIXML_UTF_LEAD_0, TIXML_UTF_LEAD_1, TIXML_UTF_LEAD_2, 0 };
-        Print( "%s", bom );
+        Write( reinterpret_cast<const char*>( bom ) );
     }
     if ( writeDec ) {
         PushDeclaration( "xml version=\"1.0\"" );
@@ -2069,13 +2479,14 @@ void XMLPrinter::OpenElement( const char* name, bool compactMode )
     _stack.Push( name );
 
     if ( _textDepth < 0 && !_firstElement && !compactMode ) {
-        Print( "\n" );
+        Write( "\n", 1 );
     }
     if ( !compactMode ) {
         PrintSpace( _depth );
     }
 
-    Print( "<%s", name );
+    Write( "<", 1 );
+    Write( name );
     _elementJustOpened = true;
     _firstElement = false;
     ++_depth;
@@ -2085,9 +2496,11 @@ void XMLPrinter::OpenElement( const char* name, bool compactMode )
 void XMLPrinter::PushAttribute( const char* name, const char* value )
 {
     TIXMLASSERT( _elementJustOpened );
-    Print( " %s=\"", name );
+    Write( " ", 1 );
+    Write( name );
+    Write( "=\"", 2 );
     PrintString( value, false );
-    Print( "\"" );
+    Write( "\"", 1 );
 }
 
 
@@ -2129,21 +2542,23 @@ void XMLPrinter::CloseElement( bool compactMode )
     const char* name = _stack.Pop();
 
     if ( _elementJustOpened ) {
-        Print( "/>" );
+        Write( "/>", 2 );
     }
     else {
         if ( _textDepth < 0 && !compactMode) {
-            Print( "\n" );
+            Write( "\n", 1 );
             PrintSpace( _depth );
         }
-        Print( "</%s>", name );
+        Write( "</", 2 );
+        Write( name );
+        Write( ">", 1 );
     }
 
     if ( _textDepth == _depth ) {
         _textDepth = -1;
     }
     if ( _depth == 0 && !compactMode) {
-        Print( "\n" );
+        Write( "\n", 1 );
     }
     _elementJustOpened = false;
 }
@@ -2155,7 +2570,7 @@ void XMLPrinter::SealElementIfJustOpened()
         return;
     }
     _elementJustOpened = false;
-    Print( ">" );
+    Write( ">", 1 );
 }
 
 
@@ -2165,9 +2580,9 @@ void XMLPrinter::PushText( const char* text, bool cdata )
 
     SealElementIfJustOpened();
     if ( cdata ) {
-        Print( "<![CDATA[" );
-        Print( "%s", text );
-        Print( "]]>" );
+        Write( "<![CDATA[", 9 );
+        Write( text );
+        Write( "]]>", 3 );
     }
     else {
         PrintString( text, true );
@@ -2218,11 +2633,13 @@ void XMLPrinter::PushComment( const char* comment )
 {
     SealElementIfJustOpened();
     if ( _textDepth < 0 && !_firstElement && !_compactMode) {
-        Print( "\n" );
+        Write( "\n", 1 );
         PrintSpace( _depth );
     }
     _firstElement = false;
-    Print( "<!--%s-->", comment );
+    Write( "<!--", 4 );
+    Write( comment );
+    Write( "-->", 3 );
 }
 
 
@@ -2230,11 +2647,13 @@ void XMLPrinter::PushDeclaration( const char* value )
 {
     SealElementIfJustOpened();
     if ( _textDepth < 0 && !_firstElement && !_compactMode) {
-        Print( "\n" );
+        Write( "\n", 1 );
         PrintSpace( _depth );
     }
     _firstElement = false;
-    Print( "<?%s?>", value );
+    Write( "<?", 2 );
+    Write( value );
+    Write( "?>", 2 );
 }
 
 
@@ -2242,11 +2661,13 @@ void XMLPrinter::PushUnknown( const char* value )
 {
     SealElementIfJustOpened();
     if ( _textDepth < 0 && !_firstElement && !_compactMode) {
-        Print( "\n" );
+        Write( "\n", 1 );
         PrintSpace( _depth );
     }
     _firstElement = false;
-    Print( "<!%s>", value );
+    Write( "<!", 2 );
+    Write( value );
+    Write( ">", 1 );
 }
 
 
@@ -2306,5 +2727,430 @@ bool XMLPrinter::Visit( const XMLUnknown& unknown )
     return true;
 }
 
+
+// --------- XMLPullParser ----------- //
+
+XMLPullParser::XMLPullParser( const char* xml, size_t nBytes, bool processEntities ) :
+    _start( xml ),
+    _p( xml ),
+    _end( xml + nBytes ),
+    _processEntities( processEntities ),
+    _pendingEnd( false ),
+    _rootSeen( false ),
+    _errorID( XML_NO_ERROR ),
+    _errorOffset( 0 )
+{
+    if ( StartsWith( _p, "\xef\xbb\xbf" ) ) {
+        _p += 3;
+    }
+    _name.Push( 0 );
+    _text.Push( 0 );
+}
+
+
+XMLPullEvent XMLPullParser::SetError( XMLError error, const char* p )
+{
+    _errorID = error;
+    _errorOffset = p - _start;
+    return XML_PULL_ERROR;
+}
+
+
+bool XMLPullParser::StartsWith( const char* p, const char* pattern ) const
+{
+    size_t length = strlen( pattern );
+    return (size_t)( _end - p ) >= length && memcmp( p, pattern, length ) == 0;
+}
+
+
+const char* XMLPullParser::Find( const char* p, const char* pattern ) const
+{
+    // The buffer is not null terminated, so strstr can't be used.
+    size_t length = strlen( pattern );
+    while ( (size_t)( _end - p ) >= length ) {
+        const char* q = static_cast<const char*>( memchr( p, pattern[0], _end - p ) );
+        if ( !q || (size_t)( _end - q ) < length ) {
+            return 0;
+        }
+        if ( memcmp( q, pattern, length ) == 0 ) {
+            return q;
+        }
+        p = q + 1;
+    }
+    return 0;
+}
+
+
+const char* XMLPullParser::ParseName( const char* p ) const
+{
+    if ( p < _end && XMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+        ++p;
+        while ( p < _end && XMLUtil::IsNameChar( (unsigned char) *p ) ) {
+            ++p;
+        }
+    }
+    return p;
+}
+
+
+void XMLPullParser::SetName( const char* p, const char* q )
+{
+    _name.Clear();
+    memcpy( _name.PushArr( (int)( q - p ) ), p, q - p );
+    _name.Push( 0 );
+}
+
+
+void XMLPullParser::Decode( const char* p, const char* q, CharBuffer* out, bool translate ) const
+{
+    // Appends [p, q) to out, null terminated, normalizing newlines and
+    // (optionally) translating entities like StrPair::GetStr().
+    while ( p < q ) {
+        if ( *p == CR ) {
+            out->Push( LF );
+            p += ( p + 1 < q && *(p+1) == LF ) ? 2 : 1;
+        }
+        else if ( *p == '&' && translate ) {
+            const char* semicolon = static_cast<const char*>( memchr( p, ';', q - p ) );
+            if ( semicolon && p + 2 < semicolon && *(p+1) == '#' ) {
+                unsigned long ucs = 0;
+                bool hex = *(p+2) == 'x';
+                const char* digit = p + ( hex ? 3 : 2 );
+                bool valid = digit < semicolon;
+                for ( ; digit < semicolon && valid; ++digit ) {
+                    char c = *digit;
+                    unsigned v = 0;
+                    if ( c >= '0' && c <= '9' ) {
+                        v = c - '0';
+                    }
+                    else if ( hex && c >= 'a' && c <= 'f' ) {
+                        v = c - 'a' + 10;
+                    }
+                    else if ( hex && c >= 'A' && c <= 'F' ) {
+                        v = c - 'A' + 10;
+                    }
+                    else {
+                        valid = false;
+                    }
+                    ucs = ucs * ( hex ? 16 : 10 ) + v;
+                    valid = valid && ucs <= 0x10FFFF;
+                }
+                if ( valid ) {
+                    char buf[4] = { 0 };
+                    int len = 0;
+                    XMLUtil::ConvertUTF32ToUTF8( ucs, buf, &len );
+                    memcpy( out->PushArr( len ), buf, len );
+                    p = semicolon + 1;
+                    continue;
+                }
+            }
+            else if ( semicolon ) {
+                int i = 0;
+                for( ; i<NUM_ENTITIES; ++i ) {
+                    const Entity& entity = entities[i];
+                    if ( semicolon - p == entity.length + 1
+                            && strncmp( p + 1, entity.pattern, entity.length ) == 0 ) {
+                        out->Push( entity.value );
+                        p = semicolon + 1;
+                        break;
+                    }
+                }
+                if ( i < NUM_ENTITIES ) {
+                    continue;
+                }
+            }
+            // Not an entity: keep the '&', as StrPair does.
+            out->Push( *p++ );
+        }
+        else {
+            out->Push( *p++ );
+        }
+    }
+    out->Push( 0 );
+}
+
+
+bool XMLPullParser::ParseAttributes( const char* p )
+{
+    _attributes.Clear();
+    _attributeChars.Clear();
+    for( ;; ) {
+        while ( p < _end && XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        if ( p == _end ) {
+            SetError( XML_ERROR_PARSING_ELEMENT, p );
+            return false;
+        }
+        if ( *p == '>' ) {
+            _p = p + 1;
+            return true;
+        }
+        if ( StartsWith( p, "/>" ) ) {
+            _pendingEnd = true;
+            _p = p + 2;
+            return true;
+        }
+
+        // name = "value"
+        const char* name = p;
+        p = ParseName( p );
+        if ( p == name ) {
+            SetError( XML_ERROR_PARSING_ATTRIBUTE, p );
+            return false;
+        }
+        _attributes.Push( _attributeChars.Size() );
+        memcpy( _attributeChars.PushArr( (int)( p - name ) ), name, p - name );
+        _attributeChars.Push( 0 );
+
+        while ( p < _end && XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        if ( p == _end || *p != '=' ) {
+            SetError( XML_ERROR_PARSING_ATTRIBUTE, p );
+            return false;
+        }
+        ++p;
+        while ( p < _end && XMLUtil::IsWhiteSpace( *p ) ) {
+            ++p;
+        }
+        const char* close = 0;
+        if ( p < _end && ( *p == DOUBLE_QUOTE || *p == SINGLE_QUOTE ) ) {
+            close = static_cast<const char*>( memchr( p + 1, *p, _end - p - 1 ) );
+        }
+        if ( !close ) {
+            SetError( XML_ERROR_PARSING_ATTRIBUTE, p );
+            return false;
+        }
+        _attributes.Push( _attributeChars.Size() );
+        Decode( p + 1, close, &_attributeChars, _processEntities );
+        p = close + 1;
+    }
+}
+
+
+XMLPullEvent XMLPullParser::Next()
+{
+    if ( _errorID != XML_NO_ERROR ) {
+        return XML_PULL_ERROR;
+    }
+    if ( _pendingEnd ) {
+        _pendingEnd = false;
+        _stackLengths.Pop();
+        _stack.Pop();
+        return XML_END_ELEMENT;
+    }
+
+    while ( _p < _end ) {
+        // Text, up to the next tag.
+        if ( *_p != '<' ) {
+            const char* text = _p;
+            const char* q = static_cast<const char*>( memchr( _p, '<', _end - _p ) );
+            _p = q ? q : _end;
+            const char* c = text;
+            while ( c < _p && XMLUtil::IsWhiteSpace( *c ) ) {
+                ++c;
+            }
+            if ( c == _p ) {
+                continue;
+            }
+            if ( _stack.Empty() ) {
+                return SetError( XML_ERROR_PARSING_TEXT, c );
+            }
+            _text.Clear();
+            Decode( text, _p, &_text, _processEntities );
+            return XML_TEXT;
+        }
+
+        const char* p = _p;
+        if ( StartsWith( p, "<?" ) ) {
+            const char* q = Find( p + 2, "?>" );
+            if ( !q ) {
+                return SetError( XML_ERROR_PARSING_DECLARATION, p );
+            }
+            _p = q + 2;
+        }
+        else if ( StartsWith( p, "<!--" ) ) {
+            const char* q = Find( p + 4, "-->" );
+            if ( !q ) {
+                return SetError( XML_ERROR_PARSING_COMMENT, p );
+            }
+            _p = q + 3;
+        }
+        else if ( StartsWith( p, "<![CDATA[" ) ) {
+            const char* q = Find( p + 9, "]]>" );
+            if ( !q || _stack.Empty() ) {
+                return SetError( XML_ERROR_PARSING_CDATA, p );
+            }
+            _p = q + 3;
+            _text.Clear();
+            Decode( p + 9, q, &_text, false );
+            return XML_TEXT;
+        }
+        else if ( StartsWith( p, "<!" ) ) {
+            // DOCTYPE and the like, which may have an internal [subset].
+            int brackets = 0;
+            const char* q = p + 2;
+            for( ; q < _end && ( *q != '>' || brackets > 0 ); ++q ) {
+                brackets += ( *q == '[' ) - ( *q == ']' );
+            }
+            if ( q == _end ) {
+                return SetError( XML_ERROR_PARSING_UNKNOWN, p );
+            }
+            _p = q + 1;
+        }
+        else if ( StartsWith( p, "</" ) ) {
+            const char* name = p + 2;
+            const char* q = ParseName( name );
+            if ( q == name ) {
+                return SetError( XML_ERROR_PARSING_ELEMENT, p );
+            }
+            if ( _stack.Empty() || _stackLengths.PeekTop() != q - name
+                    || memcmp( _stack.PeekTop(), name, q - name ) != 0 ) {
+                return SetError( XML_ERROR_MISMATCHED_ELEMENT, p );
+            }
+            while ( q < _end && XMLUtil::IsWhiteSpace( *q ) ) {
+                ++q;
+            }
+            if ( q == _end || *q != '>' ) {
+                return SetError( XML_ERROR_PARSING_ELEMENT, p );
+            }
+            _p = q + 1;
+            SetName( name, name + _stackLengths.Pop() );
+            _stack.Pop();
+            return XML_END_ELEMENT;
+        }
+        else {
+            const char* name = p + 1;
+            const char* q = ParseName( name );
+            if ( q == name ) {
+                return SetError( XML_ERROR_PARSING_ELEMENT, p );
+            }
+            SetName( name, q );
+            _stack.Push( name );
+            _stackLengths.Push( (int)( q - name ) );
+            _rootSeen = true;
+            if ( !ParseAttributes( q ) ) {
+                return XML_PULL_ERROR;
+            }
+            return XML_START_ELEMENT;
+        }
+    }
+
+    if ( !_stack.Empty() ) {
+        return SetError( XML_ERROR_PARSING_ELEMENT, _stack.PeekTop() - 1 );
+    }
+    if ( !_rootSeen ) {
+        return SetError( XML_ERROR_EMPTY_DOCUMENT, _p );
+    }
+    return XML_END_DOCUMENT;
+}
+
+
+const char* XMLPullParser::Attribute( const char* name ) const
+{
+    for( int i=0; i<AttributeCount(); ++i ) {
+        if ( XMLUtil::StringEqual( AttributeName( i ), name ) ) {
+            return AttributeValue( i );
+        }
+    }
+    return 0;
+}
+
+
+const char* XMLPullParser::ReadElementText()
+{
+    const int depth = _stack.Size();
+    _elementText.Clear();
+    for( ;; ) {
+        XMLPullEvent event = Next();
+        if ( event == XML_TEXT ) {
+            if ( _stack.Size() == depth ) {
+                int length = _text.Size() - 1;
+                memcpy( _elementText.PushArr( length ), _text.Mem(), length );
+            }
+        }
+        else if ( event == XML_END_ELEMENT ) {
+            if ( _stack.Size() < depth ) {
+                break;
+            }
+        }
+        else if ( event != XML_START_ELEMENT ) {
+            return 0;
+        }
+    }
+    _elementText.Push( 0 );
+    return _elementText.Mem();
+}
+
+
+bool XMLPullParser::SkipElement()
+{
+    const int depth = _stack.Size();
+    for( ;; ) {
+        XMLPullEvent event = Next();
+        if ( event == XML_END_ELEMENT && _stack.Size() < depth ) {
+            return true;
+        }
+        if ( event == XML_END_DOCUMENT || event == XML_PULL_ERROR ) {
+            return false;
+        }
+    }
+}
+
+
+XMLError XMLPullParser::ReadDoubleChildren( const char* const* names, int count, double* values )
+{
+    DynArray< bool, 16 > found;
+    for( int i=0; i<count; ++i ) {
+        found.Push( false );
+    }
+    XMLError result = XML_SUCCESS;
+    const int depth = _stack.Size();
+    for( ;; ) {
+        XMLPullEvent event = Next();
+        if ( event == XML_END_ELEMENT && _stack.Size() < depth ) {
+            break;
+        }
+        if ( event == XML_END_DOCUMENT || event == XML_PULL_ERROR ) {
+            return _errorID;
+        }
+        if ( event != XML_START_ELEMENT ) {
+            continue;
+        }
+        int i = 0;
+        while ( i < count && ( found[i] || !NameIs( names[i] ) ) ) {
+            ++i;
+        }
+        if ( i == count ) {
+            if ( !SkipElement() ) {
+                return _errorID;
+            }
+            continue;
+        }
+        found[i] = true;
+        const char* text = ReadElementText();
+        if ( !text ) {
+            return _errorID;
+        }
+        if ( !XMLUtil::ToDouble( text, &values[i] ) ) {
+            result = XML_CAN_NOT_CONVERT_TEXT;
+        }
+    }
+    for( int i=0; i<count && result == XML_SUCCESS; ++i ) {
+        if ( !found[i] ) {
+            result = XML_NO_TEXT_NODE;
+        }
+    }
+    return result;
+}
+
+
+const char* XMLPullParser::ErrorName() const
+{
+    TIXMLASSERT( _errorID >= 0 && _errorID < XML_ERROR_COUNT );
+    return XMLDocument::_errorNames[_errorID];
+}
+
 }   // namespace tinyxml2
 
@@ -1495,6 +1495,27 @@ public:
     /// See QueryIntText()
     XMLError QueryFloatText( float* fval ) const;
 
+    /**
+    	Reads several numeric child elements in one pass, such as the
+    	components of a position:
+    	@verbatim
+    		static const char* const axes[] = { "x", "y", "z" };
+    		double p[3] = { 0, 0, 0 };
+    		positionElement->QueryDoubleChildren( axes, 3, p );
+    	@endverbatim
+
+    	values[i] receives the text of the first child element named names[i],
+    	in whatever order the children come; values without such a child, or
+    	whose text is not a number, are left unchanged.
+
+    	@returns XML_SUCCESS if every value was read, XML_CAN_NOT_CONVERT_TEXT
+    			 if a text could not be converted, and XML_NO_TEXT_NODE if a child
+    			 or its text is missing.
+    */
+    XMLError QueryDoubleChildren( const char* const* names, int count, double* values ) const;
+    /// See QueryDoubleChildren()
+    XMLError QueryFloatChildren( const char* const* names, int count, float* values ) const;
+
     // internal:
     enum {
         OPEN,		// <foo>
@@ -1545,6 +1566,7 @@ enum Whitespace {
 class TINYXML2_LIB XMLDocument : public XMLNode
 {
     friend class XMLElement;
+    friend class XMLPullParser;
 public:
     /// constructor
     XMLDocument( bool processEntities = true, Whitespace = PRESERVE_WHITESPACE );
@@ -1753,6 +1775,141 @@ private:
 };
 
 
+/// Events returned by XMLPullParser::Next().
+enum XMLPullEvent {
+    XML_START_ELEMENT,
+    XML_END_ELEMENT,
+    XML_TEXT,
+    XML_END_DOCUMENT,
+    XML_PULL_ERROR
+};
+
+
+/** A streaming (pull) parser. Where XMLDocument builds the whole DOM before
+	anything can be read, the pull parser reports each element as it is
+	tokenized and keeps nothing once the caller moves on, so memory is
+	bounded by the depth of the document and the longest text, not its size.
+	The buffer does not need to be null terminated, which suits a memory
+	mapped file, and is never modified; it must outlive the parser.
+
+	@verbatim
+	XMLPullParser parser( data, size );
+	XMLPullEvent event;
+	while ( (event = parser.Next()) == XML_START_ELEMENT || event == XML_TEXT ) {
+		...
+	}
+	@endverbatim
+
+	Declarations, comments and DOCTYPEs are skipped. Text which is only
+	whitespace is skipped; other text, and CDATA, is reported as XML_TEXT.
+	An empty element, <a/>, is reported as a start followed by an end.
+	Errors use the same codes as XMLDocument.
+*/
+class TINYXML2_LIB XMLPullParser
+{
+public:
+    /// Parse nBytes of xml, which need not be null terminated.
+    XMLPullParser( const char* xml, size_t nBytes, bool processEntities = true );
+
+    /// Advance to the next event.
+    XMLPullEvent Next();
+
+    /** Name of the element just started or ended. Only valid until the
+    	next call to Next().
+    */
+    const char* Name() const {
+        return _name.Mem();
+    }
+    /// Whether the element just started or ended is called name.
+    bool NameIs( const char* name ) const {
+        return XMLUtil::StringEqual( _name.Mem(), name );
+    }
+    /** Number of elements open: for XML_START_ELEMENT this includes the
+    	element just started, for XML_END_ELEMENT not the one just ended.
+    */
+    int Depth() const {
+        return _stack.Size();
+    }
+    /// Text of the last XML_TEXT event, with entities translated.
+    const char* Text() const {
+        return _text.Mem();
+    }
+
+    /// Number of attributes of the element just started.
+    int AttributeCount() const {
+        return _attributes.Size() / 2;
+    }
+    const char* AttributeName( int i ) const {
+        return _attributeChars.Mem() + _attributes[2*i];
+    }
+    const char* AttributeValue( int i ) const {
+        return _attributeChars.Mem() + _attributes[2*i+1];
+    }
+    /// Value of the named attribute of the element just started, or null.
+    const char* Attribute( const char* name ) const;
+
+    /** Called after XML_START_ELEMENT: reads up to and including the end of
+    	the element and returns its text (empty if none; the text of child
+    	elements is not included), or null on error. Valid until the next
+    	call to Next().
+    */
+    const char* ReadElementText();
+    /** Called after XML_START_ELEMENT: skips the rest of the element, up to
+    	and including its end. Returns false on error.
+    */
+    bool SkipElement();
+    /** Called after XML_START_ELEMENT: reads the rest of the element like
+    	XMLElement::QueryDoubleChildren(), returning its codes, or the
+    	parsing error.
+    */
+    XMLError ReadDoubleChildren( const char* const* names, int count, double* values );
+
+    /// Return true if there was an error parsing the document.
+    bool Error() const {
+        return _errorID != XML_NO_ERROR;
+    }
+    XMLError ErrorID() const {
+        return _errorID;
+    }
+    const char* ErrorName() const;
+    /// Byte offset in the buffer at which the error was found.
+    size_t ErrorOffset() const {
+        return _errorOffset;
+    }
+
+private:
+    XMLPullParser( const XMLPullParser& );	// not supported
+    void operator=( const XMLPullParser& );	// not supported
+
+    typedef DynArray< char, 256 > CharBuffer;
+
+    XMLPullEvent SetError( XMLError error, const char* p );
+    bool StartsWith( const char* p, const char* pattern ) const;
+    const char* Find( const char* p, const char* pattern ) const;
+    const char* ParseName( const char* p ) const;
+    bool ParseAttributes( const char* p );
+    void SetName( const char* p, const char* q );
+    void Decode( const char* p, const char* q, CharBuffer* out, bool translate ) const;
+
+    const char* _start;
+    const char* _p;
+    const char* _end;
+    bool        _processEntities;
+    bool        _pendingEnd;
+    bool        _rootSeen;
+    XMLError    _errorID;
+    size_t      _errorOffset;
+
+    CharBuffer  _name;
+    CharBuffer  _text;
+    CharBuffer  _elementText;
+    CharBuffer  _attributeChars;
+    DynArray< int, 16 >          _attributes;		// name and value offsets
+    DynArray< const char*, 16 >  _stack;			// open element names
+    DynArray< int, 16 >          _stackLengths;
+};
+
+
 /**
 	A XMLHandle is a class that wraps a node pointer with null checks; this is
 	an incredibly useful thing. Note that XMLHandle is not part of the TinyXML-2
@@ -2090,6 +2247,11 @@ protected:
 	*/
     virtual void PrintSpace( int depth );
     void Print( const char* format, ... );
+    /// Writes size bytes of data as they are, without formatting.
+    void Write( const char* data, size_t size );
+    void Write( const char* data ) {
+        Write( data, strlen( data ) );
+    }
 
     void SealElementIfJustOpened();
     bool _elementJustOpened;